@@ -29,6 +29,9 @@
 #include "bldr.h"
 #include "rsa.h"
 #include "sha1.h"
+#include "file.h"
+#include "krnl_cache.h"
+#include "ident_db.h"
 
 #define MIN_BIOS_SIZE 0x40000                                                    // Min bios file/rom size in bytes
 #define MAX_BIOS_SIZE 0x100000                                                   // Max bios file/rom size in bytes
@@ -55,6 +58,11 @@
 #define	BIOS_LOAD_STATUS_INVALID_BLDR	1 // success; but the bldr is invalid.
 #define	BIOS_LOAD_STATUS_FAILED			2 // ERROR
 
+// BIOS components; materialized on first access.
+#define BIOS_COMPONENT_PRELDR			0x01 // the preldr is located.
+#define BIOS_COMPONENT_BLDR				0x02 // the 2BL is decrypted and its boot params validated.
+#define BIOS_COMPONENT_KERNEL			0x04 // the kernel is decrypted.
+
 // Preldr status codes
 #define	PRELDR_STATUS_BLDR_DECRYPTED	0 // found and was used to load and decrypt the 2bl.
 #define PRELDR_STATUS_FOUND				1 // found but was not used to load the 2bl.
@@ -77,6 +85,8 @@ typedef struct {
 	PRELDR_FUNC_BLOCK* func_block;
 	XB_PUBLIC_KEY* public_key;
 	uint8_t bldr_key[SHA1_DIGEST_LEN];
+	uint8_t rom_hash[SHA1_DIGEST_LEN];	// sha1 of the rom below the FBL block, as the FBL hashes it
+	bool rom_hashed;					// rom_hash is set; the rom was hashed before anything was decrypted
 	uint32_t jmp_offset;
 	int status;
 } PRELDR;
@@ -101,6 +111,13 @@ typedef struct {
 	bool encryption_state;
 } KERNEL;
 
+// Bios bank layout
+typedef struct {
+	uint32_t romsize;		// size of the unique bank; the image is this bank mirrored.
+	uint32_t banks;			// number of MIN_BIOS_SIZE banks in the image.
+	uint32_t unique_banks;	// number of distinct MIN_BIOS_SIZE banks. more than 1 is a multi-bios flash or a larger rom.
+} BIOS_BANKS;
+
 // Bios load parameters
 typedef struct BIOS_LOAD_PARAMS {	
 	uint32_t romsize;
@@ -110,6 +127,7 @@ typedef struct BIOS_LOAD_PARAMS {
 	bool enc_bldr;
 	bool enc_kernel;
 	bool restore_boot_params;
+	const KRNL_CACHE* krnl_cache;	// decompressed kernel images are looked up here first. can be NULL
 } BIOS_LOAD_PARAMS;
 
 // Bios build parmeters 
@@ -155,17 +173,40 @@ public:
 		unload();
 	};
 
-	// unload the bios. reset values and free memory.
+	// unload the bios. reset values and free memory. a mapped bios is unmapped; a mapped build is flushed to its file.
 	void unload();
 	
-	// load bios from memory.
+	// load bios from memory. only the image offsets are calculated; the init table and rom data table
+	// are usable straight away. the preldr, 2BL and kernel are materialized on first access.
+	// returns BIOS_LOAD_STATUS_FAILED if the image could not be set up. the 2BL boot params are validated
+	// by loadBldr; check its status before using the 2BL or the kernel.
 	int load(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params);
 
+	// load bios from a mapped file. the bios takes ownership of the mapping.
+	// decryption only dirties the 2BL and kernel pages; the rest of the image stays shared with the page cache.
+	int load(MAPPED_FILE* file, const BIOS_LOAD_PARAMS* bios_params);
+
 	// build bios. 
-	int build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PARAMS* bios_params);
+	// filename: if not NULL, the bios is built directly into this file via a writable mapping.
+	int build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PARAMS* bios_params, const char* filename = NULL);
+
+	// locate the preldr. cached.
+	void loadPreldr();
+
+	// decrypt the 2BL and validate its boot params. cached.
+	// returns the bios status.
+	int loadBldr();
+
+	// decrypt the kernel. materializes the 2BL first. cached.
+	// returns the bios status.
+	int loadKernel();
 
 	// initialize bios and calculate offsets and pointers.
-	int init(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params);
+	// filename: if buff is NULL and filename is not NULL, the image is mapped to this file instead of allocated.
+	int init(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params, const char* filename = NULL);
+
+	// true if the image is a file mapping.
+	bool isMapped() const { return map.data != NULL; };
 		
 	// calculate initial offsets for the bios. based on params.
 	// sets up bldr and preldr structs, initTbl and dataTbl pointers.
@@ -186,6 +227,10 @@ public:
 	// preldr symmetric encryption and decryption for the 2BL.
 	void preldrSymmetricEncDecBldr(const uint8_t* key, const uint32_t len);
 
+	// validate the preldr.
+	// sets up the preldr struct.
+	void preldrValidate();
+
 	// validate the preldr and decrypt the 2bl.
 	// sets up the preldr struct and decrypts the 2bl.
 	void preldrValidateAndDecryptBldr();
@@ -196,15 +241,37 @@ public:
 	// symmetric encryption and decryption for the kernel.
 	void symmetricEncDecKernel();
 
-	// decompress the kernel image from the bios.
-	// stores results in decompressedKrnl pointer and decompressedKrnlSize.
+	// decompress the kernel image from the bios. materializes the kernel first. cached.
+	// with a kernel cache, a known kernel is mapped from the cache instead of decompressed.
+	// stores results in kernel.img and kernel.img_size.
 	// returns 0 if successful,
 	int decompressKrnl();
 
 	// preldr decrypt preldr public key.
 	int preldrDecryptPublicKey();
 
+	// verify the rom digest signature with the preldr public key. the signed digest is compared
+	// with the sha1 of the rom below the FBL block, taken when the preldr was located. the image is not modified.
+	// digest: output; the signed sha1 digest. can be NULL.
+	// returns 0 if the signature is valid and matches the rom, 1 if it does not,
+	// 2 if there is no sb key or the rom was not hashed ( a build ).
+	int preldrVerifyRomDigest(uint8_t* digest);
+
+	// the bytes of a component the way the identification database keys it. materializes the component.
+	// the kernel is the compressed kernel.
+	// returns 0 if successful, 1 if the component is not in the bios or could not be loaded.
+	int getComponent(const IDENT_TYPE type, const uint8_t** component, uint32_t* component_size);
+
+	// hash a component the way the identification database keys it. materializes the component.
+	// hash: output; SHA1_DIGEST_LEN bytes.
+	// returns 0 if successful, 1 if the component is not in the bios or could not be loaded.
+	int hashComponent(const IDENT_TYPE type, uint8_t* hash);
+
 private:
+	MAPPED_FILE map;
+	MAPPED_FILE img_map; // kernel.img when it is mapped from the kernel cache.
+	uint32_t components; // BIOS_COMPONENT_* materialized so far.
+
 	// reset bios; reset values.
 	void resetValues();
 };
@@ -215,7 +282,23 @@ void bios_init_kernel(KERNEL* kernel);
 void bios_init_params(BIOS_LOAD_PARAMS* params);
 void bios_init_build_params(BIOS_BUILD_PARAMS* params);
 void bios_free_build_params(BIOS_BUILD_PARAMS* params);
+void bios_preldr_create_key(const uint8_t* sbkey, const uint8_t* nonce, uint8_t* key);
 int bios_check_size(const uint32_t size);
+
+// check for the dos and pe signatures of an uncompressed kernel image.
+bool bios_is_kernel_img(const uint8_t* data, const uint32_t size);
+
+// lzx compress an uncompressed kernel image for a build. safe to run on a worker thread.
+// compressed_kernel: output; the compressed kernel. free it with free().
+// returns 0 if successful.
+int bios_compress_kernel(const uint8_t* img, const uint32_t img_size, uint8_t** compressed_kernel, uint32_t* kernel_size);
 int bios_replicate_data(uint32_t from, uint32_t to, uint8_t* buffer, uint32_t buffersize);
 
+// detect the rom size of a bios image by comparing its halves; the inverse of bios_replicate_data.
+// data: the bios image
+// size: the bios image size
+// banks: output; the bank layout
+// returns 0 if successful.
+int bios_detect_banks(const uint8_t* data, const uint32_t size, BIOS_BANKS* banks);
+
 #endif // !XB_BIOS_H
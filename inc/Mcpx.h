@@ -43,10 +43,20 @@ typedef struct {
 extern "C" {
 #endif
 
+struct IDENT_DB;
+
 void mcpx_init(MCPX* mcpx);
 void mcpx_free(MCPX* mcpx);
+
+// identify a mcpx rom by its hash with the built-in entries.
+// returns 0 if the rom is known, 1 otherwise.
 int mcpx_load(MCPX* mcpx, uint8_t* data);
 
+// identify a mcpx rom by its hash. the rev and sb key offset come from the database entry.
+// db: can be NULL; only the built-in entries are searched.
+// returns 0 if the rom is known, 1 otherwise.
+int mcpx_identify(MCPX* mcpx, uint8_t* data, const struct IDENT_DB* db);
+
 #ifdef __cplusplus
 };
 #endif
@@ -27,7 +27,16 @@
 // user incl
 #include "Bios.h"
 #include "Mcpx.h"
+#include "keyring.h"
+#include "ident_db.h"
+#include "bios_diff.h"
+#include "bios_map.h"
+#include "comp_store.h"
 #include "cli_tbl.h"
+#include "log.h"
+
+// commands separated by this argument run in order in one process. see runCommand().
+#define CMD_CHAIN_SEPARATOR "+"
 
 enum XB_CLI_COMMAND : CLI_COMMAND {
 	CMD_INFO = CLI_COMMAND_START_INDEX,
@@ -43,6 +52,16 @@ enum XB_CLI_COMMAND : CLI_COMMAND {
 	CMD_REPLICATE_BIOS,
 	CMD_COMPRESS_FILE,
 	CMD_DECOMPRESS_FILE,
+	CMD_TEA_SEARCH,
+	CMD_EEPROM,
+	CMD_XBE,
+	CMD_BUILD_MATRIX,
+	CMD_DIFF,
+	CMD_MKPATCH,
+	CMD_APPLYPATCH,
+	CMD_MKIDENT,
+	CMD_SCAN,
+	CMD_SIMILAR,
 };
 enum XB_CLI_SWITCH : CLI_SWITCH {
 	SW_ROMSIZE = CLI_SWITCH_START_INDEX,
@@ -84,7 +103,24 @@ enum XB_CLI_SWITCH : CLI_SWITCH {
 	SW_HELP_ALL,
 	SW_WORKING_DIRECTORY,
 	SW_OFFSET,
-	SW_XCODES
+	SW_XCODES,
+	SW_KEYRING,
+	SW_CHECKPOINT,
+	SW_GAME_REGION,
+	SW_BIOS_FILE,
+	SW_LS_BOOTABLE,
+	SW_KRNL_CACHE,
+	SW_CACHE_SIZE,
+	SW_WATCH,
+	SW_PATCH_FILE,
+	SW_IDENT,
+	SW_JSON,
+	SW_STORE,
+	SW_INDEX,
+	SW_TOP,
+	SW_LIMIT,
+	SW_LOG_LEVEL,
+	SW_LOG_FILE
 };
 
 typedef struct {
@@ -93,9 +129,17 @@ typedef struct {
 	uint32_t simSize;
 	uint32_t base;
 	uint32_t offset;
+	uint32_t game_region;
+	uint32_t cache_size;
+	uint32_t top;
+	uint32_t limit;
 	uint8_t* bldr_key;
 	uint8_t* kernel_key;
 	MCPX mcpx;
+	KEYRING keyring;
+	KRNL_CACHE krnl_cache;
+	IDENT_DB ident;
+	LOG_SINK log_sink;		// -log file sink; the null sink otherwise
 	const char* in_file;
 	const char* out_file;
 	const char* bank_files[4];
@@ -113,6 +157,16 @@ typedef struct {
 	const char* settings_file;
 	const char* working_directory_path;
 	const char* xcodes_file;
+	const char* keyring_path;
+	const char* checkpoint_file;
+	const char* bios_file;
+	const char* krnl_cache_path;
+	const char* patch_file;
+	const char* ident_path;
+	const char* store_path;
+	const char* index_path;
+	const char* log_level;
+	const char* log_file;
 } XbToolParameters;
 
 /* Command functions */
@@ -124,6 +178,7 @@ int helpEncryption();
 int listBios();
 int extractBios();
 int buildBios();
+int watchBuildBios(const BIOS_LOAD_PARAMS* bios_params, const BIOS_BUILD_PARAMS* build_params);
 int splitBios();
 int combineBios();
 int replicateBios();
@@ -133,11 +188,29 @@ int encodeX86();
 int dumpCoffPeImg();
 int compressFile();
 int decompressFile();
+int teaSearch();
+int decryptEeprom();
+int verifyXbe();
+int buildMatrix();
+int diffBios();
+int makePatch();
+int applyPatch();
+int makeIdentDb();
+int scanBios();
+int similarBios();
 
 void init_parameters(XbToolParameters* params);
 void free_parameters(XbToolParameters* params);
-int inject_xcodes(uint8_t* data, uint32_t size, uint8_t* xcodes, uint32_t xcodesSize);
 uint8_t* load_init_tbl_file(uint32_t* size, uint32_t* base);
+int trial_keyring(uint8_t* data, uint32_t size, BIOS_LOAD_PARAMS* bios_params, MCPX* mcpx);
+int detect_banks(uint8_t* data, uint32_t size, BIOS_LOAD_PARAMS* bios_params);
+int extract_component(const COMP_STORE* store, COMP_MANIFEST* manifest, uint32_t* added, const IDENT_TYPE type, const char* filename, const char* tag, uint8_t* data, const uint32_t size);
+int extract_manifest(const COMP_STORE* store, COMP_MANIFEST* manifest, const uint8_t* kernel_key, uint32_t added);
+void printDiffRegion(const char* name, const BIOS_DIFF_REGION* region);
+void printBiosMap(const BIOS_MAP* map);
+int read_krnl_cache();
+int read_log();
+int read_ident();
 
 /* BIOS print functions */
 void printBldrInfo(Bios* bios);
@@ -146,6 +219,11 @@ void printInitTblInfo(Bios* bios);
 void printNv2aInfo(Bios* bios);
 void printDataTblInfo(Bios* bios);
 void printKeyInfo(Bios* bios);
+void printIdentInfo(Bios* bios);
+int printBootInfo(Bios* bios);
+
+// parse and run a single command. the command line switches and parameters are reset first.
+int runCommand(int argc, char** argv);
 
 int main(int argc, char** argv);
 
@@ -0,0 +1,104 @@
+// bios_diff.h: Component aware BIOS diff backed by a page hash index.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BIOS_DIFF_H
+#define XB_BIOS_DIFF_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+
+#define BIOS_DIFF_PAGE_SIZE 0x1000
+#define BIOS_DIFF_SECTION_NAME_LEN 8
+
+// bios diff error codes
+#define BIOS_DIFF_ERROR_SUCCESS 0
+#define BIOS_DIFF_ERROR_FAILED 1
+
+// region present flags
+#define BIOS_DIFF_IN_A 0x01
+#define BIOS_DIFF_IN_B 0x02
+
+// a page hash index of an image. equal pages have equal hashes.
+typedef struct {
+	uint64_t* hashes;
+	uint32_t count;
+	uint32_t size;					// image size in bytes; the last page can be short.
+} BIOS_PAGE_INDEX;
+
+// diffed components
+typedef enum {
+	BIOS_DIFF_PRELDR,
+	BIOS_DIFF_BLDR,					// decrypted 2BL block
+	BIOS_DIFF_BOOT_PARAMS,
+	BIOS_DIFF_KEYS,					// eeprom, cert and kernel keys
+	BIOS_DIFF_INIT_TBL,				// init table header
+	BIOS_DIFF_XCODES,				// init table after the header
+	BIOS_DIFF_KERNEL,				// decrypted compressed kernel
+	BIOS_DIFF_KERNEL_DATA,
+	BIOS_DIFF_COMPONENT_COUNT
+} BIOS_DIFF_COMPONENT;
+
+// the diff of one region
+typedef struct {
+	uint32_t size_a;
+	uint32_t size_b;
+	uint32_t diff_bytes;			// differing bytes over the common size, plus the size difference
+	uint32_t first_diff;			// offset of the first differing byte
+	uint8_t present;				// BIOS_DIFF_IN_A | BIOS_DIFF_IN_B
+} BIOS_DIFF_REGION;
+
+// the diff of a kernel pe section
+typedef struct {
+	char name[BIOS_DIFF_SECTION_NAME_LEN + 1];
+	BIOS_DIFF_REGION region;
+} BIOS_DIFF_SECTION;
+
+typedef struct {
+	uint32_t pages;					// pages in the larger image
+	uint32_t diff_pages;			// pages that differ at the same offset
+	uint32_t moved_pages;			// differing pages of b found elsewhere in a
+	bool identical;
+	BIOS_DIFF_REGION components[BIOS_DIFF_COMPONENT_COUNT];
+	BIOS_DIFF_SECTION* sections;	// kernel pe sections by name; NULL unless requested
+	uint32_t section_count;
+	bool kernel_decompressed;		// both kernels were decompressed and the sections diffed
+} BIOS_DIFF;
+
+// hash the fixed size pages of an image.
+// returns BIOS_DIFF_ERROR_SUCCESS or BIOS_DIFF_ERROR_FAILED.
+int bios_page_index(const uint8_t* data, const uint32_t size, BIOS_PAGE_INDEX* index);
+void bios_page_index_free(BIOS_PAGE_INDEX* index);
+
+// the 64-bit page hash of a buffer of any size. fast; not a cryptographic hash.
+uint64_t bios_page_hash(const uint8_t* data, const uint32_t size);
+
+// diff two loaded bioses. identical images are reported without decrypting anything;
+// a component is only decrypted when its raw bytes differ.
+// kernel_sections: decompress both kernels and diff them by pe section.
+// returns BIOS_DIFF_ERROR_SUCCESS or BIOS_DIFF_ERROR_FAILED.
+int bios_diff(Bios* a, Bios* b, const bool kernel_sections, BIOS_DIFF* diff);
+void bios_diff_free(BIOS_DIFF* diff);
+
+const char* bios_diff_component_name(const BIOS_DIFF_COMPONENT component);
+
+#endif // !XB_BIOS_DIFF_H
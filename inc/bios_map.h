@@ -0,0 +1,111 @@
+// bios_map.h: Free space map of a BIOS rom and a layout planner.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BIOS_MAP_H
+#define XB_BIOS_MAP_H
+
+#include <stdint.h>
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+// zero runs shorter than this are mapped as part of the bytes around them.
+#define BIOS_MAP_MIN_FREE 16
+
+// bios map error codes
+#define BIOS_MAP_ERROR_SUCCESS 0
+#define BIOS_MAP_ERROR_FAILED 1		// out of memory
+#define BIOS_MAP_ERROR_NO_SPACE 2	// an item does not fit in any free run
+
+// region owners
+typedef enum {
+	BIOS_MAP_FREE,
+	BIOS_MAP_INIT_TBL,				// init table header
+	BIOS_MAP_XCODES,				// xcodes up to and including the exit xcode
+	BIOS_MAP_DATA_TBL,				// rom data table
+	BIOS_MAP_KERNEL,				// compressed kernel
+	BIOS_MAP_KERNEL_DATA,
+	BIOS_MAP_BLDR,					// 2BL block, less the FBL
+	BIOS_MAP_PRELDR,				// FBL block
+	BIOS_MAP_MCPX,					// hidden by the mcpx rom
+	BIOS_MAP_PAYLOAD,				// placed by the planner
+	BIOS_MAP_UNKNOWN,				// non-zero bytes with no known owner
+	BIOS_MAP_OWNER_COUNT
+} BIOS_MAP_OWNER;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+	BIOS_MAP_OWNER owner;
+} BIOS_MAP_REGION;
+
+// the component sizes a map is built from. a kernel size of 0 is unknown;
+// the kernel bytes are then mapped as unknown.
+typedef struct {
+	uint32_t romsize;
+	uint32_t kernel_size;			// compressed kernel size
+	uint32_t kernel_data_size;		// uncompressed kernel data size
+	bool preldr;					// the 2BL block ends with a FBL
+} BIOS_LAYOUT;
+
+// the regions of one bank, in offset order. they cover the bank with no gaps.
+typedef struct {
+	BIOS_MAP_REGION* regions;
+	uint32_t count;
+	uint32_t romsize;
+	uint32_t free_bytes;
+	uint32_t free_runs;
+	uint32_t largest_free;
+} BIOS_MAP;
+
+// an item to place.
+typedef struct {
+	BIOS_MAP_OWNER owner;			// the owner the placed region is mapped as
+	uint32_t size;
+	uint32_t align;					// 0, or a power of 2
+	uint32_t offset;				// output
+} BIOS_MAP_ITEM;
+
+// map the first bank of a bios image.
+// data: the image; at least layout->romsize bytes.
+// returns BIOS_MAP_ERROR_SUCCESS or BIOS_MAP_ERROR_FAILED.
+int bios_map_build(const uint8_t* data, const BIOS_LAYOUT* layout, BIOS_MAP* map);
+void bios_map_free(BIOS_MAP* map);
+
+// find the region that contains offset.
+// returns the region, or NULL if the offset is outside the bank.
+const BIOS_MAP_REGION* bios_map_find(const BIOS_MAP* map, const uint32_t offset);
+
+// place items in the free runs. the largest item goes first, into the largest free run; O(n log n).
+// the placed items are added to the map. nothing is placed unless every item fits.
+// returns a BIOS_MAP_ERROR_* code.
+int bios_map_plan(BIOS_MAP* map, BIOS_MAP_ITEM* items, const uint32_t count);
+
+// add xcodes to the init table of a built bios. they replace the exit xcode when the free run after it fits them,
+// otherwise they are planned into free space and the exit xcode jumps to them. the first bank is replicated to size.
+// data: the image; size bytes, at least layout->romsize.
+// returns a BIOS_MAP_ERROR_* code.
+int bios_inject_xcodes(uint8_t* data, const uint32_t size, const BIOS_LAYOUT* layout, const uint8_t* xcodes, const uint32_t xcodes_size);
+
+const char* bios_map_owner_name(const BIOS_MAP_OWNER owner);
+
+#endif // !XB_BIOS_MAP_H
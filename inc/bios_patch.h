@@ -0,0 +1,75 @@
+// bios_patch.h: Compact binary patches between BIOS images.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BIOS_PATCH_H
+#define XB_BIOS_PATCH_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+#include "sha1.h"
+
+#define BIOS_PATCH_MAGIC 0x54504258 // 'XBPT'
+#define BIOS_PATCH_VERSION 1
+
+// patch modes
+#define BIOS_PATCH_MODE_RAW 0			// a delta of the raw images
+#define BIOS_PATCH_MODE_COMPONENT 1		// a delta of the decrypted images, and of the decompressed kernels if the kernel changed
+
+// bios patch error codes
+#define BIOS_PATCH_ERROR_SUCCESS 0
+#define BIOS_PATCH_ERROR_FAILED 1		// out of memory
+#define BIOS_PATCH_ERROR_INVALID 2		// not a patch, or the patch is corrupt
+#define BIOS_PATCH_ERROR_SRC_HASH 3		// the patch is for a different BIOS
+#define BIOS_PATCH_ERROR_DST_HASH 4		// the patched BIOS does not match the patch
+#define BIOS_PATCH_ERROR_KEYS 5			// a component patch does not fit the source decrypted with the given keys
+
+// patch header. followed by the image delta and the kernel delta.
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t mode;
+	uint32_t src_size;
+	uint32_t dst_size;
+	uint32_t romsize;				// size of the patched bank; it is replicated to dst_size
+	uint32_t image_delta_size;
+	uint32_t kernel_delta_size;		// component mode only; 0 if the compressed kernel is in the image delta
+	uint32_t kernel_img_size;		// size of the patched kernel image
+	uint8_t src_hash[SHA1_DIGEST_LEN];
+	uint8_t dst_hash[SHA1_DIGEST_LEN];
+} BIOS_PATCH_HEADER;
+
+// create a patch from src to dst. a component patch is used if it reproduces dst and is smaller than a raw patch.
+// params: keys used to decrypt the components; the romsize is detected.
+// patch: output; free it with free().
+// returns BIOS_PATCH_ERROR_SUCCESS or BIOS_PATCH_ERROR_FAILED.
+int bios_patch_create(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size,
+	const BIOS_LOAD_PARAMS* params, uint8_t** patch, uint32_t* patch_size);
+
+// apply a patch to src. the source and result hashes are verified.
+// params: keys used to decrypt and re-encrypt the components of a component patch.
+// dst: output; free it with free().
+// returns a BIOS_PATCH_ERROR_* code.
+int bios_patch_apply(const uint8_t* src, const uint32_t src_size, const uint8_t* patch, const uint32_t patch_size,
+	const BIOS_LOAD_PARAMS* params, uint8_t** dst, uint32_t* dst_size);
+
+#endif // !XB_BIOS_PATCH_H
@@ -0,0 +1,104 @@
+// bios_scan.h: Scans a directory tree of BIOS images.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BIOS_SCAN_H
+#define XB_BIOS_SCAN_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+#include "Mcpx.h"
+#include "keyring.h"
+#include "ident_db.h"
+#include "bios_sketch.h"
+
+// bios scan error codes
+#define BIOS_SCAN_ERROR_SUCCESS 0
+#define BIOS_SCAN_ERROR_FAILED 1
+
+// report formats
+#define BIOS_SCAN_FORMAT_CSV 0
+#define BIOS_SCAN_FORMAT_JSON 1
+
+#define BIOS_SCAN_NO_DUPLICATE -1	// the file is the first copy of its contents
+#define BIOS_SCAN_BOOT_NOT_RUN -1	// the mcpx revision was not simulated
+
+// scan result for one file
+typedef struct {
+	char* filename;
+	uint32_t size;
+	int duplicate_of;				// index of the first file with the same contents, or BIOS_SCAN_NO_DUPLICATE. duplicates are not loaded
+	int status;						// BIOS_LOAD_STATUS_*; BIOS_LOAD_STATUS_FAILED if the file could not be read
+	BIOS_BANKS banks;
+	uint32_t romsize;				// rom size the image was loaded with
+	int preldr_status;				// PRELDR_STATUS_*
+	const char* bldr_key;			// the 2BL key: "key-bldr", "mcpx", a keyring key name or "none"
+	const char* kernel_key;			// the kernel key: "key-krnl", "2BL", a keyring key name, "none" or "" if not found
+	BOOT_PARAMS boot_params;		// valid if status is BIOS_LOAD_STATUS_SUCCESS
+	uint16_t kernel_ver;			// init table kernel version; the delay flag is cleared
+	bool kernel_delay;				// init table kernel delay flag
+	uint32_t hashes;				// bit per IDENT_TYPE_* hashed
+	uint8_t hash[IDENT_TYPE_COUNT][SHA1_DIGEST_LEN];	// component hashes; the identification database keys
+	int boot[2];					// per mcpx rev: the BOOT_STEP the boot stopped at, BOOT_STEP_COUNT if it boots, or BIOS_SCAN_BOOT_NOT_RUN
+	BIOS_SKETCH* sketch;			// NULL if not sketched. a duplicate shares the sketch of its first copy
+} BIOS_SCAN_RESULT;
+
+// a scan of a directory tree
+typedef struct {
+	BIOS_SCAN_RESULT* results;		// in enumeration order
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t unique;				// files that are not duplicates
+	uint32_t loaded;				// unique files loaded with a valid 2BL
+	uint64_t bytes;					// total bytes of the unique files
+} BIOS_SCAN;
+
+// scan parameters; shared read only by every worker.
+typedef struct {
+	const BIOS_LOAD_PARAMS* params;	// keys, mcpx, enc flags, kernel cache. romsize 0 = detected per image
+	const KEYRING* keyring;			// can be NULL; the keys of each image are found in it
+	bool sketch;					// sketch the components of each image for a similarity index
+} BIOS_SCAN_PARAMS;
+
+void bios_scan_init(BIOS_SCAN* scan);
+void bios_scan_free(BIOS_SCAN* scan);
+
+// scan every BIOS sized file in a directory and its sub directories.
+// files are grouped by size, and only files that share a size are hashed to find duplicates;
+// a duplicate is reported against its first copy and not loaded again.
+// when sketching, each unique kernel is decompressed once; images with the same kernel share its sketch.
+// the unique files are loaded on a work stealing pool, one file per work item.
+// threads: worker count; 0 = one per core.
+// returns BIOS_SCAN_ERROR_SUCCESS or BIOS_SCAN_ERROR_FAILED.
+int bios_scan(BIOS_SCAN* scan, const char* path, const BIOS_SCAN_PARAMS* params, int threads);
+
+// render a scan as a csv or json report; one row / object per file.
+// ident: can be NULL; known components are named in the json report.
+// text: output; free it with free().
+// returns BIOS_SCAN_ERROR_SUCCESS or BIOS_SCAN_ERROR_FAILED.
+int bios_scan_report(const BIOS_SCAN* scan, const int format, const IDENT_DB* ident, char** text, uint32_t* size);
+
+// write the sketches of a scan to a similarity index; one entry per sketched file. see bios_sketch.h
+// returns BIOS_SCAN_ERROR_SUCCESS or BIOS_SCAN_ERROR_FAILED.
+int bios_scan_index(const BIOS_SCAN* scan, const char* filename);
+
+#endif // !XB_BIOS_SCAN_H
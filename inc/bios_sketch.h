@@ -0,0 +1,129 @@
+// bios_sketch.h: MinHash sketches of BIOS components and a similarity index.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BIOS_SKETCH_H
+#define XB_BIOS_SKETCH_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+#include "file.h"
+#include "sha1.h"
+#include "ident_db.h"
+
+#define BIOS_SKETCH_MAGIC 0x4B534258 // 'XBSK'
+#define BIOS_SKETCH_VERSION 1
+
+#define BIOS_SKETCH_SIZE 64			// min hash buckets per component; a power of 2
+#define BIOS_SKETCH_SHINGLE 8		// bytes hashed at each offset of a component
+#define BIOS_SKETCH_EMPTY 0xFFFF	// a bucket no shingle fell in
+
+// the sketched components; preldr, 2BL, init table, kernel and kernel data.
+#define BIOS_SKETCH_COMPONENTS (IDENT_TYPE_COUNT - IDENT_TYPE_PRELDR)
+#define BIOS_SKETCH_SLOT(type) ((type) - IDENT_TYPE_PRELDR)
+
+// bios sketch error codes
+#define BIOS_SKETCH_ERROR_SUCCESS 0
+#define BIOS_SKETCH_ERROR_FAILED 1		// out of memory, or the file could not be read or written
+#define BIOS_SKETCH_ERROR_INVALID 2		// not a sketch index
+
+// the sketch of a BIOS. the similarity of two components is the fraction of their buckets that hold
+// the same minimum; an estimate of the jaccard similarity of their shingles.
+typedef struct {
+	uint32_t hashes;				// bit per IDENT_TYPE_* hashed
+	uint32_t sketches;				// bit per IDENT_TYPE_* sketched
+	uint8_t hash[BIOS_SKETCH_COMPONENTS][SHA1_DIGEST_LEN];		// component hashes; see Bios::hashComponent()
+	uint16_t mins[BIOS_SKETCH_COMPONENTS][BIOS_SKETCH_SIZE];	// the low 16 bits of the minimum of each bucket
+} BIOS_SKETCH;
+
+// index image header. followed by count entries and strings_size bytes of strings.
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t sketch_size;			// BIOS_SKETCH_SIZE
+	uint32_t count;
+	uint32_t strings_size;
+} BIOS_SKETCH_HEADER;
+
+// an indexed image
+typedef struct {
+	uint32_t name;					// string offset of the file name
+	BIOS_SKETCH sketch;
+} BIOS_SKETCH_ENTRY;
+
+// an index mapped from a file. read only, so it can be shared between threads.
+typedef struct {
+	const BIOS_SKETCH_HEADER* header;
+	const BIOS_SKETCH_ENTRY* entries;
+	const char* strings;
+	MAPPED_FILE map;
+} BIOS_SKETCH_INDEX;
+
+// a query result
+typedef struct {
+	uint32_t entry;
+	float score;									// mean of the component similarities
+	float similarity[BIOS_SKETCH_COMPONENTS];		// 0 - 1, or -1 if neither image has the component
+} BIOS_SKETCH_MATCH;
+
+void bios_sketch_init(BIOS_SKETCH* sketch);
+
+// sketch a component. a shingle is hashed at every offset, and each hash goes to one bucket.
+void bios_sketch_component(BIOS_SKETCH* sketch, const IDENT_TYPE type, const uint8_t* data, const uint32_t size);
+
+// hash the components of a loaded bios and sketch all but the kernel. a small change to the kernel changes
+// the rest of its compressed stream, so the kernel is sketched from its image by bios_sketch_kernel().
+// returns BIOS_SKETCH_ERROR_SUCCESS, or BIOS_SKETCH_ERROR_FAILED if the 2BL could not be loaded.
+int bios_sketch_bios(Bios* bios, BIOS_SKETCH* sketch);
+
+// decompress the kernel and sketch its image.
+// returns BIOS_SKETCH_ERROR_SUCCESS, or BIOS_SKETCH_ERROR_FAILED if the kernel could not be decompressed.
+int bios_sketch_kernel(Bios* bios, BIOS_SKETCH* sketch);
+
+// compare two sketches. components with equal hashes are identical; the buckets are not compared.
+// a component with a different hash scores just under 1 at most.
+// similarity: output; per component, 0 - 1 or -1 if neither sketch has it. can be NULL.
+// returns the mean similarity of the components either sketch has.
+float bios_sketch_compare(const BIOS_SKETCH* a, const BIOS_SKETCH* b, float* similarity);
+
+// write an index of sketches.
+// returns BIOS_SKETCH_ERROR_SUCCESS or BIOS_SKETCH_ERROR_FAILED.
+int bios_sketch_index_write(const char* filename, const char* const* names, const BIOS_SKETCH* const* sketches, const uint32_t count);
+
+// map an index file.
+// returns a BIOS_SKETCH_ERROR_* code.
+int bios_sketch_index_open(BIOS_SKETCH_INDEX* index, const char* filename);
+void bios_sketch_index_close(BIOS_SKETCH_INDEX* index);
+
+// copy the kernel sketch of an indexed image with the same kernel hash, so the kernel need not be decompressed.
+// returns true if the kernel was found.
+bool bios_sketch_index_kernel(const BIOS_SKETCH_INDEX* index, BIOS_SKETCH* sketch);
+
+// find the indexed images closest to a sketch.
+// matches: output; best first.
+// count: the number of matches wanted; output, the number found.
+void bios_sketch_index_query(const BIOS_SKETCH_INDEX* index, const BIOS_SKETCH* query, BIOS_SKETCH_MATCH* matches, uint32_t* count);
+
+// the file name of an entry.
+const char* bios_sketch_index_name(const BIOS_SKETCH_INDEX* index, const uint32_t entry);
+
+#endif // !XB_BIOS_SKETCH_H
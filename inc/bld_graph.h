@@ -0,0 +1,85 @@
+// bld_graph.h: An incremental BIOS build; stages are rebuilt only when their inputs change.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BLD_GRAPH_H
+#define XB_BLD_GRAPH_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+#include "sha1.h"
+
+// build graph nodes. input files -> kernel compress -> 2BL patch -> RC4 -> preldr -> replicate
+typedef enum {
+	BLD_NODE_BLDR,
+	BLD_NODE_INITTBL,
+	BLD_NODE_KRNL,
+	BLD_NODE_KRNLDATA,
+	BLD_NODE_PRELDR,
+	BLD_NODE_EEPROM_KEY,
+	BLD_NODE_CERT_KEY,
+	BLD_NODE_XCODES,				// not used by the stages; applied by the caller
+	BLD_NODE_INPUT_COUNT,
+	BLD_NODE_COMPRESS = BLD_NODE_INPUT_COUNT, // krnl -> compressed kernel
+	BLD_NODE_BLDR_PATCH,			// inputs, compressed kernel -> one bank; boot params and keys patched, kernel encrypted
+	BLD_NODE_RC4,					// bank -> bank with the 2BL encrypted
+	BLD_NODE_PRELDR_COPY,			// bank, preldr -> bank with the preldr
+	BLD_NODE_IMAGE,					// bank -> bios image, replicated to binsize
+	BLD_NODE_COUNT
+} BLD_NODE_ID;
+
+// a node; an input file or the output of a stage.
+typedef struct {
+	const char* path;				// input file; NULL for stages and unused inputs
+	uint64_t size;					// file size at the last read
+	int64_t mtime;					// file mtime at the last read
+	uint8_t hash[SHA1_DIGEST_LEN];	// hash of the output; an input is its content, a stage is its inputs
+	uint8_t* data;
+	uint32_t data_size;
+	bool rebuilt;					// the output changed in the last update / build
+} BLD_NODE;
+
+typedef struct {
+	BLD_NODE nodes[BLD_NODE_COUNT];
+	bool compressed;				// the kernel was an uncompressed image
+	uint32_t romsize;				// bank size; set by the 2BL patch stage
+	uint32_t bfm_key_offset;		// offset of the 2BL bfm key in the bank; 0 if there is none
+} BLD_GRAPH;
+
+void bld_graph_init(BLD_GRAPH* graph);
+void bld_graph_free(BLD_GRAPH* graph);
+
+// set the file of an input node. the path is not copied.
+void bld_graph_set_input(BLD_GRAPH* graph, const BLD_NODE_ID id, const char* path);
+
+// re-read the inputs whose size or mtime changed and flag the ones whose content changed.
+// returns the number of changed inputs, or -1 if an input could not be read.
+int bld_graph_update(BLD_GRAPH* graph);
+
+// run the stages whose inputs changed; the others keep their cached output. a stage is keyed by
+// the hashes of the nodes it reads and the settings it uses.
+// build_params: build flags. the buffers come from the graph.
+// the image is nodes[BLD_NODE_IMAGE].data
+// returns BIOS_LOAD_STATUS_SUCCESS or BIOS_LOAD_STATUS_FAILED.
+int bld_graph_build(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const uint32_t binsize, const BIOS_LOAD_PARAMS* params);
+
+#endif // !XB_BLD_GRAPH_H
@@ -0,0 +1,85 @@
+// bld_matrix.h: Build a matrix of BIOS variants declared in a manifest.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BLD_MATRIX_H
+#define XB_BLD_MATRIX_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+
+#define BLD_MATRIX_NAME_LEN 64
+
+// build matrix error codes
+#define BLD_MATRIX_ERROR_SUCCESS 0
+#define BLD_MATRIX_ERROR_FAILED 1		// invalid manifest, missing input or out of memory
+#define BLD_MATRIX_ERROR_BUILD 2		// one or more variants failed to build
+
+// a variant; a [section] of the manifest. settings it does not set are taken from the global section.
+typedef struct {
+	char name[BLD_MATRIX_NAME_LEN];
+	char* out;						// output file; defaults to <name>.bin
+	uint32_t romsize;				// bytes
+	uint32_t binsize;				// bytes; 0 = romsize
+	bool bfm;
+	bool enc_bldr;
+	bool enc_kernel;
+	bool hackinittbl;
+	bool hacksignature;
+	bool nobootparams;
+	uint8_t* kernel_key;			// shared between variants; NULL = the load params key
+	uint8_t* eeprom_key;			// shared between variants; can be NULL
+	uint8_t* cert_key;				// shared between variants; can be NULL
+	int result;						// BIOS_LOAD_STATUS_* of the build
+	uint32_t size;					// output size in bytes
+} BLD_VARIANT;
+
+// a file loaded once and shared between variants
+typedef struct {
+	char* path;
+	uint8_t* data;
+} BLD_MATRIX_FILE;
+
+// a loaded manifest. the inputs are loaded and processed once and shared by every variant.
+typedef struct {
+	BIOS_BUILD_PARAMS inputs;		// init tbl, preldr, 2BL, compressed kernel, kernel data
+	BLD_VARIANT* variants;
+	uint32_t count;
+	BLD_MATRIX_FILE* keys;			// key files by path
+	uint32_t key_count;
+	uint32_t kernel_img_size;		// size of the uncompressed kernel image, if the kernel was compressed here. otherwise 0
+} BLD_MATRIX;
+
+void bld_matrix_init(BLD_MATRIX* matrix);
+void bld_matrix_free(BLD_MATRIX* matrix);
+
+// load a manifest and its inputs. input paths are relative to the working directory.
+// returns BLD_MATRIX_ERROR_SUCCESS or BLD_MATRIX_ERROR_FAILED.
+int bld_matrix_load(BLD_MATRIX* matrix, const char* manifest);
+
+// build every variant into its output file, in parallel.
+// params: load params shared by every variant; mcpx, bldr key, kernel key.
+// threads: worker count; 0 = one per core. the variants are built one at a time if any output is a memory file.
+// returns BLD_MATRIX_ERROR_SUCCESS if every variant was built, otherwise BLD_MATRIX_ERROR_BUILD.
+int bld_matrix_build(BLD_MATRIX* matrix, const BIOS_LOAD_PARAMS* params, int threads);
+
+#endif // !XB_BLD_MATRIX_H
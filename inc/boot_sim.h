@@ -0,0 +1,86 @@
+// boot_sim.h: Simulate the MCPX, FBL and 2BL boot state machines over a BIOS image.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_BOOT_SIM_H
+#define XB_BOOT_SIM_H
+
+#include <stdint.h>
+
+// user incl
+#include "Bios.h"
+#include "Mcpx.h"
+
+// boot sim error codes
+#define BOOT_SIM_ERROR_SUCCESS 0	// the kernel entry was reached
+#define BOOT_SIM_ERROR_FAILED 1		// invalid image or out of memory
+#define BOOT_SIM_ERROR_NO_BOOT 2	// the boot stopped; see BOOT_SIM_RESULT.step
+
+// boot steps in boot order. see boot_state_diagram_*.md
+typedef enum {
+	BOOT_STEP_XCODES,				// sb: run the xcode interpreter over the init table
+	BOOT_STEP_SB_DECRYPT_BLDR,		// mcpx 1.0: rc4 decrypt the 2BL with the sb key
+	BOOT_STEP_SB_BLDR_SIGNATURE,	// mcpx 1.0: compare the 2BL boot signature
+	BOOT_STEP_SB_HASH_FBL,			// mcpx 1.1: tea hash the FBL
+	BOOT_STEP_SB_FBL_HASH,			// mcpx 1.1: compare the FBL hash with the mcpx rom
+	BOOT_STEP_FBL_DECRYPT_PK,		// FBL: rc4 decrypt the public key
+	BOOT_STEP_FBL_VERIFY_ROM,		// FBL: compare the signed rom digest with the sha1 of the rom
+	BOOT_STEP_FBL_DECRYPT_BLDR,		// FBL: build the 2BL key and decrypt the 2BL
+	BOOT_STEP_BLDR_BOOT_PARAMS,		// 2BL: the boot params fit the rom
+	BOOT_STEP_BLDR_DECRYPT_KERNEL,	// 2BL: rc4 decrypt the kernel
+	BOOT_STEP_BLDR_DECOMPRESS_KERNEL,// 2BL: lzx decompress the kernel
+	BOOT_STEP_BLDR_KERNEL_ENTRY,	// 2BL: locate the kernel entry
+	BOOT_STEP_COUNT
+} BOOT_STEP;
+
+// boot step results
+#define BOOT_RESULT_NOT_RUN 0		// not on the boot path or the boot stopped before it
+#define BOOT_RESULT_PASS 1
+#define BOOT_RESULT_FAIL 2			// the boot stops; the console shuts down here
+#define BOOT_RESULT_UNKNOWN 3		// could not be checked without the mcpx rom or a rom hash; the boot stops with no verdict
+#define BOOT_RESULT_NO_KEY 4		// the sb key is needed; the boot stops
+
+// boot sim result
+typedef struct {
+	MCPX_REV rev;					// the mcpx revision simulated
+	int result[BOOT_STEP_COUNT];	// BOOT_RESULT_* of each step
+	BOOT_STEP step;					// the step the boot stopped at; BOOT_STEP_COUNT if the kernel entry was reached
+	uint32_t fbl_hash[2];			// mcpx 1.1 tea hash of the FBL
+	uint32_t kernel_entry;			// kernel entry point; image base + entry rva
+} BOOT_SIM_RESULT;
+
+// simulate the boot of a BIOS image on an mcpx revision, step by step. the image is not modified.
+// only the unique bank of a mirrored image is copied and booted.
+// data: the BIOS image
+// size: the BIOS image size
+// params: the sb key (bldr_key or mcpx->sbkey), kernel key and enc_kernel. mcpx->data is needed for the FBL hash.
+// rev: MCPX_REV_0 or MCPX_REV_1
+// result: output; the result of every step
+// returns BOOT_SIM_ERROR_SUCCESS if the image boots, BOOT_SIM_ERROR_NO_BOOT if it stops at a step.
+int boot_simulate(const uint8_t* data, const uint32_t size, const BIOS_LOAD_PARAMS* params, const MCPX_REV rev, BOOT_SIM_RESULT* result);
+
+// true if the step is on the boot path of the mcpx revision.
+bool boot_step_on_path(const BOOT_STEP step, const MCPX_REV rev);
+
+// name of a step / result.
+const char* boot_step_name(const BOOT_STEP step);
+const char* boot_result_name(const int result);
+
+#endif // !XB_BOOT_SIM_H
@@ -101,6 +101,7 @@ int parseCli(int argc, char* argv[],
 
 void setFlag(const CLI_SWITCH sw);
 void clearFlag(const CLI_SWITCH sw);
+void clearFlags();
 bool isFlagSet(const CLI_SWITCH sw);
 bool isFlagClear(const CLI_SWITCH sw);
 
@@ -0,0 +1,82 @@
+// comp_store.h: A content addressed store of extracted BIOS components.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_COMP_STORE_H
+#define XB_COMP_STORE_H
+
+#include <stdint.h>
+
+// user incl
+#include "sha1.h"
+#include "ident_db.h"
+#include "bld_matrix.h"
+
+// component store error codes
+#define COMP_STORE_ERROR_SUCCESS 0
+#define COMP_STORE_ERROR_FAILED 1
+
+// a store directory. objects are named by the SHA-1 of their contents; <path>/<first byte hex>/<sha1 hex>.
+// an object is never modified once stored, so a store can be shared between threads and processes.
+typedef struct {
+	char* path;
+} COMP_STORE;
+
+// the components of one BIOS; written as a /bld-matrix manifest that rebuilds the BIOS from the store.
+typedef struct {
+	char name[BLD_MATRIX_NAME_LEN];		// the variant name; the rebuilt BIOS is <name>.bin
+	uint32_t components;				// bit per IDENT_TYPE_* stored
+	uint8_t hash[IDENT_TYPE_COUNT][SHA1_DIGEST_LEN];
+	bool kernel_key;					// the kernel was encrypted with a key from outside the 2BL
+	uint8_t kernel_key_hash[SHA1_DIGEST_LEN];
+	uint32_t romsize;					// bytes
+	uint32_t binsize;					// bytes
+	bool enc_bldr;						// the 2BL is not encrypted
+	bool enc_kernel;					// the kernel is encrypted with the 2BL kernel key
+} COMP_MANIFEST;
+
+// open a store directory; it is created if it does not exist.
+// returns COMP_STORE_ERROR_SUCCESS or COMP_STORE_ERROR_FAILED.
+int comp_store_open(COMP_STORE* store, const char* path);
+void comp_store_close(COMP_STORE* store);
+
+// the filename of an object.
+// returns the filename; free it with free(). NULL if out of memory.
+char* comp_store_filename(const COMP_STORE* store, const uint8_t hash[SHA1_DIGEST_LEN]);
+
+// store an object. an object already in the store is not written again. a new object is written to
+// a temporary file and renamed into place, so readers never see a partial object.
+// hash: output; the object name.
+// added: output; true if the object was new. can be NULL.
+// returns COMP_STORE_ERROR_SUCCESS or COMP_STORE_ERROR_FAILED.
+int comp_store_put(const COMP_STORE* store, const uint8_t* data, const uint32_t size, uint8_t hash[SHA1_DIGEST_LEN], bool* added);
+
+void comp_manifest_init(COMP_MANIFEST* manifest);
+
+// set the variant name from a BIOS filename; the directory and extension are dropped, and
+// characters the manifest format reserves are replaced.
+void comp_manifest_set_name(COMP_MANIFEST* manifest, const char* filename);
+
+// write a manifest. input paths are the object filenames, so the manifest is built from the
+// directory the store path is relative to.
+// returns COMP_STORE_ERROR_SUCCESS or COMP_STORE_ERROR_FAILED.
+int comp_manifest_write(const COMP_STORE* store, const COMP_MANIFEST* manifest, const char* filename);
+
+#endif // !XB_COMP_STORE_H
@@ -0,0 +1,53 @@
+// cpu_features.h: runtime cpu feature detection for the SIMD code paths.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CPU_X86
+#endif
+
+#ifdef _MSC_VER
+#define CPU_TARGET(x)
+#else
+#define CPU_TARGET(x) __attribute__((target(x)))
+#endif
+
+// cpu features
+#define CPU_FEATURE_SSE2  0x01
+#define CPU_FEATURE_SSSE3 0x02
+#define CPU_FEATURE_SSE41 0x04
+#define CPU_FEATURE_AVX2  0x08
+#define CPU_FEATURE_SHA   0x10
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// get the cpu features; detected once.
+int cpu_features(void);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // !CPU_FEATURES_H
@@ -0,0 +1,44 @@
+// delta.h: Binary delta encoding with a suffix array matcher.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_DELTA_H
+#define XB_DELTA_H
+
+#include <stdint.h>
+
+// delta error codes
+#define DELTA_ERROR_SUCCESS 0
+#define DELTA_ERROR_FAILED 1		// out of memory
+#define DELTA_ERROR_INVALID 2		// the delta is corrupt or does not fit the source
+
+// encode dst as copies from src and literals.
+// the delta is a stream of ops; op = varint (len << 1 | copy). a copy is followed by the zigzag varint
+// distance from the end of the previous copy, a literal by its bytes.
+// delta: output; free it with free().
+// returns DELTA_ERROR_SUCCESS or DELTA_ERROR_FAILED.
+int delta_encode(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size, uint8_t** delta, uint32_t* delta_size);
+
+// rebuild dst from src and a delta.
+// dst: output buffer of dst_size bytes; the delta has to produce exactly dst_size bytes.
+// returns DELTA_ERROR_SUCCESS or DELTA_ERROR_INVALID.
+int delta_decode(const uint8_t* src, const uint32_t src_size, const uint8_t* delta, const uint32_t delta_size, uint8_t* dst, const uint32_t dst_size);
+
+#endif // !XB_DELTA_H
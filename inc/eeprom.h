@@ -0,0 +1,117 @@
+// eeprom.h: Xbox EEPROM security section decryption, verification and encryption.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_EEPROM_H
+#define XB_EEPROM_H
+
+#include <stdint.h>
+
+// user incl
+#include "bldr.h"
+#include "keyring.h"
+#include "sha1.h"
+
+#define EEPROM_SIZE 256
+#define EEPROM_ENC_SIZE 0x1C	// encrypted bytes of the security section; confounder, hdd key, game region
+
+// eeprom error codes
+#define EEPROM_ERROR_SUCCESS 0
+#define EEPROM_ERROR_FAILED 1
+#define EEPROM_ERROR_HASH 2		// the decrypted section does not match the hash; wrong key or corrupt
+#define EEPROM_ERROR_NO_MATCH 3
+
+// game regions
+#define EEPROM_REGION_NA 0x00000001
+#define EEPROM_REGION_JP 0x00000002
+#define EEPROM_REGION_EU 0x00000004
+#define EEPROM_REGION_MANUFACTURING 0x80000000
+
+// eeprom security section; encrypted with the 2BL eeprom key.
+typedef struct {
+	uint8_t hash[SHA1_DIGEST_LEN];	// hmac of the decrypted section; the rc4 key is the hmac of this hash
+	uint8_t confounder[8];
+	uint8_t hdd_key[XB_KEY_SIZE];
+	uint32_t game_region;
+} EEPROM_SECURITY;
+
+// eeprom factory section
+typedef struct {
+	uint32_t checksum;
+	char serial_number[12];
+	uint8_t mac_address[6];
+	uint8_t reserved1[2];
+	uint8_t online_key[16];
+	uint32_t video_standard;
+	uint8_t reserved2[4];
+} EEPROM_FACTORY;
+
+// eeprom image
+typedef struct {
+	EEPROM_SECURITY security;		// 0x00
+	EEPROM_FACTORY factory;			// 0x30
+	uint8_t user[0xA0];				// 0x60; user settings
+} XB_EEPROM;
+
+// an eeprom key with its hmac states precomputed.
+typedef struct {
+	SHA1HmacContext hmac;
+} EEPROM_KEY;
+
+// batch result for one eeprom file
+typedef struct {
+	char* filename;
+	int key;						// keyring index of the key that decrypted the eeprom, or KEYRING_NO_MATCH
+	EEPROM_SECURITY security;		// decrypted security section
+} EEPROM_BATCH_RESULT;
+
+// batch of eeprom files
+typedef struct {
+	EEPROM_BATCH_RESULT* results;
+	uint32_t count;
+	uint32_t capacity;
+} EEPROM_BATCH;
+
+// precompute the hmac inner and outer states of a 16 byte eeprom key.
+void eeprom_key_init(EEPROM_KEY* key, const uint8_t* eeprom_key);
+
+// decrypt and verify the security section of an eeprom image.
+// eeprom: EEPROM_SIZE bytes; not modified.
+// security: the decrypted section. hash is the stored hash.
+// returns EEPROM_ERROR_SUCCESS or EEPROM_ERROR_HASH.
+int eeprom_decrypt(const EEPROM_KEY* key, const uint8_t* eeprom, EEPROM_SECURITY* security);
+
+// encrypt a security section into an eeprom image. the hash is recalculated.
+// security: the decrypted section. hash is ignored.
+// eeprom: EEPROM_SIZE bytes; the security section is overwritten.
+void eeprom_encrypt(const EEPROM_KEY* key, const EEPROM_SECURITY* security, uint8_t* eeprom);
+
+// try every key against every eeprom file in a directory. files are spread across cores;
+// each file stops at its first matching key.
+// path: a directory of eeprom images. files that are not EEPROM_SIZE bytes are skipped.
+// returns EEPROM_ERROR_SUCCESS or EEPROM_ERROR_FAILED.
+int eeprom_batch(EEPROM_BATCH* batch, const char* path, const KEYRING* keyring);
+void eeprom_batch_free(EEPROM_BATCH* batch);
+
+// game region / video standard names
+const char* eeprom_region_str(const uint32_t region);
+const char* eeprom_video_standard_str(const uint32_t standard);
+
+#endif // !XB_EEPROM_H
@@ -25,10 +25,70 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// enumerate files callback.
+// filename: the path to the file.
+// context: the user context passed to enumerateFiles.
+// returns 0 to continue, non-zero to stop the enumeration.
+typedef int (*ENUM_FILES_CALLBACK)(const char* filename, void* context);
+
+// memory files. a path that starts with MEM_FILE_PREFIX names a buffer instead of a file on disk;
+// it lives until freeMemFiles(). chained commands hand their outputs over in memory files.
+#define MEM_FILE_PREFIX '@'
+
+// mapped file views
+#define MAPPED_FILE_DISK 0	// a mapping of a file on disk
+#define MAPPED_FILE_COPY 1	// a private copy of a memory file; freed on unmap
+#define MAPPED_FILE_MEM 2	// the buffer of a memory file; writes reach the memory file
+
+// a memory mapped file.
+typedef struct {
+	uint8_t* data;
+	uint32_t size;
+	bool writable;	// the view is shared with the file; writes reach the file.
+	uint8_t type;
+} MAPPED_FILE;
+
+// a range of a file.
+typedef struct {
+	const char* filename;
+	uint32_t offset;
+	uint32_t size;
+} FILE_RANGE;
+
+// map a file into memory. the view is copy-on-write; pages are read from the page cache
+// and only pages that are written get a private copy. writes never reach the file.
+// filename: the absolute path to the file.
+// map: the mapping.
+// returns 0 if successful, 1 otherwise.
+int mapFile(const char* filename, MAPPED_FILE* map);
+
+// create a file and map it into memory for writing. the file is zero filled.
+// filename: the absolute path to the file.
+// size: the file size in bytes.
+// map: the mapping.
+// returns 0 if successful, 1 otherwise.
+int mapFileWrite(const char* filename, const uint32_t size, MAPPED_FILE* map);
+
+// unmap a file. writable views are flushed to the file first.
+void unmapFile(MAPPED_FILE* map);
+
+// create a file from ranges of other files, in order. the bytes go file to file; copy_file_range on linux,
+// which shares the extents on filesystems with reflinks, otherwise a write from a mapped view of the source.
+// the file is written to a temp file and renamed, so a source can also be the destination.
+// filename: the file to create.
+// ranges: the ranges to copy.
+// count: the number of ranges.
+// returns 0 if successful, 1 otherwise.
+int copyFileRanges(const char* filename, const FILE_RANGE* ranges, const uint32_t count);
+
 // read a file. allocates memory for the buffer.
 // filename: the absolute path to the file.
 // bytesRead: if not NULL, will store the number of bytes read.
@@ -43,9 +103,32 @@ uint8_t* readFile(const char* filename, uint32_t* bytesRead, const uint32_t expe
 // returns 0 if successful, 1 otherwise.
 int writeFile(const char* filename, void* ptr, const uint32_t bytesToWrite);
 
+// print the "writing tag to file ( size )" message.
+void printWriteF(const char* filename, const char* tag, const uint32_t bytesWritten);
+
 // write to a file.
 int writeFileF(const char* filename, const char* tag, void* ptr, const uint32_t bytesToWrite);
 
+// open a stream on a file, like fopen. a memory file is streamed through an anonymous temp file.
+// returns the stream; close it with closeFile. NULL otherwise.
+FILE* openFile(const char* filename, const char* mode);
+
+// close a stream from openFile. a memory file opened for writing gets the written bytes.
+// returns 0 if successful, 1 otherwise.
+int closeFile(FILE* stream);
+
+// flush a stream and its file to disk. sync a temp file before renameFile so the rename never
+// lands before the bytes do.
+// returns 0 if successful, 1 otherwise.
+int syncFile(FILE* stream);
+
+// check if a path names a memory file.
+// the memory files are a process wide registry without a lock; use them from one thread at a time.
+bool isMemFile(const char* filename);
+
+// free every memory file.
+void freeMemFiles();
+
 // check if file exists.
 bool fileExists(const char* filename);
 
@@ -60,6 +143,40 @@ int deleteFile(const char* filename);
 // returns 0 if successful, 1 otherwise.
 int getFileSize(FILE* file, uint32_t* fileSize);
 
+// check if a path is a directory.
+bool isDirectory(const char* path);
+
+// create a directory. succeeds if it already exists.
+// returns 0 if successful, 1 otherwise.
+int createDirectory(const char* path);
+
+// name a temp file next to a file. write the temp file and renameFile it into place,
+// so a failed write leaves the file as it was. a memory file gets a memory temp file.
+// returns the name, free it; NULL otherwise.
+char* tempFileName(const char* filename);
+
+// rename a file, replacing the destination. the replace is atomic; readers see the old or the new file.
+// returns 0 if successful, 1 otherwise.
+int renameFile(const char* from, const char* to);
+
+// get the size and last modified time of a file.
+// size: if not NULL, will store the file size.
+// mtime: if not NULL, will store the last modified time in seconds.
+// returns 0 if successful, 1 otherwise.
+int getFileStat(const char* filename, uint64_t* size, int64_t* mtime);
+
+// set the last modified time of a file to now.
+// returns 0 if successful, 1 otherwise.
+int touchFile(const char* filename);
+
+// enumerate the files in a directory.
+// path: the directory.
+// recursive: if true, descend into sub directories.
+// callback: invoked for each file.
+// context: passed to the callback.
+// returns 0 if successful, 1 on error, otherwise the non-zero value the callback stopped with.
+int enumerateFiles(const char* path, bool recursive, ENUM_FILES_CALLBACK callback, void* context);
+
 #ifdef __cplusplus
 };
 #endif
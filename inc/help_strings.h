@@ -24,7 +24,7 @@
 
 // All lines are limited to 80 characters.
 
-const char HELP_USAGE_STR[] = "Usage: xbios <command> [switches]";
+const char HELP_USAGE_STR[] = "Usage: xbios <command> [switches] [+ <command> [switches]]...";
 const char HELP_STR_LIST[] = "Dump BIOS infomation. params, sizes, signatures, keys, tables, etc.";
 
 const char HELP_STR_BUILD[] = "Build a BIOS from a preldr, 2BL, kernel, section data, init table.\n" \
@@ -51,6 +51,36 @@ const char HELP_STR_INFO[] = "Display licence, version and author information.";
 const char HELP_STR_REPLICATE[] = "Replicate a BIOS image upto a specified size.";
 const char HELP_STR_COMPRESS_FILE[] = "Compress a file using the lzx algorithm.";
 const char HELP_STR_DECOMPRESS_FILE[] = "Decompress a file using the lzx algorithm.";
+const char HELP_STR_TEA_SEARCH[] = "Search for modifications of the FBL region that keep its TEA hash. (mcpx 1.1 research)\n" \
+"* Searches every xor delta of 8 bytes in one TEA block across all cores.\n" \
+"* Progress is checkpointed; rerun the same command to resume.";
+const char HELP_STR_EEPROM[] = "Decrypt and verify the security section of an EEPROM image.\n" \
+"* -in can be a directory; every key is tried against every 256 byte file in it.\n" \
+"* Use -out to write the EEPROM re-encrypted, optionally with a new game region.";
+const char HELP_STR_XBE[] = "Verify the section digests and header signature of an XBE.\n" \
+"* -in can be a directory; every .xbe in it and its sub directories is verified.\n" \
+"* Use -bios to verify against the public key and cert key of the BIOS the XBEs boot with.";
+const char HELP_STR_BUILD_MATRIX[] = "Build every BIOS variant declared in a manifest (ini) in one run.\n" \
+"* The global section names the inputs; each [section] is a variant.\n" \
+"* Inputs are loaded once and the variants are built in parallel.";
+const char HELP_STR_DIFF[] = "Compare two BIOSes component by component.\n" \
+"* Identical pages are skipped; only the components that differ are decrypted.\n" \
+"* Exits with 0 if the BIOSes are identical, 1 if they differ and 2 on error.";
+const char HELP_STR_MKPATCH[] = "Create a binary patch that turns one BIOS into another.\n" \
+"* With the 2BL key, the patch targets the decrypted 2BL and the decompressed kernel\n" \
+"  when that makes it smaller; apply re-encrypts and recompresses them.";
+const char HELP_STR_APPLYPATCH[] = "Apply a binary patch to a BIOS.\n" \
+"* The BIOS and the patched result are verified against the hashes in the patch.";
+const char HELP_STR_MKIDENT[] = "Compile an identification data file into a database for -ident.\n" \
+"* A database is mapped, not parsed, so it loads in constant time.\n" \
+"* Use /ls to get the component hashes of a BIOS.";
+const char HELP_STR_SCAN[] = "Scan a directory tree of BIOSes and report each one as csv or json.\n" \
+"* Duplicate files are found by size and hash and loaded only once.\n" \
+"* The BIOSes are loaded in parallel across cores.\n" \
+"* With -index, each component is sketched and the sketches are written to an index for -similar.";
+const char HELP_STR_SIMILAR[] = "Find the BIOSes in an index that are closest to a BIOS.\n" \
+"* Each component is compared by its MinHash sketch; an equal hash is an exact match.\n" \
+"* The kernel is decompressed only if no indexed BIOS has the same kernel.";
 const char HELP_STR_DISASM[] = "Disasm x86 instructions from a file.";
 
 const char HELP_STR_VALID_ROM_SIZES[] = "valid opts: 256, 512, 1024.";
@@ -59,6 +89,10 @@ const char HELP_STR_MCPX_ROM[] = "-mcpx <path>\t\t- path to the mcpx file. Shoul
 "\t\t\t- Used for en/decrypting the 2BL.\n" \
 "\t\t\t- Use mcpx 1.0 for BIOS versions <= 4627\n\t\t\t- Use mcpx 1.1 for BIOS versions >= 4817.";
 
+const char HELP_STR_KEYRING[] = "-keyring <path>\t\t- path to a key file or a directory of key files.\n" \
+"\t\t\t- Each key is tried until one decrypts the 2BL and kernel.\n" \
+"\t\t\t- 16 byte sb keys, 512 byte mcpx roms or packed 16 byte key lists.";
+
 const char HELP_STR_RC4_KEY[] = " <path> " \
 "\t- path to the %s key file. Should be 16 bytes";
 
@@ -67,7 +101,7 @@ const char HELP_STR_RC4_ENC[] = "\t\t- dont encrypt/decrypt the %s";
 const char HELP_STR_PARAM_EEPROM_KEY[] =	"-eepromkey <path>  eeprom key file";
 const char HELP_STR_PARAM_BLDR[] =			"-bldr <path>     - 2BL file";
 const char HELP_STR_PARAM_PRELDR[] =		"-preldr <path>   - FBL file";
-const char HELP_STR_PARAM_KRNL[] =			"-krnl <path>	  - kernel file";
+const char HELP_STR_PARAM_KRNL[] =			"-krnl <path>	  - kernel file; compressed or an uncompressed image";
 const char HELP_STR_PARAM_KRNL_DATA[] =		"-krnldata <path> - kernel data section file";
 const char HELP_STR_PARAM_INITTBL[] =		"-inittbl <path>  - init table file";
 const char HELP_STR_PARAM_CERT_KEY[] =		"-certkey <path>  - cert key file";
@@ -76,9 +110,11 @@ const char HELP_STR_PARAM_LS_NV2A_TBL[] =	"-nv2a            - list NV2A table";
 const char HELP_STR_PARAM_LS_DATA_TBL[] =	"-datatbl         - list ROM data table";
 const char HELP_STR_PARAM_LS_DUMP_KRNL[] =	"-img             - list kernel image header info";
 const char HELP_STR_PARAM_LS_KEYS[] =		"-keys            - list rc4 keys";
+const char HELP_STR_PARAM_LS_BOOTABLE[] =	"-bootable        - simulate the boot path; report the step the BIOS fails at";
 const char HELP_STR_PARAM_EXTRACT_KEYS[] =	"-keys            - extract rc4 keys";
 const char HELP_STR_PARAM_BFM[] =			"-bfm             - build a boot from media BIOS";
 const char HELP_STR_PARAM_DECODE_INI[] =	"-ini <path>      - set the decode settings file";
+const char HELP_STR_PARAM_MANIFEST[] =		"-in <path>       - build manifest file";
 const char HELP_STR_PARAM_IN_FILE[] =		"-in <path>       - input file";
 const char HELP_STR_PARAM_OUT_FILE[] =		"-out <path>      - output file";
 const char HELP_STR_PARAM_IN_BIOS_FILE[] =	"-in <path>       - BIOS file";
@@ -90,8 +126,41 @@ const char HELP_STR_PARAM_BASE[] =			"-base <offset>   - base offset in bytes";
 const char HELP_STR_PARAM_HACK_INITTBL[] =	"-hackinittbl     - hack init tbl (size = 0)";
 const char HELP_STR_PARAM_HACK_SIGNATURE[] ="-hacksignature   - hack boot signature (signature = 0)";
 const char HELP_STR_PARAM_WDIR[] =          "-dir             - working directory";
+const char HELP_STR_PARAM_WATCH[] =			"-watch           - rebuild when an input file changes";
+const char HELP_STR_PARAM_WATCH_LIMIT[] =	"-limit <n>       - with -watch, stop after writing n images";
 const char HELP_STR_PARAM_UPDATE_BOOT_PARAMS[] =  "-nobootparams    - dont update 2BL boot params";
 const char HELP_STR_PARAM_RESTORE_BOOT_PARAMS[] = "-nobootparams    - dont restore 2BL boot params (FBL BIOSes only)";
+const char HELP_STR_PARAM_KEYRING[] =		"-keyring <path>  - find the keys in a key file or directory";
+const char HELP_STR_PARAM_KRNL_CACHE[] =	"-krnl-cache <dir>- cache decompressed kernel images in a directory";
+const char HELP_STR_PARAM_CACHE_SIZE[] =	"-cachesize <mb>  - kernel cache size cap in mb; defaults to 256";
+const char HELP_STR_PARAM_STORE[] =		"-store <dir>     - put the components in a store named by SHA-1 and write a manifest";
+const char HELP_STR_PARAM_STORE_OUT_FILE[] =	"-out <path>      - manifest file for -store; defaults to <bios name>.ini";
+const char HELP_STR_PARAM_TEA_OFFSET[] =	"-offset <offset> - offset of the searched bytes in the region. defaults to the last block";
+const char HELP_STR_PARAM_CHECKPOINT[] =	"-ckpt <path>     - checkpoint file; defaults to <out>.ckpt. -ckpt or -out is required";
+const char HELP_STR_PARAM_TEA_LIMIT[] =	"-limit <n>       - stop after about n candidates; exits with 2 if no match yet";
+const char HELP_STR_PARAM_EEPROM_KEY_IN[] =	"-eepromkey <path>- eeprom key file. use /extr -keys to get it from a BIOS";
+const char HELP_STR_PARAM_EEPROM_KEYRING[] = "-keyring <path>  - eeprom key file or directory of key files to try";
+const char HELP_STR_PARAM_GAME_REGION[] =	"-region <region> - set the game region. 1 = NA, 2 = JP, 4 = EU, 0x80000000 = manufacturing";
+const char HELP_STR_PARAM_BIOS_FILE[] =		"-bios <path>     - BIOS file to take the public key and cert key from";
+const char HELP_STR_PARAM_DIFF_BIOS_FILE[] =	"-bios <path>     - BIOS file to compare against";
+const char HELP_STR_PARAM_DIFF_KRNL[] =		"-img             - decompress both kernels and compare their sections";
+const char HELP_STR_PARAM_PATCH_SRC_FILE[] =	"-in <path>       - original BIOS file";
+const char HELP_STR_PARAM_PATCH_DST_FILE[] =	"-bios <path>     - modified BIOS file";
+const char HELP_STR_PARAM_PATCH_FILE[] =	"-patch <path>    - patch file";
+const char HELP_STR_PARAM_OUT_PATCH_FILE[] =	"-out <path>      - patch output file; defaults to bios.xbp";
+const char HELP_STR_PARAM_LOG_LEVEL[] =	"-loglevel <lvl>  - debug, info, warn, error or none; defaults to info";
+const char HELP_STR_PARAM_LOG_FILE[] =		"-log <path>      - append the log to a file instead of stdout";
+const char HELP_STR_PARAM_IDENT[] =		"-ident <path>    - identification database or data file; names known components";
+const char HELP_STR_PARAM_IDENT_DATA_FILE[] =	"-in <path>       - identification data file";
+const char HELP_STR_PARAM_OUT_IDENT_FILE[] =	"-out <path>      - database output file; defaults to ident.db";
+const char HELP_STR_PARAM_SCAN_DIR[] =		"-in <path>       - directory to scan; sub directories are included";
+const char HELP_STR_PARAM_SCAN_OUT_FILE[] =	"-out <path>      - report output file; defaults to stdout";
+const char HELP_STR_PARAM_SCAN_JSON[] =		"-json            - write the report as json instead of csv";
+const char HELP_STR_PARAM_SCAN_INDEX[] =		"-index <path>    - also write a similarity index of the BIOSes";
+const char HELP_STR_PARAM_SIMILAR_INDEX[] =	"-index <path>    - similarity index written by -scan";
+const char HELP_STR_PARAM_SIMILAR_TOP[] =	"-top <k>         - number of matches to list; defaults to 10";
+const char HELP_STR_PARAM_XBE_PUB_KEY[] =	"-pubkey <path>   - kernel public key file";
+const char HELP_STR_PARAM_XBE_CERT_KEY[] =	"-certkey <path>  - 2BL cert key file";
 const char HELP_STR_PARAM_BRANCH[] =		"-branch          - take unbranchable jumps";
 
 #endif // XB_BIOS_TOOL_COMMANDS_H
\ No newline at end of file
@@ -0,0 +1,130 @@
+// ident_db.h: Known component identification database.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_IDENT_DB_H
+#define XB_IDENT_DB_H
+
+#include <stdint.h>
+
+// user incl
+#include "Mcpx.h"
+#include "file.h"
+#include "sha1.h"
+
+#define IDENT_DB_MAGIC 0x44494258 // 'XBID'
+#define IDENT_DB_VERSION 1
+#define IDENT_DB_MAX_TABLES 8
+
+// ident db error codes
+#define IDENT_DB_ERROR_SUCCESS 0
+#define IDENT_DB_ERROR_FAILED 1			// out of memory, or the file could not be read
+#define IDENT_DB_ERROR_INVALID 2		// not a database, or a line of a data file is malformed
+#define IDENT_DB_ERROR_NOT_FOUND 3
+
+// component types. the hash of each is the SHA-1 of:
+typedef enum {
+	IDENT_TYPE_NONE,				// an empty slot
+	IDENT_TYPE_MCPX,				// the 512 byte rom
+	IDENT_TYPE_PRELDR,				// the FBL, less the rom digest and params
+	IDENT_TYPE_BLDR,				// the decrypted 2BL, less the boot params and the FBL block
+	IDENT_TYPE_INIT_TBL,			// the init table, boot params init_tbl_size bytes
+	IDENT_TYPE_KERNEL,				// the decrypted compressed kernel; the kernel cache key
+	IDENT_TYPE_KERNEL_DATA,			// the uncompressed kernel data section
+	IDENT_TYPE_COUNT
+} IDENT_TYPE;
+
+// database image header. followed by slot_count slots and strings_size bytes of strings.
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t reserved;
+	uint32_t slot_count;			// a power of 2; at most half are used.
+	uint32_t entry_count;
+	uint32_t strings_size;
+} IDENT_DB_HEADER;
+
+// an open addressed slot. the first 4 bytes of the hash are the index.
+typedef struct {
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t type;					// IDENT_TYPE_*
+	uint8_t mcpx_rev;				// MCPX_REV_*; mcpx only
+	uint16_t sbkey_offset;			// offset of the sb key in the rom; mcpx only
+	uint32_t name;					// string offsets; 0 is the empty string
+	uint32_t version;
+} IDENT_DB_SLOT;
+
+// a database image; mapped from a file, or compiled in memory.
+typedef struct {
+	const IDENT_DB_HEADER* header;
+	const IDENT_DB_SLOT* slots;
+	const char* strings;
+	MAPPED_FILE map;
+	uint8_t* image;					// the compiled image; NULL if mapped
+} IDENT_DB_TABLE;
+
+// the loaded tables. read only once loaded, so it can be shared between threads.
+typedef struct IDENT_DB {
+	IDENT_DB_TABLE tables[IDENT_DB_MAX_TABLES];
+	uint32_t count;
+} IDENT_DB;
+
+// a known component.
+typedef struct {
+	IDENT_TYPE type;
+	const char* name;
+	const char* version;			// "" if none
+	MCPX_REV mcpx_rev;
+	uint16_t sbkey_offset;
+} IDENT_ENTRY;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void ident_db_init(IDENT_DB* db);
+void ident_db_free(IDENT_DB* db);
+
+// load a database file, or compile a data file. tables loaded later are searched first.
+// a database is mapped; a lookup only touches the pages of the slots it probes.
+// a data file has a line per component; '#' and ';' start a comment:
+//   <type> <sha1> <name> [version] [rev=<0|1>] [sbkey=<offset>]
+// type: mcpx, preldr, bldr, inittbl, krnl or krnldata. a name or version with spaces is quoted.
+// returns an IDENT_DB_ERROR_* code.
+int ident_db_load(IDENT_DB* db, const char* path);
+
+// compile a data file into a database image. a malformed line is logged.
+// image: output; free it with free().
+// returns an IDENT_DB_ERROR_* code.
+int ident_db_compile(const char* path, uint8_t** image, uint32_t* size);
+
+// look up a component hash. the loaded tables are probed, then the built-in entries.
+// db: can be NULL; only the built-in entries are searched.
+// returns IDENT_DB_ERROR_SUCCESS or IDENT_DB_ERROR_NOT_FOUND.
+int ident_db_find(const IDENT_DB* db, const IDENT_TYPE type, const uint8_t hash[SHA1_DIGEST_LEN], IDENT_ENTRY* entry);
+
+// the data file name of a component type.
+const char* ident_type_name(const IDENT_TYPE type);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // !XB_IDENT_DB_H
@@ -0,0 +1,99 @@
+// keyring.h: A set of candidate 2BL / kernel keys and the key trial engine.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_KEYRING_H
+#define XB_KEYRING_H
+
+#include <stdint.h>
+
+// user incl
+#include "Mcpx.h"
+#include "bldr.h"
+#include "sha1.h"
+
+#define KEYRING_NAME_LEN 64
+
+// keyring match indices
+#define KEYRING_NO_MATCH -1 // no key matched
+#define KEYRING_KEY_BLDR -2 // the kernel key stored in the 2BL
+#define KEYRING_KEY_NONE -3 // the 2BL or kernel is not encrypted
+
+// keyring error codes
+#define KEYRING_ERROR_SUCCESS 0
+#define KEYRING_ERROR_FAILED 1
+#define KEYRING_ERROR_NO_MATCH 2
+
+// a candidate key
+typedef struct {
+	uint8_t key[XB_KEY_SIZE];
+	MCPX_REV rev;					// MCPX_REV_0: 2BL path only. MCPX_REV_1 or MCPX_REV_UNK: 2BL and FBL path.
+	char name[KEYRING_NAME_LEN];
+} KEYRING_KEY;
+
+// a set of candidate keys
+typedef struct KEYRING {
+	KEYRING_KEY* keys;
+	uint32_t count;
+	uint32_t capacity;
+} KEYRING;
+
+// key trial result
+typedef struct {
+	int bldr_key;							// keyring index of the sb key that decrypted the 2BL, KEYRING_KEY_NONE or KEYRING_NO_MATCH
+	bool preldr;							// the 2BL was decrypted via the FBL path (preldrCreateKey)
+	uint8_t preldr_key[SHA1_DIGEST_LEN];	// the FBL 2BL key, if preldr is set
+	int kernel_key;							// keyring index of the kernel key, KEYRING_KEY_BLDR, KEYRING_KEY_NONE or KEYRING_NO_MATCH
+	uint32_t trials;						// number of keys tried
+} KEYRING_MATCH;
+
+void keyring_init(KEYRING* keyring);
+void keyring_free(KEYRING* keyring);
+
+// add a key to the keyring.
+// returns KEYRING_ERROR_SUCCESS or KEYRING_ERROR_FAILED.
+int keyring_add(KEYRING* keyring, const uint8_t* key, MCPX_REV rev, const char* name);
+
+// load keys from a file or a directory of files.
+// 16 byte files are sb keys, 512 byte files are MCPX ROMs, other multiple-of-16 files are packed key lists.
+// returns KEYRING_ERROR_SUCCESS or KEYRING_ERROR_FAILED.
+int keyring_load(KEYRING* keyring, const char* path);
+
+// try every key in the keyring against the 2BL and kernel of a BIOS image.
+// the image is not modified; only the bytes needed to validate a key are decrypted.
+// candidates are tried in parallel across cores and the search stops at the first valid key.
+// data: the BIOS image
+// size: the BIOS image size
+// match: the result
+// a 2BL that validates without a key is a match with no key; match->bldr_key is KEYRING_KEY_NONE.
+// returns KEYRING_ERROR_SUCCESS if a 2BL key was found, otherwise KEYRING_ERROR_NO_MATCH.
+int keyring_trial(const KEYRING* keyring, const uint8_t* data, const uint32_t size, KEYRING_MATCH* match);
+
+struct BIOS_LOAD_PARAMS;
+
+// find the keys for a BIOS image in the keyring and point the load params at them.
+// the key pointers point into the keyring; it must outlive the load.
+// mcpx: set up with only the rev of the match so the load takes the same 2BL path; params->mcpx points at it.
+// a 2BL that is not encrypted sets params->enc_bldr; the bldr key and mcpx are not used.
+// match: the result
+// returns KEYRING_ERROR_SUCCESS if a 2BL key was found, otherwise KEYRING_ERROR_NO_MATCH; the params are left as they were.
+int keyring_find_keys(const KEYRING* keyring, const uint8_t* data, const uint32_t size, struct BIOS_LOAD_PARAMS* params, MCPX* mcpx, KEYRING_MATCH* match);
+
+#endif // !XB_KEYRING_H
@@ -0,0 +1,67 @@
+// krnl_cache.h: An on-disk cache of decompressed kernel images keyed by the SHA-1 of the compressed kernel.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_KRNL_CACHE_H
+#define XB_KRNL_CACHE_H
+
+#include <stdint.h>
+
+// user incl
+#include "file.h"
+#include "sha1.h"
+
+#define KRNL_CACHE_DEFAULT_SIZE (256U * 1024U * 1024U) // default size cap in bytes
+#define KRNL_CACHE_EXT ".img"
+
+// kernel cache error codes
+#define KRNL_CACHE_ERROR_SUCCESS 0
+#define KRNL_CACHE_ERROR_FAILED 1
+#define KRNL_CACHE_ERROR_MISS 2
+
+// a kernel cache directory. read only once opened, so it can be shared between threads.
+typedef struct KRNL_CACHE {
+	char* path;
+	uint64_t max_size;		// size cap in bytes; the least recently used images are evicted past it. 0 = no cap
+} KRNL_CACHE;
+
+// open a cache directory; it is created if it does not exist.
+// max_size: size cap in bytes. 0 = no cap
+// returns KRNL_CACHE_ERROR_SUCCESS or KRNL_CACHE_ERROR_FAILED.
+int krnl_cache_open(KRNL_CACHE* cache, const char* path, const uint64_t max_size);
+void krnl_cache_close(KRNL_CACHE* cache);
+
+// the cache key of a compressed kernel; the SHA-1 of the decrypted compressed stream.
+void krnl_cache_key(const uint8_t* compressed_kernel, const uint32_t size, uint8_t key[SHA1_DIGEST_LEN]);
+
+// look up a decompressed kernel image. a hit is mapped copy-on-write and marked as recently used.
+// the stored size and sha1 of the image are checked; a file that fails the check is deleted and is a miss.
+// map: output; the image, at offset 0 of the mapping. release it with unmapFile().
+// img_size: output; the image size. the mapping is a little larger.
+// returns KRNL_CACHE_ERROR_SUCCESS on a hit, otherwise KRNL_CACHE_ERROR_MISS.
+int krnl_cache_get(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], MAPPED_FILE* map, uint32_t* img_size);
+
+// store a decompressed kernel image, followed by its size and sha1. the file is written to a temporary file,
+// synced and renamed into place, so readers never see a partial image. then the least recently used images
+// are evicted to the size cap.
+// returns KRNL_CACHE_ERROR_SUCCESS or KRNL_CACHE_ERROR_FAILED.
+int krnl_cache_put(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], const uint8_t* img, const uint32_t size);
+
+#endif // !XB_KRNL_CACHE_H
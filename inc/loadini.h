@@ -25,9 +25,12 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#define LOADINI_MAX_LINE_SIZE 512 // a key and a full path
+
 typedef enum {
 	LOADINI_SETTING_TYPE_STR,
-	LOADINI_SETTING_TYPE_BOOL
+	LOADINI_SETTING_TYPE_BOOL,
+	LOADINI_SETTING_TYPE_INT
 } LOADINI_SETTING_TYPE;
 
 enum {
@@ -63,6 +66,15 @@ extern "C" {
 // returns LOADINI_ERROR_CODE
 int loadini(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size);
 
+// load ini file up to the next [section] line
+// stream: file stream
+// settings_map: map of settings
+// map_size: size of the map
+// section: output; the name of the next section, or an empty string at the end of the file.
+// section_size: size of the section buffer
+// returns LOADINI_ERROR_CODE
+int loadini_section(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size, char* section, uint32_t section_size);
+
 #ifdef __cplusplus
 };
 #endif
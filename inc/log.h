@@ -0,0 +1,118 @@
+// log.h: leveled logging with per-thread buffering and pluggable sinks.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_LOG_H
+#define XB_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+// library code logs through here; only the CLI front end renders text.
+// messages are formatted into a per-thread buffer and handed to the sink in batches, so
+// threads only meet on the sink lock when a buffer is flushed. the default sink is the null sink.
+
+#define LOG_BUFFER_SIZE 4096	// per-thread buffer size in bytes
+#define LOG_MESSAGE_MAX 1024	// longer messages are truncated
+
+// log levels
+typedef enum {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_NONE
+} LOG_LEVEL;
+
+// sink write callback. calls are serialized.
+// text: one message; not null terminated; ends with a new line.
+typedef void (*LOG_WRITE)(void* context, LOG_LEVEL level, const char* text, const uint32_t len);
+
+// a log sink
+typedef struct {
+	LOG_WRITE write;
+	void* context;
+} LOG_SINK;
+
+// in-memory ring of the newest log text
+typedef struct {
+	char* data;
+	uint32_t size;
+	uint64_t written;	// total bytes written
+} LOG_RING;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// set the minimum level that is logged. default is LOG_LEVEL_INFO.
+void log_set_level(LOG_LEVEL level);
+LOG_LEVEL log_get_level(void);
+
+// set the sink. the calling thread's buffer is flushed to the old sink first.
+// sink: copied. NULL for the null sink.
+void log_set_sink(const LOG_SINK* sink);
+
+// buffered: if false, every message goes to the sink straight away; use when log text is
+// interleaved with other output on the same stream. default is true.
+void log_set_buffered(bool buffered);
+
+// write a message. a new line is appended if missing.
+// warnings and errors flush the calling thread's buffer.
+void log_write(LOG_LEVEL level, const char* format, ...);
+
+// flush the calling thread's buffer to the sink.
+void log_flush(void);
+
+// discard messages.
+void log_sink_null(LOG_SINK* sink);
+
+// write messages to a stream, eg. stdout or stderr. errors and warnings are prefixed with "Error: " and "Warning: ".
+void log_sink_stream(LOG_SINK* sink, FILE* stream);
+
+// append messages to a file. same format as the stream sink.
+// returns 0 if successful, 1 otherwise.
+int log_sink_file(LOG_SINK* sink, const char* filename);
+void log_sink_file_close(LOG_SINK* sink);
+
+// keep the newest messages in memory. same format as the stream sink.
+// returns 0 if successful, 1 otherwise.
+int log_ring_init(LOG_RING* ring, const uint32_t size);
+void log_ring_free(LOG_RING* ring);
+void log_sink_ring(LOG_SINK* sink, LOG_RING* ring);
+
+// copy the newest ring text to buf; null terminated.
+// returns the number of bytes copied, excluding the terminator.
+uint32_t log_ring_read(LOG_RING* ring, char* buf, const uint32_t size);
+
+#ifdef __cplusplus
+};
+#endif
+
+#define log_debug(...) log_write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_info(...) log_write(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_warn(...) log_write(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_error(...) log_write(LOG_LEVEL_ERROR, __VA_ARGS__)
+
+#endif // !XB_LOG_H
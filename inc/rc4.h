@@ -23,6 +23,10 @@
 #define RC4_H
 
 #include <stdint.h>
+#include <stddef.h>
+
+// max number of contexts processed together by rc4_lanes()
+#define RC4_MAX_LANES 8
 
 typedef struct _RC4_CONTEXT {
     uint8_t k;
@@ -39,6 +43,14 @@ void rc4_key(RC4_CONTEXT* context, const uint8_t* key, const size_t len);
 void rc4(RC4_CONTEXT* context, uint8_t* data, const size_t size);
 void rc4_symmetric_enc_dec(uint8_t* data, const size_t size, const uint8_t* key, const size_t key_len);
 
+// run several independent rc4 contexts in lock step.
+// the rounds of each lane are interleaved so the dependent loads of one lane overlap with the others.
+// contexts: array of keyed contexts
+// data: array of buffers, one per lane. a NULL array or NULL buffer discards the keystream for that lane.
+// lanes: number of contexts; upto RC4_MAX_LANES
+// size: number of bytes to process per lane
+void rc4_lanes(RC4_CONTEXT* contexts, uint8_t** data, const int lanes, const size_t size);
+
 #ifdef __cplusplus
 };
 #endif
@@ -24,6 +24,9 @@
 
 #include <stdint.h>
 
+// user incl
+#include "sha1.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -31,11 +34,15 @@ extern "C" {
 #define RSA_ERROR_SUCCESS		0
 #define RSA_ERROR               1
 #define RSA_ERROR_INVALID_DATA	2
+#define RSA_ERROR_SIGNATURE		3
+
+#define RSA_MAX_BITS 2048
 
 #define RSA_MOD_SIZE(rsa_header) ((rsa_header)->bits / 8U)
 #define RSA_MOD_BUFFER_SIZE(rsa_header) ((rsa_header)->mod_size)
 #define RSA_PUBKEY_SIZE(rsa_header) (sizeof(RSA_HEADER) + RSA_MOD_SIZE((RSA_HEADER*)rsa_header))
 #define RSA_PUBKEY_BUFFER_SIZE(rsa_header) (sizeof(RSA_HEADER) + RSA_MOD_BUFFER_SIZE(rsa_header))
+#define RSA_MODULUS(pubkey) ((const uint8_t*)(pubkey) + sizeof(RSA_HEADER)) // the modulus follows the header in place
 
 // The rsa header structure
 typedef struct _RSA_HEADER {
@@ -66,6 +73,21 @@ int rsa_verifyPublicKey(uint8_t* data, uint32_t size, uint32_t offset, PUBLIC_KE
 // offset: output offset where the pub key was found.
 int rsa_findPublicKey(uint8_t* data, uint32_t size, PUBLIC_KEY** pubkey, uint32_t* offset);
 
+// rsa public key operation; out = sig ^ e mod n. (montgomery)
+// pubkey: the public key (PUBLIC_KEY or XB_PUBLIC_KEY)
+// sig: little endian input, RSA_MOD_SIZE bytes
+// out: little endian output, RSA_MOD_SIZE bytes
+int rsa_public(const PUBLIC_KEY* pubkey, const uint8_t* sig, uint8_t* out);
+
+// recover the sha1 digest from an xbox rsa signature.
+// returns RSA_ERROR_SIGNATURE if the signature padding is invalid.
+// digest: output digest, SHA1_DIGEST_LEN bytes
+int rsa_recoverDigest(const PUBLIC_KEY* pubkey, const uint8_t* sig, uint8_t* digest);
+
+// verify an xbox rsa signature of a sha1 digest.
+// returns RSA_ERROR_SUCCESS if the signature matches the digest, otherwise RSA_ERROR_SIGNATURE.
+int rsa_verifySignature(const PUBLIC_KEY* pubkey, const uint8_t* sig, const uint8_t* digest);
+
 #ifdef __cplusplus
 };
 #endif
@@ -19,6 +19,11 @@
 #define SHA_STATUS_INPUT_TOO_LONG 2
 #define SHA_STATUS_STATE_ERROR 3
 
+// max number of messages hashed together by SHA1Multi()
+#define SHA1_MAX_LANES 8
+
+#include "cpu_features.h"
+
 // SHA-1 context
 typedef struct _SHA1Context {
     uint32_t intermediate_hash[SHA1_DIGEST_LEN / 4U]; // Digest
@@ -33,6 +38,12 @@ typedef struct _SHA1Context {
     int corrupted;      // Is the message digest corrupted?
 } SHA1Context;
 
+// HMAC-SHA1 context; the key states are precomputed once per key
+typedef struct _SHA1HmacContext {
+    SHA1Context inner;  // state after key ^ ipad
+    SHA1Context outer;  // state after key ^ opad
+} SHA1HmacContext;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -41,6 +52,31 @@ int SHA1Reset(SHA1Context* context);
 int SHA1Input(SHA1Context* context, const uint8_t* message, uint32_t len);
 int SHA1Result(SHA1Context* context, uint8_t digest[SHA1_DIGEST_LEN]);
 
+// hash count independent messages. messages are hashed SHA1_MAX_LANES at a time
+// using the widest multi-buffer path the cpu supports.
+int SHA1Multi(const uint8_t* const* messages, const uint32_t* lens, uint8_t (*digests)[SHA1_DIGEST_LEN], const uint32_t count);
+
+// HMAC-SHA1. SHA1HmacReset() precomputes the key states; SHA1Hmac() does not modify the context.
+int SHA1HmacReset(SHA1HmacContext* context, const uint8_t* key, uint32_t len);
+int SHA1Hmac(const SHA1HmacContext* context, const uint8_t* message, uint32_t len, uint8_t digest[SHA1_DIGEST_LEN]);
+
+// select the block function for this cpu. not thread safe; call it once at startup.
+// until then, the generic block function is used.
+void SHA1Init(void);
+
+// name of the block function selected for this cpu.
+const char* SHA1Impl(void);
+
+// block functions; process 64 byte blocks into the hash state.
+void sha1_compress_generic(uint32_t state[5], const uint8_t* blocks, uint32_t count);
+#ifdef CPU_X86
+void sha1_compress_shani(uint32_t state[5], const uint8_t* blocks, uint32_t count);
+void sha1_compress_ssse3(uint32_t state[5], const uint8_t* blocks, uint32_t count);
+// one block for each of 4 / 8 independent states.
+void sha1_compress_x4(uint32_t state[][5], const uint8_t* const* blocks);
+void sha1_compress_x8(uint32_t state[][5], const uint8_t* const* blocks);
+#endif
+
 #ifdef __cplusplus
 };
 #endif
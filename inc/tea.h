@@ -8,6 +8,11 @@
 
 #include <stdint.h>
 
+#include "cpu_features.h"
+
+#define TEA_BLOCK_SIZE 16 // message bytes absorbed per hash step; one tea key
+#define TEA_MAX_LANES 8   // lanes hashed together by tea_hash_lanes()
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -15,6 +20,27 @@ extern "C" {
 void tea_encrypt(uint32_t v[2], const uint32_t k[4]);
 void tea_decrypt(uint32_t v[2], const uint32_t k[4]);
 
+// davies-meyer tea hash; each 16 byte block is the tea key: h = E(block, h) ^ h.
+// h is the chaining value (in / out). trailing bytes that do not fill a block are ignored.
+void tea_hash(uint32_t h[2], const uint8_t* data, uint32_t size);
+
+// hash TEA_MAX_LANES independent chains. lane i absorbs the block k[0..3][i],
+// then the shared blocks in data. h[0][i], h[1][i] is the chaining value of lane i (in / out).
+void tea_hash_lanes(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks);
+
+// select the lane function for this cpu. not thread safe; call it once at startup.
+// until then, the generic lane function is used.
+void tea_init(void);
+
+// name of the lane function selected for this cpu.
+const char* tea_impl(void);
+
+// lane functions; 4 / 8 lanes of tea_hash_lanes().
+#ifdef CPU_X86
+void tea_hash_x4(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks, int lane);
+void tea_hash_x8(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
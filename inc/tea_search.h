@@ -0,0 +1,66 @@
+// tea_search.h: Multithreaded search for modifications of a region that keep its tea hash.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_TEA_SEARCH_H
+#define XB_TEA_SEARCH_H
+
+#include <stdint.h>
+
+// user incl
+#include "tea.h"
+
+#define TEA_SEARCH_MAX_FOUND 64			// matches kept / written to the checkpoint
+#define TEA_SEARCH_WORD_SIZE 8			// bytes modified per candidate; two tea key words
+
+// tea search error codes
+#define TEA_SEARCH_ERROR_SUCCESS 0
+#define TEA_SEARCH_ERROR_FAILED 1
+#define TEA_SEARCH_ERROR_INTERRUPTED 2	// stopped early; progress is in the checkpoint
+
+typedef struct {
+	const uint8_t* region;		// hashed region; the mcpx 1.1 preldr region for a bios
+	uint32_t size;				// region size; rounded down to a whole tea block
+	uint32_t offset;			// offset of the 8 searched bytes; 4 byte aligned, within one tea block
+	const char* checkpoint;		// checkpoint file; resumed if it exists. NULL = no checkpoint
+	int threads;				// worker threads; 0 = one per core
+	uint64_t limit;				// stop once about this many candidates are searched this run; 0 = no limit
+} TEA_SEARCH_PARAMS;
+
+typedef struct {
+	uint32_t hash[2];						// tea hash of the unmodified region
+	uint64_t searched;						// candidates searched, including resumed progress
+	uint64_t total;							// candidates in the search space
+	double rate;							// hashes per second this run
+	uint32_t found_count;
+	uint64_t found[TEA_SEARCH_MAX_FOUND];	// matching xor deltas; low word applies at offset, high word at offset + 4
+} TEA_SEARCH_RESULT;
+
+// search every xor delta of the 8 bytes at offset for ones that keep the tea hash of the region.
+// candidates are hashed TEA_MAX_LANES at a time from the precomputed prefix state and spread
+// across cores with work stealing. progress is printed every second and checkpointed to disk.
+// returns TEA_SEARCH_ERROR_SUCCESS when the search space is exhausted, TEA_SEARCH_ERROR_INTERRUPTED
+// when it stops on Ctrl+C or the limit.
+int tea_search(const TEA_SEARCH_PARAMS* params, TEA_SEARCH_RESULT* result);
+
+// apply a delta found by tea_search() to a copy of the region.
+void tea_search_apply(uint8_t* region, const uint32_t offset, const uint64_t delta);
+
+#endif // !XB_TEA_SEARCH_H
@@ -0,0 +1,94 @@
+// work_pool.h: A work stealing thread pool over ranges of a 64-bit index space.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_WORK_POOL_H
+#define XB_WORK_POOL_H
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a half open range of work items [begin, end)
+typedef struct {
+	uint64_t begin;
+	uint64_t end;
+} WORK_RANGE;
+
+// process work items [begin, end). called from the worker threads.
+typedef void(*WORK_FUNC)(uint64_t begin, uint64_t end, void* context);
+
+class WorkPool {
+public:
+	WorkPool();
+	~WorkPool();
+
+	// start processing the ranges. ranges are dealt round robin to the workers; a worker that
+	// runs dry steals the upper half of the largest range held by another worker.
+	// grain: items handed to func per call.
+	// threads: worker count; 0 = one per core.
+	// returns 0 on success.
+	int start(const WORK_RANGE* ranges, const uint32_t count, const uint64_t grain, int threads, WORK_FUNC func, void* context);
+
+	// wait up to ms milliseconds for the work to finish. returns true when all work is done.
+	bool wait(const uint32_t ms);
+
+	// stop handing out work and join the workers. in flight calls to func are finished;
+	// remaining() still reports the unprocessed ranges afterwards.
+	void stop();
+
+	// number of items processed / started with.
+	uint64_t completed() const { return done.load(); }
+	uint64_t total() const { return totalItems; }
+	int threadCount() const { return (int)workers.size(); }
+
+	// snapshot the unprocessed ranges, including ranges in flight. returns the number of
+	// ranges; when ranges is NULL or max is too small, only the count is returned.
+	uint32_t remaining(WORK_RANGE* ranges, const uint32_t max);
+
+private:
+	struct Worker {
+		std::mutex lock;
+		WORK_RANGE current;				// range being processed, grain at a time
+		WORK_RANGE inflight;			// grain handed to func
+		std::deque<WORK_RANGE> queue;	// ranges not started
+		std::thread thread;
+	};
+
+	void run(Worker* self);
+	bool next(Worker* self, WORK_RANGE* work);
+	bool steal(Worker* self);
+	void join();
+	void clear();
+
+	std::vector<Worker*> workers;
+	std::atomic<uint64_t> done;
+	std::atomic<int> active;
+	std::atomic<bool> stopping;
+	uint64_t totalItems;
+	uint64_t grainSize;
+	WORK_FUNC func;
+	void* context;
+};
+
+#endif // !XB_WORK_POOL_H
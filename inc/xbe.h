@@ -0,0 +1,172 @@
+// xbe.h: Xbox executable (XBE) parsing and verification.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_XBE_H
+#define XB_XBE_H
+
+#include <stdint.h>
+
+// user incl
+#include "bldr.h"
+#include "rsa.h"
+#include "sha1.h"
+
+#define XBE_MAGIC 0x48454258 // 'XBEH'
+#define XBE_SIGNATURE_SIZE 256
+#define XBE_TITLE_NAME_LEN 40
+
+// entry point / kernel thunk xor keys
+#define XBE_ENTRY_XOR_RETAIL 0xA8FC57AB
+#define XBE_ENTRY_XOR_DEBUG 0x94859D4B
+#define XBE_THUNK_XOR_RETAIL 0x5B6D40B6
+#define XBE_THUNK_XOR_DEBUG 0xEFB1F152
+
+// xbe error codes
+#define XBE_ERROR_SUCCESS 0
+#define XBE_ERROR_FAILED 1
+#define XBE_ERROR_INVALID_DATA 2	// not an xbe or a header points outside the file
+#define XBE_ERROR_SIGNATURE 3		// header signature does not verify
+#define XBE_ERROR_DIGEST 4			// one or more section digests do not match
+
+// xbe image header
+typedef struct {
+	uint32_t magic;
+	uint8_t signature[XBE_SIGNATURE_SIZE];		// rsa signature of the headers after the signature
+	uint32_t base_address;
+	uint32_t headers_size;
+	uint32_t image_size;
+	uint32_t image_header_size;
+	uint32_t timedate;
+	uint32_t certificate_address;
+	uint32_t section_count;
+	uint32_t section_headers_address;
+	uint32_t init_flags;
+	uint32_t entry_point;						// xor'd with XBE_ENTRY_XOR_*
+	uint32_t tls_address;
+	uint32_t pe_stack_commit;
+	uint32_t pe_heap_reserve;
+	uint32_t pe_heap_commit;
+	uint32_t pe_base_address;
+	uint32_t pe_image_size;
+	uint32_t pe_checksum;
+	uint32_t pe_timedate;
+	uint32_t debug_pathname_address;
+	uint32_t debug_filename_address;
+	uint32_t debug_unicode_filename_address;
+	uint32_t kernel_thunk_address;				// xor'd with XBE_THUNK_XOR_*
+	uint32_t non_kernel_import_dir_address;
+	uint32_t library_version_count;
+	uint32_t library_versions_address;
+	uint32_t kernel_library_version_address;
+	uint32_t xapi_library_version_address;
+	uint32_t logo_bitmap_address;
+	uint32_t logo_bitmap_size;
+} XBE_HEADER;
+
+// xbe certificate
+typedef struct {
+	uint32_t size;
+	uint32_t timedate;
+	uint32_t title_id;
+	uint16_t title_name[XBE_TITLE_NAME_LEN];
+	uint32_t alt_title_ids[16];
+	uint32_t allowed_media;
+	uint32_t game_region;
+	uint32_t game_ratings;
+	uint32_t disk_number;
+	uint32_t version;
+	uint8_t lan_key[XB_KEY_SIZE];
+	uint8_t signature_key[XB_KEY_SIZE];
+	uint8_t alt_signature_keys[16][XB_KEY_SIZE];
+} XBE_CERTIFICATE;
+
+// xbe section header
+typedef struct {
+	uint32_t flags;
+	uint32_t virtual_address;
+	uint32_t virtual_size;
+	uint32_t raw_address;
+	uint32_t raw_size;
+	uint32_t section_name_address;
+	uint32_t section_name_ref_count;
+	uint32_t head_shared_page_ref_count_address;
+	uint32_t tail_shared_page_ref_count_address;
+	uint8_t digest[SHA1_DIGEST_LEN];			// sha1 of the raw size then the raw data
+} XBE_SECTION_HEADER;
+
+// a loaded xbe; pointers into the file data.
+typedef struct {
+	uint8_t* data;
+	uint32_t size;
+	XBE_HEADER* header;
+	XBE_CERTIFICATE* cert;
+	XBE_SECTION_HEADER* sections;
+	bool debug;									// entry point decodes with the debug key
+} XBE;
+
+// batch result for one xbe file
+typedef struct {
+	char* filename;
+	uint32_t size;
+	int status;				// XBE_ERROR_SUCCESS or the first failure; XBE_ERROR_FAILED if the file could not be read
+	int header;				// header signature; XBE_ERROR_SUCCESS, XBE_ERROR_SIGNATURE or XBE_ERROR_FAILED if not checked
+	uint32_t bad_sections;
+} XBE_BATCH_RESULT;
+
+// batch of xbe files
+typedef struct {
+	XBE_BATCH_RESULT* results;
+	uint32_t count;
+	uint32_t capacity;
+	uint64_t bytes;			// total bytes verified
+} XBE_BATCH;
+
+// validate the headers and set up the pointers. data is not copied.
+// returns XBE_ERROR_SUCCESS or XBE_ERROR_INVALID_DATA.
+int xbe_load(XBE* xbe, uint8_t* data, const uint32_t size);
+
+// get a section name; "" if the name is outside the headers.
+const char* xbe_sectionName(const XBE* xbe, const XBE_SECTION_HEADER* section);
+
+// the header digest; sha1 of the size then the headers after the signature.
+void xbe_headerDigest(const XBE* xbe, uint8_t digest[SHA1_DIGEST_LEN]);
+
+// verify the header signature with the kernel public key.
+// returns XBE_ERROR_SUCCESS or XBE_ERROR_SIGNATURE.
+int xbe_verifyHeader(const XBE* xbe, const PUBLIC_KEY* pubkey);
+
+// verify the section digests. sections are hashed in parallel across threads.
+// status: optional; XBE_ERROR_SUCCESS or XBE_ERROR_DIGEST per section.
+// threads: worker count; 0 = one per core, 1 = this thread.
+// returns XBE_ERROR_SUCCESS or XBE_ERROR_DIGEST.
+int xbe_verifySections(const XBE* xbe, int* status, const int threads);
+
+// derive the title lan and signature keys from the 2BL cert key.
+// key = first 16 bytes of hmac-sha1(cert key, certificate key).
+void xbe_titleKeys(const XBE_CERTIFICATE* cert, const uint8_t* cert_key, uint8_t lan_key[XB_KEY_SIZE], uint8_t signature_key[XB_KEY_SIZE]);
+
+// verify every .xbe file in a directory and its sub directories. files are spread across cores.
+// pubkey: the kernel public key, or NULL to skip the header signatures.
+// returns XBE_ERROR_SUCCESS or XBE_ERROR_FAILED.
+int xbe_batch(XBE_BATCH* batch, const char* path, const PUBLIC_KEY* pubkey);
+void xbe_batch_free(XBE_BATCH* batch);
+
+#endif // !XB_XBE_H
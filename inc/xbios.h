@@ -0,0 +1,201 @@
+// xbios.h: libxbios; a reentrant, handle based interface to the BIOS tools.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#ifndef XB_XBIOS_H
+#define XB_XBIOS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef __cplusplus
+#include <stdbool.h>
+#endif
+
+// every call works on the handle or buffers it is given, so separate handles can be used from
+// separate threads at the same time. a single handle is not locked; callers sharing one handle
+// across threads must serialize.
+// the library does keep some process-wide state:
+//  - the hash functions picked for the cpu, once, by the first xbios_create().
+//  - the log level, sink and buffering set through log.h; log text from every handle goes to the one sink.
+//    the default is the null sink.
+//  - the memory file registry in file.h, used for '@' file names. it is not locked;
+//    '@' file names must not be used from more than one thread at a time.
+
+// xbios error codes
+#define XBIOS_ERROR_SUCCESS 0
+#define XBIOS_ERROR_FAILED 1
+#define XBIOS_ERROR_INVALID_SIZE 2		// the image is not a valid BIOS size
+#define XBIOS_ERROR_INVALID_BLDR 3		// the 2BL did not decrypt to valid boot params
+#define XBIOS_ERROR_NO_KEY 4			// no key in the keyring decrypts the 2BL
+#define XBIOS_ERROR_NOT_LOADED 5		// the handle has no image
+
+// BIOS components
+typedef enum {
+	XBIOS_COMPONENT_PRELDR,
+	XBIOS_COMPONENT_BLDR,
+	XBIOS_COMPONENT_INIT_TBL,
+	XBIOS_COMPONENT_KERNEL,				// the compressed kernel
+	XBIOS_COMPONENT_KERNEL_DATA,		// the uncompressed kernel data section
+	XBIOS_COMPONENT_KERNEL_IMG,			// the decompressed kernel image
+	XBIOS_COMPONENT_COUNT
+} XBIOS_COMPONENT;
+
+// an xbios handle
+typedef struct XBIOS XBIOS;
+
+// a keyring; see keyring.h
+typedef struct KEYRING KEYRING;
+
+// a decompressed kernel cache; see krnl_cache.h
+typedef struct KRNL_CACHE KRNL_CACHE;
+
+// an identification database; see ident_db.h
+typedef struct IDENT_DB IDENT_DB;
+
+// load parameters. keys are copied into the handle.
+typedef struct {
+	const uint8_t* bldr_key;			// sb key; XB_KEY_SIZE bytes. NULL to use the mcpx rom
+	const uint8_t* kernel_key;			// kernel key; XB_KEY_SIZE bytes. NULL to use the key in the 2BL
+	const uint8_t* mcpx;				// mcpx rom; MCPX_BLOCK_SIZE bytes. can be NULL
+	const IDENT_DB* ident;				// identifies a mcpx rom that is not built-in. not copied; only read by xbios_create(). can be NULL
+	const KEYRING* keyring;				// keys to trial when no bldr key is given. not copied; read only, so it can be shared between handles
+	const KRNL_CACHE* krnl_cache;		// decompressed kernel cache. not copied; can be shared between handles. can be NULL
+	uint32_t romsize;					// rom size in bytes. 0 to detect it from the mirrored banks of the image
+	bool enc_bldr;						// the 2BL is not encrypted
+	bool enc_kernel;					// the kernel is not encrypted
+	bool restore_boot_params;			// restore the 2BL boot params of FBL BIOSes
+} XBIOS_PARAMS;
+
+// build parameters. buffers are borrowed for the duration of the build.
+typedef struct {
+	const uint8_t* init_tbl;
+	const uint8_t* preldr;				// can be NULL
+	const uint8_t* bldr;
+	const uint8_t* compressed_kernel;	// can be NULL if kernel_img is given
+	const uint8_t* kernel_img;			// uncompressed kernel pe image; compressed during the build when compressed_kernel is NULL
+	const uint8_t* kernel_data;
+	const uint8_t* eeprom_key;			// can be NULL
+	const uint8_t* cert_key;			// can be NULL
+	const uint8_t* xcodes;				// xcodes to add to the init table after the build. can be NULL
+	uint32_t init_tbl_size;
+	uint32_t preldr_size;
+	uint32_t bldr_size;
+	uint32_t kernel_size;
+	uint32_t kernel_img_size;
+	uint32_t kernel_data_size;
+	uint32_t xcodes_size;
+	uint32_t binsize;					// image size in bytes; the rom is replicated up to it. 0 to use the rom size
+	bool bfm;
+	bool hackinittbl;
+	bool hacksignature;
+	bool nobootparams;
+} XBIOS_BUILD_PARAMS;
+
+// BIOS summary
+typedef struct {
+	uint32_t size;
+	uint32_t romsize;
+	uint32_t banks;						// number of 256kb banks in the image
+	uint32_t unique_banks;				// number of distinct 256kb banks; more than 1 may be a multi-bios flash
+	int bldr_status;					// BIOS_LOAD_STATUS_*
+	int preldr_status;					// PRELDR_STATUS_*
+	uint32_t bldr_entry_point;
+	uint32_t bfm_entry_point;			// 0 if there is no BFM entry
+	uint32_t signature;
+	uint32_t init_tbl_size;
+	uint32_t kernel_size;
+	uint32_t kernel_data_size;
+	int available_space;
+	uint16_t kernel_ver;
+	uint16_t init_tbl_revision;
+	uint8_t init_tbl_identifier;
+	bool kernel_delay_flag;
+} XBIOS_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void xbios_init_params(XBIOS_PARAMS* params);
+void xbios_init_build_params(XBIOS_BUILD_PARAMS* params);
+
+// load a keyring from a key file or directory.
+// the keyring is read only once loaded and can be shared between handles and threads.
+// returns the keyring, or NULL on error.
+KEYRING* xbios_keyring_load(const char* path);
+void xbios_keyring_destroy(KEYRING* keyring);
+
+// open a decompressed kernel cache directory. the directory is created if it does not exist.
+// max_size: the cache size cap in bytes. 0 for the default.
+// returns the cache, or NULL on error.
+KRNL_CACHE* xbios_krnl_cache_open(const char* path, uint64_t max_size);
+void xbios_krnl_cache_close(KRNL_CACHE* cache);
+
+// create a handle.
+// returns the handle, or NULL if out of memory.
+XBIOS* xbios_create(const XBIOS_PARAMS* params);
+
+// destroy a handle and everything it owns.
+void xbios_destroy(XBIOS* xbios);
+
+// load a BIOS image. the image is copied into the handle.
+// returns XBIOS_ERROR_SUCCESS, XBIOS_ERROR_INVALID_SIZE, XBIOS_ERROR_NO_KEY or XBIOS_ERROR_FAILED.
+int xbios_load(XBIOS* xbios, const uint8_t* data, const uint32_t size);
+
+// load a BIOS file. the file is mapped copy-on-write.
+int xbios_load_file(XBIOS* xbios, const char* filename);
+
+// list the BIOS. decrypts the 2BL; the kernel is left alone.
+// returns XBIOS_ERROR_SUCCESS or XBIOS_ERROR_INVALID_BLDR. info is filled in either way.
+int xbios_list(XBIOS* xbios, XBIOS_INFO* info);
+
+// get a component of the BIOS. decrypts or decompresses only what the component needs.
+// data: output; points into the handle; valid until the next load / build or destroy.
+// returns XBIOS_ERROR_SUCCESS if the component exists.
+int xbios_extract(XBIOS* xbios, XBIOS_COMPONENT component, const uint8_t** data, uint32_t* size);
+
+// build a BIOS into the handle.
+// filename: if not NULL, the image is built straight into this file. a failed build leaves the file as it was.
+int xbios_build(XBIOS* xbios, const XBIOS_BUILD_PARAMS* build_params, const char* filename);
+
+// get the BIOS image held by the handle.
+int xbios_image(XBIOS* xbios, const uint8_t** data, uint32_t* size);
+
+// lzx compress / decompress a buffer.
+// dest: output; allocated. free with xbios_free.
+// returns XBIOS_ERROR_SUCCESS or XBIOS_ERROR_FAILED.
+int xbios_compress(const uint8_t* src, const uint32_t size, uint8_t** dest, uint32_t* dest_size);
+int xbios_decompress(const uint8_t* src, const uint32_t size, uint8_t** dest, uint32_t* dest_size);
+
+// decode the xcodes of an init table.
+// data: the init table; xcodes start at data[base].
+// ini: decode settings file. can be NULL.
+// branch: walk branches.
+// stream: output stream.
+int xbios_decode(const uint8_t* data, const uint32_t size, const uint32_t base, const char* ini, bool branch, FILE* stream);
+
+void xbios_free(void* ptr);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif // !XB_XBIOS_H
@@ -35,6 +35,8 @@
 #include "rc4.h"
 #include "rsa.h"
 #include "sha1.h"
+#include "log.h"
+#include "nt_headers.h"
 
 #ifdef MEM_TRACKING
 #include "mem_tracking.h"
@@ -43,12 +45,26 @@
 static int validate_required_space(const uint32_t requiredSpace, uint32_t* size);
 
 int Bios::load(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params) {
-	// load bios
+	// load bios; components are materialized on first access.
 
 	bios_status = init(buff, binsize, bios_params);
-	if (bios_status != 0) {
+	return bios_status;
+}
+void Bios::loadPreldr() {
+	// locate the preldr
+
+	if (components & BIOS_COMPONENT_PRELDR)
+		return;
+	components |= BIOS_COMPONENT_PRELDR;
+
+	preldrValidate();
+}
+int Bios::loadBldr() {
+	// decrypt the 2BL and validate the boot params
+
+	if (components & BIOS_COMPONENT_BLDR)
 		return bios_status;
-	}
+	components |= BIOS_COMPONENT_BLDR;
 
 	// verify the presence of FBL and decrypt the 2BL.
 	preldrValidateAndDecryptBldr();
@@ -86,15 +102,35 @@ int Bios::load(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bi
 
 	getOffsets2();
 
+	bios_status = BIOS_LOAD_STATUS_SUCCESS;
+	return bios_status;
+}
+int Bios::loadKernel() {
 	// decrypt the kernel
+
+	if (components & BIOS_COMPONENT_KERNEL)
+		return bios_status;
+
+	if (loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+		return bios_status;
+	components |= BIOS_COMPONENT_KERNEL;
+
 	if (kernel.encryption_state) {
 		symmetricEncDecKernel();
 	}
 
-	bios_status = BIOS_LOAD_STATUS_SUCCESS;
 	return bios_status;
 }
-int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PARAMS* bios_params) {
+int Bios::load(MAPPED_FILE* file, const BIOS_LOAD_PARAMS* bios_params) {
+	// load bios from a mapped file. the view is copy-on-write, so decrypting in place never touches the file.
+
+	map = *file;
+	file->data = NULL;
+	file->size = 0;
+
+	return load(map.data, map.size, bios_params);
+}
+int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PARAMS* bios_params, const char* filename) {
 	// build a bios from the build parameters
 
 	const uint32_t requiredSpace = BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE + build_params->kernel_size + build_params->kernel_data_size + build_params->init_tbl_size;
@@ -112,17 +148,24 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 		binsize = bios_params->romsize;
 	}
 
-	bios_status = init(NULL, binsize, bios_params);
+	bios_status = init(NULL, binsize, bios_params, filename);
 	if (bios_status != 0) {
 		return bios_status;
 	}
 
+	// assemble the first bank; it is replicated to binsize at the end.
+	size = params.romsize;
+	getOffsets();
+
+	// a build is assembled in place; there is nothing to materialize.
+	components = BIOS_COMPONENT_PRELDR | BIOS_COMPONENT_BLDR | BIOS_COMPONENT_KERNEL;
+
 	// override encryption flags; reverse for building.
 	bldr.encryption_state = params.enc_bldr;
 	kernel.encryption_state = (!params.enc_kernel && params.kernel_key == NULL) || (params.enc_kernel && params.kernel_key != NULL);
 
 	if (build_params->bldrSize > BLDR_BLOCK_SIZE) {
-		printf("Error: 2BL is too big\n");
+		log_error("2BL is too big\n");
 		bios_status = BIOS_LOAD_STATUS_FAILED;
 		return bios_status;
 	}
@@ -130,7 +173,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 	memcpy(bldr.data, build_params->bldr, build_params->bldrSize);
 
 	if (!build_params->nobootparams) {
-		printf("Updating boot params\n");
+		log_info("Updating boot params\n");
 		bldr.boot_params->compressed_kernel_size = build_params->kernel_size;
 		bldr.boot_params->uncompressed_kernel_data_size = build_params->kernel_data_size;
 
@@ -153,17 +196,15 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 	getOffsets2();
 
 	if (build_params->eeprom_key != NULL) {
-		printf("Updating eeprom key\n");
+		log_info("Updating eeprom key\n");
 		memcpy(bldr.keys->eeprom_key, build_params->eeprom_key, XB_KEY_SIZE);
 	}
 
 	if (build_params->cert_key != NULL) {
-		printf("Updating cert key\n");
+		log_info("Updating cert key\n");
 		memcpy(bldr.keys->cert_key, build_params->cert_key, XB_KEY_SIZE);
 	}
 
-	// to-do add option to compress a kernel image.
-
 	// copy in the compressed kernel image.
 	memcpy(kernel.compressed_kernel_ptr, build_params->compressed_kernel, build_params->kernel_size);
 
@@ -171,7 +212,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 	memcpy(kernel.uncompressed_data_ptr, build_params->kernel_data, build_params->kernel_data_size);
 
 	if (data + build_params->init_tbl_size >= kernel.compressed_kernel_ptr) {
-		printf("Error: Init table is too big\n");
+		log_error("Init table is too big\n");
 		bios_status = BIOS_LOAD_STATUS_FAILED;
 		return bios_status;
 	}
@@ -179,7 +220,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 
 	// build a bios that boots from media. ( BFM )
 	if (build_params->bfm) {
-		printf("Adding kernel delay flag (bfm)\n");
+		log_info("Adding kernel delay flag (bfm)\n");
 		uint32_t* bootFlags = (uint32_t*)(&init_tbl->init_tbl_identifier);
 		*bootFlags |= KD_DELAY_FLAG;
 	}
@@ -191,7 +232,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 		// if the kernel was encrypted with a key file, update the key in the 2BL.
 		if (kernel.encryption_state) {
 			if (bldr.keys != NULL && params.kernel_key != NULL) {
-				printf("Updating kernel key\n");
+				log_info("Updating kernel key\n");
 				memcpy(bldr.keys->kernel_key, params.kernel_key, XB_KEY_SIZE);
 			}
 		}
@@ -199,7 +240,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 	else {
 		if (build_params->zero_kernel_key) {
 			if (bldr.keys != NULL && params.kernel_key != NULL) {
-				printf("Zeroing kernel key\n");
+				log_info("Zeroing kernel key\n");
 				memset(bldr.keys->kernel_key, 0, XB_KEY_SIZE);
 			}
 		}
@@ -227,7 +268,7 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 
 	if (build_params->preldr != NULL && build_params->preldr_size > 0) {
 		if (build_params->preldr_size > PRELDR_SIZE) {
-			printf("Error: Preldr is too big\n");
+			log_error("Preldr is too big\n");
 			bios_status = BIOS_LOAD_STATUS_FAILED;
 			return bios_status;
 		}
@@ -235,9 +276,10 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 		memcpy(preldr.data, build_params->preldr, build_params->preldr_size);
 	}
 
+	size = binsize;
 	if (size > params.romsize) {
 		if (bios_replicate_data(params.romsize, binsize, data, size) != 0) {
-			printf("Error: Failed to replicate the bios\n");
+			log_error("Failed to replicate the bios\n");
 			bios_status = BIOS_LOAD_STATUS_FAILED;
 			return bios_status;
 		}
@@ -247,14 +289,20 @@ int Bios::build(BIOS_BUILD_PARAMS* build_params, uint32_t binsize, BIOS_LOAD_PAR
 	return bios_status;
 }
 
-int Bios::init(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params) {
+int Bios::init(uint8_t* buff, const uint32_t binsize, const BIOS_LOAD_PARAMS* bios_params, const char* filename) {
 	// init bios from buffer
 
 	if (bios_params != NULL) {
 		memcpy(&params, bios_params, sizeof(BIOS_LOAD_PARAMS));
 	}
 		
-	if (buff == NULL) {
+	if (buff == NULL && filename != NULL) {
+		// a new mapped file is zero filled.
+		if (mapFileWrite(filename, binsize, &map) != 0)
+			return BIOS_LOAD_STATUS_FAILED;
+		data = map.data;
+	}
+	else if (buff == NULL) {
 		data = (uint8_t*)malloc(binsize);
 		if (data == NULL)
 			return BIOS_LOAD_STATUS_FAILED;
@@ -329,25 +377,22 @@ int Bios::validateBldrBootParams() {
 	const uint32_t kernel_size_valid = kernel_size >= 0 && kernel_size <= size;
 	const uint32_t kernel_data_size_valid = kernel_data_size >= 0 && kernel_data_size <= size;
 	const uint32_t inittbl_size_valid = inittbl_size >= 0 && inittbl_size <= size;
-	
-	return (kernel_size_valid && kernel_data_size_valid && inittbl_size_valid) ? BIOS_LOAD_STATUS_SUCCESS : BIOS_LOAD_STATUS_INVALID_BLDR;
+
+	// the init table is at the bottom of the rom and the kernel below the 2BL; together they must fit.
+	const uint64_t used = (uint64_t)kernel_size + kernel_data_size + inittbl_size + BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE;
+	const uint32_t used_valid = used <= size;
+
+	return (kernel_size_valid && kernel_data_size_valid && inittbl_size_valid && used_valid) ? BIOS_LOAD_STATUS_SUCCESS : BIOS_LOAD_STATUS_INVALID_BLDR;
 }
 
 void Bios::preldrCreateKey(uint8_t* sbkey, uint8_t* key) {
 	// create the bldr key from the sb key.
 
 	uint8_t* nonce = (preldr.data + PRELDR_BLOCK_SIZE - PRELDR_NONCE_SIZE);
-	SHA1Context sha = { 0 };
-	SHA1Reset(&sha);
-	SHA1Input(&sha, sbkey, XB_KEY_SIZE);
-	SHA1Input(&sha, nonce, PRELDR_NONCE_SIZE);
-	for (int i = 0; i < XB_KEY_SIZE; ++i)
-		key[i] = sbkey[i] ^ 0x5C;
-	SHA1Input(&sha, key, XB_KEY_SIZE);
-	SHA1Result(&sha, key);
+	bios_preldr_create_key(sbkey, nonce, key);
 }
-void Bios::preldrValidateAndDecryptBldr() {
-	// validate the preldr and decrypt the 2bl.
+void Bios::preldrValidate() {
+	// validate the preldr.
 
 	preldr.status = PRELDR_STATUS_NOT_FOUND;
 	preldr.params = (PRELDR_PARAMS*)(preldr.data);
@@ -377,7 +422,24 @@ void Bios::preldrValidateAndDecryptBldr() {
 		}
 	}
 
+	// the FBL hashes the rom up to its own block as it is in flash; hash it before anything is decrypted.
+	if (!(components & BIOS_COMPONENT_BLDR) && params.romsize >= BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE && params.romsize <= size) {
+		SHA1Context sha;
+		SHA1Reset(&sha);
+		SHA1Input(&sha, data + size - params.romsize, params.romsize - MCPX_BLOCK_SIZE - PRELDR_BLOCK_SIZE);
+		SHA1Result(&sha, preldr.rom_hash);
+		preldr.rom_hashed = true;
+	}
+
 	preldr.status = PRELDR_STATUS_FOUND;
+}
+void Bios::preldrValidateAndDecryptBldr() {
+	// validate the preldr and decrypt the 2bl.
+
+	loadPreldr();
+	if (preldr.status != PRELDR_STATUS_FOUND) {
+		return;
+	}
 
 	// ignore the preldr if a rev 0 equivalent mcpx was provided.
 	if (params.mcpx->rev == MCPX_REV_0) {
@@ -439,11 +501,11 @@ void Bios::preldrSymmetricEncDecBldr(const uint8_t* key, const uint32_t len) {
 	// encrypt / decrypt 2bl ( preserve preldr block )
 
 	if (!IN_BOUNDS_BLOCK(bldr.data, BLDR_BLOCK_SIZE, data, size)) {
-		printf("Error: De/Encrypting 2BL. 2BL ptr is out of bounds\n");
+		log_error("De/Encrypting 2BL. 2BL ptr is out of bounds\n");
 		return;
 	}
 
-	printf("%s 2BL (preserving FBL)\n", bldr.encryption_state ? "Decrypting" : "Encrypting");
+	log_info("%s 2BL (preserving FBL)\n", bldr.encryption_state ? "Decrypting" : "Encrypting");
 
 	RC4_CONTEXT context = { 0 };
 	rc4_key(&context, key, len);
@@ -464,11 +526,11 @@ void Bios::symmetricEncDecBldr(const uint8_t* key, const uint32_t len) {
 	// encrypt / decrypt 2bl
 
 	if (!IN_BOUNDS_BLOCK(bldr.data, BLDR_BLOCK_SIZE, data, size)) {
-		printf("Error: De/Encrypting 2BL. 2BL ptr is out of bounds\n");
+		log_error("De/Encrypting 2BL. 2BL ptr is out of bounds\n");
 		return;
 	}
 
-	printf("%s 2BL\n", bldr.encryption_state ? "Decrypting" : "Encrypting");
+	log_info("%s 2BL\n", bldr.encryption_state ? "Decrypting" : "Encrypting");
 	
 	RC4_CONTEXT context = { 0 };
 	rc4_key(&context, key, len);
@@ -501,11 +563,11 @@ void Bios::symmetricEncDecKernel() {
 	}
 
 	if (!IN_BOUNDS_BLOCK(kernel.compressed_kernel_ptr, bldr.boot_params->compressed_kernel_size, data, size)) {
-		printf("Error: De/Encrypting kernel. kernel ptr is out of bounds\n");
+		log_error("De/Encrypting kernel. kernel ptr is out of bounds\n");
 		return;
 	}
 
-	printf("%s kernel\n", kernel.encryption_state ? "Decrypting" : "Encrypting");
+	log_info("%s kernel\n", kernel.encryption_state ? "Decrypting" : "Encrypting");
 		
 	RC4_CONTEXT context = { 0 };
 	rc4_key(&context, key, XB_KEY_SIZE);
@@ -517,22 +579,48 @@ void Bios::symmetricEncDecKernel() {
 int Bios::decompressKrnl() {
 	// decompress kernel
 
-	if (kernel.compressed_kernel_ptr == NULL || bios_status != BIOS_LOAD_STATUS_SUCCESS) {
+	if (kernel.img != NULL) {
+		return 0;
+	}
+
+	if (loadKernel() != BIOS_LOAD_STATUS_SUCCESS || kernel.compressed_kernel_ptr == NULL) {
 		return 1;
 	}
 
+	const uint32_t compressed_size = bldr.boot_params->compressed_kernel_size;
+	uint8_t key[SHA1_DIGEST_LEN];
+
+	// a known kernel is mapped from the cache.
+	if (params.krnl_cache != NULL && IN_BOUNDS_BLOCK(kernel.compressed_kernel_ptr, compressed_size, data, size)) {
+		krnl_cache_key(kernel.compressed_kernel_ptr, compressed_size, key);
+		if (krnl_cache_get(params.krnl_cache, key, &img_map, &kernel.img_size) == KRNL_CACHE_ERROR_SUCCESS) {
+			log_info("Kernel image cache hit\n");
+			kernel.img = img_map.data;
+			return 0;
+		}
+	}
+
 	// use decompression function.
 	uint32_t buffer_size = (1 * 1024 * 1024 / 2); // 512 kb ( 26 blocks )
 	kernel.img = (uint8_t*)malloc(buffer_size);
 	if (kernel.img == NULL)
 		return 1;
-	if (lzx_decompress(kernel.compressed_kernel_ptr, bldr.boot_params->compressed_kernel_size, &kernel.img, &buffer_size, &kernel.img_size) != 0)
-		return 1;		
+	if (lzx_decompress(kernel.compressed_kernel_ptr, compressed_size, &kernel.img, &buffer_size, &kernel.img_size) != 0) {
+		free(kernel.img);
+		kernel.img = NULL;
+		return 1;
+	}
+
+	// failing to cache the image is not an error.
+	if (params.krnl_cache != NULL && IN_BOUNDS_BLOCK(kernel.compressed_kernel_ptr, compressed_size, data, size)) {
+		krnl_cache_put(params.krnl_cache, key, kernel.img, kernel.img_size);
+	}
 	return 0;
 }
 int Bios::preldrDecryptPublicKey() {
 	// decrypt the preldr public key
 
+	loadPreldr();
 	if (preldr.public_key == NULL)
 		return 1;
 
@@ -554,6 +642,124 @@ int Bios::preldrDecryptPublicKey() {
 
 	return 0;
 }
+int Bios::preldrVerifyRomDigest(uint8_t* digest) {
+	// verify the rom digest signature with the preldr public key against the sha1 of the rom.
+
+	XB_PUBLIC_KEY public_key;
+	uint8_t recovered[SHA1_DIGEST_LEN];
+
+	loadPreldr();
+	if (preldr.public_key == NULL || rom_digest == NULL)
+		return 1;
+
+	// get sbkey
+	uint8_t* sbkey = NULL;
+	if (params.bldr_key != NULL) {
+		sbkey = params.bldr_key;
+	}
+	else if (params.mcpx->sbkey != NULL) {
+		sbkey = params.mcpx->sbkey;
+	}
+	else {
+		return 2;
+	}
+
+	// the rom is hashed when the preldr is located, before the 2BL is decrypted.
+	if (!preldr.rom_hashed)
+		return 2;
+
+	// decrypt a copy of the public key.
+	memcpy(&public_key, preldr.public_key, sizeof(XB_PUBLIC_KEY));
+	RC4_CONTEXT context = { 0 };
+	rc4_key(&context, sbkey, 12);
+	rc4(&context, (uint8_t*)&public_key, sizeof(XB_PUBLIC_KEY));
+
+	if (rsa_verifyPublicKey((uint8_t*)&public_key, sizeof(XB_PUBLIC_KEY), 0, NULL) != RSA_ERROR_SUCCESS)
+		return 1;
+
+	if (RSA_MOD_SIZE(&public_key.header) != ROM_DIGEST_SIZE)
+		return 1;
+
+	if (rsa_recoverDigest((PUBLIC_KEY*)&public_key, rom_digest, recovered) != RSA_ERROR_SUCCESS)
+		return 1;
+
+	if (digest != NULL)
+		memcpy(digest, recovered, SHA1_DIGEST_LEN);
+
+	if (memcmp(recovered, preldr.rom_hash, SHA1_DIGEST_LEN) != 0)
+		return 1;
+
+	return 0;
+}
+int Bios::getComponent(const IDENT_TYPE type, const uint8_t** component, uint32_t* component_size) {
+	// the bytes of a component the way the identification database keys it.
+
+	*component = NULL;
+	*component_size = 0;
+
+	switch (type) {
+		case IDENT_TYPE_PRELDR:
+			loadPreldr();
+			if (preldr.status >= PRELDR_STATUS_NOT_FOUND)
+				return 1;
+			*component = preldr.data;
+			*component_size = PRELDR_SIZE;
+			break;
+
+		case IDENT_TYPE_BLDR:
+			if (loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+				return 1;
+			// the boot params and the FBL block are rewritten by every build.
+			*component = bldr.data;
+			*component_size = (preldr.status < PRELDR_STATUS_NOT_FOUND) ? BLDR_BLOCK_SIZE - PRELDR_BLOCK_SIZE : BLDR_BLOCK_SIZE - sizeof(BOOT_PARAMS);
+			break;
+
+		case IDENT_TYPE_INIT_TBL:
+			if (loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+				return 1;
+			*component = data;
+			*component_size = bldr.boot_params->init_tbl_size;
+			break;
+
+		case IDENT_TYPE_KERNEL:
+			if (loadKernel() != BIOS_LOAD_STATUS_SUCCESS || kernel.compressed_kernel_ptr == NULL)
+				return 1;
+			*component = kernel.compressed_kernel_ptr;
+			*component_size = bldr.boot_params->compressed_kernel_size;
+			break;
+
+		case IDENT_TYPE_KERNEL_DATA:
+			if (loadBldr() != BIOS_LOAD_STATUS_SUCCESS || kernel.uncompressed_data_ptr == NULL)
+				return 1;
+			*component = kernel.uncompressed_data_ptr;
+			*component_size = bldr.boot_params->uncompressed_kernel_data_size;
+			break;
+
+		default:
+			return 1;
+	}
+
+	if (*component_size == 0)
+		return 1;
+
+	return 0;
+}
+int Bios::hashComponent(const IDENT_TYPE type, uint8_t* hash) {
+	// hash a component the way the identification database keys it. the kernel hash is the kernel cache key.
+
+	const uint8_t* component;
+	uint32_t component_size;
+
+	if (getComponent(type, &component, &component_size) != 0)
+		return 1;
+
+	SHA1Context context;
+	SHA1Reset(&context);
+	SHA1Input(&context, component, component_size);
+	SHA1Result(&context, hash);
+
+	return 0;
+}
 
 void Bios::resetValues() {
 	// reset bios class values.
@@ -565,6 +771,13 @@ void Bios::resetValues() {
 
 	data = NULL;
 	size = 0;
+	map.data = NULL;
+	map.size = 0;
+	map.writable = false;
+	img_map.data = NULL;
+	img_map.size = 0;
+	img_map.writable = false;
+	components = 0;
 
 	init_tbl = NULL;
 	rom_digest = NULL;
@@ -575,12 +788,20 @@ void Bios::resetValues() {
 void Bios::unload() {
 	// unload bios
 
-	if (data != NULL) {
+	if (map.data != NULL) {
+		unmapFile(&map);
+		data = NULL;
+	}
+	else if (data != NULL) {
 		free(data);
 		data = NULL;
 	}
 
-	if (kernel.img != NULL) {
+	if (img_map.data != NULL) {
+		unmapFile(&img_map);
+		kernel.img = NULL;
+	}
+	else if (kernel.img != NULL) {
 		free(kernel.img);
 		kernel.img = NULL;
 	}
@@ -597,6 +818,19 @@ void bios_print_state(Bios* bios) {
 		bios->bldr.boot_params->uncompressed_kernel_data_size, bios->bldr.boot_params->compressed_kernel_size,
 		BLDR_BLOCK_SIZE, bios->bldr.boot_params->init_tbl_size, bios->available_space);
 }
+void bios_preldr_create_key(const uint8_t* sbkey, const uint8_t* nonce, uint8_t* key) {
+	// create the bldr key from the sb key and the preldr nonce.
+
+	uint8_t tmp[XB_KEY_SIZE];
+	SHA1Context sha = { 0 };
+	SHA1Reset(&sha);
+	SHA1Input(&sha, sbkey, XB_KEY_SIZE);
+	SHA1Input(&sha, nonce, PRELDR_NONCE_SIZE);
+	for (int i = 0; i < XB_KEY_SIZE; ++i)
+		tmp[i] = sbkey[i] ^ 0x5C;
+	SHA1Input(&sha, tmp, XB_KEY_SIZE);
+	SHA1Result(&sha, key);
+}
 int bios_check_size(const uint32_t size) {
 	switch (size) {
 		case 0x40000U:
@@ -606,6 +840,43 @@ int bios_check_size(const uint32_t size) {
 	}
 	return 1;
 }
+bool bios_is_kernel_img(const uint8_t* data, const uint32_t size) {
+	// check for the dos and pe signatures of an uncompressed kernel image.
+
+	const IMAGE_DOS_HEADER* dos = (const IMAGE_DOS_HEADER*)data;
+
+	if (data == NULL || size < sizeof(IMAGE_DOS_HEADER))
+		return false;
+
+	if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+		return false;
+
+	if (dos->e_lfanew > size - sizeof(uint32_t))
+		return false;
+
+	return *(const uint32_t*)(data + dos->e_lfanew) == IMAGE_NT_SIGNATURE;
+}
+int bios_compress_kernel(const uint8_t* img, const uint32_t img_size, uint8_t** compressed_kernel, uint32_t* kernel_size) {
+	// lzx compress an uncompressed kernel image for a build.
+
+	int result;
+
+	*compressed_kernel = NULL;
+	*kernel_size = 0;
+
+	result = lzx_compress(img, img_size, compressed_kernel, kernel_size);
+	if (result != 0) {
+		log_error("Failed to compress the kernel image\n");
+		if (*compressed_kernel != NULL) {
+			free(*compressed_kernel);
+			*compressed_kernel = NULL;
+		}
+		*kernel_size = 0;
+		return 1;
+	}
+
+	return 0;
+}
 int bios_replicate_data(uint32_t from, uint32_t to, uint8_t* buffer, uint32_t buffersize) {
 	// replicate buffer based on to
 
@@ -627,6 +898,35 @@ int bios_replicate_data(uint32_t from, uint32_t to, uint8_t* buffer, uint32_t bu
 
 	return 0;
 }
+int bios_detect_banks(const uint8_t* data, const uint32_t size, BIOS_BANKS* banks) {
+	// detect the rom size and the distinct banks of a bios image
+
+	uint32_t i, j;
+
+	if (bios_check_size(size) != 0)
+		return 1;
+
+	// halve while the image is two copies of its first half.
+	banks->romsize = size;
+	while (banks->romsize > MIN_BIOS_SIZE && memcmp(data, data + banks->romsize / 2, banks->romsize / 2) == 0) {
+		banks->romsize /= 2;
+	}
+
+	banks->banks = size / MIN_BIOS_SIZE;
+
+	// the banks of the unique rom are distinct unless a bank repeats within it.
+	banks->unique_banks = 0;
+	for (i = 0; i < banks->romsize / MIN_BIOS_SIZE; i++) {
+		for (j = 0; j < i; j++) {
+			if (memcmp(data + i * MIN_BIOS_SIZE, data + j * MIN_BIOS_SIZE, MIN_BIOS_SIZE) == 0)
+				break;
+		}
+		if (j == i)
+			banks->unique_banks++;
+	}
+
+	return 0;
+}
 
 void bios_init_preldr(PRELDR* preldr) {
 	preldr->data = NULL;
@@ -636,7 +936,9 @@ void bios_init_preldr(PRELDR* preldr) {
 	preldr->public_key = NULL;
 	for (int i = 0; i < SHA1_DIGEST_LEN; ++i) {
 		preldr->bldr_key[i] = 0;
+		preldr->rom_hash[i] = 0;
 	}
+	preldr->rom_hashed = false;
 	preldr->jmp_offset = 0;
 	preldr->status = PRELDR_STATUS_ERROR;
 }
@@ -664,6 +966,7 @@ void bios_init_params(BIOS_LOAD_PARAMS* params) {
 	params->enc_bldr = false;
 	params->enc_kernel = false;
 	params->restore_boot_params = true;
+	params->krnl_cache = NULL;
 }
 void bios_init_build_params(BIOS_BUILD_PARAMS* params) {
 	params->init_tbl = NULL;
@@ -722,7 +1025,7 @@ static int validate_required_space(const uint32_t requiredSpace, uint32_t* size)
 		}
 
 		if (bios_check_size(*size) != 0) {
-			printf("Error: romsize is less than the total size of the bios.\n");
+			log_error("romsize is less than the total size of the bios.\n");
 			return 1;
 		}
 	}
@@ -25,6 +25,8 @@
 #include <string.h>
 #include <direct.h>
 #include <malloc.h>
+#include <chrono>
+#include <thread>
 
 // user incl
 #include "XbTool.h"
@@ -38,6 +40,18 @@
 #include "rc4.h"
 #include "rsa.h"
 #include "sha1.h"
+#include "tea.h"
+#include "tea_search.h"
+#include "eeprom.h"
+#include "xbe.h"
+#include "boot_sim.h"
+#include "bld_matrix.h"
+#include "bld_graph.h"
+#include "bios_patch.h"
+#include "bios_scan.h"
+#include "bios_sketch.h"
+#include "xbios.h"
+#include "log.h"
 #include "lzx.h"
 #include "help_strings.h"
 #include "version.h"
@@ -46,6 +60,7 @@
 #include "mem_tracking.h"
 #endif
 
+// command line state. the CLI only; library code is passed what it needs, see xbios.h.
 static XbToolParameters params;
 static const CMD_TBL* cmd;
 
@@ -64,6 +79,16 @@ static const CMD_TBL cmd_tbl[] = {
 	{ "replicate", CMD_REPLICATE_BIOS, {SW_IN_FILE}, {SW_IN_FILE} },
 	{ "compress", CMD_COMPRESS_FILE, {SW_IN_FILE, SW_OUT_FILE}, {SW_IN_FILE} },
 	{ "decompress", CMD_DECOMPRESS_FILE, {SW_IN_FILE, SW_OUT_FILE}, {SW_IN_FILE} },
+	{ "tea-search", CMD_TEA_SEARCH, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "eeprom", CMD_EEPROM, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "xbe", CMD_XBE, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "bld-matrix", CMD_BUILD_MATRIX, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "diff", CMD_DIFF, {SW_IN_FILE, SW_BIOS_FILE}, {SW_IN_FILE, SW_BIOS_FILE} },
+	{ "mkpatch", CMD_MKPATCH, {SW_IN_FILE, SW_BIOS_FILE}, {SW_IN_FILE, SW_BIOS_FILE} },
+	{ "applypatch", CMD_APPLYPATCH, {SW_IN_FILE, SW_PATCH_FILE}, {SW_IN_FILE, SW_PATCH_FILE} },
+	{ "mkident", CMD_MKIDENT, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "scan", CMD_SCAN, {SW_IN_FILE}, {SW_IN_FILE} },
+	{ "similar", CMD_SIMILAR, {SW_IN_FILE, SW_INDEX}, {SW_IN_FILE} },
 };
 static const PARAM_TBL param_tbl[] = {
 	{ "in", &params.in_file, SW_IN_FILE, PARAM_TBL::STR },
@@ -114,6 +139,23 @@ static const PARAM_TBL param_tbl[] = {
 	{ "dir", &params.working_directory_path, SW_WORKING_DIRECTORY, PARAM_TBL::STR },
 	{ "xcodes", &params.xcodes_file, SW_XCODES, PARAM_TBL::STR },
 	{ "offset", &params.offset, SW_OFFSET, PARAM_TBL::INT },
+	{ "keyring", &params.keyring_path, SW_KEYRING, PARAM_TBL::STR },
+	{ "ckpt", &params.checkpoint_file, SW_CHECKPOINT, PARAM_TBL::STR },
+	{ "region", &params.game_region, SW_GAME_REGION, PARAM_TBL::INT },
+	{ "bios", &params.bios_file, SW_BIOS_FILE, PARAM_TBL::STR },
+	{ "bootable", NULL, SW_LS_BOOTABLE, PARAM_TBL::FLAG },
+	{ "krnl-cache", &params.krnl_cache_path, SW_KRNL_CACHE, PARAM_TBL::STR },
+	{ "cachesize", &params.cache_size, SW_CACHE_SIZE, PARAM_TBL::INT },
+	{ "watch", NULL, SW_WATCH, PARAM_TBL::FLAG },
+	{ "patch", &params.patch_file, SW_PATCH_FILE, PARAM_TBL::STR },
+	{ "ident", &params.ident_path, SW_IDENT, PARAM_TBL::STR },
+	{ "json", NULL, SW_JSON, PARAM_TBL::FLAG },
+	{ "store", &params.store_path, SW_STORE, PARAM_TBL::STR },
+	{ "index", &params.index_path, SW_INDEX, PARAM_TBL::STR },
+	{ "top", &params.top, SW_TOP, PARAM_TBL::INT },
+	{ "limit", &params.limit, SW_LIMIT, PARAM_TBL::INT },
+	{ "loglevel", &params.log_level, SW_LOG_LEVEL, PARAM_TBL::STR },
+	{ "log", &params.log_file, SW_LOG_FILE, PARAM_TBL::STR },
 };
 
 uint8_t* load_init_tbl_file(uint32_t* size, uint32_t* base);
@@ -122,12 +164,24 @@ void lzx_print_error(int error);
 // Command Functions
 
 int buildBios() {
+	// the build itself is done by libxbios; this reads the inputs and reports.
+
 	int result = 0;
 	const char* filename = params.out_file;
+	const uint8_t* image = NULL;
+	uint32_t size = 0;
 	
-	Bios bios;
+	XBIOS* xbios = NULL;
+	XBIOS_PARAMS xbios_params;
+	XBIOS_BUILD_PARAMS xbios_build_params;
 	BIOS_LOAD_PARAMS bios_params;
 	BIOS_BUILD_PARAMS build_params;
+	uint8_t* kernel_img = NULL;
+	uint32_t kernel_img_size = 0;
+	uint8_t* xcodes = NULL;
+	uint32_t xcodes_size = 0;
+	int compress_result = 0;
+	std::thread compressor;
 
 	printf("Build BIOS\n\n");
 
@@ -145,6 +199,10 @@ int buildBios() {
 	build_params.hacksignature = isFlagSet(SW_HACK_SIGNATURE);
 	build_params.nobootparams = isFlagSet(SW_UPDATE_BOOT_PARAMS);
 
+	if (isFlagSet(SW_WATCH)) {
+		return watchBuildBios(&bios_params, &build_params);
+	}
+
 	if (params.mcpx_file != NULL)
 		printf("mcpx file:\t\t%s\n", params.mcpx_file);
 
@@ -173,13 +231,24 @@ int buildBios() {
 		goto Cleanup;
 	}
 
-	// compressed krnl image
+	// krnl image; compressed, or an uncompressed pe image.
 	printf("Kernel file:\t\t%s\n", params.kernel_file);
-	build_params.compressed_kernel = readFile(params.kernel_file, &build_params.kernel_size, 0);
-	if (build_params.compressed_kernel == NULL) {
+	kernel_img = readFile(params.kernel_file, &kernel_img_size, 0);
+	if (kernel_img == NULL) {
 		result = 1;
 		goto Cleanup;
 	}
+	if (bios_is_kernel_img(kernel_img, kernel_img_size)) {
+		// compress the kernel image while the rest of the inputs are read.
+		compressor = std::thread([&]() {
+			compress_result = bios_compress_kernel(kernel_img, kernel_img_size, &build_params.compressed_kernel, &build_params.kernel_size);
+		});
+	}
+	else {
+		build_params.compressed_kernel = kernel_img;
+		build_params.kernel_size = kernel_img_size;
+		kernel_img = NULL;
+	}
 
 	// uncompressed kernel data
 	printf("Kernel data file:\t%s\n", params.kernel_data_file);
@@ -201,40 +270,268 @@ int buildBios() {
 		build_params.cert_key = readFile(params.cert_key_file, NULL, XB_KEY_SIZE);		
 	}
 
-	printf("rom size:\t\t%u kb\n\n", params.romsize / 1024);
-
-	result = bios.build(&build_params, params.binsize, &bios_params);
-
 	// xcodes
 	if (isFlagSet(SW_XCODES)) {
-		uint32_t xcodesSize;
-		uint8_t* xcodes = readFile(params.xcodes_file, &xcodesSize, 0);
+		printf("Xcodes file:\t\t%s\n", params.xcodes_file);
+		xcodes = readFile(params.xcodes_file, &xcodes_size, 0);
 		if (xcodes == NULL) {
 			result = 1;
+			goto Cleanup;
 		}
-		else {
-			result = inject_xcodes(bios.data, bios.size, xcodes, xcodesSize);
-			free(xcodes);
-			xcodes = NULL;
+	}
+
+	printf("rom size:\t\t%u kb\n\n", params.romsize / 1024);
+
+	if (compressor.joinable()) {
+		compressor.join();
+		if (compress_result != 0) {
+			printf("Error: Failed to compress the kernel image\n");
+			result = 1;
+			goto Cleanup;
 		}
+		printf("Compressed kernel image %u -> %u bytes\n\n", kernel_img_size, build_params.kernel_size);
+	}
+
+	xbios_init_params(&xbios_params);
+	xbios_params.bldr_key = params.bldr_key;
+	xbios_params.kernel_key = params.kernel_key;
+	xbios_params.mcpx = params.mcpx.data;
+	xbios_params.ident = &params.ident;
+	xbios_params.romsize = params.romsize;
+	xbios_params.enc_bldr = bios_params.enc_bldr;
+	xbios_params.enc_kernel = bios_params.enc_kernel;
+
+	xbios_init_build_params(&xbios_build_params);
+	xbios_build_params.init_tbl = build_params.init_tbl;
+	xbios_build_params.preldr = build_params.preldr;
+	xbios_build_params.bldr = build_params.bldr;
+	xbios_build_params.compressed_kernel = build_params.compressed_kernel;
+	xbios_build_params.kernel_data = build_params.kernel_data;
+	xbios_build_params.eeprom_key = build_params.eeprom_key;
+	xbios_build_params.cert_key = build_params.cert_key;
+	xbios_build_params.xcodes = xcodes;
+	xbios_build_params.init_tbl_size = build_params.init_tbl_size;
+	xbios_build_params.preldr_size = build_params.preldr_size;
+	xbios_build_params.bldr_size = build_params.bldrSize;
+	xbios_build_params.kernel_size = build_params.kernel_size;
+	xbios_build_params.kernel_data_size = build_params.kernel_data_size;
+	xbios_build_params.xcodes_size = xcodes_size;
+	xbios_build_params.binsize = params.binsize;
+	xbios_build_params.bfm = build_params.bfm;
+	xbios_build_params.hackinittbl = build_params.hackinittbl;
+	xbios_build_params.hacksignature = build_params.hacksignature;
+	xbios_build_params.nobootparams = build_params.nobootparams;
+
+	xbios = xbios_create(&xbios_params);
+	if (xbios == NULL) {
+		printf("Error: Out of memory\n");
+		result = 1;
+		goto Cleanup;
 	}
 
-	if (result != 0) {
+	filename = params.out_file;
+	if (filename == NULL)
+		filename = "bios.bin";
+
+	// the build goes into a temp file; it replaces the output only once the build succeeds.
+	if (xbios_build(xbios, &xbios_build_params, filename) != XBIOS_ERROR_SUCCESS) {
 		printf("Error: Failed to build bios\n");
+		result = 1;
+		goto Cleanup;
 	}
-	else {
-		filename = params.out_file;
-		if (filename == NULL)
-			filename = "bios.bin";
-		result = writeFileF(filename, "bios", bios.data, bios.size);
-	}
+
+	xbios_image(xbios, &image, &size);
+	printWriteF(filename, "bios", size);
 
 Cleanup:
-		
+
+	if (compressor.joinable()) {
+		compressor.join();
+	}
+
+	if (kernel_img != NULL) {
+		free(kernel_img);
+		kernel_img = NULL;
+	}
+
+	if (xcodes != NULL) {
+		free(xcodes);
+		xcodes = NULL;
+	}
+
+	xbios_destroy(xbios);
 	bios_free_build_params(&build_params);
 	
 	return result;
 }
+int watchBuildBios(const BIOS_LOAD_PARAMS* bios_params, const BIOS_BUILD_PARAMS* build_params) {
+	// rebuild the bios whenever an input file changes. only the stages that depend on the change are run.
+
+	static const uint32_t POLL_MS = 250;
+
+	BLD_GRAPH graph;
+	BIOS_LAYOUT layout;
+	const char* filename;
+	char* temp;
+	uint8_t* image = NULL;
+	uint32_t size = 0;
+	uint32_t written = 0;
+	int changed;
+	int i;
+	bool failed = false;
+	bool retry;
+
+	filename = params.out_file;
+	if (filename == NULL)
+		filename = "bios.bin";
+
+	bld_graph_init(&graph);
+	bld_graph_set_input(&graph, BLD_NODE_BLDR, params.bldr_file);
+	bld_graph_set_input(&graph, BLD_NODE_INITTBL, params.init_tbl_file);
+	bld_graph_set_input(&graph, BLD_NODE_KRNL, params.kernel_file);
+	bld_graph_set_input(&graph, BLD_NODE_KRNLDATA, params.kernel_data_file);
+	bld_graph_set_input(&graph, BLD_NODE_PRELDR, params.preldr_file);
+	bld_graph_set_input(&graph, BLD_NODE_EEPROM_KEY, params.eeprom_key_file);
+	bld_graph_set_input(&graph, BLD_NODE_CERT_KEY, params.cert_key_file);
+	if (isFlagSet(SW_XCODES))
+		bld_graph_set_input(&graph, BLD_NODE_XCODES, params.xcodes_file);
+
+	printf("Watching the inputs of %s. Press Ctrl+C to stop.\n\n", filename);
+	fflush(stdout);
+
+	for (;;) {
+		changed = bld_graph_update(&graph);
+		if (changed < 0) {
+			// an editor may be part way through saving; try again on the next poll.
+			if (!failed)
+				printf("Error: Failed to read the inputs; waiting for them to change\n\n");
+			failed = true;
+		}
+		else if (changed > 0 || failed) {
+			// inputs read before a failed update are not flagged again; write the image regardless.
+			retry = failed;
+			failed = false;
+			for (i = 0; i < BLD_NODE_INPUT_COUNT; ++i) {
+				if (graph.nodes[i].rebuilt)
+					printf("Changed: %s\n", graph.nodes[i].path);
+			}
+
+			if (bld_graph_build(&graph, build_params, params.binsize, bios_params) != BIOS_LOAD_STATUS_SUCCESS) {
+				printf("Error: Failed to build bios\n\n");
+			}
+			else if (graph.nodes[BLD_NODE_IMAGE].rebuilt || graph.nodes[BLD_NODE_XCODES].rebuilt || retry) {
+				if (graph.nodes[BLD_NODE_COMPRESS].rebuilt && graph.compressed) {
+					printf("Compressed kernel image %u -> %u bytes\n", graph.nodes[BLD_NODE_KRNL].data_size, graph.nodes[BLD_NODE_COMPRESS].data_size);
+				}
+
+				size = graph.nodes[BLD_NODE_IMAGE].data_size;
+				image = (uint8_t*)malloc(size);
+				if (image == NULL) {
+					printf("Error: Out of memory\n\n");
+				}
+				else {
+					memcpy(image, graph.nodes[BLD_NODE_IMAGE].data, size);
+					layout.romsize = graph.romsize;
+					layout.kernel_size = graph.nodes[BLD_NODE_COMPRESS].data_size;
+					layout.kernel_data_size = graph.nodes[BLD_NODE_KRNLDATA].data_size;
+					layout.preldr = (graph.nodes[BLD_NODE_PRELDR].data != NULL);
+					if (graph.nodes[BLD_NODE_XCODES].data != NULL && bios_inject_xcodes(image, size, &layout, graph.nodes[BLD_NODE_XCODES].data, graph.nodes[BLD_NODE_XCODES].data_size) != BIOS_MAP_ERROR_SUCCESS) {
+						printf("Error: Failed to inject xcodes\n\n");
+					}
+					else {
+						// written to a temp file and renamed, so the output is never seen part way written.
+						temp = tempFileName(filename);
+						if (temp == NULL || writeFile(temp, image, size) != 0 || renameFile(temp, filename) != 0) {
+							printf("Error: Failed to write %s\n", filename);
+							if (temp != NULL)
+								deleteFile(temp);
+						}
+						else {
+							printWriteF(filename, "bios", size);
+							written++;
+						}
+						if (temp != NULL)
+							free(temp);
+						printf("\n");
+					}
+					free(image);
+					image = NULL;
+				}
+			}
+			else {
+				printf("%s is up to date\n\n", filename);
+			}
+			fflush(stdout);
+		}
+
+		// -limit stops after writing n images.
+		if (isFlagSet(SW_LIMIT) && written >= params.limit)
+			break;
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(POLL_MS));
+	}
+
+	bld_graph_free(&graph);
+	return 0;
+}
+int buildMatrix() {
+	// build the bios variants declared in a manifest.
+
+	int result = 0;
+	uint32_t i;
+	BLD_MATRIX matrix;
+	BIOS_LOAD_PARAMS bios_params;
+	LOG_LEVEL level;
+
+	printf("Build BIOS matrix\n\n");
+
+	bios_init_params(&bios_params);
+	bios_params.mcpx = &params.mcpx;
+	bios_params.bldr_key = params.bldr_key;
+	bios_params.kernel_key = params.kernel_key;
+
+	if (params.mcpx_file != NULL)
+		printf("mcpx file:\t\t%s\n", params.mcpx_file);
+	printf("manifest:\t\t%s\n", params.in_file);
+
+	bld_matrix_init(&matrix);
+	if (bld_matrix_load(&matrix, params.in_file) != BLD_MATRIX_ERROR_SUCCESS) {
+		printf("Error: Failed to load the manifest\n");
+		result = 1;
+		goto Cleanup;
+	}
+
+	printf("variants:\t\t%u\n", matrix.count);
+	if (matrix.kernel_img_size != 0) {
+		printf("Compressed kernel image %u -> %u bytes\n", matrix.kernel_img_size, matrix.inputs.kernel_size);
+	}
+	printf("\n");
+
+	// the variants build in parallel; keep their progress messages out of the output.
+	level = log_get_level();
+	log_set_level(LOG_LEVEL_WARN);
+	result = bld_matrix_build(&matrix, &bios_params, 0);
+	log_set_level(level);
+
+	for (i = 0; i < matrix.count; ++i) {
+		if (matrix.variants[i].result == BIOS_LOAD_STATUS_SUCCESS) {
+			printWriteF(matrix.variants[i].out, matrix.variants[i].name, matrix.variants[i].size);
+		}
+		else {
+			printf("Error: Failed to build %s\n", matrix.variants[i].name);
+		}
+	}
+
+	if (result != BLD_MATRIX_ERROR_SUCCESS) {
+		result = 1;
+	}
+
+Cleanup:
+
+	bld_matrix_free(&matrix);
+
+	return result;
+}
 int extractBios() {
 	// Extract components from the bios file.
 
@@ -243,6 +540,11 @@ int extractBios() {
 	size_t init_tbl_size = 0;
 	Bios bios;
 	BIOS_LOAD_PARAMS bios_params;
+	MCPX keyring_mcpx;
+	COMP_STORE store = { NULL };
+	COMP_STORE* store_ptr = NULL;
+	COMP_MANIFEST manifest;
+	uint32_t added = 0;
 
 
 	bios_init_params(&bios_params);
@@ -253,25 +555,37 @@ int extractBios() {
 	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
 	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
 	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+	bios_params.krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
 	
 	printf("Extract BIOS\n\n");
 
-	uint32_t size = 0;
-	uint8_t* buffer = readFile(params.in_file, &size, 0);
-	if (buffer == NULL) {
+	MAPPED_FILE map;
+	if (mapFile(params.in_file, &map) != 0) {
 		return 1;
 	}
+	uint32_t size = map.size;
 
 	if (bios_check_size(size) != 0) {
 		printf("Error: BIOS size is invalid\n");
+		unmapFile(&map);
 		return 1;
 	}
 
 	if (params.mcpx_file != NULL)
 		printf("mcpx file: %s\n", params.mcpx_file);
-	printf("bios file: %s\nbios size: %d kb\nrom size:  %d kb\n\n", params.in_file, size / 1024, params.romsize / 1024);
+	printf("bios file: %s\nbios size: %d kb\n", params.in_file, size / 1024);
+	detect_banks(map.data, size, &bios_params);
+
+	if (trial_keyring(map.data, size, &bios_params, &keyring_mcpx) != 0) {
+		unmapFile(&map);
+		return 1;
+	}
 
-	result = bios.load(buffer, size, &bios_params);
+	// extracting needs every component.
+	result = bios.load(&map, &bios_params);
+	if (result == BIOS_LOAD_STATUS_SUCCESS) {
+		result = bios.loadKernel();
+	}
 	if (result != BIOS_LOAD_STATUS_SUCCESS) {
 		printf("Error: invalid 2BL\n");		
 		return 1;
@@ -287,8 +601,25 @@ int extractBios() {
 		}
 	}
 
-	// zero rom digest so we have a clean 2bl;
-	if (bios.rom_digest != NULL) {
+	// store mode; components go into the store, and a manifest that rebuilds the bios from it is written.
+	if (params.store_path != NULL) {
+		if (comp_store_open(&store, params.store_path) != COMP_STORE_ERROR_SUCCESS) {
+			printf("Error: Failed to open the store '%s'\n", params.store_path);
+			return 1;
+		}
+		store_ptr = &store;
+
+		comp_manifest_init(&manifest);
+		comp_manifest_set_name(&manifest, params.in_file);
+		manifest.romsize = bios_params.romsize;
+		manifest.binsize = size;
+		manifest.enc_bldr = bios_params.enc_bldr;
+		// load and build read the kernel flags the other way round; see Bios::build().
+		manifest.enc_kernel = !bios_params.enc_kernel && bios_params.kernel_key == NULL;
+	}
+
+	// zero rom digest so we have a clean 2bl; a stored 2BL is kept as is so the image rebuilds unchanged.
+	if (bios.rom_digest != NULL && store_ptr == NULL) {
 		memset(bios.rom_digest, 0, ROM_DIGEST_SIZE);
 	}
 
@@ -297,19 +628,21 @@ int extractBios() {
 		filename = params.preldr_file;
 		if (filename == NULL)
 			filename = "preldr.bin";
-		writeFileF(filename, "preldr", bios.preldr.data, PRELDR_SIZE);
+		result |= extract_component(store_ptr, &manifest, &added, IDENT_TYPE_PRELDR, filename, "preldr", bios.preldr.data, PRELDR_SIZE);
 
-		// zero preldr
-		memset(bios.preldr.data, 0, PRELDR_SIZE);
-		// zero preldr params.
-		memset(bios.preldr.data + PRELDR_SIZE + ROM_DIGEST_SIZE, 0, PRELDR_PARAMS_SIZE - sizeof(BOOT_PARAMS));
+		if (store_ptr == NULL) {
+			// zero preldr
+			memset(bios.preldr.data, 0, PRELDR_SIZE);
+			// zero preldr params.
+			memset(bios.preldr.data + PRELDR_SIZE + ROM_DIGEST_SIZE, 0, PRELDR_PARAMS_SIZE - sizeof(BOOT_PARAMS));
+		}
 	}
 
 	// 2bl
 	filename = params.bldr_file;
 	if (filename == NULL)
 		filename = "bldr.bin";
-	writeFileF(filename, "2BL", bios.bldr.data, BLDR_BLOCK_SIZE);
+	result |= extract_component(store_ptr, &manifest, &added, IDENT_TYPE_BLDR, filename, "2BL", bios.bldr.data, BLDR_BLOCK_SIZE);
 	
 	// extract init tbl
 	init_tbl_size = bios.bldr.boot_params->init_tbl_size;
@@ -317,20 +650,27 @@ int extractBios() {
 		filename = params.init_tbl_file;
 		if (filename == NULL)
 			filename = "inittbl.bin";
-		writeFileF(filename, "init table", bios.data, init_tbl_size);
+		result |= extract_component(store_ptr, &manifest, &added, IDENT_TYPE_INIT_TBL, filename, "init table", bios.data, init_tbl_size);
 	}
 
 	// extract compressed kernel
 	filename = params.kernel_file;
 	if (filename == NULL)
 		filename = "krnl.bin";
-	writeFileF(filename, "compressed kernel", bios.kernel.compressed_kernel_ptr, bios.bldr.boot_params->compressed_kernel_size);
+	result |= extract_component(store_ptr, &manifest, &added, IDENT_TYPE_KERNEL, filename, "compressed kernel", bios.kernel.compressed_kernel_ptr, bios.bldr.boot_params->compressed_kernel_size);
 	
 	// extract uncompressed kernel section data
 	filename = params.kernel_data_file;
 	if (filename == NULL)
 		filename = "krnl_data.bin";
-	writeFileF(filename, "kernel data", bios.kernel.uncompressed_data_ptr, bios.bldr.boot_params->uncompressed_kernel_data_size);
+	result |= extract_component(store_ptr, &manifest, &added, IDENT_TYPE_KERNEL_DATA, filename, "kernel data", bios.kernel.uncompressed_data_ptr, bios.bldr.boot_params->uncompressed_kernel_data_size);
+
+	if (store_ptr != NULL) {
+		if (result == 0)
+			result = extract_manifest(&store, &manifest, bios_params.enc_kernel ? NULL : bios_params.kernel_key, added);
+		comp_store_close(&store);
+		return result;
+	}
 	
 	// decompress the kernel now so the public key can be extracted.
 	if (bios.decompressKrnl() == 0) {
@@ -391,7 +731,7 @@ int extractBios() {
 }
 int splitBios() {
 	int result = 0;
-	uint8_t* data = NULL;
+	uint64_t fileSize = 0;
 	uint32_t size = 0;
 	uint32_t fnLen = 0;
 	uint32_t bankFnLen = 0;
@@ -402,6 +742,7 @@ int splitBios() {
 	char* biosFn = NULL;
 	char* ext = NULL;
 	char* bankFn = NULL;
+	FILE_RANGE range;
 	int i;
 	int j;
 
@@ -410,10 +751,13 @@ int splitBios() {
 	//romsize sanity check
 	if (params.romsize < MIN_BIOS_SIZE)
 		return 1;
-		
-	data = readFile(params.in_file, &size, 0);
-	if (data == NULL)
+
+	// the banks are copied file to file; only the size is needed here.
+	if (getFileStat(params.in_file, &fileSize, NULL) != 0) {
+		printf("Error: Could not open file: %s\n", params.in_file);
 		return 1;
+	}
+	size = (fileSize > MAX_BIOS_SIZE) ? 0 : (uint32_t)fileSize;
 
 	result = bios_check_size(size);
 	if (result != 0) {
@@ -492,7 +836,10 @@ int splitBios() {
 
 		// write bank to file
 		printf("Writing bank %d to %s\n", bank + 1, bankFn);
-		result = writeFile(bankFn, (data + (params.romsize * bank)), params.romsize);
+		range.filename = params.in_file;
+		range.offset = params.romsize * bank;
+		range.size = params.romsize;
+		result = copyFileRanges(bankFn, &range, 1);
 		if (result != 0) {
 			goto Cleanup;
 		}
@@ -504,9 +851,6 @@ int splitBios() {
 	printf("BIOS split into %d banks\n", bank);
 
 Cleanup:
-	if (data != NULL) {
-		free(data);
-	}
 	if (biosFn != NULL) {
 		free(biosFn);
 	}
@@ -522,15 +866,12 @@ Cleanup:
 int combineBios() {
 	const uint32_t MAX_BANKS = MAX_BIOS_SIZE / MIN_BIOS_SIZE;
 	uint32_t totalSize = 0;
-	uint32_t offset = 0;
+	uint64_t fileSize = 0;
 	int i;
 	int result = 0;
 	int numBanks = 0;
 
-	uint8_t* data = NULL;
-
-	uint8_t* banks[MAX_BANKS] = { NULL };
-	uint32_t bankSizes[MAX_BANKS] = { 0 };
+	FILE_RANGE banks[MAX_BANKS] = { 0 };
 
 	printf("Combine BIOS\n\n");
 
@@ -544,62 +885,42 @@ int combineBios() {
 		if (params.bank_files[i] == NULL)
 			continue;
 
-		numBanks++;
-		
-		banks[i] = readFile(params.bank_files[i], &bankSizes[i], 0);
-		if (banks[i] == NULL) {
-			result = 1;
-			goto Cleanup;
+		if (getFileStat(params.bank_files[i], &fileSize, NULL) != 0) {
+			printf("Error: Could not open file: %s\n", params.bank_files[i]);
+			return 1;
 		}
 
-		if (bios_check_size(bankSizes[i]) != 0) {
-			printf("Error: %s has invalid file size: %d\n", params.bank_files[i], bankSizes[i]);
-			result = 1;
-			goto Cleanup;
+		banks[numBanks].filename = params.bank_files[i];
+		banks[numBanks].offset = 0;
+		banks[numBanks].size = (fileSize > MAX_BIOS_SIZE) ? 0 : (uint32_t)fileSize;
+
+		if (bios_check_size(banks[numBanks].size) != 0) {
+			printf("Error: %s has invalid file size: %llu\n", params.bank_files[i], (unsigned long long)fileSize);
+			return 1;
 		}
-		
-		totalSize += bankSizes[i];
+
+		printf("Copying %s %d kb into offset 0x%x (bank %d)\n", params.bank_files[i], banks[numBanks].size / 1024, totalSize, i + 1);
+		totalSize += banks[numBanks].size;
+		numBanks++;
 	}
 
 	if (numBanks < 2) {
 		printf("Error: Not enough banks to combine. Expected atleast 2 banks\n");
-		result = 1;
-		goto Cleanup;
+		return 1;
 	}
 
 	if (bios_check_size(totalSize) != 0) {
 		printf("Error: Invalid total bios size: %d\n", totalSize);
-		result = 1;
-		goto Cleanup;
-	}
-
-	data = (uint8_t*)malloc(totalSize);
-	if (data == NULL) {
-		result = 1;
-		goto Cleanup;
-	}
-
-	for (i = 0; i < MAX_BANKS; i++) {
-		if (banks[i] != NULL) {
-			printf("Copying %s %d kb into offset 0x%x (bank %d)\n", params.bank_files[i], bankSizes[i] / 1024, offset, i + 1);
-			memcpy(data + offset, banks[i], bankSizes[i]);
-			offset += bankSizes[i];
-		}
+		return 1;
 	}
 
-	result = writeFileF(filename, "bios", data, totalSize);
-	
-Cleanup:
-
-	if (data != NULL) {
-		free(data);
+	// the banks are copied file to file into the bios.
+	result = copyFileRanges(filename, banks, numBanks);
+	if (result == 0) {
+		printWriteF(filename, "bios", totalSize);
 	}
-
-	for (i = 0; i < MAX_BANKS; i++) {
-		if (banks[i] != NULL) {
-			free(banks[i]);
-			banks[i] = NULL;
-		}
+	else {
+		printf("Error: Failed to write %s\n", filename);
 	}
 
 	return result;
@@ -609,6 +930,7 @@ int listBios() {
 	int biosStatus = 0;
 	Bios bios;
 	BIOS_LOAD_PARAMS bios_params;
+	MCPX keyring_mcpx;
 
 	bios_init_params(&bios_params);
 	bios_params.mcpx = &params.mcpx;
@@ -618,25 +940,34 @@ int listBios() {
 	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
 	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
 	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+	bios_params.krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
 
 	printf("List BIOS\n\n");
 
-	uint32_t size = 0;
-	uint8_t* buffer = readFile(params.in_file, &size, 0);
-	if (buffer == NULL) {
+	MAPPED_FILE map;
+	if (mapFile(params.in_file, &map) != 0) {
 		return 1;
 	}
+	uint32_t size = map.size;
 
 	if (bios_check_size(size) != 0) {
 		printf("Error: BIOS size is invalid\n");
+		unmapFile(&map);
 		return 1;
 	}
 
 	if (params.mcpx_file != NULL) printf("mcpx file: %s\n", params.mcpx_file);
-	printf("bios file: %s\nbios size: %d kb\nrom size:  %d kb\n\n", params.in_file, size / 1024, params.romsize / 1024);
+	printf("bios file: %s\nbios size: %d kb\n", params.in_file, size / 1024);
+	detect_banks(map.data, size, &bios_params);
 
-	biosStatus = bios.load(buffer, size, &bios_params);	
-	if (biosStatus > BIOS_LOAD_STATUS_INVALID_BLDR) {
+	if (trial_keyring(map.data, size, &bios_params, &keyring_mcpx) != 0) {
+		unmapFile(&map);
+		return 1;
+	}
+
+	// the preldr, 2BL and kernel are only decrypted if the listing needs them.
+	biosStatus = bios.load(&map, &bios_params);
+	if (biosStatus != BIOS_LOAD_STATUS_SUCCESS) {
 		printf("Error: Failed to load BIOS\n");
 		return 1;
 	}
@@ -649,9 +980,13 @@ int listBios() {
 		// rom data table
 		printDataTblInfo(&bios);
 	}
+	else if (isFlagSet(SW_LS_BOOTABLE)) {
+		// simulate the boot path
+		result = printBootInfo(&bios);
+	}
 	else if (isFlagSet(SW_KEYS)) {
 		// keys
-		if (biosStatus != BIOS_LOAD_STATUS_SUCCESS) {
+		if (bios.loadBldr() != BIOS_LOAD_STATUS_SUCCESS) {
 			printf("Error: 2BL is invalid.\n");
 			return 1;
 		}
@@ -665,7 +1000,7 @@ int listBios() {
 	else if (isFlagSet(SW_DUMP_KRNL)) {
 		// kernel pe/coff header
 
-		if (biosStatus != BIOS_LOAD_STATUS_SUCCESS) {
+		if (bios.loadBldr() != BIOS_LOAD_STATUS_SUCCESS) {
 			printf("Error: 2BL is invalid.\n");
 			return 1;
 		}
@@ -686,6 +1021,12 @@ int listBios() {
 	else {
 		// default ls command
 
+		biosStatus = bios.loadBldr();
+		if (biosStatus > BIOS_LOAD_STATUS_INVALID_BLDR) {
+			printf("Error: Failed to load BIOS\n");
+			return 1;
+		}
+
 		printPreldrInfo(&bios);
 		printBldrInfo(&bios);
 		printInitTblInfo(&bios);
@@ -693,80 +1034,600 @@ int listBios() {
 		printf("Available space:\t");
 		int valid = (bios.available_space >= 0 && bios.available_space <= (int)bios.params.romsize);
 		uprintc(valid, "%d", bios.available_space);
-		printf(" bytes\n");
+		printf(" bytes\n\n");
+
+		printIdentInfo(&bios);
+
+		// the kernel is only mapped if the boot params could be read.
+		BIOS_LAYOUT layout;
+		BIOS_MAP rom_map;
+		layout.romsize = bios.params.romsize;
+		layout.kernel_size = (biosStatus == BIOS_LOAD_STATUS_SUCCESS) ? bios.bldr.boot_params->compressed_kernel_size : 0;
+		layout.kernel_data_size = (biosStatus == BIOS_LOAD_STATUS_SUCCESS) ? bios.bldr.boot_params->uncompressed_kernel_data_size : 0;
+		layout.preldr = (bios.preldr.status < PRELDR_STATUS_NOT_FOUND);
+		if (bios_map_build(bios.data, &layout, &rom_map) == BIOS_MAP_ERROR_SUCCESS) {
+			printBiosMap(&rom_map);
+			bios_map_free(&rom_map);
+		}
 	}
 	
 	return result;
 }
-int replicateBios() {
-	uint32_t size;
-	uint8_t* bios = NULL;
-	uint8_t* bank = NULL;
-	int result = 0;
-	uint32_t binsize;
+int diffBios() {
+	// compare two bioses component by component.
+	// returns 0 if they are identical, 1 if they differ, 2 on error.
+
+	const char* files[2] = { params.in_file, params.bios_file };
+	Bios bios[2];
+	BIOS_LOAD_PARAMS bios_params[2];
+	MCPX keyring_mcpx[2];
+	BIOS_BANKS banks;
+	BIOS_DIFF diff;
+	MAPPED_FILE map;
+	int i;
 
-	const char* filename = params.out_file;
-	if (filename == NULL) {
-		filename = "bios.bin";
+	printf("Diff BIOS\n\n");
+
+	for (i = 0; i < 2; ++i) {
+		bios_init_params(&bios_params[i]);
+		bios_params[i].mcpx = &params.mcpx;
+		bios_params[i].bldr_key = params.bldr_key;
+		bios_params[i].kernel_key = params.kernel_key;
+		bios_params[i].romsize = params.romsize;
+		bios_params[i].enc_bldr = isFlagSet(SW_ENC_BLDR);
+		bios_params[i].enc_kernel = isFlagSet(SW_ENC_KRNL);
+		bios_params[i].restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+		bios_params[i].krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
+
+		if (mapFile(files[i], &map) != 0) {
+			return 2;
+		}
+
+		if (bios_check_size(map.size) != 0) {
+			printf("Error: %s: BIOS size is invalid\n", files[i]);
+			unmapFile(&map);
+			return 2;
+		}
+
+		printf("%c: %s (%d kb)\n", 'a' + i, files[i], map.size / 1024);
+
+		if (isFlagClear(SW_ROMSIZE) && bios_detect_banks(map.data, map.size, &banks) == 0) {
+			bios_params[i].romsize = banks.romsize;
+		}
+
+		if (trial_keyring(map.data, map.size, &bios_params[i], &keyring_mcpx[i]) != 0) {
+			unmapFile(&map);
+			return 2;
+		}
+
+		if (bios[i].load(&map, &bios_params[i]) != BIOS_LOAD_STATUS_SUCCESS) {
+			printf("Error: %s: Failed to load BIOS\n", files[i]);
+			return 2;
+		}
+
+		// the 2BL is needed to locate the kernel; an invalid 2BL is still diffed.
+		if (bios[i].loadBldr() == BIOS_LOAD_STATUS_FAILED) {
+			printf("Error: %s: Failed to load the 2BL\n", files[i]);
+			return 2;
+		}
+		if (bios[i].bios_status == BIOS_LOAD_STATUS_INVALID_BLDR) {
+			printf("Warning: %s: 2BL boot params are invalid\n", files[i]);
+		}
 	}
 
-	printf("Replicate BIOS\n\n");
+	if (bios_diff(&bios[0], &bios[1], isFlagSet(SW_DUMP_KRNL), &diff) != BIOS_DIFF_ERROR_SUCCESS) {
+		printf("Error: Failed to diff BIOS\n");
+		bios_diff_free(&diff);
+		return 2;
+	}
 
-	bank = readFile(params.in_file, &size, 0);
-	if (bank == NULL) {
-		result = 1;
-		goto Cleanup;
+	if (diff.identical) {
+		printf("\nBIOSes are identical (%u pages)\n", diff.pages);
+		return 0;
 	}
 
-	if (bios_check_size(size) != 0) {
-		printf("Error: Invalid bank size: %d\n", size);
-		result = 1;
-		goto Cleanup;
+	printf("\npages: %u of %u differ", diff.diff_pages, diff.pages);
+	if (diff.moved_pages > 0) {
+		printf(" (%u moved)", diff.moved_pages);
 	}
+	printf("\n\n%-14s %10s %10s %10s  %s\n", "component", "size a", "size b", "diff bytes", "first diff");
 
-	// did user type romsize instead? (romsize param isnt used in command so free to use either).
-	if (isFlagClear(SW_BINSIZE)) {
-		binsize = params.romsize;
+	for (i = 0; i < BIOS_DIFF_COMPONENT_COUNT; ++i) {
+		printDiffRegion(bios_diff_component_name((BIOS_DIFF_COMPONENT)i), &diff.components[i]);
+	}
+
+	if (isFlagSet(SW_DUMP_KRNL)) {
+		if (!diff.kernel_decompressed) {
+			printf("\nError: Failed to decompress kernel image\n");
+		}
+		else {
+			printf("\nkernel sections:\n");
+			for (i = 0; i < (int)diff.section_count; ++i) {
+				printDiffRegion(diff.sections[i].name, &diff.sections[i].region);
+			}
+		}
+	}
+
+	bios_diff_free(&diff);
+	return 1;
+}
+void printBiosMap(const BIOS_MAP* map) {
+	uint32_t i;
+
+	printf("ROM map:\n%-9s %-9s %s\n", "offset", "size", "owner");
+	for (i = 0; i < map->count; ++i) {
+		printf("0x%05x   0x%05x   %s\n", map->regions[i].offset, map->regions[i].size, bios_map_owner_name(map->regions[i].owner));
+	}
+	printf("Free space:\t\t%u bytes in %u runs; largest run %u bytes\n", map->free_bytes, map->free_runs, map->largest_free);
+}
+void printDiffRegion(const char* name, const BIOS_DIFF_REGION* region) {
+	printf("%-14s ", name);
+
+	if (region->present & BIOS_DIFF_IN_A)
+		printf("%10u ", region->size_a);
+	else
+		printf("%10s ", "-");
+
+	if (region->present & BIOS_DIFF_IN_B)
+		printf("%10u ", region->size_b);
+	else
+		printf("%10s ", "-");
+
+	if (region->present == 0) {
+		printf("%10s\n", "-");
+	}
+	else if (region->diff_bytes == 0) {
+		printf("%10s\n", "same");
+	}
+	else if (region->present != (BIOS_DIFF_IN_A | BIOS_DIFF_IN_B)) {
+		printf("%10u  only in %c\n", region->diff_bytes, (region->present & BIOS_DIFF_IN_A) ? 'a' : 'b');
 	}
 	else {
-		binsize = params.binsize;
+		printf("%10u  0x%x\n", region->diff_bytes, region->first_diff);
 	}
+}
+int makePatch() {
+	// create a patch from the -in BIOS to the -bios BIOS.
 
-	printf("bios file: %s\nbios size: %dkb\nbin size:  %dkb\n\n", params.in_file, size / 1024, binsize / 1024);
+	BIOS_LOAD_PARAMS bios_params;
+	uint8_t* src = NULL;
+	uint8_t* dst = NULL;
+	uint8_t* patch = NULL;
+	uint32_t src_size = 0;
+	uint32_t dst_size = 0;
+	uint32_t patch_size = 0;
+	const char* filename;
+	LOG_LEVEL level;
+	int result = 1;
 
-	if (size >= binsize) {
-		printf("Nothing to replicate.\n");
-		result = 0;
+	bios_init_params(&bios_params);
+	bios_params.mcpx = &params.mcpx;
+	bios_params.bldr_key = params.bldr_key;
+	bios_params.kernel_key = params.kernel_key;
+	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
+	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
+	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+
+	printf("Make patch\n\n");
+
+	src = readFile(params.in_file, &src_size, 0);
+	if (src == NULL)
+		goto Cleanup;
+	dst = readFile(params.bios_file, &dst_size, 0);
+	if (dst == NULL)
 		goto Cleanup;
-	}
 
-	bios = (uint8_t*)malloc(binsize);
-	if (bios == NULL) {
-		result = 1;
+	if (bios_check_size(src_size) != 0 || bios_check_size(dst_size) != 0) {
+		printf("Error: BIOS size is invalid\n");
 		goto Cleanup;
 	}
 
-	memcpy(bios, bank, size);
-	if (bios_replicate_data(size, binsize, bios, binsize) != 0) {
-		printf("Error: Failed to replicate BIOS\n");
+	printf("src: %s (%d kb)\ndst: %s (%d kb)\n\n", params.in_file, src_size / 1024, params.bios_file, dst_size / 1024);
+
+	// the components are decrypted several times; keep the load messages out of the report.
+	level = log_get_level();
+	log_set_level(LOG_LEVEL_WARN);
+	result = bios_patch_create(src, src_size, dst, dst_size, &bios_params, &patch, &patch_size);
+	log_set_level(level);
+
+	if (result != BIOS_PATCH_ERROR_SUCCESS) {
+		printf("Error: Failed to create the patch\n");
 		result = 1;
 		goto Cleanup;
 	}
 
-	result = writeFileF(filename, "bios", bios, binsize);
-	
-Cleanup:
+	printf("Patch mode: %s\nPatch size: %u bytes\n",
+		(((BIOS_PATCH_HEADER*)patch)->mode == BIOS_PATCH_MODE_COMPONENT) ? "component" : "raw", patch_size);
 
-	if (bank != NULL) {
-		free(bank);
-		bank = NULL;
-	}
+	filename = params.out_file;
+	if (filename == NULL)
+		filename = "bios.xbp";
+
+	result = writeFileF(filename, "patch", patch, patch_size);
 
-	if (bios != NULL) {
-		free(bios);
-		bios = NULL;
+Cleanup:
+	if (src != NULL) {
+		free(src);
 	}
-	
+	if (dst != NULL) {
+		free(dst);
+	}
+	if (patch != NULL) {
+		free(patch);
+	}
+	return result;
+}
+int applyPatch() {
+	// apply a patch to the -in BIOS.
+
+	BIOS_LOAD_PARAMS bios_params;
+	uint8_t* src = NULL;
+	uint8_t* patch = NULL;
+	uint8_t* dst = NULL;
+	uint32_t src_size = 0;
+	uint32_t patch_size = 0;
+	uint32_t dst_size = 0;
+	const char* filename;
+	LOG_LEVEL level;
+	int result = 1;
+
+	bios_init_params(&bios_params);
+	bios_params.mcpx = &params.mcpx;
+	bios_params.bldr_key = params.bldr_key;
+	bios_params.kernel_key = params.kernel_key;
+	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
+	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
+	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+
+	printf("Apply patch\n\n");
+
+	src = readFile(params.in_file, &src_size, 0);
+	if (src == NULL)
+		goto Cleanup;
+	patch = readFile(params.patch_file, &patch_size, 0);
+	if (patch == NULL)
+		goto Cleanup;
+
+	printf("bios:  %s\npatch: %s\n\n", params.in_file, params.patch_file);
+
+	level = log_get_level();
+	log_set_level(LOG_LEVEL_WARN);
+	result = bios_patch_apply(src, src_size, patch, patch_size, &bios_params, &dst, &dst_size);
+	log_set_level(level);
+
+	switch (result) {
+		case BIOS_PATCH_ERROR_SUCCESS:
+			break;
+		case BIOS_PATCH_ERROR_INVALID:
+			printf("Error: The patch is invalid\n");
+			break;
+		case BIOS_PATCH_ERROR_SRC_HASH:
+			printf("Error: The patch is for a different BIOS\n");
+			break;
+		case BIOS_PATCH_ERROR_DST_HASH:
+			printf("Error: The patched BIOS does not match the patch hash\n");
+			break;
+		case BIOS_PATCH_ERROR_KEYS:
+			printf("Error: The patch targets the decrypted BIOS. Use the keys and switches it was made with\n");
+			break;
+		default:
+			printf("Error: Failed to apply the patch\n");
+			break;
+	}
+	if (result != BIOS_PATCH_ERROR_SUCCESS) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	printf("Patched BIOS verified (%d kb)\n", dst_size / 1024);
+
+	filename = params.out_file;
+	if (filename == NULL)
+		filename = "bios.bin";
+
+	result = writeFileF(filename, "bios", dst, dst_size);
+
+Cleanup:
+	if (src != NULL) {
+		free(src);
+	}
+	if (patch != NULL) {
+		free(patch);
+	}
+	if (dst != NULL) {
+		free(dst);
+	}
+	return result;
+}
+int makeIdentDb() {
+	// compile an identification data file into a database.
+
+	uint8_t* image = NULL;
+	uint32_t size = 0;
+	const char* filename;
+	int result = 1;
+
+	printf("Make identification database\n\n");
+
+	if (ident_db_compile(params.in_file, &image, &size) != IDENT_DB_ERROR_SUCCESS) {
+		printf("Error: Failed to compile '%s'\n", params.in_file);
+		return 1;
+	}
+
+	printf("Components: %u\n", ((IDENT_DB_HEADER*)image)->entry_count);
+
+	filename = params.out_file;
+	if (filename == NULL)
+		filename = "ident.db";
+
+	result = writeFileF(filename, "database", image, size);
+
+	free(image);
+	return result;
+}
+int scanBios() {
+	// scan a directory tree of BIOSes and write a report.
+
+	BIOS_SCAN scan;
+	BIOS_SCAN_PARAMS scan_params;
+	BIOS_LOAD_PARAMS bios_params;
+	LOG_LEVEL level;
+	char* report = NULL;
+	uint32_t report_size = 0;
+	double elapsed;
+	int result = 0;
+
+	bios_init_params(&bios_params);
+	bios_params.mcpx = &params.mcpx;
+	bios_params.bldr_key = params.bldr_key;
+	bios_params.kernel_key = params.kernel_key;
+	bios_params.romsize = isFlagSet(SW_ROMSIZE) ? params.romsize : 0; // detected per image
+	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
+	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
+	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+	bios_params.krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
+
+	scan_params.params = &bios_params;
+	scan_params.keyring = (params.keyring_path != NULL) ? &params.keyring : NULL;
+	scan_params.sketch = (params.index_path != NULL);
+
+	printf("Scan BIOSes\n\n");
+
+	if (!isDirectory(params.in_file)) {
+		printf("Error: '%s' is not a directory\n", params.in_file);
+		return 1;
+	}
+
+	bios_scan_init(&scan);
+
+	// the images load in parallel; keep their load messages out of the report.
+	level = log_get_level();
+	log_set_level(LOG_LEVEL_ERROR);
+	auto start = std::chrono::steady_clock::now();
+	result = bios_scan(&scan, params.in_file, &scan_params, 0);
+	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	log_set_level(level);
+
+	if (result != BIOS_SCAN_ERROR_SUCCESS) {
+		printf("Error: Failed to scan '%s'\n", params.in_file);
+		result = 1;
+		goto Cleanup;
+	}
+
+	printf("%u files, %u unique, %u loaded ( %.2f mb, %.2f mb/s )\n\n", scan.count, scan.unique, scan.loaded,
+		scan.bytes / (1024.0 * 1024.0), (elapsed > 0) ? scan.bytes / (1024.0 * 1024.0) / elapsed : 0);
+
+	if (params.index_path != NULL) {
+		if (bios_scan_index(&scan, params.index_path) != BIOS_SCAN_ERROR_SUCCESS) {
+			printf("Error: Failed to write the index '%s'\n", params.index_path);
+			result = 1;
+			goto Cleanup;
+		}
+		printf("Wrote index to %s\n\n", params.index_path);
+	}
+
+	if (bios_scan_report(&scan, isFlagSet(SW_JSON) ? BIOS_SCAN_FORMAT_JSON : BIOS_SCAN_FORMAT_CSV, &params.ident, &report, &report_size) != BIOS_SCAN_ERROR_SUCCESS) {
+		printf("Error: Failed to write the report\n");
+		result = 1;
+		goto Cleanup;
+	}
+
+	if (params.out_file != NULL) {
+		result = writeFileF(params.out_file, "report", report, report_size);
+	}
+	else {
+		fwrite(report, 1, report_size, stdout);
+	}
+
+Cleanup:
+
+	if (report != NULL) {
+		free(report);
+	}
+	bios_scan_free(&scan);
+
+	return result;
+}
+int similarBios() {
+	// list the indexed BIOSes closest to a BIOS.
+
+	Bios bios;
+	BIOS_LOAD_PARAMS bios_params;
+	BIOS_SKETCH_INDEX index;
+	BIOS_SKETCH sketch;
+	BIOS_SKETCH_MATCH* matches = NULL;
+	MCPX keyring_mcpx;
+	MAPPED_FILE map;
+	char value[16];
+	uint32_t count;
+	uint32_t i;
+	int j;
+	double elapsed;
+	int result = 1;
+
+	bios_init_params(&bios_params);
+	bios_params.mcpx = &params.mcpx;
+	bios_params.bldr_key = params.bldr_key;
+	bios_params.kernel_key = params.kernel_key;
+	bios_params.romsize = params.romsize;
+	bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
+	bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
+	bios_params.restore_boot_params = isFlagClear(SW_UPDATE_BOOT_PARAMS);
+	bios_params.krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
+
+	count = isFlagSet(SW_TOP) ? params.top : 10;
+	if (count == 0) {
+		printf("Error: -top must be at least 1\n");
+		return 1;
+	}
+
+	printf("Similar BIOSes\n\n");
+
+	if (bios_sketch_index_open(&index, params.index_path) != BIOS_SKETCH_ERROR_SUCCESS) {
+		printf("Error: Failed to open the index '%s'\n", params.index_path);
+		return 1;
+	}
+
+	if (mapFile(params.in_file, &map) != 0) {
+		bios_sketch_index_close(&index);
+		return 1;
+	}
+
+	if (bios_check_size(map.size) != 0) {
+		printf("Error: BIOS size is invalid\n");
+		unmapFile(&map);
+		bios_sketch_index_close(&index);
+		return 1;
+	}
+
+	printf("bios file: %s\nindex: %s ( %u BIOSes )\n", params.in_file, params.index_path, index.header->count);
+	detect_banks(map.data, map.size, &bios_params);
+
+	if (trial_keyring(map.data, map.size, &bios_params, &keyring_mcpx) != 0) {
+		unmapFile(&map);
+		bios_sketch_index_close(&index);
+		return 1;
+	}
+
+	// the bios owns the map from here.
+	if (bios.load(&map, &bios_params) != BIOS_LOAD_STATUS_SUCCESS || bios_sketch_bios(&bios, &sketch) != BIOS_SKETCH_ERROR_SUCCESS) {
+		printf("Error: invalid 2BL\n");
+		goto Cleanup;
+	}
+
+	// an indexed bios with the same kernel already has its sketch.
+	if ((sketch.hashes & (1U << IDENT_TYPE_KERNEL)) && !bios_sketch_index_kernel(&index, &sketch)) {
+		if (bios_sketch_kernel(&bios, &sketch) != BIOS_SKETCH_ERROR_SUCCESS) {
+			printf("Warning: Failed to decompress the kernel; it is compared by hash only\n");
+		}
+	}
+
+	matches = (BIOS_SKETCH_MATCH*)malloc(count * sizeof(BIOS_SKETCH_MATCH));
+	if (matches == NULL)
+		goto Cleanup;
+
+	{
+		auto start = std::chrono::steady_clock::now();
+		bios_sketch_index_query(&index, &sketch, matches, &count);
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// = is an exact match, - is a component neither bios has.
+	printf("query: %.3f ms\n\n", elapsed * 1000.0);
+	printf("%-7s %-8s %-8s %-8s %-8s %-8s %s\n", "score", "preldr", "bldr", "inittbl", "krnl", "krnldata", "file");
+	for (i = 0; i < count; ++i) {
+		const BIOS_SKETCH* other = &index.entries[matches[i].entry].sketch;
+
+		printf("%6.2f%%", matches[i].score * 100.0f);
+		for (j = 0; j < BIOS_SKETCH_COMPONENTS; ++j) {
+			if (matches[i].similarity[j] < 0)
+				strcpy(value, "-");
+			else if ((sketch.hashes & other->hashes & (1U << (j + IDENT_TYPE_PRELDR))) &&
+				memcmp(sketch.hash[j], other->hash[j], SHA1_DIGEST_LEN) == 0)
+				strcpy(value, "=");
+			else
+				sprintf(value, "%.1f%%", matches[i].similarity[j] * 100.0f);
+			printf(" %-8s", value);
+		}
+		printf(" %s\n", bios_sketch_index_name(&index, matches[i].entry));
+	}
+	if (count == 0) {
+		printf("The index is empty\n");
+	}
+
+	result = 0;
+
+Cleanup:
+	if (matches != NULL) {
+		free(matches);
+	}
+	bios_sketch_index_close(&index);
+
+	return result;
+}
+int replicateBios() {
+	const uint32_t MAX_BANKS = MAX_BIOS_SIZE / MIN_BIOS_SIZE;
+	uint64_t fileSize = 0;
+	uint32_t size;
+	uint32_t binsize;
+	uint32_t i;
+	int result = 0;
+
+	FILE_RANGE copies[MAX_BANKS] = { 0 };
+
+	const char* filename = params.out_file;
+	if (filename == NULL) {
+		filename = "bios.bin";
+	}
+
+	printf("Replicate BIOS\n\n");
+
+	if (getFileStat(params.in_file, &fileSize, NULL) != 0) {
+		printf("Error: Could not open file: %s\n", params.in_file);
+		return 1;
+	}
+	size = (fileSize > MAX_BIOS_SIZE) ? 0 : (uint32_t)fileSize;
+
+	if (bios_check_size(size) != 0) {
+		printf("Error: Invalid bank size: %llu\n", (unsigned long long)fileSize);
+		return 1;
+	}
+
+	// did user type romsize instead? (romsize param isnt used in command so free to use either).
+	if (isFlagClear(SW_BINSIZE)) {
+		binsize = params.romsize;
+	}
+	else {
+		binsize = params.binsize;
+	}
+
+	printf("bios file: %s\nbios size: %dkb\nbin size:  %dkb\n\n", params.in_file, size / 1024, binsize / 1024);
+
+	if (size >= binsize) {
+		printf("Nothing to replicate.\n");
+		return 0;
+	}
+
+	if (bios_check_size(binsize) != 0) {
+		printf("Error: Failed to replicate BIOS\n");
+		return 1;
+	}
+
+	// the bank is copied file to file once per mirror.
+	for (i = 0; i < binsize / size; i++) {
+		copies[i].filename = params.in_file;
+		copies[i].offset = 0;
+		copies[i].size = size;
+	}
+
+	result = copyFileRanges(filename, copies, binsize / size);
+	if (result == 0) {
+		printWriteF(filename, "bios", binsize);
+	}
+	else {
+		printf("Error: Failed to write %s\n", filename);
+	}
+
 	return result;
 }
 int decodeXcodes() {
@@ -816,7 +1677,7 @@ int decodeXcodes() {
 		deleteFile(filename);
 
 		printf("Writing xcodes to %s\n", filename);
-		FILE* stream = fopen(filename, "w");
+		FILE* stream = openFile(filename, "w");
 		if (stream == NULL) {
 			printf("Error: Failed to open file %s\n", filename);
 			result = 1;
@@ -831,7 +1692,7 @@ int decodeXcodes() {
 	result = decoder.decodeXcodes();
 
 	if (isFlagSet(SW_DMP)) {
-		fclose(context->stream);
+		closeFile(context->stream);
 		printf("Done\n");
 	}
 
@@ -1107,6 +1968,470 @@ Cleanup:
 
 	return result;
 }
+int teaSearch() {
+	// search the FBL region for modifications that keep its tea hash.
+
+	TEA_SEARCH_PARAMS search;
+	TEA_SEARCH_RESULT* found = NULL;
+	uint8_t* data = NULL;
+	uint8_t* patched = NULL;
+	char* checkpoint = NULL;
+	uint32_t size = 0;
+	uint32_t region;
+	uint32_t entry;
+	bool fbl;
+	int result = 0;
+
+	printf("TEA Search\n\n");
+
+	// the checkpoint goes next to the output unless it is named; never into the working directory unasked.
+	if (params.checkpoint_file == NULL && params.out_file == NULL) {
+		printf("Error: -ckpt or -out is required; progress is checkpointed to -ckpt, or to <out>.ckpt\n");
+		return 1;
+	}
+	if (params.checkpoint_file == NULL) {
+		checkpoint = (char*)malloc(strlen(params.out_file) + 6);
+		if (checkpoint == NULL) {
+			return 1;
+		}
+		sprintf(checkpoint, "%s.ckpt", params.out_file);
+	}
+
+	data = readFile(params.in_file, &size, 0);
+	if (data == NULL) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	// the mcpx 1.1 hashes the FBL; fall back to the whole file for a raw region.
+	fbl = (bios_check_size(size) == 0);
+	if (fbl) {
+		region = size - MCPX_BLOCK_SIZE - PRELDR_BLOCK_SIZE;
+		search.size = PRELDR_SIZE;
+	}
+	else {
+		region = 0;
+		search.size = size;
+	}
+	search.size -= search.size % TEA_BLOCK_SIZE;
+	search.region = data + region;
+	search.offset = isFlagSet(SW_OFFSET) ? params.offset : search.size - TEA_BLOCK_SIZE;
+	search.checkpoint = (checkpoint != NULL) ? checkpoint : params.checkpoint_file;
+	search.threads = 0;
+	search.limit = isFlagSet(SW_LIMIT) ? params.limit : 0;
+
+	printf("file:      %s\nregion:    0x%x - 0x%x\noffset:    0x%x\n", params.in_file, region, region + search.size, search.offset);
+
+	found = (TEA_SEARCH_RESULT*)malloc(sizeof(TEA_SEARCH_RESULT));
+	if (found == NULL) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	result = tea_search(&search, found);
+	if (result == TEA_SEARCH_ERROR_FAILED) {
+		goto Cleanup;
+	}
+
+	printf("\n%s: searched %llu candidates, %u found ( %.2f MH/s )\n", (result == TEA_SEARCH_ERROR_SUCCESS) ? "Done" : "Stopped",
+		(unsigned long long)found->searched, found->found_count, found->rate / 1000000.0);
+	if (fbl && found->found_count > 0) {
+		patched = (uint8_t*)malloc(search.size);
+		if (patched == NULL) {
+			result = 1;
+			goto Cleanup;
+		}
+	}
+	for (uint32_t i = 0; i < found->found_count; ++i) {
+		printf(" delta %016llX", (unsigned long long)found->found[i]);
+		if (patched != NULL) {
+			// where the patched FBL jumps to; the tea attack lands the jump in the flash.
+			memcpy(patched, data + region, search.size);
+			tea_search_apply(patched, search.offset, found->found[i]);
+			entry = PRELDR_REAL_BASE + ((PRELDR_PARAMS*)patched)->jmp_offset + 5;
+			printf(" ( entry point 0x%08x%s )", entry, (entry == PRELDR_TEA_ATTACK_ENTRY_POINT) ? ", TEA Attack" : "");
+		}
+		printf("\n");
+	}
+
+	// stopped at the limit or by ctrl+c with nothing found; run the same command to resume.
+	result = (result == TEA_SEARCH_ERROR_INTERRUPTED && found->found_count == 0) ? 2 : 0;
+	if (params.out_file != NULL && found->found_count > 0) {
+		tea_search_apply(data + region, search.offset, found->found[0]);
+		result = writeFileF(params.out_file, "patched bios", data, size);
+	}
+
+Cleanup:
+
+	if (data != NULL) {
+		free(data);
+		data = NULL;
+	}
+
+	if (patched != NULL) {
+		free(patched);
+		patched = NULL;
+	}
+
+	if (checkpoint != NULL) {
+		free(checkpoint);
+		checkpoint = NULL;
+	}
+
+	if (found != NULL) {
+		free(found);
+		found = NULL;
+	}
+
+	return result;
+}
+int decryptEeprom() {
+	// decrypt, verify and optionally re-encrypt an eeprom, or every eeprom in a directory.
+
+	KEYRING keys;
+	EEPROM_BATCH batch;
+	EEPROM_KEY eeprom_key;
+	EEPROM_SECURITY security;
+	XB_EEPROM* eeprom = NULL;
+	uint8_t* key = NULL;
+	uint32_t size = 0;
+	uint32_t i;
+	int match = KEYRING_NO_MATCH;
+	int result = 0;
+
+	printf("EEPROM\n\n");
+
+	keyring_init(&keys);
+	batch.results = NULL;
+	batch.count = 0;
+
+	// the -eepromkey key is tried first, then the keyring.
+	if (params.eeprom_key_file != NULL) {
+		key = readFile(params.eeprom_key_file, NULL, XB_KEY_SIZE);
+		if (key == NULL) {
+			result = 1;
+			goto Cleanup;
+		}
+		result = keyring_add(&keys, key, MCPX_REV_UNK, params.eeprom_key_file);
+	}
+	for (i = 0; result == 0 && i < params.keyring.count; ++i) {
+		result = keyring_add(&keys, params.keyring.keys[i].key, MCPX_REV_UNK, params.keyring.keys[i].name);
+	}
+	if (result != 0) {
+		printf("Error: Failed to add the eeprom keys\n");
+		result = 1;
+		goto Cleanup;
+	}
+	if (keys.count == 0) {
+		printf("Error: No eeprom key. Use -eepromkey or -keyring\n");
+		result = 1;
+		goto Cleanup;
+	}
+
+	if (isDirectory(params.in_file)) {
+		if (eeprom_batch(&batch, params.in_file, &keys) != EEPROM_ERROR_SUCCESS) {
+			printf("Error: Failed to read eeproms in '%s'\n", params.in_file);
+			result = 1;
+			goto Cleanup;
+		}
+
+		printf("directory: %s ( %u eeproms, %u keys )\n\n", params.in_file, batch.count, keys.count);
+		for (i = 0; i < batch.count; ++i) {
+			printf("%s\n", batch.results[i].filename);
+			if (batch.results[i].key == KEYRING_NO_MATCH) {
+				printf(" key:\t\tno match\n");
+				continue;
+			}
+			printf(" key:\t\t%s\n hdd key:\t", keys.keys[batch.results[i].key].name);
+			uprinth(batch.results[i].security.hdd_key, XB_KEY_SIZE);
+			printf(" game region:\t0x%08X ( %s )\n", batch.results[i].security.game_region, eeprom_region_str(batch.results[i].security.game_region));
+		}
+		goto Cleanup;
+	}
+
+	eeprom = (XB_EEPROM*)readFile(params.in_file, &size, EEPROM_SIZE);
+	if (eeprom == NULL) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	for (i = 0; i < keys.count; ++i) {
+		eeprom_key_init(&eeprom_key, keys.keys[i].key);
+		if (eeprom_decrypt(&eeprom_key, (uint8_t*)eeprom, &security) == EEPROM_ERROR_SUCCESS) {
+			match = (int)i;
+			break;
+		}
+	}
+
+	printf("eeprom: %s\n", params.in_file);
+	if (match == KEYRING_NO_MATCH) {
+		printf("Error: No key verified the security section ( %u keys tried )\n", keys.count);
+		result = 1;
+		goto Cleanup;
+	}
+
+	printf("key:\t\t%s\nhash:\t\t", keys.keys[match].name);
+	uprinth(security.hash, SHA1_DIGEST_LEN);
+	printf("confounder:\t");
+	uprinth(security.confounder, sizeof(security.confounder));
+	printf("hdd key:\t");
+	uprinth(security.hdd_key, XB_KEY_SIZE);
+	printf("game region:\t0x%08X ( %s )\n", security.game_region, eeprom_region_str(security.game_region));
+	printf("serial number:\t%.12s\nmac address:\t%02X:%02X:%02X:%02X:%02X:%02X\nonline key:\t", eeprom->factory.serial_number,
+		eeprom->factory.mac_address[0], eeprom->factory.mac_address[1], eeprom->factory.mac_address[2],
+		eeprom->factory.mac_address[3], eeprom->factory.mac_address[4], eeprom->factory.mac_address[5]);
+	uprinth(eeprom->factory.online_key, sizeof(eeprom->factory.online_key));
+	printf("video standard:\t0x%08X ( %s )\n", eeprom->factory.video_standard, eeprom_video_standard_str(eeprom->factory.video_standard));
+
+	if (isFlagSet(SW_GAME_REGION)) {
+		printf("\nSetting game region to 0x%08X ( %s )\n", params.game_region, eeprom_region_str(params.game_region));
+		security.game_region = params.game_region;
+	}
+
+	if (params.out_file != NULL) {
+		eeprom_encrypt(&eeprom_key, &security, (uint8_t*)eeprom);
+		result = writeFileF(params.out_file, "eeprom", eeprom, EEPROM_SIZE);
+	}
+	else if (isFlagSet(SW_GAME_REGION)) {
+		printf("Use -out to write the eeprom\n");
+	}
+
+Cleanup:
+
+	if (eeprom != NULL) {
+		free(eeprom);
+		eeprom = NULL;
+	}
+
+	if (key != NULL) {
+		free(key);
+		key = NULL;
+	}
+
+	eeprom_batch_free(&batch);
+	keyring_free(&keys);
+
+	return result;
+}
+int verifyXbe() {
+	// verify an xbe, or every xbe in a directory, against the BIOS keys.
+
+	Bios bios;
+	BIOS_LOAD_PARAMS bios_params;
+	MCPX keyring_mcpx;
+	XBE xbe;
+	XBE_BATCH batch;
+	PUBLIC_KEY* pubkey = NULL;
+	uint8_t* pubkey_file = NULL;
+	uint8_t* cert_key = NULL;
+	uint8_t* data = NULL;
+	int* status = NULL;
+	uint8_t lan_key[XB_KEY_SIZE];
+	uint8_t signature_key[XB_KEY_SIZE];
+	char title[XBE_TITLE_NAME_LEN + 1];
+	uint32_t size = 0;
+	uint32_t ok;
+	uint32_t i;
+	double elapsed;
+	int result = 0;
+
+	printf("Verify XBE\n\n");
+
+	batch.results = NULL;
+	batch.count = 0;
+
+	// public key and cert key; from key files, else from the BIOS.
+	if (params.public_key_file != NULL) {
+		pubkey_file = readFile(params.public_key_file, &size, 0);
+		if (pubkey_file == NULL || rsa_verifyPublicKey(pubkey_file, size, 0, &pubkey) != RSA_ERROR_SUCCESS) {
+			printf("Error: Invalid public key file: %s\n", params.public_key_file);
+			result = 1;
+			goto Cleanup;
+		}
+	}
+	if (params.cert_key_file != NULL) {
+		cert_key = readFile(params.cert_key_file, NULL, XB_KEY_SIZE);
+		if (cert_key == NULL) {
+			result = 1;
+			goto Cleanup;
+		}
+	}
+	if (params.bios_file != NULL) {
+		bios_init_params(&bios_params);
+		bios_params.mcpx = &params.mcpx;
+		bios_params.bldr_key = params.bldr_key;
+		bios_params.kernel_key = params.kernel_key;
+		bios_params.romsize = params.romsize;
+		bios_params.enc_bldr = isFlagSet(SW_ENC_BLDR);
+		bios_params.enc_kernel = isFlagSet(SW_ENC_KRNL);
+		bios_params.krnl_cache = (params.krnl_cache.path != NULL) ? &params.krnl_cache : NULL;
+
+		data = readFile(params.bios_file, &size, 0);
+		if (data == NULL) {
+			result = 1;
+			goto Cleanup;
+		}
+		if (bios_check_size(size) != 0) {
+			printf("Error: BIOS size is invalid\n");
+			result = 1;
+			goto Cleanup;
+		}
+		if (trial_keyring(data, size, &bios_params, &keyring_mcpx) != 0) {
+			result = 1;
+			goto Cleanup;
+		}
+
+		// the bios owns the data once loaded.
+		result = bios.load(data, size, &bios_params);
+		data = NULL;
+		if (result != BIOS_LOAD_STATUS_SUCCESS || bios.decompressKrnl() != 0) {
+			printf("Error: Failed to load BIOS: %s\n", params.bios_file);
+			result = 1;
+			goto Cleanup;
+		}
+		result = 0;
+
+		if (pubkey == NULL && rsa_findPublicKey(bios.kernel.img, bios.kernel.img_size, &pubkey, NULL) != RSA_ERROR_SUCCESS) {
+			printf("Error: Public key not found in the kernel\n");
+			result = 1;
+			goto Cleanup;
+		}
+		if (cert_key == NULL) {
+			if (bios.bldr.keys == NULL) {
+				printf("Error: 2BL keys not found; use -certkey\n");
+				result = 1;
+				goto Cleanup;
+			}
+			cert_key = (uint8_t*)malloc(XB_KEY_SIZE);
+			if (cert_key == NULL) {
+				result = 1;
+				goto Cleanup;
+			}
+			memcpy(cert_key, bios.bldr.keys->cert_key, XB_KEY_SIZE);
+		}
+		printf("bios file: %s\n", params.bios_file);
+	}
+	if (pubkey == NULL) {
+		printf("No public key; header signatures are not checked. Use -bios or -pubkey\n");
+	}
+
+	if (isDirectory(params.in_file)) {
+		auto start = std::chrono::steady_clock::now();
+		if (xbe_batch(&batch, params.in_file, pubkey) != XBE_ERROR_SUCCESS) {
+			printf("Error: Failed to read XBEs in '%s'\n", params.in_file);
+			result = 1;
+			goto Cleanup;
+		}
+		elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		ok = 0;
+		for (i = 0; i < batch.count; ++i) {
+			switch (batch.results[i].status) {
+				case XBE_ERROR_SUCCESS:
+					ok++;
+					break;
+				case XBE_ERROR_INVALID_DATA:
+					printf("INVALID   %s\n", batch.results[i].filename);
+					break;
+				case XBE_ERROR_SIGNATURE:
+					printf("BAD SIG   %s\n", batch.results[i].filename);
+					break;
+				case XBE_ERROR_DIGEST:
+					printf("BAD HASH  %s ( %u sections )\n", batch.results[i].filename, batch.results[i].bad_sections);
+					break;
+				default:
+					printf("FAILED    %s\n", batch.results[i].filename);
+					break;
+			}
+		}
+
+		printf("\n%u of %u XBEs verified ( %.2f mb, %.2f mb/s )\n", ok, batch.count,
+			batch.bytes / (1024.0 * 1024.0), (elapsed > 0) ? batch.bytes / (1024.0 * 1024.0) / elapsed : 0);
+		if (ok != batch.count)
+			result = 1;
+		goto Cleanup;
+	}
+
+	data = readFile(params.in_file, &size, 0);
+	if (data == NULL) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	if (xbe_load(&xbe, data, size) != XBE_ERROR_SUCCESS) {
+		printf("Error: Invalid XBE: %s\n", params.in_file);
+		result = 1;
+		goto Cleanup;
+	}
+
+	for (i = 0; i < XBE_TITLE_NAME_LEN; ++i) {
+		title[i] = (xbe.cert->title_name[i] < 0x80) ? (char)xbe.cert->title_name[i] : '?';
+	}
+	title[XBE_TITLE_NAME_LEN] = '\0';
+
+	printf("xbe file:\t%s\ntitle id:\t%08X\ntitle name:\t%s\nversion:\t%u\ngame region:\t0x%08X\nmedia:\t\t0x%08X\ntype:\t\t%s\nentry point:\t0x%08X\n\n",
+		params.in_file, xbe.cert->title_id, title, xbe.cert->version, xbe.cert->game_region, xbe.cert->allowed_media,
+		xbe.debug ? "debug" : "retail", xbe.header->entry_point ^ (xbe.debug ? XBE_ENTRY_XOR_DEBUG : XBE_ENTRY_XOR_RETAIL));
+
+	status = (int*)malloc((xbe.header->section_count + 1) * sizeof(int));
+	if (status == NULL) {
+		result = 1;
+		goto Cleanup;
+	}
+
+	if (xbe_verifySections(&xbe, status, 0) != XBE_ERROR_SUCCESS)
+		result = 1;
+
+	printf("sections:\n");
+	for (i = 0; i < xbe.header->section_count; ++i) {
+		printf(" %-10s 0x%08X %8u bytes  %s\n", xbe_sectionName(&xbe, &xbe.sections[i]), xbe.sections[i].raw_address,
+			xbe.sections[i].raw_size, (status[i] == XBE_ERROR_SUCCESS) ? "ok" : "BAD DIGEST");
+	}
+
+	if (pubkey != NULL) {
+		if (xbe_verifyHeader(&xbe, pubkey) == XBE_ERROR_SUCCESS) {
+			printf("\nheader signature: valid\n");
+		}
+		else {
+			printf("\nheader signature: INVALID\n");
+			result = 1;
+		}
+	}
+
+	if (cert_key != NULL) {
+		xbe_titleKeys(xbe.cert, cert_key, lan_key, signature_key);
+		printf("\nlan key:\t");
+		uprinth(lan_key, XB_KEY_SIZE);
+		printf("signature key:\t");
+		uprinth(signature_key, XB_KEY_SIZE);
+	}
+
+Cleanup:
+
+	if (data != NULL) {
+		free(data);
+		data = NULL;
+	}
+
+	if (pubkey_file != NULL) {
+		free(pubkey_file);
+		pubkey_file = NULL;
+	}
+
+	if (cert_key != NULL) {
+		free(cert_key);
+		cert_key = NULL;
+	}
+
+	if (status != NULL) {
+		free(status);
+		status = NULL;
+	}
+
+	xbe_batch_free(&batch);
+
+	return result;
+}
 int dumpCoffPeImg() {
 	int result = 0;
 	uint8_t* data = NULL;
@@ -1141,6 +2466,9 @@ int info() {
 		"Bulit:  %s %s\n", \
 		__TIME__, __DATE__);
 
+	printf("SHA-1:  %s\n", SHA1Impl());
+	printf("TEA:    %s\n", tea_impl());
+
 	printf("\nThis program is free software: you can redistribute it and/or modify\n" \
 		"it under the terms of the GNU General Public License as published by\n" \
 		"the Free Software Foundation.\n");
@@ -1162,23 +2490,26 @@ int help() {
 	if (isFlagSet(SW_HELP)) {
 		switch (cmd->type) {
 			case CMD_LIST_BIOS:
-				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n\n",
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n\n",
 					HELP_STR_LIST, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_LS_DATA_TBL,
-					HELP_STR_PARAM_LS_NV2A_TBL, HELP_STR_PARAM_LS_DUMP_KRNL, HELP_STR_PARAM_LS_KEYS);
+					HELP_STR_PARAM_LS_NV2A_TBL, HELP_STR_PARAM_LS_DUMP_KRNL, HELP_STR_PARAM_LS_KEYS, HELP_STR_PARAM_LS_BOOTABLE, HELP_STR_PARAM_KEYRING, HELP_STR_PARAM_KRNL_CACHE, HELP_STR_PARAM_CACHE_SIZE, HELP_STR_PARAM_IDENT,
+					HELP_STR_PARAM_LOG_LEVEL, HELP_STR_PARAM_LOG_FILE);
 				printf("Usage: xbios -ls <bios_path> [switches]\n");
 				return 0;
 
 			case CMD_EXTRACT_BIOS:
-				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n\n",
-					HELP_STR_EXTR_ALL, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_EXTRACT_KEYS, HELP_STR_PARAM_RESTORE_BOOT_PARAMS, HELP_STR_PARAM_WDIR);
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n\n",
+					HELP_STR_EXTR_ALL, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_EXTRACT_KEYS, HELP_STR_PARAM_RESTORE_BOOT_PARAMS, HELP_STR_PARAM_WDIR, HELP_STR_PARAM_KEYRING,
+					HELP_STR_PARAM_KRNL_CACHE, HELP_STR_PARAM_CACHE_SIZE, HELP_STR_PARAM_STORE, HELP_STR_PARAM_STORE_OUT_FILE, HELP_STR_PARAM_LOG_LEVEL, HELP_STR_PARAM_LOG_FILE);
 				printf("Usage: xbios -extr <bios_path> [switches]\n");
 				return 0;
 
 			case CMD_BUILD_BIOS:
-				printf("# %s\n\n %s (req)\n %s (req)\n %s (req)\n %s (req)\n %s\n %s\n %s %s\n %s %s\n %s\n %s\n %s\n %s\n\n",
+				printf("# %s\n\n %s (req)\n %s (req)\n %s (req)\n %s (req)\n %s\n %s\n %s %s\n %s %s\n %s\n %s\n %s\n %s\n %s\n %s\n\n",
 					HELP_STR_BUILD, HELP_STR_PARAM_BLDR, HELP_STR_PARAM_KRNL, HELP_STR_PARAM_KRNL_DATA, HELP_STR_PARAM_INITTBL, HELP_STR_PARAM_PRELDR,
 					HELP_STR_PARAM_OUT_BIOS_FILE, HELP_STR_PARAM_ROMSIZE, HELP_STR_VALID_ROM_SIZES, HELP_STR_PARAM_BINSIZE, HELP_STR_VALID_ROM_SIZES,
-					HELP_STR_PARAM_BFM, HELP_STR_PARAM_HACK_INITTBL, HELP_STR_PARAM_HACK_SIGNATURE, HELP_STR_PARAM_UPDATE_BOOT_PARAMS);
+					HELP_STR_PARAM_BFM, HELP_STR_PARAM_HACK_INITTBL, HELP_STR_PARAM_HACK_SIGNATURE, HELP_STR_PARAM_UPDATE_BOOT_PARAMS, HELP_STR_PARAM_WATCH,
+					HELP_STR_PARAM_WATCH_LIMIT);
 				printf("Usage:\nxbios -bld -bldr <path> -krnl <path> -krnldata <path> -inittbl <path> [switches]\n");
 				return 0;
 
@@ -1253,10 +2584,74 @@ int help() {
 				printf("Usage: xbios -compress <path> [switches]\n");
 				return 0;
 
-			case CMD_DECOMPRESS_FILE:
-				printf("# %s\n\n %s (req) *inferred\n %s (req)\n\n",
-					HELP_STR_DECOMPRESS_FILE, HELP_STR_PARAM_IN_FILE, HELP_STR_PARAM_OUT_FILE);
-				printf("Usage: xbios -decompress <path> [switches]\n");
+			case CMD_DECOMPRESS_FILE:
+				printf("# %s\n\n %s (req) *inferred\n %s (req)\n\n",
+					HELP_STR_DECOMPRESS_FILE, HELP_STR_PARAM_IN_FILE, HELP_STR_PARAM_OUT_FILE);
+				printf("Usage: xbios -decompress <path> [switches]\n");
+				return 0;
+
+			case CMD_TEA_SEARCH:
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n -out <path>      - write the BIOS patched with the first match\n\n",
+					HELP_STR_TEA_SEARCH, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_TEA_OFFSET, HELP_STR_PARAM_CHECKPOINT, HELP_STR_PARAM_TEA_LIMIT);
+				printf("Usage: xbios -tea-search <bios_path> [switches]\n");
+				return 0;
+
+			case CMD_EEPROM:
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n\n",
+					HELP_STR_EEPROM, HELP_STR_PARAM_IN_FILE, HELP_STR_PARAM_EEPROM_KEY_IN, HELP_STR_PARAM_EEPROM_KEYRING,
+					HELP_STR_PARAM_GAME_REGION, HELP_STR_PARAM_OUT_FILE);
+				printf("Usage: xbios -eeprom <eeprom_path> -eepromkey <path> [switches]\n");
+				return 0;
+
+			case CMD_XBE:
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n\n",
+					HELP_STR_XBE, HELP_STR_PARAM_IN_FILE, HELP_STR_PARAM_BIOS_FILE, HELP_STR_PARAM_XBE_PUB_KEY, HELP_STR_PARAM_XBE_CERT_KEY, HELP_STR_MCPX_ROM);
+				printf("Usage: xbios -xbe <xbe_path> -bios <bios_path> [switches]\n");
+				return 0;
+
+			case CMD_BUILD_MATRIX:
+				printf("# %s\n\n %s (req) *inferred\n %s\n\n",
+					HELP_STR_BUILD_MATRIX, HELP_STR_PARAM_MANIFEST, HELP_STR_MCPX_ROM);
+				printf("Usage: xbios -bld-matrix <manifest_path> [switches]\n");
+				return 0;
+
+			case CMD_DIFF:
+				printf("# %s\n\n %s (req) *inferred\n %s (req) *inferred\n %s\n %s\n %s\n %s\n\n",
+					HELP_STR_DIFF, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_DIFF_BIOS_FILE, HELP_STR_PARAM_DIFF_KRNL, HELP_STR_PARAM_ROMSIZE,
+					HELP_STR_PARAM_KEYRING, HELP_STR_PARAM_KRNL_CACHE);
+				printf("Usage: xbios -diff <bios_path_a> <bios_path_b> [switches]\n");
+				return 0;
+
+			case CMD_MKPATCH:
+				printf("# %s\n\n %s (req) *inferred\n %s (req) *inferred\n %s\n %s\n\n",
+					HELP_STR_MKPATCH, HELP_STR_PARAM_PATCH_SRC_FILE, HELP_STR_PARAM_PATCH_DST_FILE, HELP_STR_PARAM_OUT_PATCH_FILE, HELP_STR_MCPX_ROM);
+				printf("Usage: xbios -mkpatch <bios_path> <modified_bios_path> [switches]\n");
+				return 0;
+
+			case CMD_APPLYPATCH:
+				printf("# %s\n\n %s (req) *inferred\n %s (req) *inferred\n %s\n %s\n\n",
+					HELP_STR_APPLYPATCH, HELP_STR_PARAM_PATCH_SRC_FILE, HELP_STR_PARAM_PATCH_FILE, HELP_STR_PARAM_OUT_BIOS_FILE, HELP_STR_MCPX_ROM);
+				printf("Usage: xbios -applypatch <bios_path> <patch_path> [switches]\n");
+				return 0;
+
+			case CMD_MKIDENT:
+				printf("# %s\n\n %s (req) *inferred\n %s\n\n",
+					HELP_STR_MKIDENT, HELP_STR_PARAM_IDENT_DATA_FILE, HELP_STR_PARAM_OUT_IDENT_FILE);
+				printf("Usage: xbios -mkident <data_file_path> [switches]\n");
+				return 0;
+
+			case CMD_SCAN:
+				printf("# %s\n\n %s (req) *inferred\n %s\n %s\n %s\n %s\n %s\n %s\n %s\n\n",
+					HELP_STR_SCAN, HELP_STR_PARAM_SCAN_DIR, HELP_STR_PARAM_SCAN_OUT_FILE, HELP_STR_PARAM_SCAN_JSON, HELP_STR_PARAM_SCAN_INDEX,
+					HELP_STR_PARAM_ROMSIZE, HELP_STR_PARAM_KEYRING, HELP_STR_PARAM_KRNL_CACHE, HELP_STR_PARAM_IDENT);
+				printf("Usage: xbios -scan <dir> [switches]\n");
+				return 0;
+
+			case CMD_SIMILAR:
+				printf("# %s\n\n %s (req) *inferred\n %s (req)\n %s\n %s\n %s\n\n",
+					HELP_STR_SIMILAR, HELP_STR_PARAM_IN_BIOS_FILE, HELP_STR_PARAM_SIMILAR_INDEX, HELP_STR_PARAM_SIMILAR_TOP,
+					HELP_STR_PARAM_KEYRING, HELP_STR_PARAM_KRNL_CACHE);
+				printf("Usage: xbios -similar <bios_file> -index <path> [switches]\n");
 				return 0;
 
 			case CMD_REPLICATE_BIOS:
@@ -1296,6 +2691,9 @@ int helpEncryption() {
 	printf("\n -key-bldr");
 	printf(HELP_STR_RC4_KEY, "2BL");
 
+	// keyring
+	printf("\n\n %s", HELP_STR_KEYRING);
+
 	// kernel 
 	printf("\n\nKernel encryption / decryption:\nOnly needed for custom BIOSes as keys are located in the 2BL.\n\n");
 	printf(" -key-krnl");
@@ -1341,86 +2739,17 @@ void free_parameters(XbToolParameters* _params) {
 		_params->kernel_key = NULL;
 	}
 	mcpx_free(&_params->mcpx);
-}
-
-int inject_xcodes(uint8_t* data, uint32_t size, uint8_t* xcodes, uint32_t xcodesSize) {
-	int result;
-	XcodeInterp interp;
-	result = interp.load(data + 0x80, size - 0x80);
-	if (result != 0) {
-		return result;
-	}
-
-	INIT_TBL* init_tbl = (INIT_TBL*)data;
-	XCODE* xcode = NULL;
-
-	while (interp.interpretNext(xcode) == 0) {
-		if (xcode->opcode == XC_EXIT)
-			break;
-	}
-
-	if (xcode->opcode != XC_EXIT) {
-		printf("XCODE: exit xcode not found.\n");
-		return 1;
-	}
-
-	bool jmp = false;
-	uint32_t offset = 0;
-	uint32_t count = 0;
-
-	// if data_tbl_offset is 0 then no rom data table.
-	if (init_tbl->data_tbl_offset != 0) {
-		if (init_tbl->data_tbl_offset < 0x80 + interp.offset + xcodesSize) {
-			//printf("no space for xcodes. only %d bytes available. xcode size: %d bytes\n", (0x80 + interp.offset + xcodesSize - init_tbl->data_tbl_offset), xcodesSize);
-
-			jmp = true;
-			offset = sizeof(ROM_DATA_TBL);
-		}
-	}
-
-	// sanity check.
-	for (; offset < size - 0x80 - interp.offset - xcodesSize; offset++) {
-		if (*(data + 0x80 + interp.offset + offset) != 0x0) {
-			//printf("no zero space for xcodes.\n");
-			count = 0;
-			jmp = true;
-			continue;
-		}
-		if (count == xcodesSize) {
-			offset -= count;
-			break;
-		}
-		count++;
-	}
+	keyring_free(&_params->keyring);
+	krnl_cache_close(&_params->krnl_cache);
+	ident_db_free(&_params->ident);
 
-	xcode = (XCODE*)(data + 0x80 + interp.offset - sizeof(XCODE));
-
-	if (jmp) {
-		printf("XCODE: replacing quit xcode at 0x%x with jump to free space at 0x%x\n", (uint8_t*)xcode - data, 0x80 + interp.offset + offset);
-
-		// patch quit xcode to a jmp xcode.
-		xcode->opcode = XC_JMP;
-		xcode->addr = 0;
-		xcode->data = offset;
-
-		// update xcode ptr.
-		xcode = (XCODE*)(data + 0x80 + interp.offset + offset);
+	// back to stdout for the next command.
+	if (_params->log_sink.write != NULL) {
+		LOG_SINK sink;
+		log_sink_stream(&sink, stdout);
+		log_set_sink(&sink);
+		log_sink_file_close(&_params->log_sink);
 	}
-
-	printf("XCODE: adding xcodes\n");
-
-	// copy in xcodes.
-	memcpy(xcode, xcodes, xcodesSize);
-
-	// copy in quit xcode.
-	xcode = (XCODE*)((uint8_t*)xcode + xcodesSize);
-	xcode->opcode = XC_EXIT;
-	xcode->addr = 0x806;
-	xcode->data = 0;
-
-	interp.~XcodeInterp();
-
-	return 0;
 }
 
 int read_keys() {
@@ -1462,19 +2791,245 @@ int read_mcpx() {
 	if (mcpxData == NULL)
 		return 1;
 
-	result = mcpx_load(&params.mcpx, mcpxData);
+	result = mcpx_identify(&params.mcpx, mcpxData, &params.ident);
 
 	if (params.mcpx.rev == MCPX_REV_UNK) {
 		printf("\nError: hash did not match known mcpx roms\n" \
 			"See github page for md5 hashes.\n" \
 			"1.) Use a MCPX dump\n" \
 			"2.) Use a M.O.U.S.E v0.8.0, v0.9.0 rom\n" \
-			"3.) Use -bldr-key <path>\n");
+			"3.) Use -bldr-key <path>\n" \
+			"4.) Add the rom to a -ident data file with its rev and sbkey offset\n");
 	}
 
 	return result;
 }
 
+int read_keyring() {
+	// load the keyring from command line. keys given with -key-bldr / -mcpx are tried first.
+
+	int result = 0;
+
+	keyring_init(&params.keyring);
+
+	if (params.keyring_path == NULL)
+		return 0;
+
+	if (params.bldr_key != NULL) {
+		result = keyring_add(&params.keyring, params.bldr_key, MCPX_REV_UNK, params.bldr_key_file);
+	}
+	if (result == 0 && params.mcpx.sbkey != NULL) {
+		result = keyring_add(&params.keyring, params.mcpx.sbkey, params.mcpx.rev, params.mcpx_file);
+	}
+	if (result == 0) {
+		result = keyring_load(&params.keyring, params.keyring_path);
+	}
+	if (result != 0) {
+		printf("Error: Failed to load keyring '%s'\n", params.keyring_path);
+		return 1;
+	}
+
+	printf("keyring: %s (%d keys)\n", params.keyring_path, params.keyring.count);
+
+	return 0;
+}
+int read_ident() {
+	// load the identification database from command line.
+
+	ident_db_init(&params.ident);
+
+	if (params.ident_path == NULL)
+		return 0;
+
+	if (ident_db_load(&params.ident, params.ident_path) != IDENT_DB_ERROR_SUCCESS) {
+		printf("Error: Failed to load identification database '%s'\n", params.ident_path);
+		return 1;
+	}
+
+	printf("ident: %s (%u components)\n", params.ident_path, params.ident.tables[params.ident.count - 1].header->entry_count);
+
+	return 0;
+}
+int read_krnl_cache() {
+	// open the kernel cache from command line.
+
+	uint64_t max_size = KRNL_CACHE_DEFAULT_SIZE;
+
+	if (params.krnl_cache_path == NULL)
+		return 0;
+
+	if (isFlagSet(SW_CACHE_SIZE)) {
+		max_size = (uint64_t)params.cache_size * 1024 * 1024;
+	}
+
+	if (krnl_cache_open(&params.krnl_cache, params.krnl_cache_path, max_size) != KRNL_CACHE_ERROR_SUCCESS) {
+		printf("Error: Failed to open kernel cache '%s'\n", params.krnl_cache_path);
+		return 1;
+	}
+
+	return 0;
+}
+int read_log() {
+	// set the log level and the log file from command line. each command starts at info, on stdout.
+
+	static const char* levels[] = { "debug", "info", "warn", "error", "none" };
+	int level = LOG_LEVEL_INFO;
+
+	if (params.log_level != NULL) {
+		for (level = LOG_LEVEL_DEBUG; level <= LOG_LEVEL_NONE; ++level) {
+			if (strcmp(params.log_level, levels[level]) == 0)
+				break;
+		}
+		if (level > LOG_LEVEL_NONE) {
+			printf("Error: Invalid log level '%s'. Use debug, info, warn, error or none\n", params.log_level);
+			return 1;
+		}
+	}
+	log_set_level((LOG_LEVEL)level);
+
+	if (params.log_file != NULL) {
+		if (log_sink_file(&params.log_sink, params.log_file) != 0) {
+			printf("Error: Failed to open log file '%s'\n", params.log_file);
+			return 1;
+		}
+		log_set_sink(&params.log_sink);
+	}
+
+	return 0;
+}
+int trial_keyring(uint8_t* data, uint32_t size, BIOS_LOAD_PARAMS* bios_params, MCPX* mcpx) {
+	// find the 2BL and kernel keys for the BIOS in the keyring and set up the load params to use them.
+	// mcpx: the mcpx to use for the load; only the rev is set so the correct 2BL path is taken.
+
+	KEYRING_MATCH match;
+
+	if (params.keyring_path == NULL)
+		return 0;
+
+	if (keyring_find_keys(&params.keyring, data, size, bios_params, mcpx, &match) != KEYRING_ERROR_SUCCESS) {
+		printf("Error: No key in the keyring decrypts the 2BL (%d keys tried)\n", match.trials);
+		return 1;
+	}
+
+	if (match.bldr_key == KEYRING_KEY_NONE)
+		printf("bldr key: none (2BL is not encrypted)\n");
+	else
+		printf("bldr key: %s (%s)\n", params.keyring.keys[match.bldr_key].name, match.preldr ? "FBL" : "2BL");
+
+	switch (match.kernel_key) {
+		case KEYRING_KEY_NONE:
+			printf("krnl key: none (kernel is not encrypted)\n");
+			break;
+		case KEYRING_KEY_BLDR:
+			printf("krnl key: 2BL\n");
+			break;
+		case KEYRING_NO_MATCH:
+			printf("krnl key: not found\n");
+			break;
+		default:
+			printf("krnl key: %s\n", params.keyring.keys[match.kernel_key].name);
+			break;
+	}
+
+	printf("%d keys tried\n\n", match.trials);
+
+	return 0;
+}
+int detect_banks(uint8_t* data, uint32_t size, BIOS_LOAD_PARAMS* bios_params) {
+	// detect the rom size when -romsize is not given and report the bank layout.
+	// mirrored banks are identical, so only the unique bank is analyzed.
+
+	BIOS_BANKS banks;
+
+	if (bios_detect_banks(data, size, &banks) != 0)
+		return 1;
+
+	if (isFlagClear(SW_ROMSIZE)) {
+		bios_params->romsize = banks.romsize;
+	}
+
+	printf("rom size:  %d kb\n", bios_params->romsize / 1024);
+	if (banks.banks > 1) {
+		printf("banks:     %u x %d kb (%u unique)\n", banks.banks, MIN_BIOS_SIZE / 1024, banks.unique_banks);
+	}
+	if (banks.unique_banks > 1) {
+		printf("Warning: the banks differ; this may be a multi-bios flash. Use -split to extract each bank.\n");
+	}
+	printf("\n");
+
+	return 0;
+}
+
+int extract_component(const COMP_STORE* store, COMP_MANIFEST* manifest, uint32_t* added, const IDENT_TYPE type, const char* filename, const char* tag, uint8_t* data, const uint32_t size) {
+	// write a component to its file, or with a store, put it in the store and reference it from the manifest.
+	// added: counts the components that were new to the store.
+	// returns 0 if successful, 1 if the component could not be stored.
+
+	bool is_new = false;
+
+	if (store == NULL) {
+		writeFileF(filename, tag, data, size);
+		return 0;
+	}
+
+	if (comp_store_put(store, data, size, manifest->hash[type], &is_new) != COMP_STORE_ERROR_SUCCESS) {
+		printf("Error: Failed to store %s\n", tag);
+		return 1;
+	}
+	manifest->components |= (1U << type);
+	if (is_new)
+		(*added)++;
+
+	printf("%s %s ", is_new ? "Storing" : "Stored ", tag);
+	for (int i = 0; i < SHA1_DIGEST_LEN; ++i)
+		printf("%02x", manifest->hash[type][i]);
+	printf("\n");
+
+	return 0;
+}
+int extract_manifest(const COMP_STORE* store, COMP_MANIFEST* manifest, const uint8_t* kernel_key, uint32_t added) {
+	// write the manifest of a stored bios. the kernel key is stored too when it is not in the 2BL.
+
+	char name[BLD_MATRIX_NAME_LEN + 4];
+	const char* filename;
+	bool key_added = false;
+	uint32_t count = 0;
+
+	if (kernel_key != NULL) {
+		if (comp_store_put(store, kernel_key, XB_KEY_SIZE, manifest->kernel_key_hash, &key_added) != COMP_STORE_ERROR_SUCCESS) {
+			printf("Error: Failed to store kernel key\n");
+			return 1;
+		}
+		manifest->kernel_key = true;
+		if (key_added)
+			added++;
+	}
+
+	for (int i = 0; i < IDENT_TYPE_COUNT; i++) {
+		if (manifest->components & (1U << i))
+			count++;
+	}
+	if (manifest->kernel_key)
+		count++;
+
+	// the manifest defaults to <name>.ini
+	filename = params.out_file;
+	if (filename == NULL) {
+		sprintf(name, "%s.ini", manifest->name);
+		filename = name;
+	}
+
+	if (comp_manifest_write(store, manifest, filename) != COMP_STORE_ERROR_SUCCESS) {
+		printf("Error: Failed to write manifest %s\n", filename);
+		return 1;
+	}
+	printf("Writing manifest to %s\n", filename);
+
+	printf("%u of %u objects added to %s\n", added, count, store->path);
+
+	return 0;
+}
+
 uint8_t* load_init_tbl_file(uint32_t* size, uint32_t* base) {
 	uint8_t* init_tbl = NULL;
 	int result = 0;
@@ -1547,6 +3102,8 @@ void lzx_print_error(int error) {
 
 void printBldrInfo(Bios* bios) {
 	BIOS_LOAD_PARAMS bios_params = bios->params;
+
+	bios->loadBldr();
 	
 	printf("2BL:\n");
 
@@ -1581,6 +3138,7 @@ void printBldrInfo(Bios* bios) {
 void printPreldrInfo(Bios* bios) {
 	BIOS_LOAD_PARAMS bios_params = bios->params;
 
+	bios->loadPreldr();
 	if (bios->preldr.status > PRELDR_STATUS_FOUND)
 		return;
 
@@ -1605,6 +3163,28 @@ void printPreldrInfo(Bios* bios) {
 		// escaped mcpx!
 	}
 
+	uint8_t digest[SHA1_DIGEST_LEN];
+	if (bios->preldr.public_key != NULL) {
+		printf("ROM digest:\t\t");
+		switch (bios->preldrVerifyRomDigest(digest)) {
+			case 0:
+				uprintc(true, "signed");
+				printf(" ( ");
+				for (int i = 0; i < SHA1_DIGEST_LEN; ++i)
+					printf("%02x", digest[i]);
+				printf(" )\n");
+				break;
+			case 2:
+				// without the sb key, or a hash of the rom, there is nothing to check; no verdict.
+				printf("unknown ( no key )\n");
+				break;
+			default:
+				uprintc(false, "not signed");
+				printf("\n");
+				break;
+		}
+	}
+
 	printf("\n");
 }
 void printInitTblInfo(Bios* bios) {
@@ -1772,6 +3352,8 @@ void printKeyInfo(Bios* bios) {
 
 	MCPX* mcpx = bios->params.mcpx;
 	PUBLIC_KEY* pubkey;
+
+	bios->loadBldr();
 	
 	if (mcpx->sbkey != NULL) {
 		printf("SB key (+%d):\t", mcpx->sbkey - mcpx->data);
@@ -1800,9 +3382,99 @@ void printKeyInfo(Bios* bios) {
 	if (bios->kernel.img != NULL) {
 		if (rsa_findPublicKey(bios->kernel.img, bios->kernel.img_size, &pubkey, NULL) == RSA_ERROR_SUCCESS) {
 			printf("\nPublic key:\b\b\b\b");
-			uprinthl((uint8_t*)&pubkey->modulus, RSA_MOD_SIZE(&pubkey->header), 16, "\t\t", 0);
+			uprinthl((uint8_t*)RSA_MODULUS(pubkey), RSA_MOD_SIZE(&pubkey->header), 16, "\t\t", 0);
+		}
+	}
+}
+static void printIdentLine(const char* label, const IDENT_TYPE type, const uint8_t* hash) {
+	IDENT_ENTRY entry;
+
+	printf("%s", label);
+	for (int i = 0; i < SHA1_DIGEST_LEN; ++i)
+		printf("%02x", hash[i]);
+
+	if (ident_db_find(&params.ident, type, hash, &entry) == IDENT_DB_ERROR_SUCCESS) {
+		printf(" ");
+		uprintc(true, "%s", entry.name);
+		if (entry.version[0] != '\0')
+			printf(" %s", entry.version);
+		printf("\n");
+	}
+	else {
+		printf(" unknown\n");
+	}
+}
+void printIdentInfo(Bios* bios) {
+	static const struct {
+		IDENT_TYPE type;
+		const char* label;
+	} components[] = {
+		{ IDENT_TYPE_PRELDR, "FBL:\t\t\t" },
+		{ IDENT_TYPE_BLDR, "2BL:\t\t\t" },
+		{ IDENT_TYPE_INIT_TBL, "Init table:\t\t" },
+		{ IDENT_TYPE_KERNEL, "Kernel:\t\t\t" },
+		{ IDENT_TYPE_KERNEL_DATA, "Kernel data:\t\t" },
+	};
+	uint8_t hash[SHA1_DIGEST_LEN];
+
+	printf("Components:\n");
+
+	if (params.mcpx.data != NULL) {
+		printIdentLine("MCPX:\t\t\t", IDENT_TYPE_MCPX, params.mcpx.hash);
+	}
+
+	for (uint32_t i = 0; i < sizeof(components) / sizeof(components[0]); ++i) {
+		if (bios->hashComponent(components[i].type, hash) == 0) {
+			printIdentLine(components[i].label, components[i].type, hash);
+		}
+	}
+
+	printf("\n");
+}
+int printBootInfo(Bios* bios) {
+	// simulate the boot path on the mcpx revision of the key, or on both if it is unknown.
+	// returns 0 if the BIOS boots on every simulated revision.
+
+	const MCPX_REV revs[] = { MCPX_REV_0, MCPX_REV_1 };
+	BOOT_SIM_RESULT sim;
+	int result = 0;
+
+	// the simulator decrypts its own copy; keep the load messages out of the report.
+	LOG_LEVEL level = log_get_level();
+	log_set_level(LOG_LEVEL_WARN);
+
+	for (int i = 0; i < 2; i++) {
+		if (bios->params.mcpx->rev != MCPX_REV_UNK && bios->params.mcpx->rev != revs[i])
+			continue;
+
+		if (boot_simulate(bios->data, bios->size, &bios->params, revs[i], &sim) == BOOT_SIM_ERROR_FAILED) {
+			printf("Error: Failed to simulate the boot path\n");
+			result = 1;
+			break;
+		}
+
+		printf("MCPX %s boot:\n", revs[i] == MCPX_REV_0 ? "1.0" : "1.1");
+		for (int step = 0; step < BOOT_STEP_COUNT; step++) {
+			if (!boot_step_on_path((BOOT_STEP)step, revs[i]))
+				continue;
+			printf(" %-26s%s\n", boot_step_name((BOOT_STEP)step), boot_result_name(sim.result[step]));
+		}
+		if (revs[i] == MCPX_REV_1) {
+			printf(" FBL tea hash:             %08X %08X\n", sim.fbl_hash[0], sim.fbl_hash[1]);
+		}
+
+		if (sim.step == BOOT_STEP_COUNT) {
+			printf("Result: boots; kernel entry 0x%08X\n\n", sim.kernel_entry);
+		}
+		else {
+			printf("Result: stops at '%s' (%s)\n\n", boot_step_name(sim.step), boot_result_name(sim.result[sim.step]));
+			result = 1;
 		}
 	}
+
+	log_set_level(level);
+
+	return result;
 }
 
 int validateArgs() {
@@ -1850,12 +3522,10 @@ int validateArgs() {
 	return 0;
 }
 
-int main(int argc, char** argv) {
-
-	printf("Xbox Bios Tools by tommojphillips\n\n");
-
+int runCommand(int argc, char** argv) {
 	int result = 0;
 	cmd = NULL;
+	clearFlags();
 	init_parameters(&params);
 
 	result = parseCli(argc, argv, cmd, cmd_tbl, sizeof(cmd_tbl), param_tbl, sizeof(param_tbl));
@@ -1884,11 +3554,25 @@ int main(int argc, char** argv) {
 		goto Exit;
 	}
 
+	result = ERROR_FAILED;
+
+	if (read_log() != 0)
+		goto Exit;
+
 	if (read_keys() != 0)
 		goto Exit;
 
+	if (read_ident() != 0)
+		goto Exit;
+
 	if (read_mcpx() != 0)
 		goto Exit;
+
+	if (read_keyring() != 0)
+		goto Exit;
+
+	if (read_krnl_cache() != 0)
+		goto Exit;
 	
 	switch (cmd->type) {
 		case CMD_INFO:
@@ -1943,6 +3627,46 @@ int main(int argc, char** argv) {
 			result = decompressFile();
 			break;
 
+		case CMD_TEA_SEARCH:
+			result = teaSearch();
+			break;
+
+		case CMD_EEPROM:
+			result = decryptEeprom();
+			break;
+
+		case CMD_XBE:
+			result = verifyXbe();
+			break;
+
+		case CMD_BUILD_MATRIX:
+			result = buildMatrix();
+			break;
+
+		case CMD_DIFF:
+			result = diffBios();
+			break;
+
+		case CMD_MKPATCH:
+			result = makePatch();
+			break;
+
+		case CMD_APPLYPATCH:
+			result = applyPatch();
+			break;
+
+		case CMD_MKIDENT:
+			result = makeIdentDb();
+			break;
+
+		case CMD_SCAN:
+			result = scanBios();
+			break;
+
+		case CMD_SIMILAR:
+			result = similarBios();
+			break;
+
 		case CMD_DUMP_PE_IMG:
 			result = dumpCoffPeImg();
 			break;
@@ -1956,6 +3680,49 @@ Exit:
 
 	free_parameters(&params);
 
+	return result;
+}
+
+int main(int argc, char** argv) {
+
+	printf("Xbox Bios Tools by tommojphillips\n\n");
+
+	// library messages are rendered on stdout, in order with the command output.
+	LOG_SINK log_sink;
+	log_sink_stream(&log_sink, stdout);
+	log_set_sink(&log_sink);
+	log_set_buffered(false);
+
+	// pick the hash functions for this cpu before any worker thread starts.
+	SHA1Init();
+	tea_init();
+
+	int result = 0;
+	int start = 1;
+	int end;
+	char** cmd_argv = NULL;
+
+	// each command gets argv[0] and its own arguments. memory files (@name) pass outputs to the next command.
+	cmd_argv = (char**)malloc(argc * sizeof(char*));
+	if (cmd_argv == NULL)
+		return ERROR_FAILED;
+	cmd_argv[0] = argv[0];
+
+	for (;;) {
+		for (end = start; end < argc && strcmp(argv[end], CMD_CHAIN_SEPARATOR) != 0; ++end);
+
+		memcpy(cmd_argv + 1, argv + start, (end - start) * sizeof(char*));
+		result = runCommand(end - start + 1, cmd_argv);
+		if (result != 0 || end >= argc)
+			break;
+
+		start = end + 1;
+		printf("\n");
+	}
+
+	free(cmd_argv);
+	freeMemFiles();
+
 #ifdef MEM_TRACKING
 	memtrack_report();
 #endif
@@ -31,6 +31,8 @@
 #include "util.h"
 #include "str_util.h"
 #include "loadini.h"
+#include "file.h"
+#include "log.h"
 
 #ifdef MEM_TRACKING
 #include "mem_tracking.h"
@@ -234,7 +236,7 @@ int XcodeDecoder::loadSettings(const char* ini, DECODE_SETTINGS* settings) const
 
 	static const char* default_format_str = "{offset}: {op} {addr} {data} {comment}";
 	
-	static const LOADINI_SETTING_MAP var_map[] = {
+	const LOADINI_SETTING_MAP var_map[] = {
 		{ &decode_settings_map.s[0], &settings->format_str},
 		{ &decode_settings_map.s[1], &settings->jmp_str },
 		{ &decode_settings_map.s[2], &settings->no_operand_str },
@@ -261,18 +263,18 @@ int XcodeDecoder::loadSettings(const char* ini, DECODE_SETTINGS* settings) const
 	};
 
 	if (ini != NULL) {
-		stream = fopen(ini, "r");
+		stream = openFile(ini, "r");
 		if (stream != NULL) { // only load ini file if it exists
-			printf("settings file: %s\n", ini);
+			log_info("settings file: %s\n", ini);
 			result = loadini(stream, var_map, decode_settings_map.size);
-			fclose(stream);
+			closeFile(stream);
 			if (result != 0) { // convert to error code
 				result = 1;
 				goto Cleanup;
 			}
 		}
 		else {
-			printf("settings: default\n");
+			log_info("settings: default\n");
 		}
 	}
 
@@ -468,7 +470,7 @@ int XcodeDecoder::loadSettings(const char* ini, DECODE_SETTINGS* settings) const
 Cleanup:
 
 	if (result == ERROR_INVALID_DATA) {
-		printf("Error: key '%s' has invalid value '%s'\n", buf, value);
+		log_error("key '%s' has invalid value '%s'\n", buf, value);
 	}
 
 	return result;
@@ -481,10 +483,10 @@ int XcodeDecoder::decodeXcodes() {
 		result = decode();
 		if (result != 0) {
 			if (result == ERROR_BUFFER_OVERFLOW) {
-				printf("Error: decode format too large.\n");
+				log_error("decode format too large.\n");
 			}
 			else {
-				printf("Error: decoding xcode:\n\t%04X, OP: %02X, ADDR: %04X, DATA: %04X\n",
+				log_error("decoding xcode:\n\t%04X, OP: %02X, ADDR: %04X, DATA: %04X\n",
 					(context->xcodeBase + interp.offset - sizeof(XCODE)), context->xcode->opcode, context->xcode->addr, context->xcode->data);
 			}
 			return result;
@@ -0,0 +1,490 @@
+// bios_diff.cpp: Implements a component aware BIOS diff backed by a page hash index.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "bios_diff.h"
+#include "Bios.h"
+#include "bldr.h"
+#include "nt_headers.h"
+#include "util.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+// regions are compared in blocks; only a differing block is compared byte by byte.
+#define BIOS_DIFF_BLOCK_SIZE 64
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL
+#define HASH_ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static const char* component_names[BIOS_DIFF_COMPONENT_COUNT] = {
+	"preldr",
+	"2BL",
+	"boot params",
+	"keys",
+	"init tbl",
+	"xcodes",
+	"kernel",
+	"kernel data",
+};
+
+static int compare_hash(const void* a, const void* b);
+static void diff_region(BIOS_DIFF_REGION* region, const uint8_t* a, const uint32_t size_a, const uint8_t* b, const uint32_t size_b);
+static const uint8_t* region_ptr(const Bios* bios, const uint8_t* ptr, const uint32_t size);
+static const uint8_t* kernel_key(const Bios* bios);
+static bool pages_equal(const uint8_t* data_a, const BIOS_PAGE_INDEX* a, const uint8_t* data_b, const BIOS_PAGE_INDEX* b, const uint32_t page);
+static void diff_pages(const uint8_t* data_a, const BIOS_PAGE_INDEX* a, const uint8_t* data_b, const BIOS_PAGE_INDEX* b, BIOS_DIFF* diff);
+static const uint8_t* component_ptr(const Bios* bios, const BIOS_DIFF_COMPONENT component, uint32_t* size);
+static void diff_component(const Bios* a, const Bios* b, const BIOS_DIFF_COMPONENT component, BIOS_DIFF* diff);
+static void diff_components(Bios* a, Bios* b, BIOS_DIFF* diff);
+static const uint8_t* section_ptr(const Bios* bios, const IMAGE_SECTION_HEADER* section, uint32_t* size);
+static int diff_sections(Bios* a, Bios* b, BIOS_DIFF* diff);
+
+int bios_page_index(const uint8_t* data, const uint32_t size, BIOS_PAGE_INDEX* index) {
+	uint32_t i;
+	uint32_t len;
+
+	index->size = size;
+	index->count = (size + BIOS_DIFF_PAGE_SIZE - 1) / BIOS_DIFF_PAGE_SIZE;
+	index->hashes = (uint64_t*)malloc(index->count * sizeof(uint64_t));
+	if (index->hashes == NULL) {
+		index->count = 0;
+		return BIOS_DIFF_ERROR_FAILED;
+	}
+
+	for (i = 0; i < index->count; ++i) {
+		len = size - i * BIOS_DIFF_PAGE_SIZE;
+		if (len > BIOS_DIFF_PAGE_SIZE)
+			len = BIOS_DIFF_PAGE_SIZE;
+		index->hashes[i] = bios_page_hash(data + i * BIOS_DIFF_PAGE_SIZE, len);
+	}
+
+	return BIOS_DIFF_ERROR_SUCCESS;
+}
+void bios_page_index_free(BIOS_PAGE_INDEX* index) {
+	if (index->hashes != NULL) {
+		free(index->hashes);
+		index->hashes = NULL;
+	}
+	index->count = 0;
+	index->size = 0;
+}
+
+int bios_diff(Bios* a, Bios* b, const bool kernel_sections, BIOS_DIFF* diff) {
+	BIOS_PAGE_INDEX index_a = {};
+	BIOS_PAGE_INDEX index_b = {};
+	int result = BIOS_DIFF_ERROR_SUCCESS;
+
+	memset(diff, 0, sizeof(BIOS_DIFF));
+
+	if (bios_page_index(a->data, a->size, &index_a) != BIOS_DIFF_ERROR_SUCCESS ||
+		bios_page_index(b->data, b->size, &index_b) != BIOS_DIFF_ERROR_SUCCESS) {
+		result = BIOS_DIFF_ERROR_FAILED;
+		goto Cleanup;
+	}
+
+	diff_pages(a->data, &index_a, b->data, &index_b, diff);
+
+	// nothing differs; nothing needs to be decrypted.
+	if (diff->identical)
+		goto Cleanup;
+
+	diff_components(a, b, diff);
+
+	if (kernel_sections) {
+		result = diff_sections(a, b, diff);
+	}
+
+Cleanup:
+	bios_page_index_free(&index_a);
+	bios_page_index_free(&index_b);
+	return result;
+}
+void bios_diff_free(BIOS_DIFF* diff) {
+	if (diff->sections != NULL) {
+		free(diff->sections);
+		diff->sections = NULL;
+	}
+	diff->section_count = 0;
+}
+
+const char* bios_diff_component_name(const BIOS_DIFF_COMPONENT component) {
+	if (component >= BIOS_DIFF_COMPONENT_COUNT)
+		return "unknown";
+	return component_names[component];
+}
+
+uint64_t bios_page_hash(const uint8_t* data, const uint32_t size) {
+	// 4 independent lanes over 8 byte words; the lanes keep the multiplies in flight.
+
+	uint64_t lanes[4] = { HASH_PRIME1, HASH_PRIME2, ~HASH_PRIME1, ~HASH_PRIME2 };
+	uint64_t w;
+	uint64_t h;
+	uint32_t i = 0;
+	uint32_t j;
+
+	for (; i + 32 <= size; i += 32) {
+		for (j = 0; j < 4; ++j) {
+			memcpy(&w, data + i + j * 8, sizeof(uint64_t));
+			lanes[j] = HASH_ROTL(lanes[j] ^ (w * HASH_PRIME2), 31) * HASH_PRIME1;
+		}
+	}
+
+	h = HASH_ROTL(lanes[0], 1) + HASH_ROTL(lanes[1], 7) + HASH_ROTL(lanes[2], 12) + HASH_ROTL(lanes[3], 18);
+	h ^= size;
+
+	for (; i < size; ++i) {
+		h = HASH_ROTL(h ^ (data[i] * HASH_PRIME1), 11) * HASH_PRIME2;
+	}
+
+	h ^= h >> 33;
+	h *= HASH_PRIME2;
+	h ^= h >> 29;
+	return h;
+}
+static int compare_hash(const void* a, const void* b) {
+	const uint64_t x = *(const uint64_t*)a;
+	const uint64_t y = *(const uint64_t*)b;
+	return (x > y) - (x < y);
+}
+
+static bool pages_equal(const uint8_t* data_a, const BIOS_PAGE_INDEX* a, const uint8_t* data_b, const BIOS_PAGE_INDEX* b, const uint32_t page) {
+	// the page at the same offset of both images; equal hashes are confirmed byte by byte, a 64-bit hash can collide.
+
+	const uint32_t offset = page * BIOS_DIFF_PAGE_SIZE;
+	uint32_t len_a = a->size - offset;
+	uint32_t len_b = b->size - offset;
+
+	if (a->hashes[page] != b->hashes[page])
+		return false;
+
+	if (len_a > BIOS_DIFF_PAGE_SIZE)
+		len_a = BIOS_DIFF_PAGE_SIZE;
+	if (len_b > BIOS_DIFF_PAGE_SIZE)
+		len_b = BIOS_DIFF_PAGE_SIZE;
+
+	return len_a == len_b && memcmp(data_a + offset, data_b + offset, len_a) == 0;
+}
+static void diff_pages(const uint8_t* data_a, const BIOS_PAGE_INDEX* a, const uint8_t* data_b, const BIOS_PAGE_INDEX* b, BIOS_DIFF* diff) {
+	// count the pages that differ at the same offset and the differing pages of b that are elsewhere in a.
+
+	uint64_t* sorted = NULL;
+	uint32_t common;
+	uint32_t i;
+
+	common = (a->count < b->count) ? a->count : b->count;
+	diff->pages = (a->count > b->count) ? a->count : b->count;
+
+	for (i = 0; i < common; ++i) {
+		if (!pages_equal(data_a, a, data_b, b, i))
+			diff->diff_pages++;
+	}
+	diff->diff_pages += diff->pages - common;
+	diff->identical = (a->size == b->size && diff->diff_pages == 0);
+
+	if (diff->identical || a->count == 0)
+		return;
+
+	sorted = (uint64_t*)malloc(a->count * sizeof(uint64_t));
+	if (sorted == NULL)
+		return;
+	memcpy(sorted, a->hashes, a->count * sizeof(uint64_t));
+	qsort(sorted, a->count, sizeof(uint64_t), compare_hash);
+
+	for (i = 0; i < b->count; ++i) {
+		if (i < a->count && pages_equal(data_a, a, data_b, b, i))
+			continue;
+		if (bsearch(&b->hashes[i], sorted, a->count, sizeof(uint64_t), compare_hash) != NULL)
+			diff->moved_pages++;
+	}
+
+	free(sorted);
+}
+
+static void diff_region(BIOS_DIFF_REGION* region, const uint8_t* a, const uint32_t size_a, const uint8_t* b, const uint32_t size_b) {
+	// diff two regions. a region that is NULL is not present.
+
+	uint32_t common;
+	uint32_t offset;
+	uint32_t len;
+	uint32_t i;
+	bool found = false;
+
+	memset(region, 0, sizeof(BIOS_DIFF_REGION));
+
+	if (a != NULL) {
+		region->present |= BIOS_DIFF_IN_A;
+		region->size_a = size_a;
+	}
+	if (b != NULL) {
+		region->present |= BIOS_DIFF_IN_B;
+		region->size_b = size_b;
+	}
+
+	if (a == NULL || b == NULL) {
+		region->diff_bytes = region->size_a + region->size_b;
+		return;
+	}
+
+	common = (size_a < size_b) ? size_a : size_b;
+
+	for (offset = 0; offset < common; offset += BIOS_DIFF_BLOCK_SIZE) {
+		len = common - offset;
+		if (len > BIOS_DIFF_BLOCK_SIZE)
+			len = BIOS_DIFF_BLOCK_SIZE;
+
+		if (memcmp(a + offset, b + offset, len) == 0)
+			continue;
+
+		for (i = 0; i < len; ++i) {
+			if (a[offset + i] == b[offset + i])
+				continue;
+			if (!found) {
+				region->first_diff = offset + i;
+				found = true;
+			}
+			region->diff_bytes++;
+		}
+	}
+
+	if (size_a != size_b) {
+		if (!found)
+			region->first_diff = common;
+		region->diff_bytes += (size_a > size_b) ? size_a - size_b : size_b - size_a;
+	}
+}
+static const uint8_t* region_ptr(const Bios* bios, const uint8_t* ptr, const uint32_t size) {
+	// a component pointer, or NULL if it is not inside the image.
+
+	if (ptr == NULL || ptr < bios->data || size > bios->size || ptr - bios->data > bios->size - size)
+		return NULL;
+	return ptr;
+}
+static const uint8_t* kernel_key(const Bios* bios) {
+	// the key the kernel is decrypted with; see Bios::symmetricEncDecKernel()
+
+	if (bios->params.kernel_key != NULL)
+		return bios->params.kernel_key;
+	if (bios->bldr.keys == NULL)
+		return NULL;
+	return bios->bldr.keys->kernel_key;
+}
+
+static const uint8_t* component_ptr(const Bios* bios, const BIOS_DIFF_COMPONENT component, uint32_t* size) {
+	// a component of a bios, or NULL if it is not present. the 2BL components need the 2BL loaded.
+
+	const bool bldr = (bios->bios_status != BIOS_LOAD_STATUS_FAILED);
+	const bool valid = (bios->bios_status == BIOS_LOAD_STATUS_SUCCESS);
+	const uint8_t* ptr = NULL;
+
+	*size = 0;
+
+	switch (component) {
+		case BIOS_DIFF_PRELDR:
+			if (bios->preldr.status != PRELDR_STATUS_NOT_FOUND) {
+				ptr = bios->preldr.data;
+				*size = PRELDR_SIZE;
+			}
+			break;
+		case BIOS_DIFF_BLDR:
+			if (bldr) {
+				ptr = bios->bldr.data;
+				*size = BLDR_BLOCK_SIZE;
+			}
+			break;
+		case BIOS_DIFF_BOOT_PARAMS:
+			if (bldr) {
+				ptr = (const uint8_t*)bios->bldr.boot_params;
+				*size = sizeof(BOOT_PARAMS);
+			}
+			break;
+		case BIOS_DIFF_KEYS:
+			if (bldr) {
+				ptr = (const uint8_t*)bios->bldr.keys;
+				*size = sizeof(BLDR_KEYS);
+			}
+			break;
+		case BIOS_DIFF_INIT_TBL:
+			ptr = bios->data;
+			*size = sizeof(INIT_TBL);
+			break;
+		case BIOS_DIFF_XCODES:
+			if (valid && bios->bldr.boot_params->init_tbl_size >= sizeof(INIT_TBL)) {
+				ptr = bios->data + sizeof(INIT_TBL);
+				*size = bios->bldr.boot_params->init_tbl_size - sizeof(INIT_TBL);
+			}
+			break;
+		case BIOS_DIFF_KERNEL:
+			if (valid) {
+				ptr = bios->kernel.compressed_kernel_ptr;
+				*size = bios->bldr.boot_params->compressed_kernel_size;
+			}
+			break;
+		case BIOS_DIFF_KERNEL_DATA:
+			if (valid) {
+				ptr = bios->kernel.uncompressed_data_ptr;
+				*size = bios->bldr.boot_params->uncompressed_kernel_data_size;
+			}
+			break;
+		default:
+			break;
+	}
+
+	ptr = region_ptr(bios, ptr, *size);
+	if (ptr == NULL)
+		*size = 0;
+	return ptr;
+}
+static void diff_component(const Bios* a, const Bios* b, const BIOS_DIFF_COMPONENT component, BIOS_DIFF* diff) {
+	const uint8_t* ptr_a;
+	const uint8_t* ptr_b;
+	uint32_t size_a;
+	uint32_t size_b;
+
+	ptr_a = component_ptr(a, component, &size_a);
+	ptr_b = component_ptr(b, component, &size_b);
+	diff_region(&diff->components[component], ptr_a, size_a, ptr_b, size_b);
+}
+static void diff_components(Bios* a, Bios* b, BIOS_DIFF* diff) {
+	const uint8_t* key_a;
+	const uint8_t* key_b;
+	BIOS_DIFF_REGION* kernel = &diff->components[BIOS_DIFF_KERNEL];
+
+	// the preldr and the init table are never encrypted.
+	a->loadPreldr();
+	b->loadPreldr();
+	diff_component(a, b, BIOS_DIFF_PRELDR, diff);
+	diff_component(a, b, BIOS_DIFF_INIT_TBL, diff);
+
+	// the 2BL has to be decrypted to locate the kernel and the end of the init table.
+	a->loadBldr();
+	b->loadBldr();
+	diff_component(a, b, BIOS_DIFF_BLDR, diff);
+	diff_component(a, b, BIOS_DIFF_BOOT_PARAMS, diff);
+	diff_component(a, b, BIOS_DIFF_KEYS, diff);
+	diff_component(a, b, BIOS_DIFF_XCODES, diff);
+	diff_component(a, b, BIOS_DIFF_KERNEL_DATA, diff);
+
+	// the kernel is only decrypted if its encrypted bytes differ, or they were encrypted differently.
+	diff_component(a, b, BIOS_DIFF_KERNEL, diff);
+	if (kernel->present != (BIOS_DIFF_IN_A | BIOS_DIFF_IN_B))
+		return;
+
+	key_a = kernel_key(a);
+	key_b = kernel_key(b);
+	if (kernel->diff_bytes == 0 && a->kernel.encryption_state == b->kernel.encryption_state &&
+		(key_a == key_b || (key_a != NULL && key_b != NULL && memcmp(key_a, key_b, XB_KEY_SIZE) == 0))) {
+		return;
+	}
+
+	a->loadKernel();
+	b->loadKernel();
+	diff_component(a, b, BIOS_DIFF_KERNEL, diff);
+}
+static const uint8_t* section_ptr(const Bios* bios, const IMAGE_SECTION_HEADER* section, uint32_t* size) {
+	// the raw data of a kernel section, clipped to the image.
+
+	uint32_t offset = section->pointerToRawData;
+
+	if (offset > bios->kernel.img_size)
+		offset = bios->kernel.img_size;
+
+	*size = section->rawDataSize;
+	if (*size > bios->kernel.img_size - offset)
+		*size = bios->kernel.img_size - offset;
+
+	return bios->kernel.img + offset;
+}
+static int diff_sections(Bios* a, Bios* b, BIOS_DIFF* diff) {
+	// decompress both kernels and diff their pe sections by name.
+
+	Bios* bios[2] = { a, b };
+	const IMAGE_SECTION_HEADER* sections[2];
+	uint32_t count[2];
+	const IMAGE_SECTION_HEADER* s;
+	const IMAGE_SECTION_HEADER* t;
+	const uint8_t* ptr[2];
+	uint32_t size[2];
+	uint32_t i;
+	uint32_t j;
+	uint32_t k;
+
+	for (i = 0; i < 2; ++i) {
+		const IMAGE_DOS_HEADER* dos;
+		const IMAGE_NT_HEADER* nt;
+		uint32_t offset;
+
+		if (bios[i]->decompressKrnl() != 0 || bios[i]->kernel.img == NULL)
+			return BIOS_DIFF_ERROR_SUCCESS;
+
+		dos = (const IMAGE_DOS_HEADER*)bios[i]->kernel.img;
+		if (!bios_is_kernel_img(bios[i]->kernel.img, bios[i]->kernel.img_size))
+			return BIOS_DIFF_ERROR_SUCCESS;
+
+		nt = (const IMAGE_NT_HEADER*)(bios[i]->kernel.img + dos->e_lfanew);
+		offset = dos->e_lfanew + sizeof(uint32_t) + sizeof(COFF_FILE_HEADER);
+		if (offset > bios[i]->kernel.img_size - sizeof(uint16_t))
+			return BIOS_DIFF_ERROR_SUCCESS;
+		offset += nt->file_header.sizeOfOptionalHeader;
+		count[i] = nt->file_header.numSections;
+		if (offset > bios[i]->kernel.img_size || count[i] > (bios[i]->kernel.img_size - offset) / sizeof(IMAGE_SECTION_HEADER))
+			return BIOS_DIFF_ERROR_SUCCESS;
+		sections[i] = (const IMAGE_SECTION_HEADER*)(bios[i]->kernel.img + offset);
+	}
+
+	diff->kernel_decompressed = true;
+	diff->sections = (BIOS_DIFF_SECTION*)malloc((count[0] + count[1] + 1) * sizeof(BIOS_DIFF_SECTION));
+	if (diff->sections == NULL)
+		return BIOS_DIFF_ERROR_FAILED;
+
+	// sections of a, matched in b by name, then the sections only in b.
+	for (k = 0; k < 2; ++k) {
+		for (i = 0; i < count[k]; ++i) {
+			s = &sections[k][i];
+			t = NULL;
+			for (j = 0; j < count[k ^ 1]; ++j) {
+				if (memcmp(sections[k ^ 1][j].name, s->name, BIOS_DIFF_SECTION_NAME_LEN) == 0) {
+					t = &sections[k ^ 1][j];
+					break;
+				}
+			}
+			if (k == 1 && t != NULL)
+				continue;
+
+			ptr[k] = section_ptr(bios[k], s, &size[k]);
+			ptr[k ^ 1] = (t != NULL) ? section_ptr(bios[k ^ 1], t, &size[k ^ 1]) : NULL;
+
+			BIOS_DIFF_SECTION* section = &diff->sections[diff->section_count++];
+			memset(section->name, 0, sizeof(section->name));
+			memcpy(section->name, s->name, BIOS_DIFF_SECTION_NAME_LEN);
+			diff_region(&section->region, ptr[0], size[0], ptr[1], size[1]);
+		}
+	}
+
+	return BIOS_DIFF_ERROR_SUCCESS;
+}
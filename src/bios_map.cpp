@@ -0,0 +1,522 @@
+// bios_map.cpp: Implements a free space map of a BIOS rom and a layout planner.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "bios_map.h"
+#include "Bios.h"
+#include "bldr.h"
+#include "XcodeInterp.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define BIOS_MAP_MAX_XCODE_RUNS 4
+#define BIOS_MAP_MAX_OWNED (8 + BIOS_MAP_MAX_XCODE_RUNS)
+
+static const char* owner_names[BIOS_MAP_OWNER_COUNT] = {
+	"free",
+	"init tbl",
+	"xcodes",
+	"data tbl",
+	"kernel",
+	"kernel data",
+	"2BL",
+	"FBL",
+	"mcpx",
+	"payload",
+	"unknown",
+};
+
+typedef struct {
+	BIOS_MAP_REGION* regions;
+	uint32_t count;
+	uint32_t capacity;
+} REGION_LIST;
+
+static int push_region(REGION_LIST* list, const uint32_t offset, const uint32_t size, const BIOS_MAP_OWNER owner);
+static int map_gap(REGION_LIST* list, const uint8_t* data, const uint32_t start, const uint32_t end);
+static uint32_t zero_run(const uint8_t* data, uint32_t i, const uint32_t end);
+static void map_stats(BIOS_MAP* map);
+static int compare_offset(const void* a, const void* b);
+static int compare_item_size(const void* a, const void* b);
+static bool heap_before(const BIOS_MAP_REGION* a, const BIOS_MAP_REGION* b);
+static void heap_push(BIOS_MAP_REGION* heap, uint32_t* count, const uint32_t offset, const uint32_t size);
+static void heap_pop(BIOS_MAP_REGION* heap, uint32_t* count);
+
+int bios_map_build(const uint8_t* data, const BIOS_LAYOUT* layout, BIOS_MAP* map) {
+	// map the components at their fixed and boot param offsets, then split the gaps into zero runs and unknown bytes.
+
+	const uint32_t romsize = layout->romsize;
+	BIOS_MAP_REGION owned[BIOS_MAP_MAX_OWNED];
+	BIOS_MAP_REGION xcode_runs[BIOS_MAP_MAX_XCODE_RUNS];
+	REGION_LIST list = {};
+	const XCODE* xcode;
+	uint32_t owned_count = 0;
+	uint32_t xcode_run_count = 0;
+	uint32_t start;
+	uint32_t mcpx;
+	uint32_t bldr;
+	uint32_t kernel_data;
+	uint32_t limit;
+	uint32_t offset;
+	uint32_t end;
+	uint32_t i;
+	const INIT_TBL* init_tbl = (const INIT_TBL*)data;
+
+	memset(map, 0, sizeof(BIOS_MAP));
+
+	if (romsize < sizeof(INIT_TBL) + BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE)
+		return BIOS_MAP_ERROR_FAILED;
+
+	mcpx = romsize - MCPX_BLOCK_SIZE;
+	bldr = mcpx - BLDR_BLOCK_SIZE;
+
+	owned[owned_count++] = { 0, sizeof(INIT_TBL), BIOS_MAP_INIT_TBL };
+	owned[owned_count++] = { mcpx, MCPX_BLOCK_SIZE, BIOS_MAP_MCPX };
+	if (layout->preldr) {
+		owned[owned_count++] = { bldr, BLDR_BLOCK_SIZE - PRELDR_BLOCK_SIZE, BIOS_MAP_BLDR };
+		owned[owned_count++] = { mcpx - PRELDR_BLOCK_SIZE, PRELDR_BLOCK_SIZE, BIOS_MAP_PRELDR };
+	}
+	else {
+		owned[owned_count++] = { bldr, BLDR_BLOCK_SIZE, BIOS_MAP_BLDR };
+	}
+
+	// the kernel data sits below the 2BL and the kernel below that.
+	limit = bldr;
+	if (layout->kernel_size != 0 && layout->kernel_data_size <= bldr - sizeof(INIT_TBL) &&
+		layout->kernel_size <= bldr - sizeof(INIT_TBL) - layout->kernel_data_size) {
+		kernel_data = bldr - layout->kernel_data_size;
+		limit = kernel_data - layout->kernel_size;
+		owned[owned_count++] = { kernel_data, layout->kernel_data_size, BIOS_MAP_KERNEL_DATA };
+		owned[owned_count++] = { limit, layout->kernel_size, BIOS_MAP_KERNEL };
+	}
+
+	// the xcodes run from the end of the init table header to the exit xcode. forward jumps are followed;
+	// injected xcodes are reached with one.
+	start = sizeof(INIT_TBL);
+	offset = start;
+	while (offset + sizeof(XCODE) <= limit) {
+		xcode = (const XCODE*)(data + offset);
+		if (xcode->opcode == XC_EXIT) {
+			xcode_runs[xcode_run_count++] = { start, (uint32_t)(offset + sizeof(XCODE) - start), BIOS_MAP_XCODES };
+			for (i = 0; i < xcode_run_count; ++i) {
+				owned[owned_count++] = xcode_runs[i];
+			}
+			break;
+		}
+		offset += sizeof(XCODE);
+		if (xcode->opcode == XC_JMP && xcode->data != 0 && xcode->data < limit - offset && xcode_run_count < BIOS_MAP_MAX_XCODE_RUNS - 1) {
+			xcode_runs[xcode_run_count++] = { start, offset - start, BIOS_MAP_XCODES };
+			start = offset + xcode->data;
+			offset = start;
+		}
+	}
+
+	// if data_tbl_offset is 0 then no rom data table.
+	offset = init_tbl->data_tbl_offset;
+	if (offset >= sizeof(INIT_TBL) && offset <= limit && sizeof(ROM_DATA_TBL) <= limit - offset) {
+		owned[owned_count++] = { offset, sizeof(ROM_DATA_TBL), BIOS_MAP_DATA_TBL };
+	}
+
+	qsort(owned, owned_count, sizeof(BIOS_MAP_REGION), compare_offset);
+
+	end = 0;
+	for (i = 0; i < owned_count; ++i) {
+		// a corrupt table can overlap a component; the lower one keeps the bytes.
+		offset = owned[i].offset;
+		if (offset < end) {
+			if (owned[i].offset + owned[i].size <= end)
+				continue;
+			owned[i].size -= end - offset;
+			offset = end;
+		}
+		if (owned[i].size == 0)
+			continue;
+
+		if (map_gap(&list, data, end, offset) != 0 || push_region(&list, offset, owned[i].size, owned[i].owner) != 0)
+			goto Failed;
+		end = offset + owned[i].size;
+	}
+	if (map_gap(&list, data, end, romsize) != 0)
+		goto Failed;
+
+	map->regions = list.regions;
+	map->count = list.count;
+	map->romsize = romsize;
+	map_stats(map);
+
+	return BIOS_MAP_ERROR_SUCCESS;
+
+Failed:
+	if (list.regions != NULL) {
+		free(list.regions);
+	}
+	return BIOS_MAP_ERROR_FAILED;
+}
+void bios_map_free(BIOS_MAP* map) {
+	if (map->regions != NULL) {
+		free(map->regions);
+		map->regions = NULL;
+	}
+	map->count = 0;
+}
+
+const BIOS_MAP_REGION* bios_map_find(const BIOS_MAP* map, const uint32_t offset) {
+	uint32_t lo = 0;
+	uint32_t hi = map->count;
+	uint32_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (offset < map->regions[mid].offset)
+			hi = mid;
+		else if (offset - map->regions[mid].offset >= map->regions[mid].size)
+			lo = mid + 1;
+		else
+			return &map->regions[mid];
+	}
+
+	return NULL;
+}
+
+int bios_map_plan(BIOS_MAP* map, BIOS_MAP_ITEM* items, const uint32_t count) {
+	// worst fit decreasing; if the largest free run cannot hold an item, no run can.
+
+	BIOS_MAP_ITEM** order = NULL;
+	BIOS_MAP_REGION* heap = NULL;
+	REGION_LIST list = {};
+	BIOS_MAP_REGION run;
+	uint32_t heap_count = 0;
+	uint32_t start;
+	uint32_t mask;
+	uint32_t i;
+	int result = BIOS_MAP_ERROR_FAILED;
+
+	if (count == 0)
+		return BIOS_MAP_ERROR_SUCCESS;
+
+	// each placement takes one run and gives back at most two.
+	order = (BIOS_MAP_ITEM**)malloc(count * sizeof(BIOS_MAP_ITEM*));
+	heap = (BIOS_MAP_REGION*)malloc((map->free_runs + count) * sizeof(BIOS_MAP_REGION));
+	if (order == NULL || heap == NULL)
+		goto Cleanup;
+
+	for (i = 0; i < count; ++i) {
+		order[i] = &items[i];
+	}
+	qsort(order, count, sizeof(BIOS_MAP_ITEM*), compare_item_size);
+
+	for (i = 0; i < map->count; ++i) {
+		if (map->regions[i].owner == BIOS_MAP_FREE)
+			heap_push(heap, &heap_count, map->regions[i].offset, map->regions[i].size);
+	}
+
+	for (i = 0; i < count; ++i) {
+		if (order[i]->size == 0) {
+			order[i]->offset = 0;
+			continue;
+		}
+		if (heap_count == 0) {
+			result = BIOS_MAP_ERROR_NO_SPACE;
+			goto Cleanup;
+		}
+
+		run = heap[0];
+		mask = (order[i]->align > 1) ? order[i]->align - 1 : 0;
+		start = (run.offset + mask) & ~mask;
+		if (start - run.offset > run.size || order[i]->size > run.size - (start - run.offset)) {
+			result = BIOS_MAP_ERROR_NO_SPACE;
+			goto Cleanup;
+		}
+		order[i]->offset = start;
+
+		heap_pop(heap, &heap_count);
+		if (start > run.offset)
+			heap_push(heap, &heap_count, run.offset, start - run.offset);
+		if (run.offset + run.size > start + order[i]->size)
+			heap_push(heap, &heap_count, start + order[i]->size, run.offset + run.size - start - order[i]->size);
+	}
+
+	// rebuild the map from the owned regions, the placed items and what is left of the free runs.
+	for (i = 0; i < map->count; ++i) {
+		if (map->regions[i].owner != BIOS_MAP_FREE && push_region(&list, map->regions[i].offset, map->regions[i].size, map->regions[i].owner) != 0)
+			goto Cleanup;
+	}
+	for (i = 0; i < count; ++i) {
+		if (items[i].size != 0 && push_region(&list, items[i].offset, items[i].size, items[i].owner) != 0)
+			goto Cleanup;
+	}
+	for (i = 0; i < heap_count; ++i) {
+		if (push_region(&list, heap[i].offset, heap[i].size, BIOS_MAP_FREE) != 0)
+			goto Cleanup;
+	}
+	qsort(list.regions, list.count, sizeof(BIOS_MAP_REGION), compare_offset);
+
+	free(map->regions);
+	map->regions = list.regions;
+	map->count = list.count;
+	list.regions = NULL;
+	map_stats(map);
+
+	result = BIOS_MAP_ERROR_SUCCESS;
+
+Cleanup:
+	if (order != NULL) {
+		free(order);
+	}
+	if (heap != NULL) {
+		free(heap);
+	}
+	if (list.regions != NULL) {
+		free(list.regions);
+	}
+	return result;
+}
+
+int bios_inject_xcodes(uint8_t* data, const uint32_t size, const BIOS_LAYOUT* layout, const uint8_t* xcodes, const uint32_t xcodes_size) {
+	// the xcodes replace the exit xcode if the free run after it is big enough.
+	// otherwise they are planned into free space and the exit xcode becomes a jump to them.
+
+	BIOS_MAP map;
+	BIOS_MAP_ITEM item;
+	const BIOS_MAP_REGION* region = NULL;
+	XCODE* xcode = NULL;
+	uint32_t exit_offset;
+	uint32_t i;
+	int result = BIOS_MAP_ERROR_FAILED;
+
+	if (bios_map_build(data, layout, &map) != BIOS_MAP_ERROR_SUCCESS) {
+		return BIOS_MAP_ERROR_FAILED;
+	}
+
+	// jumps are only followed forward; the exit xcode ends the last xcodes region.
+	for (i = 0; i < map.count; ++i) {
+		if (map.regions[i].owner == BIOS_MAP_XCODES) {
+			region = &map.regions[i];
+		}
+	}
+	if (region == NULL) {
+		log_error("XCODE: exit xcode not found.\n");
+		goto Cleanup;
+	}
+
+	exit_offset = region->offset + region->size - sizeof(XCODE);
+	xcode = (XCODE*)(data + exit_offset);
+
+	region = bios_map_find(&map, exit_offset + sizeof(XCODE));
+	if (region == NULL || region->owner != BIOS_MAP_FREE || region->size < xcodes_size) {
+		item.owner = BIOS_MAP_XCODES;
+		item.size = xcodes_size + sizeof(XCODE);
+		item.align = 0;
+		if (bios_map_plan(&map, &item, 1) != BIOS_MAP_ERROR_SUCCESS) {
+			log_error("XCODE: no free space for %u bytes of xcodes. %u bytes free; largest run %u bytes\n", item.size, map.free_bytes, map.largest_free);
+			result = BIOS_MAP_ERROR_NO_SPACE;
+			goto Cleanup;
+		}
+
+		log_info("XCODE: replacing quit xcode at 0x%x with jump to free space at 0x%x\n", exit_offset, item.offset);
+
+		// patch quit xcode to a jmp xcode. the jump is relative to the next xcode.
+		xcode->opcode = XC_JMP;
+		xcode->addr = 0;
+		xcode->data = item.offset - (exit_offset + sizeof(XCODE));
+
+		// update xcode ptr.
+		xcode = (XCODE*)(data + item.offset);
+	}
+
+	log_info("XCODE: adding xcodes\n");
+
+	// copy in xcodes.
+	memcpy(xcode, xcodes, xcodes_size);
+
+	// copy in quit xcode.
+	xcode = (XCODE*)((uint8_t*)xcode + xcodes_size);
+	xcode->opcode = XC_EXIT;
+	xcode->addr = 0x806;
+	xcode->data = 0;
+
+	// the xcodes were only written to the first bank.
+	if (size > layout->romsize) {
+		bios_replicate_data(layout->romsize, size, data, size);
+	}
+
+	result = BIOS_MAP_ERROR_SUCCESS;
+
+Cleanup:
+	bios_map_free(&map);
+	return result;
+}
+
+const char* bios_map_owner_name(const BIOS_MAP_OWNER owner) {
+	if (owner >= BIOS_MAP_OWNER_COUNT)
+		return "unknown";
+	return owner_names[owner];
+}
+
+static int push_region(REGION_LIST* list, const uint32_t offset, const uint32_t size, const BIOS_MAP_OWNER owner) {
+	BIOS_MAP_REGION* regions;
+	uint32_t capacity;
+
+	if (list->count == list->capacity) {
+		capacity = (list->capacity > 0) ? list->capacity * 2 : 32;
+		regions = (BIOS_MAP_REGION*)realloc(list->regions, capacity * sizeof(BIOS_MAP_REGION));
+		if (regions == NULL)
+			return 1;
+		list->regions = regions;
+		list->capacity = capacity;
+	}
+
+	list->regions[list->count].offset = offset;
+	list->regions[list->count].size = size;
+	list->regions[list->count].owner = owner;
+	list->count++;
+	return 0;
+}
+static int map_gap(REGION_LIST* list, const uint8_t* data, const uint32_t start, const uint32_t end) {
+	// split a gap into zero runs and the unknown bytes between them.
+
+	uint32_t used = start;
+	uint32_t i = start;
+	uint32_t j;
+
+	while (i < end) {
+		if (data[i] != 0) {
+			i++;
+			continue;
+		}
+
+		j = zero_run(data, i, end);
+		if (j - i >= BIOS_MAP_MIN_FREE) {
+			if (i > used && push_region(list, used, i - used, BIOS_MAP_UNKNOWN) != 0)
+				return 1;
+			if (push_region(list, i, j - i, BIOS_MAP_FREE) != 0)
+				return 1;
+			used = j;
+		}
+		i = j;
+	}
+
+	if (end > used && push_region(list, used, end - used, BIOS_MAP_UNKNOWN) != 0)
+		return 1;
+
+	return 0;
+}
+static uint32_t zero_run(const uint8_t* data, uint32_t i, const uint32_t end) {
+	// returns the end of the zero run at i; the fill between components is checked 8 bytes at a time.
+
+	uint64_t w;
+
+	for (; i + 8 <= end; i += 8) {
+		memcpy(&w, data + i, sizeof(uint64_t));
+		if (w != 0)
+			break;
+	}
+	for (; i < end && data[i] == 0; ++i);
+
+	return i;
+}
+static void map_stats(BIOS_MAP* map) {
+	uint32_t i;
+
+	map->free_bytes = 0;
+	map->free_runs = 0;
+	map->largest_free = 0;
+
+	for (i = 0; i < map->count; ++i) {
+		if (map->regions[i].owner != BIOS_MAP_FREE)
+			continue;
+		map->free_bytes += map->regions[i].size;
+		map->free_runs++;
+		if (map->regions[i].size > map->largest_free)
+			map->largest_free = map->regions[i].size;
+	}
+}
+static int compare_offset(const void* a, const void* b) {
+	const BIOS_MAP_REGION* x = (const BIOS_MAP_REGION*)a;
+	const BIOS_MAP_REGION* y = (const BIOS_MAP_REGION*)b;
+
+	if (x->offset != y->offset)
+		return (x->offset < y->offset) ? -1 : 1;
+	return 0;
+}
+static int compare_item_size(const void* a, const void* b) {
+	// largest first; equal sizes keep their order.
+
+	const BIOS_MAP_ITEM* x = *(const BIOS_MAP_ITEM* const*)a;
+	const BIOS_MAP_ITEM* y = *(const BIOS_MAP_ITEM* const*)b;
+
+	if (x->size != y->size)
+		return (x->size > y->size) ? -1 : 1;
+	if (x != y)
+		return (x < y) ? -1 : 1;
+	return 0;
+}
+static bool heap_before(const BIOS_MAP_REGION* a, const BIOS_MAP_REGION* b) {
+	// the largest run is on top; the lowest offset breaks ties.
+
+	if (a->size != b->size)
+		return a->size > b->size;
+	return a->offset < b->offset;
+}
+static void heap_push(BIOS_MAP_REGION* heap, uint32_t* count, const uint32_t offset, const uint32_t size) {
+	BIOS_MAP_REGION run = { offset, size, BIOS_MAP_FREE };
+	uint32_t i = (*count)++;
+	uint32_t parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (!heap_before(&run, &heap[parent]))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+	}
+	heap[i] = run;
+}
+static void heap_pop(BIOS_MAP_REGION* heap, uint32_t* count) {
+	BIOS_MAP_REGION run;
+	uint32_t i = 0;
+	uint32_t child;
+
+	if (--(*count) == 0)
+		return;
+
+	run = heap[*count];
+	for (;;) {
+		child = i * 2 + 1;
+		if (child >= *count)
+			break;
+		if (child + 1 < *count && heap_before(&heap[child + 1], &heap[child]))
+			child++;
+		if (!heap_before(&heap[child], &run))
+			break;
+		heap[i] = heap[child];
+		i = child;
+	}
+	heap[i] = run;
+}
@@ -0,0 +1,391 @@
+// bios_patch.cpp: Implements compact binary patches between BIOS images.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "bios_patch.h"
+#include "Bios.h"
+#include "delta.h"
+#include "sha1.h"
+#include "util.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+static void hash_image(const uint8_t* data, const uint32_t size, uint8_t* hash);
+static int expand_bios(const uint8_t* data, const uint32_t size, const BIOS_LOAD_PARAMS* params, Bios* bios, const bool decompress);
+static uint8_t* compressed_kernel(Bios* bios, uint32_t* size);
+static int make_patch(const BIOS_PATCH_HEADER* header, const uint8_t* image_delta, const uint8_t* kernel_delta, uint8_t** patch, uint32_t* patch_size);
+static int create_component_patch(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const BIOS_PATCH_HEADER* raw,
+	const BIOS_LOAD_PARAMS* params, uint8_t** patch, uint32_t* patch_size);
+static int apply_component_patch(const uint8_t* src, const BIOS_PATCH_HEADER* header, const uint8_t* image_delta, const uint8_t* kernel_delta,
+	const BIOS_LOAD_PARAMS* params, uint8_t* dst);
+
+int bios_patch_create(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size,
+	const BIOS_LOAD_PARAMS* params, uint8_t** patch, uint32_t* patch_size) {
+
+	BIOS_PATCH_HEADER header;
+	BIOS_BANKS banks;
+	uint8_t* delta = NULL;
+	uint8_t* component = NULL;
+	uint32_t component_size = 0;
+	int result = BIOS_PATCH_ERROR_FAILED;
+
+	*patch = NULL;
+	*patch_size = 0;
+
+	// only the unique bank of a mirrored image is patched.
+	if (bios_check_size(src_size) != 0 || bios_detect_banks(dst, dst_size, &banks) != 0)
+		return BIOS_PATCH_ERROR_FAILED;
+
+	memset(&header, 0, sizeof(BIOS_PATCH_HEADER));
+	header.magic = BIOS_PATCH_MAGIC;
+	header.version = BIOS_PATCH_VERSION;
+	header.mode = BIOS_PATCH_MODE_RAW;
+	header.src_size = src_size;
+	header.dst_size = dst_size;
+	header.romsize = banks.romsize;
+	hash_image(src, src_size, header.src_hash);
+	hash_image(dst, dst_size, header.dst_hash);
+
+	if (delta_encode(src, src_size, dst, header.romsize, &delta, &header.image_delta_size) != DELTA_ERROR_SUCCESS)
+		goto Cleanup;
+	if (make_patch(&header, delta, NULL, patch, patch_size) != 0)
+		goto Cleanup;
+
+	// a component patch survives re-encryption and recompression; keep it if it is smaller.
+	if (create_component_patch(src, src_size, dst, &header, params, &component, &component_size) == BIOS_PATCH_ERROR_SUCCESS) {
+		if (component_size < *patch_size) {
+			free(*patch);
+			*patch = component;
+			*patch_size = component_size;
+			component = NULL;
+		}
+	}
+
+	result = BIOS_PATCH_ERROR_SUCCESS;
+
+Cleanup:
+	if (delta != NULL) {
+		free(delta);
+	}
+	if (component != NULL) {
+		free(component);
+	}
+	return result;
+}
+
+int bios_patch_apply(const uint8_t* src, const uint32_t src_size, const uint8_t* patch, const uint32_t patch_size,
+	const BIOS_LOAD_PARAMS* params, uint8_t** dst, uint32_t* dst_size) {
+
+	BIOS_PATCH_HEADER header;
+	const uint8_t* image_delta;
+	const uint8_t* kernel_delta;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t* data = NULL;
+	int result = BIOS_PATCH_ERROR_INVALID;
+
+	*dst = NULL;
+	*dst_size = 0;
+
+	if (patch_size < sizeof(BIOS_PATCH_HEADER))
+		return BIOS_PATCH_ERROR_INVALID;
+
+	memcpy(&header, patch, sizeof(BIOS_PATCH_HEADER));
+	if (header.magic != BIOS_PATCH_MAGIC || header.version != BIOS_PATCH_VERSION || header.mode > BIOS_PATCH_MODE_COMPONENT)
+		return BIOS_PATCH_ERROR_INVALID;
+	if (bios_check_size(header.dst_size) != 0 || header.romsize > header.dst_size || header.romsize == 0 || header.dst_size % header.romsize != 0)
+		return BIOS_PATCH_ERROR_INVALID;
+	if (header.image_delta_size > patch_size - sizeof(BIOS_PATCH_HEADER) ||
+		header.kernel_delta_size != patch_size - sizeof(BIOS_PATCH_HEADER) - header.image_delta_size)
+		return BIOS_PATCH_ERROR_INVALID;
+
+	image_delta = patch + sizeof(BIOS_PATCH_HEADER);
+	kernel_delta = image_delta + header.image_delta_size;
+
+	hash_image(src, src_size, hash);
+	if (src_size != header.src_size || memcmp(hash, header.src_hash, SHA1_DIGEST_LEN) != 0)
+		return BIOS_PATCH_ERROR_SRC_HASH;
+
+	data = (uint8_t*)malloc(header.dst_size);
+	if (data == NULL)
+		return BIOS_PATCH_ERROR_FAILED;
+
+	if (header.mode == BIOS_PATCH_MODE_COMPONENT) {
+		result = apply_component_patch(src, &header, image_delta, kernel_delta, params, data);
+		if (result != BIOS_PATCH_ERROR_SUCCESS)
+			goto Cleanup;
+	}
+	else {
+		if (delta_decode(src, src_size, image_delta, header.image_delta_size, data, header.romsize) != DELTA_ERROR_SUCCESS) {
+			result = BIOS_PATCH_ERROR_INVALID;
+			goto Cleanup;
+		}
+	}
+
+	if (header.romsize < header.dst_size) {
+		bios_replicate_data(header.romsize, header.dst_size, data, header.dst_size);
+	}
+
+	hash_image(data, header.dst_size, hash);
+	if (memcmp(hash, header.dst_hash, SHA1_DIGEST_LEN) != 0) {
+		result = BIOS_PATCH_ERROR_DST_HASH;
+		goto Cleanup;
+	}
+
+	*dst = data;
+	*dst_size = header.dst_size;
+	data = NULL;
+	result = BIOS_PATCH_ERROR_SUCCESS;
+
+Cleanup:
+	if (data != NULL) {
+		free(data);
+	}
+	return result;
+}
+
+static void hash_image(const uint8_t* data, const uint32_t size, uint8_t* hash) {
+	SHA1Context sha;
+	SHA1Reset(&sha);
+	SHA1Input(&sha, data, size);
+	SHA1Result(&sha, hash);
+}
+static int expand_bios(const uint8_t* data, const uint32_t size, const BIOS_LOAD_PARAMS* params, Bios* bios, const bool decompress) {
+	// load a copy of an image and decrypt the 2BL and kernel. optionally decompress the kernel.
+
+	BIOS_LOAD_PARAMS load = *params;
+	BIOS_BANKS banks;
+	uint8_t* copy;
+
+	if (bios_detect_banks(data, size, &banks) != 0)
+		return BIOS_PATCH_ERROR_FAILED;
+	load.romsize = banks.romsize;
+
+	copy = (uint8_t*)malloc(size);
+	if (copy == NULL)
+		return BIOS_PATCH_ERROR_FAILED;
+	memcpy(copy, data, size);
+
+	// the bios owns the copy.
+	if (bios->load(copy, size, &load) != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_PATCH_ERROR_FAILED;
+	if (bios->loadKernel() != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_PATCH_ERROR_FAILED;
+	if (compressed_kernel(bios, NULL) == NULL)
+		return BIOS_PATCH_ERROR_FAILED;
+	if (decompress && bios->decompressKrnl() != 0)
+		return BIOS_PATCH_ERROR_FAILED;
+
+	return BIOS_PATCH_ERROR_SUCCESS;
+}
+static uint8_t* compressed_kernel(Bios* bios, uint32_t* size) {
+	// the compressed kernel, or NULL if the boot params put it outside the image.
+
+	const uint32_t kernel_size = bios->bldr.boot_params->compressed_kernel_size;
+
+	if (!IN_BOUNDS_BLOCK(bios->kernel.compressed_kernel_ptr, kernel_size, bios->data, bios->size))
+		return NULL;
+	if (size != NULL)
+		*size = kernel_size;
+	return bios->kernel.compressed_kernel_ptr;
+}
+static int make_patch(const BIOS_PATCH_HEADER* header, const uint8_t* image_delta, const uint8_t* kernel_delta, uint8_t** patch, uint32_t* patch_size) {
+	const uint32_t size = sizeof(BIOS_PATCH_HEADER) + header->image_delta_size + header->kernel_delta_size;
+
+	*patch = (uint8_t*)malloc(size);
+	if (*patch == NULL)
+		return 1;
+
+	memcpy(*patch, header, sizeof(BIOS_PATCH_HEADER));
+	memcpy(*patch + sizeof(BIOS_PATCH_HEADER), image_delta, header->image_delta_size);
+	if (header->kernel_delta_size > 0) {
+		memcpy(*patch + sizeof(BIOS_PATCH_HEADER) + header->image_delta_size, kernel_delta, header->kernel_delta_size);
+	}
+	*patch_size = size;
+	return 0;
+}
+
+static int create_component_patch(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const BIOS_PATCH_HEADER* raw,
+	const BIOS_LOAD_PARAMS* params, uint8_t** patch, uint32_t* patch_size) {
+	// diff the decrypted images. if the kernel changed, diff the decompressed kernels instead of the compressed ones;
+	// apply recompresses it. the patch is only kept if applying it reproduces dst.
+
+	BIOS_PATCH_HEADER header = *raw;
+	Bios s;
+	Bios d;
+	uint8_t* s_kernel;
+	uint8_t* d_kernel;
+	uint32_t s_kernel_size = 0;
+	uint32_t d_kernel_size = 0;
+	uint8_t* image_delta = NULL;
+	uint8_t* kernel_delta = NULL;
+	uint8_t* data = NULL;
+	uint32_t size = 0;
+	bool kernel_changed;
+	int result = BIOS_PATCH_ERROR_FAILED;
+
+	*patch = NULL;
+	*patch_size = 0;
+
+	header.mode = BIOS_PATCH_MODE_COMPONENT;
+	header.image_delta_size = 0;
+
+	if (expand_bios(src, src_size, params, &s, false) != BIOS_PATCH_ERROR_SUCCESS ||
+		expand_bios(dst, raw->romsize, params, &d, false) != BIOS_PATCH_ERROR_SUCCESS)
+		goto Cleanup;
+
+	s_kernel = compressed_kernel(&s, &s_kernel_size);
+	d_kernel = compressed_kernel(&d, &d_kernel_size);
+	kernel_changed = (s_kernel_size != d_kernel_size || memcmp(s_kernel, d_kernel, d_kernel_size) != 0);
+
+	if (kernel_changed) {
+		if (s.decompressKrnl() != 0 || d.decompressKrnl() != 0)
+			goto Cleanup;
+		if (delta_encode(s.kernel.img, s.kernel.img_size, d.kernel.img, d.kernel.img_size, &kernel_delta, &header.kernel_delta_size) != DELTA_ERROR_SUCCESS)
+			goto Cleanup;
+		header.kernel_img_size = d.kernel.img_size;
+
+		// the compressed kernel is rebuilt from the kernel delta.
+		memset(d_kernel, 0, d_kernel_size);
+	}
+
+	if (delta_encode(s.data, s.size, d.data, d.size, &image_delta, &header.image_delta_size) != DELTA_ERROR_SUCCESS)
+		goto Cleanup;
+
+	if (make_patch(&header, image_delta, kernel_delta, patch, patch_size) != 0)
+		goto Cleanup;
+
+	// re-encryption and recompression have to reproduce dst byte for byte.
+	if (bios_patch_apply(src, src_size, *patch, *patch_size, params, &data, &size) != BIOS_PATCH_ERROR_SUCCESS) {
+		free(*patch);
+		*patch = NULL;
+		*patch_size = 0;
+		goto Cleanup;
+	}
+
+	result = BIOS_PATCH_ERROR_SUCCESS;
+
+Cleanup:
+	if (image_delta != NULL) {
+		free(image_delta);
+	}
+	if (kernel_delta != NULL) {
+		free(kernel_delta);
+	}
+	if (data != NULL) {
+		free(data);
+	}
+	return result;
+}
+static int apply_component_patch(const uint8_t* src, const BIOS_PATCH_HEADER* header, const uint8_t* image_delta, const uint8_t* kernel_delta,
+	const BIOS_LOAD_PARAMS* params, uint8_t* dst) {
+	// rebuild the decrypted bank, recompress the kernel if it changed, then re-encrypt the kernel and the 2BL.
+	// the deltas only fit the source decrypted with the keys the patch was made with.
+
+	BIOS_LOAD_PARAMS load = *params;
+	Bios s;
+	Bios d;
+	uint8_t* bank = NULL;
+	uint8_t* img = NULL;
+	uint8_t* kernel = NULL;
+	uint8_t* d_kernel;
+	uint32_t kernel_size = 0;
+	uint32_t d_kernel_size = 0;
+	uint8_t* sbkey = NULL;
+	int result = BIOS_PATCH_ERROR_FAILED;
+
+	if (expand_bios(src, header->src_size, params, &s, header->kernel_delta_size > 0) != BIOS_PATCH_ERROR_SUCCESS) {
+		return BIOS_PATCH_ERROR_KEYS;
+	}
+
+	bank = (uint8_t*)malloc(header->romsize);
+	if (bank == NULL)
+		return BIOS_PATCH_ERROR_FAILED;
+
+	if (delta_decode(s.data, s.size, image_delta, header->image_delta_size, bank, header->romsize) != DELTA_ERROR_SUCCESS) {
+		free(bank);
+		return BIOS_PATCH_ERROR_KEYS;
+	}
+
+	// the bank is decrypted; load it as is. the bios owns the bank.
+	load.romsize = header->romsize;
+	load.enc_bldr = true;
+	load.enc_kernel = true;
+	if (d.load(bank, header->romsize, &load) != BIOS_LOAD_STATUS_SUCCESS || d.loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_PATCH_ERROR_KEYS;
+
+	d_kernel = compressed_kernel(&d, &d_kernel_size);
+	if (d_kernel == NULL)
+		return BIOS_PATCH_ERROR_KEYS;
+
+	if (header->kernel_delta_size > 0) {
+		img = (uint8_t*)malloc(header->kernel_img_size);
+		if (img == NULL)
+			goto Cleanup;
+
+		if (delta_decode(s.kernel.img, s.kernel.img_size, kernel_delta, header->kernel_delta_size, img, header->kernel_img_size) != DELTA_ERROR_SUCCESS) {
+			result = BIOS_PATCH_ERROR_KEYS;
+			goto Cleanup;
+		}
+		if (bios_compress_kernel(img, header->kernel_img_size, &kernel, &kernel_size) != 0)
+			goto Cleanup;
+		if (kernel_size != d_kernel_size) {
+			result = BIOS_PATCH_ERROR_KEYS;
+			goto Cleanup;
+		}
+		memcpy(d_kernel, kernel, kernel_size);
+	}
+
+	// re-encrypt as the source was decrypted; the kernel first, its key is in the 2BL.
+	if (!params->enc_kernel) {
+		d.symmetricEncDecKernel();
+	}
+	if (!params->enc_bldr) {
+		if (params->bldr_key != NULL) {
+			sbkey = params->bldr_key;
+		}
+		else if (params->mcpx != NULL) {
+			sbkey = params->mcpx->sbkey;
+		}
+		if (sbkey != NULL) {
+			d.symmetricEncDecBldr(sbkey, XB_KEY_SIZE);
+		}
+	}
+
+	memcpy(dst, d.data, header->romsize);
+	result = BIOS_PATCH_ERROR_SUCCESS;
+
+Cleanup:
+	if (img != NULL) {
+		free(img);
+	}
+	if (kernel != NULL) {
+		free(kernel);
+	}
+	return result;
+}
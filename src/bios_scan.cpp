@@ -0,0 +1,844 @@
+// bios_scan.cpp: Implements a parallel scan of a directory tree of BIOS images.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <atomic>
+#include <mutex>
+
+// user incl
+#include "bios_scan.h"
+#include "Bios.h"
+#include "bios_diff.h"
+#include "bios_sketch.h"
+#include "boot_sim.h"
+#include "file.h"
+#include "log.h"
+#include "work_pool.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+// a file sorted by size, then contents hash.
+typedef struct {
+	uint64_t hash;
+	uint32_t size;
+	uint32_t index;
+} BIOS_SCAN_KEY;
+
+// kernels claimed for sketching. the first image with a kernel decompresses it; the rest share its sketch.
+typedef struct {
+	uint8_t (*hashes)[SHA1_DIGEST_LEN];
+	bool* used;
+	uint32_t mask;					// slot count - 1; a power of 2 - 1
+	std::mutex lock;
+} BIOS_SCAN_KERNELS;
+
+typedef struct {
+	BIOS_SCAN* scan;
+	const BIOS_SCAN_PARAMS* params;
+	BIOS_SCAN_KEY* keys;
+	const uint32_t* items;			// the keys to hash, or the results to load
+	std::atomic<uint64_t> bytes;
+	BIOS_SCAN_KERNELS* kernels;		// NULL if not sketching
+} BIOS_SCAN_CONTEXT;
+
+// report text
+typedef struct {
+	char* data;
+	uint32_t size;
+	uint32_t capacity;
+	bool failed;
+} BIOS_SCAN_TEXT;
+
+static const MCPX_REV boot_revs[2] = { MCPX_REV_0, MCPX_REV_1 };
+static const char* boot_rev_names[2] = { "1.0", "1.1" };
+
+static int bios_scan_add(const char* filename, void* context);
+static int bios_scan_dedup(BIOS_SCAN* scan, int threads);
+static int bios_scan_run(BIOS_SCAN_CONTEXT* ctx, const uint32_t count, WORK_FUNC func, int threads);
+static void bios_scan_hash_range(uint64_t begin, uint64_t end, void* context);
+static void bios_scan_load_range(uint64_t begin, uint64_t end, void* context);
+static void bios_scan_load(BIOS_SCAN_RESULT* result, BIOS_SCAN_CONTEXT* ctx);
+static int bios_scan_sketch(BIOS_SCAN_RESULT* result, Bios* bios, BIOS_SCAN_KERNELS* kernels);
+static bool bios_scan_claim_kernel(BIOS_SCAN_KERNELS* kernels, const uint8_t* hash);
+static void bios_scan_share_kernels(BIOS_SCAN* scan);
+static int compare_kernel(const void* a, const void* b);
+static bool bios_scan_files_equal(const char* a, const char* b);
+static int compare_key(const void* a, const void* b);
+static const char* status_name(const int status);
+static const char* preldr_status_name(const int status);
+static void text_printf(BIOS_SCAN_TEXT* text, const char* format, ...);
+static void text_string(BIOS_SCAN_TEXT* text, const char* str, const int format);
+static void text_hash(BIOS_SCAN_TEXT* text, const uint8_t* hash);
+static void report_csv(BIOS_SCAN_TEXT* text, const BIOS_SCAN* scan);
+static void report_json(BIOS_SCAN_TEXT* text, const BIOS_SCAN* scan, const IDENT_DB* ident);
+
+void bios_scan_init(BIOS_SCAN* scan) {
+	scan->results = NULL;
+	scan->count = 0;
+	scan->capacity = 0;
+	scan->unique = 0;
+	scan->loaded = 0;
+	scan->bytes = 0;
+}
+void bios_scan_free(BIOS_SCAN* scan) {
+	uint32_t i;
+
+	if (scan->results != NULL) {
+		for (i = 0; i < scan->count; ++i) {
+			if (scan->results[i].filename != NULL) {
+				free(scan->results[i].filename);
+				scan->results[i].filename = NULL;
+			}
+			if (scan->results[i].sketch != NULL && scan->results[i].duplicate_of == BIOS_SCAN_NO_DUPLICATE) {
+				free(scan->results[i].sketch);
+			}
+			scan->results[i].sketch = NULL;
+		}
+		free(scan->results);
+		scan->results = NULL;
+	}
+	bios_scan_init(scan);
+}
+
+int bios_scan(BIOS_SCAN* scan, const char* path, const BIOS_SCAN_PARAMS* params, int threads) {
+	BIOS_SCAN_CONTEXT ctx;
+	BIOS_SCAN_KERNELS kernels;
+	BIOS_SCAN_RESULT* result;
+	uint32_t* unique = NULL;
+	uint32_t slots;
+	uint32_t i;
+	int error = BIOS_SCAN_ERROR_SUCCESS;
+
+	kernels.hashes = NULL;
+	kernels.used = NULL;
+	kernels.mask = 0;
+
+	bios_scan_free(scan);
+
+	if (enumerateFiles(path, true, bios_scan_add, scan) != 0)
+		return BIOS_SCAN_ERROR_FAILED;
+
+	if (scan->count == 0)
+		return BIOS_SCAN_ERROR_SUCCESS;
+
+	if (bios_scan_dedup(scan, threads) != BIOS_SCAN_ERROR_SUCCESS)
+		return BIOS_SCAN_ERROR_FAILED;
+
+	unique = (uint32_t*)malloc(scan->count * sizeof(uint32_t));
+	if (unique == NULL)
+		return BIOS_SCAN_ERROR_FAILED;
+
+	for (i = 0; i < scan->count; ++i) {
+		if (scan->results[i].duplicate_of == BIOS_SCAN_NO_DUPLICATE)
+			unique[scan->unique++] = i;
+	}
+
+	ctx.scan = scan;
+	ctx.params = params;
+	ctx.keys = NULL;
+	ctx.items = unique;
+	ctx.bytes = 0;
+	ctx.kernels = NULL;
+
+	if (params->sketch) {
+		// at most half the slots are used.
+		for (slots = 16; slots < scan->unique * 2; slots *= 2) {}
+		kernels.hashes = (uint8_t(*)[SHA1_DIGEST_LEN])malloc(slots * SHA1_DIGEST_LEN);
+		kernels.used = (bool*)calloc(slots, sizeof(bool));
+		if (kernels.hashes == NULL || kernels.used == NULL) {
+			error = BIOS_SCAN_ERROR_FAILED;
+			goto Cleanup;
+		}
+		kernels.mask = slots - 1;
+		ctx.kernels = &kernels;
+	}
+
+	if (bios_scan_run(&ctx, scan->unique, bios_scan_load_range, threads) != 0) {
+		error = BIOS_SCAN_ERROR_FAILED;
+		goto Cleanup;
+	}
+	scan->bytes = ctx.bytes.load();
+
+	if (params->sketch) {
+		bios_scan_share_kernels(scan);
+	}
+
+	// a duplicate reports the results of its first copy.
+	for (i = 0; i < scan->count; ++i) {
+		result = &scan->results[i];
+		if (result->duplicate_of != BIOS_SCAN_NO_DUPLICATE) {
+			BIOS_SCAN_RESULT copy = scan->results[result->duplicate_of];
+			copy.filename = result->filename;
+			copy.duplicate_of = result->duplicate_of;
+			*result = copy;
+		}
+		else if (result->status == BIOS_LOAD_STATUS_SUCCESS) {
+			scan->loaded++;
+		}
+	}
+
+Cleanup:
+	free(unique);
+	if (kernels.hashes != NULL)
+		free(kernels.hashes);
+	if (kernels.used != NULL)
+		free(kernels.used);
+	return error;
+}
+
+int bios_scan_report(const BIOS_SCAN* scan, const int format, const IDENT_DB* ident, char** text, uint32_t* size) {
+	BIOS_SCAN_TEXT report;
+
+	report.data = NULL;
+	report.size = 0;
+	report.capacity = 0;
+	report.failed = false;
+
+	if (format == BIOS_SCAN_FORMAT_JSON)
+		report_json(&report, scan, ident);
+	else
+		report_csv(&report, scan);
+
+	if (report.failed || report.data == NULL) {
+		if (report.data != NULL)
+			free(report.data);
+		return BIOS_SCAN_ERROR_FAILED;
+	}
+
+	*text = report.data;
+	*size = report.size;
+	return BIOS_SCAN_ERROR_SUCCESS;
+}
+
+int bios_scan_index(const BIOS_SCAN* scan, const char* filename) {
+	const char** names;
+	const BIOS_SKETCH** sketches;
+	uint32_t count = 0;
+	uint32_t i;
+	int error = BIOS_SCAN_ERROR_FAILED;
+
+	names = (const char**)malloc((scan->count + 1) * sizeof(const char*));
+	sketches = (const BIOS_SKETCH**)malloc((scan->count + 1) * sizeof(const BIOS_SKETCH*));
+	if (names == NULL || sketches == NULL)
+		goto Cleanup;
+
+	for (i = 0; i < scan->count; ++i) {
+		if (scan->results[i].sketch == NULL)
+			continue;
+		names[count] = scan->results[i].filename;
+		sketches[count] = scan->results[i].sketch;
+		count++;
+	}
+
+	if (bios_sketch_index_write(filename, names, sketches, count) == BIOS_SKETCH_ERROR_SUCCESS)
+		error = BIOS_SCAN_ERROR_SUCCESS;
+
+Cleanup:
+	if (names != NULL)
+		free(names);
+	if (sketches != NULL)
+		free(sketches);
+	return error;
+}
+
+static int bios_scan_add(const char* filename, void* context) {
+	// add the files of a valid BIOS size to the scan.
+
+	BIOS_SCAN* scan = (BIOS_SCAN*)context;
+	BIOS_SCAN_RESULT* results;
+	BIOS_SCAN_RESULT* result;
+	uint64_t size;
+	uint32_t capacity;
+
+	if (getFileStat(filename, &size, NULL) != 0 || size > MAX_BIOS_SIZE || bios_check_size((uint32_t)size) != 0)
+		return 0;
+
+	if (scan->count == scan->capacity) {
+		capacity = (scan->capacity == 0) ? 64 : scan->capacity * 2;
+		results = (BIOS_SCAN_RESULT*)realloc(scan->results, capacity * sizeof(BIOS_SCAN_RESULT));
+		if (results == NULL)
+			return 1;
+		scan->results = results;
+		scan->capacity = capacity;
+	}
+
+	result = &scan->results[scan->count];
+	memset(result, 0, sizeof(BIOS_SCAN_RESULT));
+	result->filename = (char*)malloc(strlen(filename) + 1);
+	if (result->filename == NULL)
+		return 1;
+	strcpy(result->filename, filename);
+	result->size = (uint32_t)size;
+	result->duplicate_of = BIOS_SCAN_NO_DUPLICATE;
+	result->status = BIOS_LOAD_STATUS_FAILED;
+	result->preldr_status = PRELDR_STATUS_ERROR;
+	result->bldr_key = "none";
+	result->kernel_key = "";
+	result->boot[0] = BIOS_SCAN_BOOT_NOT_RUN;
+	result->boot[1] = BIOS_SCAN_BOOT_NOT_RUN;
+
+	scan->count++;
+	return 0;
+}
+
+static int bios_scan_dedup(BIOS_SCAN* scan, int threads) {
+	// mark duplicates. only files that share a size are read and hashed;
+	// files with equal hashes are compared before one is marked a duplicate of the other.
+
+	BIOS_SCAN_CONTEXT ctx;
+	BIOS_SCAN_KEY* keys = NULL;
+	uint32_t* hashed = NULL;
+	uint32_t hashed_count = 0;
+	uint32_t i, j, k;
+	int error = BIOS_SCAN_ERROR_SUCCESS;
+
+	keys = (BIOS_SCAN_KEY*)malloc(scan->count * sizeof(BIOS_SCAN_KEY));
+	hashed = (uint32_t*)malloc(scan->count * sizeof(uint32_t));
+	if (keys == NULL || hashed == NULL) {
+		error = BIOS_SCAN_ERROR_FAILED;
+		goto Cleanup;
+	}
+
+	for (i = 0; i < scan->count; ++i) {
+		keys[i].hash = 0;
+		keys[i].size = scan->results[i].size;
+		keys[i].index = i;
+	}
+	qsort(keys, scan->count, sizeof(BIOS_SCAN_KEY), compare_key);
+
+	for (i = 0; i < scan->count; i = j) {
+		for (j = i + 1; j < scan->count && keys[j].size == keys[i].size; ++j) {}
+		if (j - i > 1) {
+			for (k = i; k < j; ++k)
+				hashed[hashed_count++] = k;
+		}
+	}
+
+	if (hashed_count == 0)
+		goto Cleanup;
+
+	ctx.scan = scan;
+	ctx.params = NULL;
+	ctx.keys = keys;
+	ctx.items = hashed;
+	ctx.bytes = 0;
+
+	if (bios_scan_run(&ctx, hashed_count, bios_scan_hash_range, threads) != 0) {
+		error = BIOS_SCAN_ERROR_FAILED;
+		goto Cleanup;
+	}
+
+	qsort(keys, scan->count, sizeof(BIOS_SCAN_KEY), compare_key);
+
+	// the first file of a run of equal keys is the copy that gets loaded.
+	for (i = 0; i < scan->count; i = j) {
+		for (j = i + 1; j < scan->count && keys[j].size == keys[i].size && keys[j].hash == keys[i].hash; ++j) {}
+		for (k = i + 1; k < j; ++k) {
+			if (bios_scan_files_equal(scan->results[keys[i].index].filename, scan->results[keys[k].index].filename))
+				scan->results[keys[k].index].duplicate_of = keys[i].index;
+		}
+	}
+
+Cleanup:
+	if (keys != NULL)
+		free(keys);
+	if (hashed != NULL)
+		free(hashed);
+	return error;
+}
+
+static int bios_scan_run(BIOS_SCAN_CONTEXT* ctx, const uint32_t count, WORK_FUNC func, int threads) {
+	// one file per work item.
+
+	WorkPool pool;
+	WORK_RANGE range;
+
+	if (count == 0)
+		return 0;
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0 || (uint32_t)threads > count)
+		threads = count;
+
+	range.begin = 0;
+	range.end = count;
+	if (pool.start(&range, 1, 1, threads, func, ctx) != 0)
+		return 1;
+
+	while (!pool.wait(1000)) {}
+	pool.stop();
+
+	return 0;
+}
+
+static void bios_scan_hash_range(uint64_t begin, uint64_t end, void* context) {
+	BIOS_SCAN_CONTEXT* ctx = (BIOS_SCAN_CONTEXT*)context;
+	BIOS_SCAN_KEY* key;
+	MAPPED_FILE map;
+
+	for (; begin < end; ++begin) {
+		key = &ctx->keys[ctx->items[begin]];
+		if (mapFile(ctx->scan->results[key->index].filename, &map) != 0)
+			continue;
+		key->hash = bios_page_hash(map.data, map.size);
+		unmapFile(&map);
+	}
+}
+
+static void bios_scan_load_range(uint64_t begin, uint64_t end, void* context) {
+	BIOS_SCAN_CONTEXT* ctx = (BIOS_SCAN_CONTEXT*)context;
+	BIOS_SCAN_RESULT* result;
+
+	for (; begin < end; ++begin) {
+		result = &ctx->scan->results[ctx->items[begin]];
+		bios_scan_load(result, ctx);
+		ctx->bytes += result->size;
+	}
+}
+
+static void bios_scan_load(BIOS_SCAN_RESULT* result, BIOS_SCAN_CONTEXT* ctx) {
+	// load one image and fill in its result; the same steps as /ls, on a private copy of the load params.
+
+	const BIOS_SCAN_PARAMS* params = ctx->params;
+	BIOS_LOAD_PARAMS load = *params->params;
+	KEYRING_MATCH match;
+	MCPX keyring_mcpx;
+	MAPPED_FILE map;
+	BOOT_SIM_RESULT sim;
+	MCPX_REV rev;
+	Bios bios;
+	int i;
+
+	if (mapFile(result->filename, &map) != 0)
+		return;
+	result->size = map.size;
+
+	if (bios_detect_banks(map.data, map.size, &result->banks) != 0) {
+		unmapFile(&map);
+		return;
+	}
+	if (load.romsize == 0) {
+		load.romsize = result->banks.romsize;
+	}
+	result->romsize = load.romsize;
+
+	// the keys given on the command line, unless the keyring has a better one.
+	if (load.enc_bldr)
+		result->bldr_key = "none";
+	else if (load.bldr_key != NULL)
+		result->bldr_key = "key-bldr";
+	else if (load.mcpx != NULL && load.mcpx->sbkey != NULL)
+		result->bldr_key = "mcpx";
+	else
+		result->bldr_key = "none";
+
+	if (load.enc_kernel)
+		result->kernel_key = "none";
+	else if (load.kernel_key != NULL)
+		result->kernel_key = "key-krnl";
+	else
+		result->kernel_key = "2BL";
+
+	if (params->keyring != NULL && keyring_find_keys(params->keyring, map.data, map.size, &load, &keyring_mcpx, &match) == KEYRING_ERROR_SUCCESS) {
+		result->bldr_key = (match.bldr_key == KEYRING_KEY_NONE) ? "none" : params->keyring->keys[match.bldr_key].name;
+
+		switch (match.kernel_key) {
+			case KEYRING_KEY_NONE:
+				result->kernel_key = "none";
+				break;
+			case KEYRING_KEY_BLDR:
+				result->kernel_key = "2BL";
+				break;
+			case KEYRING_NO_MATCH:
+				result->kernel_key = "";
+				break;
+			default:
+				result->kernel_key = params->keyring->keys[match.kernel_key].name;
+				break;
+		}
+	}
+
+	// the bios takes the mapping.
+	result->status = bios.load(&map, &load);
+	if (result->status != BIOS_LOAD_STATUS_SUCCESS)
+		return;
+
+	// the simulator boots a copy of the image as it is on the flash; run it before anything is decrypted.
+	rev = (load.mcpx != NULL) ? load.mcpx->rev : MCPX_REV_UNK;
+	for (i = 0; i < 2; ++i) {
+		if (rev != MCPX_REV_UNK && rev != boot_revs[i])
+			continue;
+		if (boot_simulate(bios.data, bios.size, &bios.params, boot_revs[i], &sim) != BOOT_SIM_ERROR_FAILED)
+			result->boot[i] = sim.step;
+	}
+
+	result->status = bios.loadBldr();
+	result->preldr_status = bios.preldr.status;
+
+	if (bios.init_tbl != NULL) {
+		result->kernel_ver = bios.init_tbl->kernel_ver & 0x7FFF;
+		result->kernel_delay = (bios.init_tbl->kernel_ver & 0x8000) != 0;
+	}
+
+	if (result->status != BIOS_LOAD_STATUS_SUCCESS)
+		return;
+
+	result->boot_params = *bios.bldr.boot_params;
+
+	if (ctx->kernels != NULL) {
+		if (bios_scan_sketch(result, &bios, ctx->kernels) == 0)
+			return;
+		// the report still gets the component hashes.
+		log_warn("could not sketch %s; it is not indexed\n", result->filename);
+	}
+
+	for (i = IDENT_TYPE_PRELDR; i < IDENT_TYPE_COUNT; ++i) {
+		if (bios.hashComponent((IDENT_TYPE)i, result->hash[i]) == 0)
+			result->hashes |= (1U << i);
+	}
+}
+
+static int bios_scan_sketch(BIOS_SCAN_RESULT* result, Bios* bios, BIOS_SCAN_KERNELS* kernels) {
+	// sketch the image; the sketch hashes the components too. the kernel is only decompressed if it is new.
+	// returns 0 if successful, 1 otherwise.
+
+	const int slot = BIOS_SKETCH_SLOT(IDENT_TYPE_KERNEL);
+	BIOS_SKETCH* sketch;
+	int i;
+
+	sketch = (BIOS_SKETCH*)malloc(sizeof(BIOS_SKETCH));
+	if (sketch == NULL)
+		return 1;
+
+	if (bios_sketch_bios(bios, sketch) != BIOS_SKETCH_ERROR_SUCCESS) {
+		free(sketch);
+		return 1;
+	}
+
+	if ((sketch->hashes & (1U << IDENT_TYPE_KERNEL)) && bios_scan_claim_kernel(kernels, sketch->hash[slot])) {
+		bios_sketch_kernel(bios, sketch);
+	}
+
+	for (i = IDENT_TYPE_PRELDR; i < IDENT_TYPE_COUNT; ++i) {
+		memcpy(result->hash[i], sketch->hash[BIOS_SKETCH_SLOT(i)], SHA1_DIGEST_LEN);
+	}
+	result->hashes = sketch->hashes;
+	result->sketch = sketch;
+	return 0;
+}
+
+static bool bios_scan_claim_kernel(BIOS_SCAN_KERNELS* kernels, const uint8_t* hash) {
+	// returns true if the kernel was not claimed before.
+
+	std::lock_guard<std::mutex> guard(kernels->lock);
+	uint32_t index;
+
+	memcpy(&index, hash, sizeof(uint32_t));
+	for (index &= kernels->mask; kernels->used[index]; index = (index + 1) & kernels->mask) {
+		if (memcmp(kernels->hashes[index], hash, SHA1_DIGEST_LEN) == 0)
+			return false;
+	}
+
+	memcpy(kernels->hashes[index], hash, SHA1_DIGEST_LEN);
+	kernels->used[index] = true;
+	return true;
+}
+
+static void bios_scan_share_kernels(BIOS_SCAN* scan) {
+	// copy the kernel sketch of the image that decompressed each kernel to the images with the same kernel.
+
+	const uint32_t bit = 1U << IDENT_TYPE_KERNEL;
+	const int slot = BIOS_SKETCH_SLOT(IDENT_TYPE_KERNEL);
+	BIOS_SKETCH** sketches;
+	BIOS_SKETCH* owner;
+	uint32_t count = 0;
+	uint32_t i, j, k;
+
+	sketches = (BIOS_SKETCH**)malloc(scan->count * sizeof(BIOS_SKETCH*));
+	if (sketches == NULL)
+		return;
+
+	for (i = 0; i < scan->count; ++i) {
+		if (scan->results[i].sketch != NULL && (scan->results[i].sketch->hashes & bit))
+			sketches[count++] = scan->results[i].sketch;
+	}
+	qsort(sketches, count, sizeof(BIOS_SKETCH*), compare_kernel);
+
+	for (i = 0; i < count; i = j) {
+		owner = NULL;
+		for (j = i; j < count && memcmp(sketches[j]->hash[slot], sketches[i]->hash[slot], SHA1_DIGEST_LEN) == 0; ++j) {
+			if (sketches[j]->sketches & bit)
+				owner = sketches[j];
+		}
+		if (owner == NULL)
+			continue;
+		for (k = i; k < j; ++k) {
+			if (sketches[k] != owner) {
+				memcpy(sketches[k]->mins[slot], owner->mins[slot], sizeof(owner->mins[slot]));
+				sketches[k]->sketches |= bit;
+			}
+		}
+	}
+
+	free(sketches);
+}
+
+static bool bios_scan_files_equal(const char* a, const char* b) {
+	MAPPED_FILE map_a;
+	MAPPED_FILE map_b;
+	bool equal = false;
+
+	if (mapFile(a, &map_a) != 0)
+		return false;
+	if (mapFile(b, &map_b) == 0) {
+		equal = (map_a.size == map_b.size && memcmp(map_a.data, map_b.data, map_a.size) == 0);
+		unmapFile(&map_b);
+	}
+	unmapFile(&map_a);
+
+	return equal;
+}
+
+static int compare_key(const void* a, const void* b) {
+	const BIOS_SCAN_KEY* x = (const BIOS_SCAN_KEY*)a;
+	const BIOS_SCAN_KEY* y = (const BIOS_SCAN_KEY*)b;
+
+	if (x->size != y->size)
+		return (x->size < y->size) ? -1 : 1;
+	if (x->hash != y->hash)
+		return (x->hash < y->hash) ? -1 : 1;
+	if (x->index != y->index)
+		return (x->index < y->index) ? -1 : 1;
+	return 0;
+}
+
+static int compare_kernel(const void* a, const void* b) {
+	const BIOS_SKETCH* x = *(const BIOS_SKETCH* const*)a;
+	const BIOS_SKETCH* y = *(const BIOS_SKETCH* const*)b;
+	const int slot = BIOS_SKETCH_SLOT(IDENT_TYPE_KERNEL);
+
+	return memcmp(x->hash[slot], y->hash[slot], SHA1_DIGEST_LEN);
+}
+static const char* status_name(const int status) {
+	switch (status) {
+		case BIOS_LOAD_STATUS_SUCCESS:
+			return "ok";
+		case BIOS_LOAD_STATUS_INVALID_BLDR:
+			return "invalid 2BL";
+		default:
+			return "failed";
+	}
+}
+static const char* preldr_status_name(const int status) {
+	switch (status) {
+		case PRELDR_STATUS_BLDR_DECRYPTED:
+			return "decrypted 2BL";
+		case PRELDR_STATUS_FOUND:
+			return "found";
+		case PRELDR_STATUS_NOT_FOUND:
+			return "not found";
+		default:
+			return "error";
+	}
+}
+
+static void text_printf(BIOS_SCAN_TEXT* text, const char* format, ...) {
+	va_list args;
+	uint32_t capacity;
+	char* data;
+	int len;
+
+	if (text->failed)
+		return;
+
+	va_start(args, format);
+	len = vsnprintf(NULL, 0, format, args);
+	va_end(args);
+	if (len < 0) {
+		text->failed = true;
+		return;
+	}
+
+	if (text->size + len + 1 > text->capacity) {
+		capacity = (text->capacity == 0) ? 0x10000 : text->capacity;
+		while (text->size + len + 1 > capacity)
+			capacity *= 2;
+		data = (char*)realloc(text->data, capacity);
+		if (data == NULL) {
+			text->failed = true;
+			return;
+		}
+		text->data = data;
+		text->capacity = capacity;
+	}
+
+	va_start(args, format);
+	vsnprintf(text->data + text->size, len + 1, format, args);
+	va_end(args);
+	text->size += len;
+}
+static void text_string(BIOS_SCAN_TEXT* text, const char* str, const int format) {
+	// a quoted string. csv doubles quotes; json escapes quotes, backslashes and control characters.
+
+	text_printf(text, "\"");
+	for (; *str != '\0'; ++str) {
+		if (*str == '"')
+			text_printf(text, (format == BIOS_SCAN_FORMAT_JSON) ? "\\\"" : "\"\"");
+		else if (format == BIOS_SCAN_FORMAT_JSON && *str == '\\')
+			text_printf(text, "\\\\");
+		else if (format == BIOS_SCAN_FORMAT_JSON && (uint8_t)*str < 0x20)
+			text_printf(text, "\\u%04x", (uint8_t)*str);
+		else
+			text_printf(text, "%c", *str);
+	}
+	text_printf(text, "\"");
+}
+static void text_hash(BIOS_SCAN_TEXT* text, const uint8_t* hash) {
+	for (int i = 0; i < SHA1_DIGEST_LEN; ++i)
+		text_printf(text, "%02x", hash[i]);
+}
+
+static void report_csv(BIOS_SCAN_TEXT* text, const BIOS_SCAN* scan) {
+	const BIOS_SCAN_RESULT* result;
+	uint32_t i;
+	int j;
+
+	text_printf(text, "file,size,duplicate_of,status,romsize,banks,unique_banks,preldr,bldr_key,krnl_key,"
+		"inittbl_size,krnl_size,krnldata_size,krnl_ver,krnl_delay");
+	for (j = IDENT_TYPE_PRELDR; j < IDENT_TYPE_COUNT; ++j)
+		text_printf(text, ",%s_sha1", ident_type_name((IDENT_TYPE)j));
+	for (j = 0; j < 2; ++j)
+		text_printf(text, ",boot_%s", boot_rev_names[j]);
+	text_printf(text, "\n");
+
+	for (i = 0; i < scan->count; ++i) {
+		result = &scan->results[i];
+
+		text_string(text, result->filename, BIOS_SCAN_FORMAT_CSV);
+		text_printf(text, ",%u,", result->size);
+		if (result->duplicate_of != BIOS_SCAN_NO_DUPLICATE)
+			text_string(text, scan->results[result->duplicate_of].filename, BIOS_SCAN_FORMAT_CSV);
+		text_printf(text, ",%s,%u,%u,%u,%s,", status_name(result->status), result->romsize / 1024,
+			result->banks.banks, result->banks.unique_banks, preldr_status_name(result->preldr_status));
+		text_string(text, result->bldr_key, BIOS_SCAN_FORMAT_CSV);
+		text_printf(text, ",");
+		text_string(text, result->kernel_key, BIOS_SCAN_FORMAT_CSV);
+
+		if (result->status == BIOS_LOAD_STATUS_SUCCESS) {
+			text_printf(text, ",%u,%u,%u", result->boot_params.init_tbl_size, result->boot_params.compressed_kernel_size,
+				result->boot_params.uncompressed_kernel_data_size);
+		}
+		else {
+			text_printf(text, ",,,");
+		}
+		text_printf(text, ",%u,%u", result->kernel_ver, result->kernel_delay ? 1 : 0);
+
+		for (j = IDENT_TYPE_PRELDR; j < IDENT_TYPE_COUNT; ++j) {
+			text_printf(text, ",");
+			if (result->hashes & (1U << j))
+				text_hash(text, result->hash[j]);
+		}
+		for (j = 0; j < 2; ++j) {
+			text_printf(text, ",");
+			if (result->boot[j] == BOOT_STEP_COUNT)
+				text_printf(text, "boots");
+			else if (result->boot[j] != BIOS_SCAN_BOOT_NOT_RUN)
+				text_string(text, boot_step_name((BOOT_STEP)result->boot[j]), BIOS_SCAN_FORMAT_CSV);
+		}
+		text_printf(text, "\n");
+	}
+}
+
+static void report_json(BIOS_SCAN_TEXT* text, const BIOS_SCAN* scan, const IDENT_DB* ident) {
+	const BIOS_SCAN_RESULT* result;
+	IDENT_ENTRY entry;
+	bool first;
+	uint32_t i;
+	int j;
+
+	text_printf(text, "{\n \"files\": %u,\n \"unique\": %u,\n \"loaded\": %u,\n \"results\": [", scan->count, scan->unique, scan->loaded);
+
+	for (i = 0; i < scan->count; ++i) {
+		result = &scan->results[i];
+
+		text_printf(text, "%s\n  {\n   \"file\": ", (i == 0) ? "" : ",");
+		text_string(text, result->filename, BIOS_SCAN_FORMAT_JSON);
+		text_printf(text, ",\n   \"size\": %u,\n   \"duplicate_of\": ", result->size);
+		if (result->duplicate_of != BIOS_SCAN_NO_DUPLICATE)
+			text_string(text, scan->results[result->duplicate_of].filename, BIOS_SCAN_FORMAT_JSON);
+		else
+			text_printf(text, "null");
+
+		text_printf(text, ",\n   \"status\": \"%s\",\n   \"romsize\": %u,\n   \"banks\": %u,\n   \"unique_banks\": %u,\n   \"preldr\": \"%s\",\n   \"bldr_key\": ",
+			status_name(result->status), result->romsize / 1024, result->banks.banks, result->banks.unique_banks, preldr_status_name(result->preldr_status));
+		text_string(text, result->bldr_key, BIOS_SCAN_FORMAT_JSON);
+		text_printf(text, ",\n   \"krnl_key\": ");
+		text_string(text, result->kernel_key, BIOS_SCAN_FORMAT_JSON);
+
+		if (result->status == BIOS_LOAD_STATUS_SUCCESS) {
+			text_printf(text, ",\n   \"boot_params\": { \"inittbl_size\": %u, \"krnl_size\": %u, \"krnldata_size\": %u }",
+				result->boot_params.init_tbl_size, result->boot_params.compressed_kernel_size, result->boot_params.uncompressed_kernel_data_size);
+		}
+		else {
+			text_printf(text, ",\n   \"boot_params\": null");
+		}
+		text_printf(text, ",\n   \"krnl_ver\": %u,\n   \"krnl_delay\": %s,\n   \"components\": {", result->kernel_ver, result->kernel_delay ? "true" : "false");
+
+		first = true;
+		for (j = IDENT_TYPE_PRELDR; j < IDENT_TYPE_COUNT; ++j) {
+			if ((result->hashes & (1U << j)) == 0)
+				continue;
+			text_printf(text, "%s\n    \"%s\": { \"sha1\": \"", first ? "" : ",", ident_type_name((IDENT_TYPE)j));
+			text_hash(text, result->hash[j]);
+			text_printf(text, "\"");
+			if (ident != NULL && ident_db_find(ident, (IDENT_TYPE)j, result->hash[j], &entry) == IDENT_DB_ERROR_SUCCESS) {
+				text_printf(text, ", \"name\": ");
+				text_string(text, entry.name, BIOS_SCAN_FORMAT_JSON);
+				text_printf(text, ", \"version\": ");
+				text_string(text, entry.version, BIOS_SCAN_FORMAT_JSON);
+			}
+			text_printf(text, " }");
+			first = false;
+		}
+		text_printf(text, "%s},\n   \"boot\": {", first ? "" : "\n   ");
+
+		for (j = 0; j < 2; ++j) {
+			text_printf(text, "%s \"%s\": ", (j == 0) ? "" : ",", boot_rev_names[j]);
+			if (result->boot[j] == BIOS_SCAN_BOOT_NOT_RUN)
+				text_printf(text, "null");
+			else if (result->boot[j] == BOOT_STEP_COUNT)
+				text_printf(text, "\"boots\"");
+			else
+				text_string(text, boot_step_name((BOOT_STEP)result->boot[j]), BIOS_SCAN_FORMAT_JSON);
+		}
+		text_printf(text, " }\n  }");
+	}
+
+	text_printf(text, "\n ]\n}\n");
+}
@@ -0,0 +1,338 @@
+// bios_sketch.cpp: Implements MinHash sketches of BIOS components and a similarity index.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "bios_sketch.h"
+#include "Bios.h"
+#include "file.h"
+#include "sha1.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define BIOS_SKETCH_BITS 6 // log2(BIOS_SKETCH_SIZE)
+#define BIOS_SKETCH_CHANGED (1.0f - 0.5f / BIOS_SKETCH_SIZE) // the most a changed component scores
+
+static_assert((1 << BIOS_SKETCH_BITS) == BIOS_SKETCH_SIZE, "BIOS_SKETCH_BITS does not match BIOS_SKETCH_SIZE");
+
+static uint64_t shingle_hash(uint64_t x);
+static float bucket_similarity(const uint16_t* a, const uint16_t* b);
+static int index_open(BIOS_SKETCH_INDEX* index);
+
+void bios_sketch_init(BIOS_SKETCH* sketch) {
+	memset(sketch, 0, sizeof(BIOS_SKETCH));
+	memset(sketch->mins, 0xFF, sizeof(sketch->mins));
+}
+
+void bios_sketch_component(BIOS_SKETCH* sketch, const IDENT_TYPE type, const uint8_t* data, const uint32_t size) {
+	// one permutation min hash; the top bits of a shingle hash pick its bucket, the low bits are the value.
+
+	uint32_t mins[BIOS_SKETCH_SIZE];
+	uint16_t* out;
+	uint64_t shingle;
+	uint64_t hash;
+	uint32_t bucket;
+	uint32_t i;
+
+	if (type < IDENT_TYPE_PRELDR || type >= IDENT_TYPE_COUNT || data == NULL || size < BIOS_SKETCH_SHINGLE)
+		return;
+
+	for (i = 0; i < BIOS_SKETCH_SIZE; ++i)
+		mins[i] = 0xFFFFFFFF;
+
+	for (i = 0; i <= size - BIOS_SKETCH_SHINGLE; ++i) {
+		memcpy(&shingle, data + i, sizeof(uint64_t));
+		hash = shingle_hash(shingle);
+		bucket = (uint32_t)(hash >> (64 - BIOS_SKETCH_BITS));
+		if ((uint32_t)hash < mins[bucket])
+			mins[bucket] = (uint32_t)hash;
+	}
+
+	out = sketch->mins[BIOS_SKETCH_SLOT(type)];
+	for (i = 0; i < BIOS_SKETCH_SIZE; ++i) {
+		if (mins[i] == 0xFFFFFFFF) {
+			out[i] = BIOS_SKETCH_EMPTY;
+		}
+		else {
+			out[i] = (uint16_t)mins[i];
+			if (out[i] == BIOS_SKETCH_EMPTY)
+				out[i]--;
+		}
+	}
+
+	sketch->sketches |= (1U << type);
+}
+
+int bios_sketch_bios(Bios* bios, BIOS_SKETCH* sketch) {
+	const uint8_t* component;
+	uint32_t size;
+	SHA1Context context;
+	int type;
+
+	bios_sketch_init(sketch);
+
+	if (bios->loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_SKETCH_ERROR_FAILED;
+
+	for (type = IDENT_TYPE_PRELDR; type < IDENT_TYPE_COUNT; ++type) {
+		if (bios->getComponent((IDENT_TYPE)type, &component, &size) != 0)
+			continue;
+
+		SHA1Reset(&context);
+		SHA1Input(&context, component, size);
+		SHA1Result(&context, sketch->hash[BIOS_SKETCH_SLOT(type)]);
+		sketch->hashes |= (1U << type);
+
+		if (type != IDENT_TYPE_KERNEL)
+			bios_sketch_component(sketch, (IDENT_TYPE)type, component, size);
+	}
+
+	return BIOS_SKETCH_ERROR_SUCCESS;
+}
+
+int bios_sketch_kernel(Bios* bios, BIOS_SKETCH* sketch) {
+	if (bios->decompressKrnl() != 0 || bios->kernel.img == NULL)
+		return BIOS_SKETCH_ERROR_FAILED;
+
+	bios_sketch_component(sketch, IDENT_TYPE_KERNEL, bios->kernel.img, bios->kernel.img_size);
+	return BIOS_SKETCH_ERROR_SUCCESS;
+}
+
+float bios_sketch_compare(const BIOS_SKETCH* a, const BIOS_SKETCH* b, float* similarity) {
+	float total = 0;
+	float s;
+	uint32_t count = 0;
+	uint32_t bit;
+	int slot;
+
+	for (slot = 0; slot < BIOS_SKETCH_COMPONENTS; ++slot) {
+		bit = 1U << (slot + IDENT_TYPE_PRELDR);
+
+		if ((a->hashes & b->hashes & bit) && memcmp(a->hash[slot], b->hash[slot], SHA1_DIGEST_LEN) == 0)
+			s = 1.0f;
+		else if (a->sketches & b->sketches & bit) {
+			s = bucket_similarity(a->mins[slot], b->mins[slot]);
+			// a small change can leave every bucket the same; rank it below an exact match.
+			if (s > BIOS_SKETCH_CHANGED)
+				s = BIOS_SKETCH_CHANGED;
+		}
+		else if ((a->hashes | a->sketches | b->hashes | b->sketches) & bit)
+			s = 0.0f;
+		else
+			s = -1.0f;
+
+		if (similarity != NULL)
+			similarity[slot] = s;
+
+		if (s >= 0) {
+			total += s;
+			count++;
+		}
+	}
+
+	return (count != 0) ? total / count : 0.0f;
+}
+
+int bios_sketch_index_write(const char* filename, const char* const* names, const BIOS_SKETCH* const* sketches, const uint32_t count) {
+	BIOS_SKETCH_HEADER* header;
+	BIOS_SKETCH_ENTRY* entries;
+	char* strings;
+	uint8_t* image;
+	uint64_t image_size;
+	uint32_t strings_size = 1;
+	uint32_t offset;
+	uint32_t len;
+	uint32_t i;
+	int result;
+
+	for (i = 0; i < count; ++i) {
+		strings_size += (uint32_t)strlen(names[i]) + 1;
+	}
+
+	image_size = sizeof(BIOS_SKETCH_HEADER) + (uint64_t)count * sizeof(BIOS_SKETCH_ENTRY) + strings_size;
+	if (image_size > 0xFFFFFFFF) {
+		log_error("Sketch index is too big\n");
+		return BIOS_SKETCH_ERROR_FAILED;
+	}
+
+	image = (uint8_t*)malloc((size_t)image_size);
+	if (image == NULL)
+		return BIOS_SKETCH_ERROR_FAILED;
+
+	header = (BIOS_SKETCH_HEADER*)image;
+	entries = (BIOS_SKETCH_ENTRY*)(image + sizeof(BIOS_SKETCH_HEADER));
+	strings = (char*)(entries + count);
+
+	header->magic = BIOS_SKETCH_MAGIC;
+	header->version = BIOS_SKETCH_VERSION;
+	header->sketch_size = BIOS_SKETCH_SIZE;
+	header->count = count;
+	header->strings_size = strings_size;
+
+	// offset 0 is the empty string.
+	strings[0] = '\0';
+	offset = 1;
+	for (i = 0; i < count; ++i) {
+		len = (uint32_t)strlen(names[i]) + 1;
+		memcpy(strings + offset, names[i], len);
+		entries[i].name = offset;
+		entries[i].sketch = *sketches[i];
+		offset += len;
+	}
+
+	result = (writeFile(filename, image, (uint32_t)image_size) == 0) ? BIOS_SKETCH_ERROR_SUCCESS : BIOS_SKETCH_ERROR_FAILED;
+	free(image);
+	return result;
+}
+
+int bios_sketch_index_open(BIOS_SKETCH_INDEX* index, const char* filename) {
+	memset(index, 0, sizeof(BIOS_SKETCH_INDEX));
+
+	if (mapFile(filename, &index->map) != 0)
+		return BIOS_SKETCH_ERROR_FAILED;
+
+	if (index_open(index) != BIOS_SKETCH_ERROR_SUCCESS) {
+		log_error("'%s' is not a valid sketch index\n", filename);
+		unmapFile(&index->map);
+		memset(index, 0, sizeof(BIOS_SKETCH_INDEX));
+		return BIOS_SKETCH_ERROR_INVALID;
+	}
+
+	return BIOS_SKETCH_ERROR_SUCCESS;
+}
+void bios_sketch_index_close(BIOS_SKETCH_INDEX* index) {
+	if (index->map.data != NULL)
+		unmapFile(&index->map);
+	memset(index, 0, sizeof(BIOS_SKETCH_INDEX));
+}
+
+bool bios_sketch_index_kernel(const BIOS_SKETCH_INDEX* index, BIOS_SKETCH* sketch) {
+	const uint32_t bit = 1U << IDENT_TYPE_KERNEL;
+	const int slot = BIOS_SKETCH_SLOT(IDENT_TYPE_KERNEL);
+	const BIOS_SKETCH* entry;
+	uint32_t i;
+
+	if ((sketch->hashes & bit) == 0)
+		return false;
+
+	for (i = 0; i < index->header->count; ++i) {
+		entry = &index->entries[i].sketch;
+		if ((entry->hashes & entry->sketches & bit) && memcmp(entry->hash[slot], sketch->hash[slot], SHA1_DIGEST_LEN) == 0) {
+			memcpy(sketch->mins[slot], entry->mins[slot], sizeof(sketch->mins[slot]));
+			sketch->sketches |= bit;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void bios_sketch_index_query(const BIOS_SKETCH_INDEX* index, const BIOS_SKETCH* query, BIOS_SKETCH_MATCH* matches, uint32_t* count) {
+	// keep the best count entries in order; a better entry is inserted and the worst falls off.
+
+	BIOS_SKETCH_MATCH match;
+	uint32_t found = 0;
+	uint32_t i, j;
+
+	if (*count == 0)
+		return;
+
+	for (i = 0; i < index->header->count; ++i) {
+		match.entry = i;
+		match.score = bios_sketch_compare(query, &index->entries[i].sketch, match.similarity);
+
+		if (found == *count && match.score <= matches[found - 1].score)
+			continue;
+
+		j = (found < *count) ? found++ : found - 1;
+		for (; j > 0 && matches[j - 1].score < match.score; --j) {
+			matches[j] = matches[j - 1];
+		}
+		matches[j] = match;
+	}
+
+	*count = found;
+}
+
+const char* bios_sketch_index_name(const BIOS_SKETCH_INDEX* index, const uint32_t entry) {
+	const uint32_t name = index->entries[entry].name;
+	return index->strings + ((name < index->header->strings_size) ? name : 0);
+}
+
+static uint64_t shingle_hash(uint64_t x) {
+	// splitmix64 finalizer; every input bit reaches the bucket bits.
+	x ^= x >> 30;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 27;
+	x *= 0x94D049BB133111EBULL;
+	x ^= x >> 31;
+	return x;
+}
+static float bucket_similarity(const uint16_t* a, const uint16_t* b) {
+	// buckets empty in both sketches are not counted.
+
+	uint32_t equal = 0;
+	uint32_t used = 0;
+
+	for (int i = 0; i < BIOS_SKETCH_SIZE; ++i) {
+		if (a[i] == BIOS_SKETCH_EMPTY && b[i] == BIOS_SKETCH_EMPTY)
+			continue;
+		used++;
+		if (a[i] == b[i])
+			equal++;
+	}
+
+	return (used != 0) ? (float)equal / used : 0.0f;
+}
+static int index_open(BIOS_SKETCH_INDEX* index) {
+	// check the header and the string table; the entries are read as they are.
+
+	const BIOS_SKETCH_HEADER* header = (const BIOS_SKETCH_HEADER*)index->map.data;
+	const uint32_t size = index->map.size;
+	uint64_t expected;
+
+	if (size < sizeof(BIOS_SKETCH_HEADER) || header->magic != BIOS_SKETCH_MAGIC || header->version != BIOS_SKETCH_VERSION)
+		return BIOS_SKETCH_ERROR_INVALID;
+
+	if (header->sketch_size != BIOS_SKETCH_SIZE || header->strings_size == 0)
+		return BIOS_SKETCH_ERROR_INVALID;
+
+	expected = sizeof(BIOS_SKETCH_HEADER) + (uint64_t)header->count * sizeof(BIOS_SKETCH_ENTRY) + header->strings_size;
+	if (expected != size)
+		return BIOS_SKETCH_ERROR_INVALID;
+
+	index->header = header;
+	index->entries = (const BIOS_SKETCH_ENTRY*)(index->map.data + sizeof(BIOS_SKETCH_HEADER));
+	index->strings = (const char*)(index->entries + header->count);
+
+	// every string ends inside the table.
+	if (index->strings[0] != '\0' || index->strings[header->strings_size - 1] != '\0')
+		return BIOS_SKETCH_ERROR_INVALID;
+
+	return BIOS_SKETCH_ERROR_SUCCESS;
+}
@@ -0,0 +1,414 @@
+// bld_graph.cpp: Implements an incremental BIOS build; stages are rebuilt only when their inputs change.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// user incl
+#include "bld_graph.h"
+#include "Bios.h"
+#include "file.h"
+#include "sha1.h"
+#include "rc4.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+// file times have a 1 second resolution; a file written in the same second
+// as it was last read could change without changing its mtime.
+#define BLD_GRAPH_RACY_SECONDS 2
+
+static void bld_graph_free_node(BLD_NODE* node);
+static int bld_graph_read_input(BLD_NODE* node);
+static bool bld_graph_cached(const BLD_NODE* node, const uint8_t hash[SHA1_DIGEST_LEN]);
+static void bld_graph_set_output(BLD_NODE* node, uint8_t* data, const uint32_t size, const uint8_t hash[SHA1_DIGEST_LEN]);
+static uint8_t* bld_graph_copy_bank(const BLD_NODE* node);
+static int bld_graph_compress(BLD_GRAPH* graph);
+static int bld_graph_bldr_patch(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const BIOS_LOAD_PARAMS* params);
+static int bld_graph_rc4(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const BIOS_LOAD_PARAMS* params);
+static int bld_graph_preldr(BLD_GRAPH* graph);
+static int bld_graph_replicate(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, uint32_t binsize);
+
+void bld_graph_init(BLD_GRAPH* graph) {
+	memset(graph, 0, sizeof(BLD_GRAPH));
+}
+void bld_graph_free(BLD_GRAPH* graph) {
+	int i;
+	for (i = 0; i < BLD_NODE_COUNT; ++i) {
+		bld_graph_free_node(&graph->nodes[i]);
+	}
+}
+void bld_graph_set_input(BLD_GRAPH* graph, const BLD_NODE_ID id, const char* path) {
+	if (id >= BLD_NODE_INPUT_COUNT)
+		return;
+	bld_graph_free_node(&graph->nodes[id]);
+	graph->nodes[id].path = path;
+}
+
+int bld_graph_update(BLD_GRAPH* graph) {
+	BLD_NODE* node;
+	uint64_t size;
+	int64_t mtime;
+	int64_t now;
+	int changed = 0;
+	int i;
+
+	now = (int64_t)time(NULL);
+
+	for (i = 0; i < BLD_NODE_INPUT_COUNT; ++i) {
+		node = &graph->nodes[i];
+		node->rebuilt = false;
+
+		if (node->path == NULL)
+			continue;
+
+		if (getFileStat(node->path, &size, &mtime) != 0)
+			return -1;
+
+		// unchanged since the last read.
+		if (node->data != NULL && size == node->size && mtime == node->mtime && now - mtime >= BLD_GRAPH_RACY_SECONDS)
+			continue;
+
+		switch (bld_graph_read_input(node)) {
+			case 0:
+				break;
+			case 1:
+				node->rebuilt = true;
+				changed++;
+				break;
+			default:
+				return -1;
+		}
+		node->size = size;
+		node->mtime = mtime;
+	}
+
+	return changed;
+}
+
+int bld_graph_build(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const uint32_t binsize, const BIOS_LOAD_PARAMS* params) {
+	int i;
+	for (i = BLD_NODE_INPUT_COUNT; i < BLD_NODE_COUNT; ++i) {
+		graph->nodes[i].rebuilt = false;
+	}
+
+	// keyed by the kernel it was built from, not by the rebuilt flag; an update that failed part way
+	// can leave a new kernel that no later update flags.
+	if (graph->nodes[BLD_NODE_COMPRESS].data == NULL ||
+		memcmp(graph->nodes[BLD_NODE_COMPRESS].hash, graph->nodes[BLD_NODE_KRNL].hash, SHA1_DIGEST_LEN) != 0) {
+		if (bld_graph_compress(graph) != 0)
+			return BIOS_LOAD_STATUS_FAILED;
+	}
+
+	if (bld_graph_bldr_patch(graph, build_params, params) != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_LOAD_STATUS_FAILED;
+	if (bld_graph_rc4(graph, build_params, params) != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_LOAD_STATUS_FAILED;
+	if (bld_graph_preldr(graph) != BIOS_LOAD_STATUS_SUCCESS)
+		return BIOS_LOAD_STATUS_FAILED;
+	return bld_graph_replicate(graph, build_params, binsize);
+}
+
+static void bld_graph_free_node(BLD_NODE* node) {
+	if (node->data != NULL) {
+		free(node->data);
+		node->data = NULL;
+	}
+	node->data_size = 0;
+	node->size = 0;
+	node->mtime = 0;
+	memset(node->hash, 0, SHA1_DIGEST_LEN);
+}
+
+static int bld_graph_read_input(BLD_NODE* node) {
+	// read an input and hash it.
+	// returns 1 if the content changed, 0 if it did not, -1 on error.
+
+	SHA1Context sha;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t* data;
+	uint32_t size = 0;
+
+	data = readFile(node->path, &size, 0);
+	if (data == NULL)
+		return -1;
+
+	SHA1Reset(&sha);
+	SHA1Input(&sha, data, size);
+	SHA1Result(&sha, hash);
+
+	if (node->data != NULL && memcmp(hash, node->hash, SHA1_DIGEST_LEN) == 0) {
+		free(data);
+		return 0;
+	}
+
+	if (node->data != NULL) {
+		free(node->data);
+	}
+	node->data = data;
+	node->data_size = size;
+	memcpy(node->hash, hash, SHA1_DIGEST_LEN);
+	return 1;
+}
+
+static int bld_graph_compress(BLD_GRAPH* graph) {
+	// kernel compress stage; an already compressed kernel passes through.
+
+	BLD_NODE* krnl = &graph->nodes[BLD_NODE_KRNL];
+	BLD_NODE* node = &graph->nodes[BLD_NODE_COMPRESS];
+	uint8_t* data = NULL;
+	uint32_t size = 0;
+
+	if (krnl->data == NULL)
+		return 1;
+
+	graph->compressed = bios_is_kernel_img(krnl->data, krnl->data_size);
+	if (graph->compressed) {
+		if (bios_compress_kernel(krnl->data, krnl->data_size, &data, &size) != 0)
+			return 1;
+	}
+	else {
+		data = (uint8_t*)malloc(krnl->data_size);
+		if (data == NULL)
+			return 1;
+		memcpy(data, krnl->data, krnl->data_size);
+		size = krnl->data_size;
+	}
+
+	bld_graph_set_output(node, data, size, krnl->hash);
+	return 0;
+}
+
+static bool bld_graph_cached(const BLD_NODE* node, const uint8_t hash[SHA1_DIGEST_LEN]) {
+	return node->data != NULL && memcmp(hash, node->hash, SHA1_DIGEST_LEN) == 0;
+}
+static void bld_graph_set_output(BLD_NODE* node, uint8_t* data, const uint32_t size, const uint8_t hash[SHA1_DIGEST_LEN]) {
+	if (node->data != NULL) {
+		free(node->data);
+	}
+	node->data = data;
+	node->data_size = size;
+	memcpy(node->hash, hash, SHA1_DIGEST_LEN);
+	node->rebuilt = true;
+}
+static uint8_t* bld_graph_copy_bank(const BLD_NODE* node) {
+	uint8_t* data = (uint8_t*)malloc(node->data_size);
+	if (data != NULL) {
+		memcpy(data, node->data, node->data_size);
+	}
+	return data;
+}
+
+static int bld_graph_bldr_patch(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const BIOS_LOAD_PARAMS* params) {
+	// 2BL patch stage; build one bank with the 2BL left plain. the 2BL is encrypted by the rc4 stage.
+
+	static const BLD_NODE_ID inputs[] = {
+		BLD_NODE_BLDR, BLD_NODE_INITTBL, BLD_NODE_COMPRESS, BLD_NODE_KRNLDATA, BLD_NODE_EEPROM_KEY, BLD_NODE_CERT_KEY
+	};
+
+	BLD_NODE* node = &graph->nodes[BLD_NODE_BLDR_PATCH];
+	BLD_NODE* nodes = graph->nodes;
+	SHA1Context sha;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t flags[6];
+	uint8_t* data;
+	uint32_t i;
+	Bios bios;
+	BIOS_LOAD_PARAMS load = *params;
+	BIOS_BUILD_PARAMS build = *build_params;
+
+	flags[0] = build_params->bfm;
+	flags[1] = build_params->hackinittbl;
+	flags[2] = build_params->hacksignature;
+	flags[3] = build_params->nobootparams;
+	flags[4] = build_params->zero_kernel_key;
+	flags[5] = params->enc_kernel;
+
+	SHA1Reset(&sha);
+	for (i = 0; i < sizeof(inputs) / sizeof(BLD_NODE_ID); ++i) {
+		SHA1Input(&sha, nodes[inputs[i]].hash, SHA1_DIGEST_LEN);
+	}
+	SHA1Input(&sha, flags, sizeof(flags));
+	SHA1Input(&sha, (const uint8_t*)&params->romsize, sizeof(params->romsize));
+	if (params->kernel_key != NULL)
+		SHA1Input(&sha, params->kernel_key, XB_KEY_SIZE);
+	SHA1Result(&sha, hash);
+
+	if (bld_graph_cached(node, hash))
+		return BIOS_LOAD_STATUS_SUCCESS;
+
+	if (nodes[BLD_NODE_BLDR].data == NULL || nodes[BLD_NODE_INITTBL].data == NULL || nodes[BLD_NODE_KRNLDATA].data == NULL)
+		return BIOS_LOAD_STATUS_FAILED;
+
+	build.bldr = nodes[BLD_NODE_BLDR].data;
+	build.bldrSize = nodes[BLD_NODE_BLDR].data_size;
+	build.init_tbl = nodes[BLD_NODE_INITTBL].data;
+	build.init_tbl_size = nodes[BLD_NODE_INITTBL].data_size;
+	build.compressed_kernel = nodes[BLD_NODE_COMPRESS].data;
+	build.kernel_size = nodes[BLD_NODE_COMPRESS].data_size;
+	build.kernel_data = nodes[BLD_NODE_KRNLDATA].data;
+	build.kernel_data_size = nodes[BLD_NODE_KRNLDATA].data_size;
+	build.preldr = NULL;
+	build.preldr_size = 0;
+	build.eeprom_key = (nodes[BLD_NODE_EEPROM_KEY].data_size == XB_KEY_SIZE) ? nodes[BLD_NODE_EEPROM_KEY].data : NULL;
+	build.cert_key = (nodes[BLD_NODE_CERT_KEY].data_size == XB_KEY_SIZE) ? nodes[BLD_NODE_CERT_KEY].data : NULL;
+
+	// the 2BL is in its final state; leave it plain.
+	load.enc_bldr = true;
+
+	// a bfm build is replicated to the max size; the first bank is the same.
+	if (bios.build(&build, 0, &load, NULL) != BIOS_LOAD_STATUS_SUCCESS) {
+		return BIOS_LOAD_STATUS_FAILED;
+	}
+
+	data = (uint8_t*)malloc(load.romsize);
+	if (data == NULL)
+		return BIOS_LOAD_STATUS_FAILED;
+	memcpy(data, bios.data, load.romsize);
+
+	graph->romsize = load.romsize;
+	graph->bfm_key_offset = (bios.bldr.bfm_key != NULL) ? (uint32_t)(bios.bldr.bfm_key - bios.data) : 0;
+	bld_graph_set_output(node, data, load.romsize, hash);
+
+	return BIOS_LOAD_STATUS_SUCCESS;
+}
+
+static int bld_graph_rc4(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, const BIOS_LOAD_PARAMS* params) {
+	// rc4 stage; encrypt the 2BL with the sb key, the mcpx key or, for a bfm build, the bfm key in the 2BL.
+
+	BLD_NODE* node = &graph->nodes[BLD_NODE_RC4];
+	BLD_NODE* bank = &graph->nodes[BLD_NODE_BLDR_PATCH];
+	SHA1Context sha;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	const uint8_t* sbkey = NULL;
+	uint8_t* data;
+	RC4_CONTEXT context;
+
+	if (!params->enc_bldr) {
+		if (params->bldr_key != NULL)
+			sbkey = params->bldr_key;
+		else if (params->mcpx != NULL && params->mcpx->sbkey != NULL)
+			sbkey = params->mcpx->sbkey;
+		else if (build_params->bfm && graph->bfm_key_offset != 0)
+			sbkey = bank->data + graph->bfm_key_offset;
+	}
+
+	SHA1Reset(&sha);
+	SHA1Input(&sha, bank->hash, SHA1_DIGEST_LEN);
+	if (sbkey != NULL)
+		SHA1Input(&sha, sbkey, XB_KEY_SIZE);
+	SHA1Result(&sha, hash);
+
+	if (bld_graph_cached(node, hash))
+		return BIOS_LOAD_STATUS_SUCCESS;
+
+	data = bld_graph_copy_bank(bank);
+	if (data == NULL)
+		return BIOS_LOAD_STATUS_FAILED;
+
+	if (sbkey != NULL) {
+		log_info("Encrypting 2BL\n");
+		rc4_key(&context, sbkey, XB_KEY_SIZE);
+		rc4(&context, data + graph->romsize - MCPX_BLOCK_SIZE - BLDR_BLOCK_SIZE, BLDR_BLOCK_SIZE);
+	}
+
+	bld_graph_set_output(node, data, bank->data_size, hash);
+	return BIOS_LOAD_STATUS_SUCCESS;
+}
+
+static int bld_graph_preldr(BLD_GRAPH* graph) {
+	// preldr stage; copy the preldr over the top of the 2BL block.
+
+	BLD_NODE* node = &graph->nodes[BLD_NODE_PRELDR_COPY];
+	BLD_NODE* bank = &graph->nodes[BLD_NODE_RC4];
+	BLD_NODE* preldr = &graph->nodes[BLD_NODE_PRELDR];
+	SHA1Context sha;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t* data;
+
+	SHA1Reset(&sha);
+	SHA1Input(&sha, bank->hash, SHA1_DIGEST_LEN);
+	SHA1Input(&sha, preldr->hash, SHA1_DIGEST_LEN);
+	SHA1Result(&sha, hash);
+
+	if (bld_graph_cached(node, hash))
+		return BIOS_LOAD_STATUS_SUCCESS;
+
+	if (preldr->data_size > PRELDR_SIZE) {
+		log_error("Preldr is too big\n");
+		return BIOS_LOAD_STATUS_FAILED;
+	}
+
+	data = bld_graph_copy_bank(bank);
+	if (data == NULL)
+		return BIOS_LOAD_STATUS_FAILED;
+
+	if (preldr->data != NULL && preldr->data_size > 0) {
+		memcpy(data + graph->romsize - MCPX_BLOCK_SIZE - PRELDR_BLOCK_SIZE, preldr->data, preldr->data_size);
+	}
+
+	bld_graph_set_output(node, data, bank->data_size, hash);
+	return BIOS_LOAD_STATUS_SUCCESS;
+}
+
+static int bld_graph_replicate(BLD_GRAPH* graph, const BIOS_BUILD_PARAMS* build_params, uint32_t binsize) {
+	// replicate stage; fill binsize with copies of the bank.
+
+	BLD_NODE* node = &graph->nodes[BLD_NODE_IMAGE];
+	BLD_NODE* bank = &graph->nodes[BLD_NODE_PRELDR_COPY];
+	SHA1Context sha;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	uint8_t* data;
+
+	if (build_params->bfm) {
+		binsize = MAX_BIOS_SIZE;
+	}
+	if (binsize < graph->romsize) {
+		binsize = graph->romsize;
+	}
+
+	SHA1Reset(&sha);
+	SHA1Input(&sha, bank->hash, SHA1_DIGEST_LEN);
+	SHA1Input(&sha, (const uint8_t*)&binsize, sizeof(binsize));
+	SHA1Result(&sha, hash);
+
+	if (bld_graph_cached(node, hash))
+		return BIOS_LOAD_STATUS_SUCCESS;
+
+	data = (uint8_t*)malloc(binsize);
+	if (data == NULL)
+		return BIOS_LOAD_STATUS_FAILED;
+	memcpy(data, bank->data, graph->romsize);
+
+	if (binsize > graph->romsize && bios_replicate_data(graph->romsize, binsize, data, binsize) != 0) {
+		log_error("Failed to replicate the bios\n");
+		free(data);
+		return BIOS_LOAD_STATUS_FAILED;
+	}
+
+	bld_graph_set_output(node, data, binsize, hash);
+	return BIOS_LOAD_STATUS_SUCCESS;
+}
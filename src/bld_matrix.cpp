@@ -0,0 +1,523 @@
+// bld_matrix.cpp: Builds a matrix of BIOS variants declared in a manifest.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "bld_matrix.h"
+#include "Bios.h"
+#include "file.h"
+#include "loadini.h"
+#include "work_pool.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+// manifest settings of a section, as read.
+typedef struct {
+	char* out;
+	char* key_krnl;
+	char* eeprom_key;
+	char* cert_key;
+	uint32_t romsize;				// kb
+	uint32_t binsize;				// kb
+	bool bfm;
+	bool enc_bldr;
+	bool enc_kernel;
+	bool hackinittbl;
+	bool hacksignature;
+	bool nobootparams;
+} BLD_MATRIX_SETTINGS;
+
+// manifest inputs; global section only.
+typedef struct {
+	char* bldr;
+	char* inittbl;
+	char* krnl;
+	char* krnldata;
+	char* preldr;
+} BLD_MATRIX_INPUTS;
+
+static const LOADINI_SETTING manifest_settings[] = {
+	{ "out", LOADINI_SETTING_TYPE_STR },
+	{ "key-krnl", LOADINI_SETTING_TYPE_STR },
+	{ "eepromkey", LOADINI_SETTING_TYPE_STR },
+	{ "certkey", LOADINI_SETTING_TYPE_STR },
+	{ "romsize", LOADINI_SETTING_TYPE_INT },
+	{ "binsize", LOADINI_SETTING_TYPE_INT },
+	{ "bfm", LOADINI_SETTING_TYPE_BOOL },
+	{ "enc-bldr", LOADINI_SETTING_TYPE_BOOL },
+	{ "enc-krnl", LOADINI_SETTING_TYPE_BOOL },
+	{ "hackinittbl", LOADINI_SETTING_TYPE_BOOL },
+	{ "hacksignature", LOADINI_SETTING_TYPE_BOOL },
+	{ "nobootparams", LOADINI_SETTING_TYPE_BOOL },
+
+	{ "bldr", LOADINI_SETTING_TYPE_STR },
+	{ "inittbl", LOADINI_SETTING_TYPE_STR },
+	{ "krnl", LOADINI_SETTING_TYPE_STR },
+	{ "krnldata", LOADINI_SETTING_TYPE_STR },
+	{ "preldr", LOADINI_SETTING_TYPE_STR },
+};
+
+typedef struct {
+	BLD_MATRIX* matrix;
+	const BIOS_LOAD_PARAMS* params;
+} BLD_MATRIX_CONTEXT;
+
+static void bld_matrix_free_settings(BLD_MATRIX_SETTINGS* settings);
+static int bld_matrix_add_variant(BLD_MATRIX* matrix, const char* name, const BLD_MATRIX_SETTINGS* settings, const BLD_MATRIX_SETTINGS* global);
+static int bld_matrix_load_inputs(BLD_MATRIX* matrix, const BLD_MATRIX_INPUTS* inputs);
+static uint8_t* bld_matrix_load_key(BLD_MATRIX* matrix, const char* path);
+static void bld_matrix_build_range(uint64_t begin, uint64_t end, void* context);
+
+void bld_matrix_init(BLD_MATRIX* matrix) {
+	bios_init_build_params(&matrix->inputs);
+	matrix->variants = NULL;
+	matrix->count = 0;
+	matrix->keys = NULL;
+	matrix->key_count = 0;
+	matrix->kernel_img_size = 0;
+}
+void bld_matrix_free(BLD_MATRIX* matrix) {
+	uint32_t i;
+
+	// key buffers are owned by the key table, not the inputs.
+	matrix->inputs.eeprom_key = NULL;
+	matrix->inputs.cert_key = NULL;
+	bios_free_build_params(&matrix->inputs);
+
+	if (matrix->variants != NULL) {
+		for (i = 0; i < matrix->count; ++i) {
+			if (matrix->variants[i].out != NULL) {
+				free(matrix->variants[i].out);
+			}
+		}
+		free(matrix->variants);
+		matrix->variants = NULL;
+	}
+	matrix->count = 0;
+
+	if (matrix->keys != NULL) {
+		for (i = 0; i < matrix->key_count; ++i) {
+			free(matrix->keys[i].path);
+			free(matrix->keys[i].data);
+		}
+		free(matrix->keys);
+		matrix->keys = NULL;
+	}
+	matrix->key_count = 0;
+}
+
+int bld_matrix_load(BLD_MATRIX* matrix, const char* manifest) {
+	// the global section holds the inputs and the default settings; each [section] after it is a variant.
+
+	FILE* stream = NULL;
+	BLD_MATRIX_SETTINGS global;
+	BLD_MATRIX_SETTINGS settings;
+	BLD_MATRIX_INPUTS inputs;
+	char section[BLD_MATRIX_NAME_LEN] = { 0 };
+	char name[BLD_MATRIX_NAME_LEN] = { 0 };
+	int result = BLD_MATRIX_ERROR_SUCCESS;
+
+	memset(&global, 0, sizeof(BLD_MATRIX_SETTINGS));
+	memset(&settings, 0, sizeof(BLD_MATRIX_SETTINGS));
+	memset(&inputs, 0, sizeof(BLD_MATRIX_INPUTS));
+	global.romsize = MIN_BIOS_SIZE / 1024;
+
+	const LOADINI_SETTING_MAP global_map[] = {
+		{ &manifest_settings[0], &global.out },
+		{ &manifest_settings[1], &global.key_krnl },
+		{ &manifest_settings[2], &global.eeprom_key },
+		{ &manifest_settings[3], &global.cert_key },
+		{ &manifest_settings[4], &global.romsize },
+		{ &manifest_settings[5], &global.binsize },
+		{ &manifest_settings[6], &global.bfm },
+		{ &manifest_settings[7], &global.enc_bldr },
+		{ &manifest_settings[8], &global.enc_kernel },
+		{ &manifest_settings[9], &global.hackinittbl },
+		{ &manifest_settings[10], &global.hacksignature },
+		{ &manifest_settings[11], &global.nobootparams },
+		{ &manifest_settings[12], &inputs.bldr },
+		{ &manifest_settings[13], &inputs.inittbl },
+		{ &manifest_settings[14], &inputs.krnl },
+		{ &manifest_settings[15], &inputs.krnldata },
+		{ &manifest_settings[16], &inputs.preldr },
+	};
+	const LOADINI_SETTING_MAP variant_map[] = {
+		{ &manifest_settings[0], &settings.out },
+		{ &manifest_settings[1], &settings.key_krnl },
+		{ &manifest_settings[2], &settings.eeprom_key },
+		{ &manifest_settings[3], &settings.cert_key },
+		{ &manifest_settings[4], &settings.romsize },
+		{ &manifest_settings[5], &settings.binsize },
+		{ &manifest_settings[6], &settings.bfm },
+		{ &manifest_settings[7], &settings.enc_bldr },
+		{ &manifest_settings[8], &settings.enc_kernel },
+		{ &manifest_settings[9], &settings.hackinittbl },
+		{ &manifest_settings[10], &settings.hacksignature },
+		{ &manifest_settings[11], &settings.nobootparams },
+	};
+
+	stream = openFile(manifest, "r");
+	if (stream == NULL) {
+		log_error("Failed to open manifest '%s'\n", manifest);
+		return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	if (loadini_section(stream, global_map, sizeof(global_map), section, sizeof(section)) != LOADINI_ERROR_SUCCESS) {
+		log_error("Invalid setting in the global section of '%s'\n", manifest);
+		result = BLD_MATRIX_ERROR_FAILED;
+		goto Cleanup;
+	}
+
+	while (section[0] != '\0') {
+		strcpy(name, section);
+
+		// a variant starts with the global values; strings are inherited after the section is read.
+		settings = global;
+		settings.out = NULL;
+		settings.key_krnl = NULL;
+		settings.eeprom_key = NULL;
+		settings.cert_key = NULL;
+
+		if (loadini_section(stream, variant_map, sizeof(variant_map), section, sizeof(section)) != LOADINI_ERROR_SUCCESS) {
+			log_error("Invalid setting in section [%s] of '%s'\n", name, manifest);
+			result = BLD_MATRIX_ERROR_FAILED;
+			goto Cleanup;
+		}
+
+		if (bld_matrix_add_variant(matrix, name, &settings, &global) != BLD_MATRIX_ERROR_SUCCESS) {
+			result = BLD_MATRIX_ERROR_FAILED;
+			goto Cleanup;
+		}
+		bld_matrix_free_settings(&settings);
+	}
+
+	if (matrix->count == 0) {
+		log_error("No variants in '%s'\n", manifest);
+		result = BLD_MATRIX_ERROR_FAILED;
+		goto Cleanup;
+	}
+
+	result = bld_matrix_load_inputs(matrix, &inputs);
+
+Cleanup:
+
+	if (stream != NULL) {
+		closeFile(stream);
+	}
+
+	bld_matrix_free_settings(&settings);
+	bld_matrix_free_settings(&global);
+
+	if (inputs.bldr != NULL) free(inputs.bldr);
+	if (inputs.inittbl != NULL) free(inputs.inittbl);
+	if (inputs.krnl != NULL) free(inputs.krnl);
+	if (inputs.krnldata != NULL) free(inputs.krnldata);
+	if (inputs.preldr != NULL) free(inputs.preldr);
+
+	return result;
+}
+
+int bld_matrix_build(BLD_MATRIX* matrix, const BIOS_LOAD_PARAMS* params, int threads) {
+	WorkPool pool;
+	WORK_RANGE range;
+	BLD_MATRIX_CONTEXT context;
+	uint32_t i;
+
+	if (matrix->count == 0)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	context.matrix = matrix;
+	context.params = params;
+
+	for (i = 0; i < matrix->count; ++i) {
+		matrix->variants[i].result = BIOS_LOAD_STATUS_FAILED;
+		matrix->variants[i].size = 0;
+	}
+
+	// one variant per work item; no more workers than variants.
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0 || (uint32_t)threads > matrix->count)
+		threads = matrix->count;
+
+	// the memory file registry is not synchronized; a variant built into one is built on one worker.
+	for (i = 0; i < matrix->count; ++i) {
+		if (isMemFile(matrix->variants[i].out)) {
+			threads = 1;
+			break;
+		}
+	}
+
+	range.begin = 0;
+	range.end = matrix->count;
+	if (pool.start(&range, 1, 1, threads, bld_matrix_build_range, &context) != 0)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	while (!pool.wait(1000)) {}
+	pool.stop();
+
+	for (i = 0; i < matrix->count; ++i) {
+		if (matrix->variants[i].result != BIOS_LOAD_STATUS_SUCCESS)
+			return BLD_MATRIX_ERROR_BUILD;
+	}
+	return BLD_MATRIX_ERROR_SUCCESS;
+}
+
+static void bld_matrix_build_range(uint64_t begin, uint64_t end, void* context) {
+	BLD_MATRIX_CONTEXT* ctx = (BLD_MATRIX_CONTEXT*)context;
+	BLD_VARIANT* variant;
+	BIOS_LOAD_PARAMS params;
+	BIOS_BUILD_PARAMS build;
+	char* temp;
+	uint64_t i;
+
+	for (i = begin; i < end; ++i) {
+		Bios bios;
+		variant = &ctx->matrix->variants[i];
+
+		// the build only reads the shared inputs.
+		build = ctx->matrix->inputs;
+		build.eeprom_key = variant->eeprom_key;
+		build.cert_key = variant->cert_key;
+		build.bfm = variant->bfm;
+		build.hackinittbl = variant->hackinittbl;
+		build.hacksignature = variant->hacksignature;
+		build.nobootparams = variant->nobootparams;
+
+		params = *ctx->params;
+		params.romsize = variant->romsize;
+		params.enc_bldr = variant->enc_bldr;
+		params.enc_kernel = variant->enc_kernel;
+		if (variant->kernel_key != NULL)
+			params.kernel_key = variant->kernel_key;
+
+		// build into a temp file; it replaces the output only once the variant builds.
+		temp = tempFileName(variant->out);
+		if (temp == NULL) {
+			variant->result = BIOS_LOAD_STATUS_FAILED;
+			continue;
+		}
+
+		variant->result = bios.build(&build, variant->binsize, &params, temp);
+		if (variant->result == BIOS_LOAD_STATUS_SUCCESS) {
+			variant->size = bios.size;
+			bios.unload();
+			if (renameFile(temp, variant->out) != 0) {
+				log_error("could not write file: %s\n", variant->out);
+				deleteFile(temp);
+				variant->result = BIOS_LOAD_STATUS_FAILED;
+			}
+		}
+		else {
+			bios.unload();
+			deleteFile(temp);
+		}
+		free(temp);
+	}
+}
+
+static void bld_matrix_free_settings(BLD_MATRIX_SETTINGS* settings) {
+	if (settings->out != NULL) {
+		free(settings->out);
+		settings->out = NULL;
+	}
+	if (settings->key_krnl != NULL) {
+		free(settings->key_krnl);
+		settings->key_krnl = NULL;
+	}
+	if (settings->eeprom_key != NULL) {
+		free(settings->eeprom_key);
+		settings->eeprom_key = NULL;
+	}
+	if (settings->cert_key != NULL) {
+		free(settings->cert_key);
+		settings->cert_key = NULL;
+	}
+}
+
+static int bld_matrix_add_variant(BLD_MATRIX* matrix, const char* name, const BLD_MATRIX_SETTINGS* settings, const BLD_MATRIX_SETTINGS* global) {
+	BLD_VARIANT* variants;
+	BLD_VARIANT* variant;
+	const char* out;
+	const char* path;
+	uint32_t i;
+
+	if (bios_check_size(settings->romsize * 1024) != 0 || (settings->binsize != 0 && bios_check_size(settings->binsize * 1024) != 0)) {
+		log_error("Invalid romsize or binsize in section [%s]\n", name);
+		return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	variants = (BLD_VARIANT*)realloc(matrix->variants, (matrix->count + 1) * sizeof(BLD_VARIANT));
+	if (variants == NULL)
+		return BLD_MATRIX_ERROR_FAILED;
+	matrix->variants = variants;
+
+	variant = &matrix->variants[matrix->count];
+	memset(variant, 0, sizeof(BLD_VARIANT));
+	strcpy(variant->name, name);
+
+	// the output file; defaults to <name>.bin
+	out = (settings->out != NULL) ? settings->out : global->out;
+	if (out != NULL) {
+		variant->out = (char*)malloc(strlen(out) + 1);
+		if (variant->out == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+		strcpy(variant->out, out);
+	}
+	else {
+		variant->out = (char*)malloc(strlen(name) + 5);
+		if (variant->out == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+		strcpy(variant->out, name);
+		strcat(variant->out, ".bin");
+	}
+	matrix->count++;
+
+	for (i = 0; i < matrix->count - 1; ++i) {
+		if (strcmp(matrix->variants[i].out, variant->out) == 0) {
+			log_error("Section [%s] and [%s] have the same output file '%s'\n", matrix->variants[i].name, name, variant->out);
+			return BLD_MATRIX_ERROR_FAILED;
+		}
+	}
+
+	variant->romsize = settings->romsize * 1024;
+	variant->binsize = settings->binsize * 1024;
+	variant->bfm = settings->bfm;
+	variant->enc_bldr = settings->enc_bldr;
+	variant->enc_kernel = settings->enc_kernel;
+	variant->hackinittbl = settings->hackinittbl;
+	variant->hacksignature = settings->hacksignature;
+	variant->nobootparams = settings->nobootparams;
+
+	path = (settings->key_krnl != NULL) ? settings->key_krnl : global->key_krnl;
+	if (path != NULL) {
+		variant->kernel_key = bld_matrix_load_key(matrix, path);
+		if (variant->kernel_key == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	path = (settings->eeprom_key != NULL) ? settings->eeprom_key : global->eeprom_key;
+	if (path != NULL) {
+		variant->eeprom_key = bld_matrix_load_key(matrix, path);
+		if (variant->eeprom_key == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	path = (settings->cert_key != NULL) ? settings->cert_key : global->cert_key;
+	if (path != NULL) {
+		variant->cert_key = bld_matrix_load_key(matrix, path);
+		if (variant->cert_key == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	return BLD_MATRIX_ERROR_SUCCESS;
+}
+
+static uint8_t* bld_matrix_load_key(BLD_MATRIX* matrix, const char* path) {
+	// key files are read once; variants naming the same file share it.
+
+	BLD_MATRIX_FILE* keys;
+	BLD_MATRIX_FILE* key;
+	uint32_t i;
+
+	for (i = 0; i < matrix->key_count; ++i) {
+		if (strcmp(matrix->keys[i].path, path) == 0)
+			return matrix->keys[i].data;
+	}
+
+	keys = (BLD_MATRIX_FILE*)realloc(matrix->keys, (matrix->key_count + 1) * sizeof(BLD_MATRIX_FILE));
+	if (keys == NULL)
+		return NULL;
+	matrix->keys = keys;
+
+	key = &matrix->keys[matrix->key_count];
+	key->data = readFile(path, NULL, XB_KEY_SIZE);
+	if (key->data == NULL)
+		return NULL;
+
+	key->path = (char*)malloc(strlen(path) + 1);
+	if (key->path == NULL) {
+		free(key->data);
+		return NULL;
+	}
+	strcpy(key->path, path);
+	matrix->key_count++;
+
+	return key->data;
+}
+
+static int bld_matrix_load_inputs(BLD_MATRIX* matrix, const BLD_MATRIX_INPUTS* inputs) {
+	// read every input once. an uncompressed kernel image is compressed once for all variants.
+
+	BIOS_BUILD_PARAMS* build = &matrix->inputs;
+	uint8_t* kernel = NULL;
+	uint32_t kernel_size = 0;
+
+	if (inputs->bldr == NULL || inputs->inittbl == NULL || inputs->krnl == NULL || inputs->krnldata == NULL) {
+		log_error("The manifest needs bldr, inittbl, krnl and krnldata\n");
+		return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	build->bldr = readFile(inputs->bldr, &build->bldrSize, 0);
+	if (build->bldr == NULL)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	build->init_tbl = readFile(inputs->inittbl, &build->init_tbl_size, 0);
+	if (build->init_tbl == NULL)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	build->kernel_data = readFile(inputs->krnldata, &build->kernel_data_size, 0);
+	if (build->kernel_data == NULL)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	if (inputs->preldr != NULL) {
+		build->preldr = readFile(inputs->preldr, &build->preldr_size, 0);
+		if (build->preldr == NULL)
+			return BLD_MATRIX_ERROR_FAILED;
+	}
+
+	kernel = readFile(inputs->krnl, &kernel_size, 0);
+	if (kernel == NULL)
+		return BLD_MATRIX_ERROR_FAILED;
+
+	if (bios_is_kernel_img(kernel, kernel_size)) {
+		matrix->kernel_img_size = kernel_size;
+		if (bios_compress_kernel(kernel, kernel_size, &build->compressed_kernel, &build->kernel_size) != 0) {
+			free(kernel);
+			return BLD_MATRIX_ERROR_FAILED;
+		}
+		free(kernel);
+	}
+	else {
+		build->compressed_kernel = kernel;
+		build->kernel_size = kernel_size;
+	}
+
+	return BLD_MATRIX_ERROR_SUCCESS;
+}
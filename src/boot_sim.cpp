@@ -0,0 +1,320 @@
+// boot_sim.cpp: Simulates the MCPX, FBL and 2BL boot state machines over a BIOS image.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+// user incl
+#include "boot_sim.h"
+#include "Bios.h"
+#include "Mcpx.h"
+#include "XcodeInterp.h"
+#include "nt_headers.h"
+#include "tea.h"
+#include "util.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define BOOT_PATH_REV_0 0x01
+#define BOOT_PATH_REV_1 0x02
+#define BOOT_PATH_ALL (BOOT_PATH_REV_0 | BOOT_PATH_REV_1)
+
+typedef struct {
+	const char* name;
+	uint32_t paths; // BOOT_PATH_* the step is on
+} BOOT_STEP_INFO;
+
+static const BOOT_STEP_INFO boot_steps[BOOT_STEP_COUNT] = {
+	{ "run xcodes",					BOOT_PATH_ALL },
+	{ "sb decrypt 2BL",				BOOT_PATH_REV_0 },
+	{ "sb check 2BL signature",		BOOT_PATH_REV_0 },
+	{ "sb tea hash FBL",			BOOT_PATH_REV_1 },
+	{ "sb check FBL hash",			BOOT_PATH_REV_1 },
+	{ "FBL decrypt public key",		BOOT_PATH_REV_1 },
+	{ "FBL verify rom signature",	BOOT_PATH_REV_1 },
+	{ "FBL decrypt 2BL",			BOOT_PATH_REV_1 },
+	{ "2BL check boot params",		BOOT_PATH_ALL },
+	{ "2BL decrypt kernel",			BOOT_PATH_ALL },
+	{ "2BL decompress kernel",		BOOT_PATH_ALL },
+	{ "2BL locate kernel entry",	BOOT_PATH_ALL },
+};
+
+static int boot_step(BOOT_SIM_RESULT* result, const BOOT_STEP step, const int step_result);
+static int boot_sim_xcodes(const Bios* bios);
+static int boot_sim_fbl_hash(const MCPX* mcpx, const uint32_t hash[2]);
+static int boot_sim_rom_digest(Bios* bios);
+static int boot_sim_boot_params(const Bios* bios);
+static int boot_sim_kernel_entry(const Bios* bios, uint32_t* entry);
+
+int boot_simulate(const uint8_t* data, const uint32_t size, const BIOS_LOAD_PARAMS* params, const MCPX_REV rev, BOOT_SIM_RESULT* result) {
+	Bios bios;
+	BIOS_LOAD_PARAMS bios_params;
+	BIOS_BANKS banks;
+	MCPX mcpx;
+	uint8_t* image = NULL;
+	uint8_t* sbkey = NULL;
+
+	memset(result, 0, sizeof(BOOT_SIM_RESULT));
+	result->rev = rev;
+	result->step = BOOT_STEP_COUNT;
+
+	if (rev != MCPX_REV_0 && rev != MCPX_REV_1)
+		return BOOT_SIM_ERROR_FAILED;
+
+	if (bios_detect_banks(data, size, &banks) != 0)
+		return BOOT_SIM_ERROR_FAILED;
+
+	// mirrored banks are identical; boot a copy of the top one.
+	image = (uint8_t*)malloc(banks.romsize);
+	if (image == NULL)
+		return BOOT_SIM_ERROR_FAILED;
+	memcpy(image, data + size - banks.romsize, banks.romsize);
+
+	if (params->bldr_key != NULL) {
+		sbkey = params->bldr_key;
+	}
+	else if (params->mcpx != NULL && params->mcpx->sbkey != NULL) {
+		sbkey = params->mcpx->sbkey;
+	}
+
+	// the rev decides whether the 2BL is decrypted by the sb or the FBL.
+	mcpx_init(&mcpx);
+	mcpx.rev = rev;
+
+	// the sb always decrypts the 2BL.
+	bios_init_params(&bios_params);
+	bios_params.romsize = banks.romsize;
+	bios_params.mcpx = &mcpx;
+	bios_params.bldr_key = sbkey;
+	bios_params.kernel_key = params->kernel_key;
+	bios_params.enc_kernel = params->enc_kernel;
+	bios_params.restore_boot_params = true;
+	bios_params.krnl_cache = params->krnl_cache;
+
+	// the bios owns the image once loaded.
+	if (bios.load(image, banks.romsize, &bios_params) != BIOS_LOAD_STATUS_SUCCESS)
+		return BOOT_SIM_ERROR_FAILED;
+
+	if (boot_step(result, BOOT_STEP_XCODES, boot_sim_xcodes(&bios)))
+		goto Done;
+
+	if (rev == MCPX_REV_0) {
+		if (boot_step(result, BOOT_STEP_SB_DECRYPT_BLDR, sbkey != NULL ? BOOT_RESULT_PASS : BOOT_RESULT_NO_KEY))
+			goto Done;
+
+		bios.loadBldr();
+		if (boot_step(result, BOOT_STEP_SB_BLDR_SIGNATURE, bios.bldr.boot_params->signature == BOOT_SIGNATURE ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL))
+			goto Done;
+	}
+	else {
+		bios.loadPreldr();
+		tea_hash(result->fbl_hash, bios.preldr.data, PRELDR_SIZE);
+		boot_step(result, BOOT_STEP_SB_HASH_FBL, BOOT_RESULT_PASS);
+
+		if (boot_step(result, BOOT_STEP_SB_FBL_HASH, boot_sim_fbl_hash(params->mcpx, result->fbl_hash)))
+			goto Done;
+
+		if (boot_step(result, BOOT_STEP_FBL_DECRYPT_PK, sbkey == NULL ? BOOT_RESULT_NO_KEY :
+				(bios.preldr.status == PRELDR_STATUS_FOUND && bios.preldr.public_key != NULL) ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL))
+			goto Done;
+
+		if (boot_step(result, BOOT_STEP_FBL_VERIFY_ROM, boot_sim_rom_digest(&bios)))
+			goto Done;
+
+		bios.loadBldr();
+		if (boot_step(result, BOOT_STEP_FBL_DECRYPT_BLDR, bios.preldr.status == PRELDR_STATUS_BLDR_DECRYPTED ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL))
+			goto Done;
+	}
+
+	if (boot_step(result, BOOT_STEP_BLDR_BOOT_PARAMS, boot_sim_boot_params(&bios)))
+		goto Done;
+
+	bios.loadKernel();
+	if (boot_step(result, BOOT_STEP_BLDR_DECRYPT_KERNEL, bios.kernel.compressed_kernel_ptr != NULL ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL))
+		goto Done;
+
+	if (boot_step(result, BOOT_STEP_BLDR_DECOMPRESS_KERNEL, bios.decompressKrnl() == 0 ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL))
+		goto Done;
+
+	if (boot_step(result, BOOT_STEP_BLDR_KERNEL_ENTRY, boot_sim_kernel_entry(&bios, &result->kernel_entry)))
+		goto Done;
+
+Done:
+	return (result->step == BOOT_STEP_COUNT) ? BOOT_SIM_ERROR_SUCCESS : BOOT_SIM_ERROR_NO_BOOT;
+}
+
+bool boot_step_on_path(const BOOT_STEP step, const MCPX_REV rev) {
+	if (step < 0 || step >= BOOT_STEP_COUNT)
+		return false;
+	switch (rev) {
+		case MCPX_REV_0:
+			return (boot_steps[step].paths & BOOT_PATH_REV_0) != 0;
+		case MCPX_REV_1:
+			return (boot_steps[step].paths & BOOT_PATH_REV_1) != 0;
+		default:
+			return false;
+	}
+}
+const char* boot_step_name(const BOOT_STEP step) {
+	if (step < 0 || step >= BOOT_STEP_COUNT)
+		return "kernel entry";
+	return boot_steps[step].name;
+}
+const char* boot_result_name(const int result) {
+	switch (result) {
+		case BOOT_RESULT_PASS:
+			return "pass";
+		case BOOT_RESULT_FAIL:
+			return "fail";
+		case BOOT_RESULT_UNKNOWN:
+			return "unknown";
+		case BOOT_RESULT_NO_KEY:
+			return "no sb key";
+		default:
+			return "not run";
+	}
+}
+
+static int boot_step(BOOT_SIM_RESULT* result, const BOOT_STEP step, const int step_result) {
+	// record a step. returns 1 if the boot stops here.
+
+	result->result[step] = step_result;
+	if (step_result != BOOT_RESULT_PASS) {
+		result->step = step;
+		return 1;
+	}
+	return 0;
+}
+static int boot_sim_xcodes(const Bios* bios) {
+	// the xcodes run from the end of the init table header until an exit opcode.
+	// the interpreter must not run into the 2BL.
+
+	const uint32_t end = bios->size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE;
+	uint32_t offset = sizeof(INIT_TBL);
+
+	while (offset + sizeof(XCODE) <= end) {
+		const XCODE* xcode = (const XCODE*)(bios->data + offset);
+		if (xcode->opcode == XC_EXIT)
+			return BOOT_RESULT_PASS;
+		offset += sizeof(XCODE);
+	}
+
+	return BOOT_RESULT_FAIL;
+}
+static int boot_sim_fbl_hash(const MCPX* mcpx, const uint32_t hash[2]) {
+	// the mcpx 1.1 compares the hash words with the immediates of its cmp instructions.
+	// without the rom there is no verdict.
+
+	bool found[2] = { false, false };
+
+	if (mcpx == NULL || mcpx->data == NULL || mcpx->rev != MCPX_REV_1)
+		return BOOT_RESULT_UNKNOWN;
+
+	for (uint32_t i = 0; i + 1 < MCPX_BLOCK_SIZE; i++) {
+		const uint8_t* code = mcpx->data + i;
+		uint32_t imm_offset;
+		uint32_t imm;
+
+		if (code[0] == 0x3D) {
+			// cmp eax, imm32
+			imm_offset = i + 1;
+		}
+		else if (code[0] == 0x81 && (code[1] & 0xF8) == 0xF8) {
+			// cmp r32, imm32
+			imm_offset = i + 2;
+		}
+		else {
+			continue;
+		}
+
+		if (imm_offset + sizeof(uint32_t) > MCPX_BLOCK_SIZE)
+			continue;
+
+		memcpy(&imm, mcpx->data + imm_offset, sizeof(uint32_t));
+		if (imm == hash[0])
+			found[0] = true;
+		else if (imm == hash[1])
+			found[1] = true;
+	}
+
+	return (found[0] && found[1]) ? BOOT_RESULT_PASS : BOOT_RESULT_FAIL;
+}
+static int boot_sim_rom_digest(Bios* bios) {
+	// the FBL compares the signed rom digest with the sha1 of the rom.
+
+	switch (bios->preldrVerifyRomDigest(NULL)) {
+		case 0:
+			return BOOT_RESULT_PASS;
+		case 2:
+			return BOOT_RESULT_UNKNOWN;
+		default:
+			return BOOT_RESULT_FAIL;
+	}
+}
+static int boot_sim_boot_params(const Bios* bios) {
+	// the 2BL copies the init table from the bottom of the rom and the kernel from below itself;
+	// the components must fit the rom without overlapping.
+
+	if (bios->bios_status != BIOS_LOAD_STATUS_SUCCESS)
+		return BOOT_RESULT_FAIL;
+
+	const BOOT_PARAMS* boot_params = bios->bldr.boot_params;
+	const uint64_t used = (uint64_t)boot_params->init_tbl_size + boot_params->compressed_kernel_size +
+		boot_params->uncompressed_kernel_data_size + BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE;
+
+	if (boot_params->compressed_kernel_size == 0 || used > bios->size)
+		return BOOT_RESULT_FAIL;
+
+	return BOOT_RESULT_PASS;
+}
+static int boot_sim_kernel_entry(const Bios* bios, uint32_t* entry) {
+	// the kernel entry is read from the pe header of the decompressed image.
+
+	const uint8_t* img = bios->kernel.img;
+	const uint32_t img_size = bios->kernel.img_size;
+	const IMAGE_DOS_HEADER* dos;
+	const IMAGE_NT_HEADER* nt;
+
+	if (img == NULL || img_size < sizeof(IMAGE_DOS_HEADER))
+		return BOOT_RESULT_FAIL;
+
+	dos = (const IMAGE_DOS_HEADER*)img;
+	if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+		return BOOT_RESULT_FAIL;
+
+	if (dos->e_lfanew > img_size || img_size - dos->e_lfanew < offsetof(IMAGE_NT_HEADER, optional_header.imageSize) + sizeof(uint32_t))
+		return BOOT_RESULT_FAIL;
+
+	nt = (const IMAGE_NT_HEADER*)(img + dos->e_lfanew);
+	if (nt->signature != IMAGE_NT_SIGNATURE)
+		return BOOT_RESULT_FAIL;
+
+	if (nt->optional_header.std.addressOfEntryPoint == 0 || nt->optional_header.std.addressOfEntryPoint >= nt->optional_header.imageSize)
+		return BOOT_RESULT_FAIL;
+
+	*entry = nt->optional_header.imageBase + nt->optional_header.std.addressOfEntryPoint;
+	return BOOT_RESULT_PASS;
+}
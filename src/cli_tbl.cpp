@@ -27,6 +27,7 @@
 // user incl
 #include "cli_tbl.h"
 
+// command line switches of the one command being run. the CLI only; libxbios does not build this file.
 static int cli_flags[CLI_SWITCH_SIZE] = { 0 };
 
 void setParamValue(const PARAM_TBL* param, char* arg);
@@ -236,6 +237,10 @@ void clearFlag(const CLI_SWITCH sw)
 {
 	cli_flags[sw / CLI_SWITCH_BITS] &= ~(1 << (sw % CLI_SWITCH_BITS));
 }
+void clearFlags()
+{
+	memset(cli_flags, 0, sizeof(cli_flags));
+}
 bool isFlagSet(const CLI_SWITCH sw)
 {
 	return (cli_flags[sw / CLI_SWITCH_BITS] & (1 << (sw % CLI_SWITCH_BITS))) != 0;
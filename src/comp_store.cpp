@@ -0,0 +1,278 @@
+// comp_store.cpp: Implements a content addressed store of extracted BIOS components.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include <process.h>
+#define COMP_STORE_PID() _getpid()
+#define COMP_STORE_SEP "\\"
+#else
+#include <unistd.h>
+#define COMP_STORE_PID() getpid()
+#define COMP_STORE_SEP "/"
+#endif
+
+// user incl
+#include "comp_store.h"
+#include "file.h"
+#include "sha1.h"
+#include "loadini.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define COMP_STORE_NAME_LEN (SHA1_DIGEST_LEN * 2)
+
+// manifest inputs, in build order.
+static const IDENT_TYPE manifest_inputs[] = {
+	IDENT_TYPE_PRELDR, IDENT_TYPE_BLDR, IDENT_TYPE_INIT_TBL, IDENT_TYPE_KERNEL, IDENT_TYPE_KERNEL_DATA
+};
+
+// unique temp file names across the threads of this process.
+static std::atomic<uint32_t> temp_counter(0);
+
+static char* comp_store_path(const COMP_STORE* store, const uint8_t hash[SHA1_DIGEST_LEN], const bool dir, const char* suffix);
+static int manifest_line(char* text, uint32_t* len, const char* key, const char* value);
+
+int comp_store_open(COMP_STORE* store, const char* path) {
+	store->path = NULL;
+
+	if (path == NULL || createDirectory(path) != 0)
+		return COMP_STORE_ERROR_FAILED;
+
+	store->path = (char*)malloc(strlen(path) + 1);
+	if (store->path == NULL)
+		return COMP_STORE_ERROR_FAILED;
+	strcpy(store->path, path);
+
+	return COMP_STORE_ERROR_SUCCESS;
+}
+void comp_store_close(COMP_STORE* store) {
+	if (store->path != NULL) {
+		free(store->path);
+		store->path = NULL;
+	}
+}
+
+char* comp_store_filename(const COMP_STORE* store, const uint8_t hash[SHA1_DIGEST_LEN]) {
+	return comp_store_path(store, hash, false, NULL);
+}
+
+int comp_store_put(const COMP_STORE* store, const uint8_t* data, const uint32_t size, uint8_t hash[SHA1_DIGEST_LEN], bool* added) {
+	SHA1Context context;
+	char suffix[32];
+	char* dir = NULL;
+	char* filename = NULL;
+	char* temp = NULL;
+	MAPPED_FILE map;
+	int result = COMP_STORE_ERROR_FAILED;
+
+	if (added != NULL)
+		*added = false;
+
+	if (store == NULL || store->path == NULL || data == NULL || size == 0)
+		return COMP_STORE_ERROR_FAILED;
+
+	SHA1Reset(&context);
+	SHA1Input(&context, data, size);
+	SHA1Result(&context, hash);
+
+	filename = comp_store_path(store, hash, false, NULL);
+	if (filename == NULL)
+		goto Cleanup;
+
+	// same name, same contents.
+	if (fileExists(filename)) {
+		result = COMP_STORE_ERROR_SUCCESS;
+		goto Cleanup;
+	}
+
+	dir = comp_store_path(store, hash, true, NULL);
+	sprintf(suffix, ".%d.%u.tmp", (int)COMP_STORE_PID(), temp_counter.fetch_add(1));
+	temp = comp_store_path(store, hash, false, suffix);
+	if (dir == NULL || temp == NULL || createDirectory(dir) != 0)
+		goto Cleanup;
+
+	if (mapFileWrite(temp, size, &map) != 0)
+		goto Cleanup;
+	memcpy(map.data, data, size);
+	unmapFile(&map);
+
+	if (renameFile(temp, filename) != 0) {
+		deleteFile(temp);
+		log_error("Failed to store object %s\n", filename);
+		goto Cleanup;
+	}
+
+	if (added != NULL)
+		*added = true;
+	result = COMP_STORE_ERROR_SUCCESS;
+
+Cleanup:
+	if (dir != NULL)
+		free(dir);
+	if (filename != NULL)
+		free(filename);
+	if (temp != NULL)
+		free(temp);
+
+	return result;
+}
+
+void comp_manifest_init(COMP_MANIFEST* manifest) {
+	memset(manifest, 0, sizeof(COMP_MANIFEST));
+	strcpy(manifest->name, "bios");
+}
+
+void comp_manifest_set_name(COMP_MANIFEST* manifest, const char* filename) {
+	const char* start = filename;
+	const char* end;
+	const char* ptr;
+	uint32_t len;
+
+	for (ptr = filename; *ptr != '\0'; ptr++) {
+		if (*ptr == '/' || *ptr == '\\')
+			start = ptr + 1;
+	}
+	end = strrchr(start, '.');
+	if (end == NULL || end == start)
+		end = start + strlen(start);
+
+	len = (uint32_t)(end - start);
+	if (len == 0)
+		return;
+	if (len > BLD_MATRIX_NAME_LEN - 1)
+		len = BLD_MATRIX_NAME_LEN - 1;
+
+	memcpy(manifest->name, start, len);
+	manifest->name[len] = '\0';
+
+	// [ ] end a section name, = splits a line and ; starts a comment.
+	for (uint32_t i = 0; i < len; i++) {
+		if (strchr("[]=;", manifest->name[i]) != NULL)
+			manifest->name[i] = '_';
+	}
+}
+
+int comp_manifest_write(const COMP_STORE* store, const COMP_MANIFEST* manifest, const char* filename) {
+	char value[32];
+	char* path = NULL;
+	char* text = NULL;
+	uint32_t len = 0;
+	uint32_t i;
+	int result = COMP_STORE_ERROR_FAILED;
+
+	if (store == NULL || store->path == NULL || manifest == NULL || filename == NULL)
+		return COMP_STORE_ERROR_FAILED;
+
+	// every line fits the ini line size.
+	text = (char*)malloc((sizeof(manifest_inputs) / sizeof(IDENT_TYPE) + 12) * LOADINI_MAX_LINE_SIZE);
+	if (text == NULL)
+		return COMP_STORE_ERROR_FAILED;
+
+	len += sprintf(text + len, "; %s. rebuild with /bld-matrix\n", manifest->name);
+
+	for (i = 0; i < sizeof(manifest_inputs) / sizeof(IDENT_TYPE); i++) {
+		if ((manifest->components & (1U << manifest_inputs[i])) == 0)
+			continue;
+		path = comp_store_filename(store, manifest->hash[manifest_inputs[i]]);
+		if (path == NULL || manifest_line(text, &len, ident_type_name(manifest_inputs[i]), path) != 0)
+			goto Cleanup;
+		free(path);
+		path = NULL;
+	}
+
+	if (manifest->kernel_key) {
+		path = comp_store_filename(store, manifest->kernel_key_hash);
+		if (path == NULL || manifest_line(text, &len, "key-krnl", path) != 0)
+			goto Cleanup;
+		free(path);
+		path = NULL;
+	}
+
+	sprintf(value, "%u", manifest->romsize / 1024);
+	manifest_line(text, &len, "romsize", value);
+	sprintf(value, "%u", manifest->binsize / 1024);
+	manifest_line(text, &len, "binsize", value);
+	manifest_line(text, &len, "enc-bldr", manifest->enc_bldr ? "true" : "false");
+	manifest_line(text, &len, "enc-krnl", manifest->enc_kernel ? "true" : "false");
+
+	len += sprintf(text + len, "\n[%s]\n", manifest->name);
+
+	if (writeFile(filename, text, len) != 0)
+		goto Cleanup;
+
+	result = COMP_STORE_ERROR_SUCCESS;
+
+Cleanup:
+	if (path != NULL)
+		free(path);
+	if (text != NULL)
+		free(text);
+
+	return result;
+}
+
+static char* comp_store_path(const COMP_STORE* store, const uint8_t hash[SHA1_DIGEST_LEN], const bool dir, const char* suffix) {
+	// <path>/<first byte hex>[/<sha1 hex>[suffix]]
+
+	const size_t len = strlen(store->path) + 4 + COMP_STORE_NAME_LEN + (suffix != NULL ? strlen(suffix) : 0) + 1;
+	char* filename = (char*)malloc(len);
+	char* ptr;
+
+	if (filename == NULL)
+		return NULL;
+
+	ptr = filename + sprintf(filename, "%s" COMP_STORE_SEP "%02x", store->path, hash[0]);
+	if (dir)
+		return filename;
+
+	ptr += sprintf(ptr, COMP_STORE_SEP);
+	for (int i = 0; i < SHA1_DIGEST_LEN; i++) {
+		ptr += sprintf(ptr, "%02x", hash[i]);
+	}
+	sprintf(ptr, "%s", suffix != NULL ? suffix : "");
+
+	return filename;
+}
+static int manifest_line(char* text, uint32_t* len, const char* key, const char* value) {
+	// key=value; a line too long for the ini reader would be split into a bad key.
+
+	if (strlen(key) + 1 + strlen(value) + 1 >= LOADINI_MAX_LINE_SIZE) {
+		log_error("Manifest path is too long: %s\n", value);
+		return 1;
+	}
+	if (strchr(value, '=') != NULL) {
+		log_error("Manifest path can not contain '=': %s\n", value);
+		return 1;
+	}
+
+	*len += sprintf(text + *len, "%s=%s\n", key, value);
+	return 0;
+}
@@ -0,0 +1,107 @@
+// cpu_features.c: runtime cpu feature detection for the SIMD code paths.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+
+// user incl
+#include "cpu_features.h"
+
+#ifdef CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+
+static void cpu_cpuid(int leaf, int subleaf, int regs[4]) {
+#ifdef _MSC_VER
+	__cpuidex(regs, leaf, subleaf);
+#else
+	unsigned int a, b, c, d;
+	__cpuid_count(leaf, subleaf, a, b, c, d);
+	regs[0] = (int)a;
+	regs[1] = (int)b;
+	regs[2] = (int)c;
+	regs[3] = (int)d;
+#endif
+}
+
+static uint64_t cpu_xgetbv(void) {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t a, d;
+	__asm__ volatile("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+	return ((uint64_t)d << 32) | a;
+#endif
+}
+
+static int cpu_detect(void) {
+	int regs[4];
+	int features = 0;
+	int max_leaf;
+	int osxsave;
+	int avx;
+
+	cpu_cpuid(0, 0, regs);
+	max_leaf = regs[0];
+	if (max_leaf < 1)
+		return 0;
+
+	cpu_cpuid(1, 0, regs);
+	if (regs[3] & (1 << 26))
+		features |= CPU_FEATURE_SSE2;
+	if (regs[2] & (1 << 9))
+		features |= CPU_FEATURE_SSSE3;
+	if (regs[2] & (1 << 19))
+		features |= CPU_FEATURE_SSE41;
+
+	// avx2 needs the os to save the ymm state.
+	osxsave = (regs[2] & (1 << 27)) != 0;
+	avx = (regs[2] & (1 << 28)) != 0;
+
+	if (max_leaf < 7)
+		return features;
+
+	cpu_cpuid(7, 0, regs);
+	if ((regs[1] & (1 << 29)) && (features & CPU_FEATURE_SSE41))
+		features |= CPU_FEATURE_SHA;
+	if ((regs[1] & (1 << 5)) && osxsave && avx && (cpu_xgetbv() & 0x6) == 0x6)
+		features |= CPU_FEATURE_AVX2;
+
+	return features;
+}
+#endif
+
+int cpu_features(void) {
+	static int features = -1;
+
+	if (features == -1) {
+#ifdef CPU_X86
+		features = cpu_detect();
+#else
+		features = 0;
+#endif
+	}
+
+	return features;
+}
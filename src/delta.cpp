@@ -0,0 +1,355 @@
+// delta.cpp: Implements binary delta encoding with a suffix array matcher.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "delta.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define DELTA_MIN_MATCH 8	// shortest copy found by a search; a copy op costs 2 - 10 bytes.
+#define DELTA_MIN_RUN 4		// shortest copy that continues the previous copy; its distance is 0.
+
+typedef struct {
+	uint8_t* data;
+	uint32_t size;
+	uint32_t capacity;
+} DELTA_BUFFER;
+
+static int build_suffix_array(const uint8_t* data, const uint32_t n, int32_t* sa);
+static uint32_t match_len(const uint8_t* a, const uint32_t a_size, const uint8_t* b, const uint32_t b_size);
+static uint32_t search(const int32_t* sa, const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size, uint32_t* pos);
+static int put_bytes(DELTA_BUFFER* buffer, const uint8_t* data, const uint32_t size);
+static int put_varint(DELTA_BUFFER* buffer, uint32_t value);
+static int get_varint(const uint8_t* delta, const uint32_t delta_size, uint32_t* offset, uint32_t* value);
+
+int delta_encode(const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size, uint8_t** delta, uint32_t* delta_size) {
+	DELTA_BUFFER buffer = {};
+	int32_t* sa = NULL;
+	uint32_t i = 0;
+	uint32_t lit = 0;			// start of the pending literal
+	uint32_t last = 0;			// end of the previous copy in src
+	uint32_t expected;
+	uint32_t pos = 0;
+	uint32_t len;
+	int32_t distance;
+	int result = DELTA_ERROR_FAILED;
+
+	*delta = NULL;
+	*delta_size = 0;
+
+	if (src_size > 0) {
+		sa = (int32_t*)malloc(src_size * sizeof(int32_t));
+		if (sa == NULL)
+			goto Cleanup;
+		if (build_suffix_array(src, src_size, sa) != 0)
+			goto Cleanup;
+	}
+
+	while (i < dst_size) {
+		// a copy usually resumes where the previous one would have continued; a changed run in between.
+		expected = last + (i - lit);
+		len = 0;
+		if (expected < src_size) {
+			len = match_len(src + expected, src_size - expected, dst + i, dst_size - i);
+		}
+		if (len >= DELTA_MIN_RUN) {
+			pos = expected;
+		}
+		else {
+			len = (sa != NULL) ? search(sa, src, src_size, dst + i, dst_size - i, &pos) : 0;
+			if (len < DELTA_MIN_MATCH) {
+				i++;
+				continue;
+			}
+		}
+
+		if (i > lit) {
+			if (put_varint(&buffer, (i - lit) << 1) != 0 || put_bytes(&buffer, dst + lit, i - lit) != 0)
+				goto Cleanup;
+		}
+
+		distance = (int32_t)(pos - expected);
+		if (put_varint(&buffer, (len << 1) | 1) != 0 || put_varint(&buffer, ((uint32_t)distance << 1) ^ (uint32_t)(distance >> 31)) != 0)
+			goto Cleanup;
+
+		i += len;
+		lit = i;
+		last = pos + len;
+	}
+
+	if (i > lit) {
+		if (put_varint(&buffer, (i - lit) << 1) != 0 || put_bytes(&buffer, dst + lit, i - lit) != 0)
+			goto Cleanup;
+	}
+
+	*delta = buffer.data;
+	*delta_size = buffer.size;
+	buffer.data = NULL;
+	result = DELTA_ERROR_SUCCESS;
+
+Cleanup:
+	if (sa != NULL) {
+		free(sa);
+	}
+	if (buffer.data != NULL) {
+		free(buffer.data);
+	}
+	return result;
+}
+
+int delta_decode(const uint8_t* src, const uint32_t src_size, const uint8_t* delta, const uint32_t delta_size, uint8_t* dst, const uint32_t dst_size) {
+	uint32_t offset = 0;
+	uint32_t i = 0;
+	uint32_t lit = 0;
+	uint32_t last = 0;
+	uint32_t op;
+	uint32_t len;
+	uint32_t zigzag;
+	uint32_t pos;
+
+	while (offset < delta_size) {
+		if (get_varint(delta, delta_size, &offset, &op) != 0)
+			return DELTA_ERROR_INVALID;
+
+		len = op >> 1;
+		if (len > dst_size - i)
+			return DELTA_ERROR_INVALID;
+
+		if ((op & 1) == 0) {
+			// literal
+			if (len > delta_size - offset)
+				return DELTA_ERROR_INVALID;
+			memcpy(dst + i, delta + offset, len);
+			offset += len;
+			i += len;
+			continue;
+		}
+
+		// copy
+		if (get_varint(delta, delta_size, &offset, &zigzag) != 0)
+			return DELTA_ERROR_INVALID;
+
+		pos = last + (i - lit) + (uint32_t)((int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1));
+		if (pos > src_size || len > src_size - pos)
+			return DELTA_ERROR_INVALID;
+
+		memcpy(dst + i, src + pos, len);
+		i += len;
+		lit = i;
+		last = pos + len;
+	}
+
+	return (i == dst_size) ? DELTA_ERROR_SUCCESS : DELTA_ERROR_INVALID;
+}
+
+static int build_suffix_array(const uint8_t* data, const uint32_t n, int32_t* sa) {
+	// prefix doubling with radix sorts; O(n log n) and no worst case on long runs of fill bytes.
+
+	int32_t* rank = NULL;
+	int32_t* tmp = NULL;
+	uint32_t* count = NULL;
+	uint32_t classes;
+	uint32_t k;
+	uint32_t i;
+	uint32_t p;
+	int32_t a;
+	int32_t b;
+	int result = 1;
+
+	rank = (int32_t*)malloc(n * sizeof(int32_t));
+	tmp = (int32_t*)malloc(n * sizeof(int32_t));
+	count = (uint32_t*)malloc(((n > 256) ? n : 256) * sizeof(uint32_t));
+	if (rank == NULL || tmp == NULL || count == NULL)
+		goto Cleanup;
+
+	// sort by the first byte.
+	memset(count, 0, 256 * sizeof(uint32_t));
+	for (i = 0; i < n; ++i) {
+		count[data[i]]++;
+	}
+	for (i = 1; i < 256; ++i) {
+		count[i] += count[i - 1];
+	}
+	for (i = n; i > 0; --i) {
+		sa[--count[data[i - 1]]] = i - 1;
+	}
+	rank[sa[0]] = 0;
+	for (i = 1; i < n; ++i) {
+		rank[sa[i]] = rank[sa[i - 1]] + (data[sa[i]] != data[sa[i - 1]]);
+	}
+	classes = rank[sa[n - 1]] + 1;
+
+	// sort by the first 2k bytes until every suffix has its own rank.
+	for (k = 1; classes < n; k <<= 1) {
+		// order by the second key; suffixes shorter than k have none and come first.
+		p = 0;
+		for (i = n - ((k < n) ? k : n); i < n; ++i) {
+			tmp[p++] = i;
+		}
+		for (i = 0; i < n; ++i) {
+			if ((uint32_t)sa[i] >= k)
+				tmp[p++] = sa[i] - k;
+		}
+
+		// stable sort by the first key.
+		memset(count, 0, classes * sizeof(uint32_t));
+		for (i = 0; i < n; ++i) {
+			count[rank[i]]++;
+		}
+		for (i = 1; i < classes; ++i) {
+			count[i] += count[i - 1];
+		}
+		for (i = n; i > 0; --i) {
+			sa[--count[rank[tmp[i - 1]]]] = tmp[i - 1];
+		}
+
+		tmp[sa[0]] = 0;
+		for (i = 1; i < n; ++i) {
+			a = sa[i - 1];
+			b = sa[i];
+			tmp[b] = tmp[a];
+			if (rank[a] != rank[b] ||
+				(((uint32_t)a + k < n) ? rank[a + k] : -1) != (((uint32_t)b + k < n) ? rank[b + k] : -1)) {
+				tmp[b]++;
+			}
+		}
+
+		int32_t* swap = rank;
+		rank = tmp;
+		tmp = swap;
+		classes = rank[sa[n - 1]] + 1;
+	}
+
+	result = 0;
+
+Cleanup:
+	if (rank != NULL) {
+		free(rank);
+	}
+	if (tmp != NULL) {
+		free(tmp);
+	}
+	if (count != NULL) {
+		free(count);
+	}
+	return result;
+}
+
+static uint32_t match_len(const uint8_t* a, const uint32_t a_size, const uint8_t* b, const uint32_t b_size) {
+	const uint32_t size = (a_size < b_size) ? a_size : b_size;
+	uint64_t x;
+	uint64_t y;
+	uint32_t i = 0;
+
+	for (; i + 8 <= size; i += 8) {
+		memcpy(&x, a + i, sizeof(uint64_t));
+		memcpy(&y, b + i, sizeof(uint64_t));
+		if (x != y)
+			break;
+	}
+	for (; i < size && a[i] == b[i]; ++i);
+
+	return i;
+}
+static uint32_t search(const int32_t* sa, const uint8_t* src, const uint32_t src_size, const uint8_t* dst, const uint32_t dst_size, uint32_t* pos) {
+	// binary search the suffix array for the longest prefix of dst in src.
+
+	uint32_t st = 0;
+	uint32_t en = src_size - 1;
+	uint32_t x;
+	uint32_t y;
+	uint32_t len;
+
+	while (en - st >= 2) {
+		x = st + (en - st) / 2;
+		len = src_size - sa[x];
+		if (len > dst_size)
+			len = dst_size;
+		if (memcmp(src + sa[x], dst, len) < 0)
+			st = x;
+		else
+			en = x;
+	}
+
+	x = match_len(src + sa[st], src_size - sa[st], dst, dst_size);
+	y = match_len(src + sa[en], src_size - sa[en], dst, dst_size);
+	if (x >= y) {
+		*pos = sa[st];
+		return x;
+	}
+	*pos = sa[en];
+	return y;
+}
+
+static int put_bytes(DELTA_BUFFER* buffer, const uint8_t* data, const uint32_t size) {
+	uint8_t* new_data;
+	uint32_t capacity;
+
+	if (size > buffer->capacity - buffer->size) {
+		capacity = (buffer->capacity > 0) ? buffer->capacity : 0x1000;
+		while (size > capacity - buffer->size) {
+			capacity *= 2;
+		}
+		new_data = (uint8_t*)realloc(buffer->data, capacity);
+		if (new_data == NULL)
+			return 1;
+		buffer->data = new_data;
+		buffer->capacity = capacity;
+	}
+
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	return 0;
+}
+static int put_varint(DELTA_BUFFER* buffer, uint32_t value) {
+	uint8_t bytes[5];
+	uint32_t i = 0;
+
+	while (value >= 0x80) {
+		bytes[i++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	bytes[i++] = (uint8_t)value;
+
+	return put_bytes(buffer, bytes, i);
+}
+static int get_varint(const uint8_t* delta, const uint32_t delta_size, uint32_t* offset, uint32_t* value) {
+	uint32_t shift = 0;
+	uint8_t byte;
+
+	*value = 0;
+	do {
+		if (*offset >= delta_size || shift > 28)
+			return 1;
+		byte = delta[(*offset)++];
+		*value |= (uint32_t)(byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+
+	return 0;
+}
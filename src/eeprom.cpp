@@ -0,0 +1,276 @@
+// eeprom.cpp: Xbox EEPROM security section decryption, verification and encryption.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+
+// user incl
+#include "eeprom.h"
+#include "keyring.h"
+#include "file.h"
+#include "rc4.h"
+#include "sha1.h"
+#include "work_pool.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+typedef struct {
+	EEPROM_BATCH* batch;
+	uint8_t* images;			// EEPROM_SIZE bytes per result
+	uint32_t images_capacity;
+} EEPROM_LOAD_CONTEXT;
+
+typedef struct {
+	EEPROM_BATCH* batch;
+	const uint8_t* images;
+	const EEPROM_KEY* keys;
+	uint32_t key_count;
+} EEPROM_TRIAL_CONTEXT;
+
+static int eeprom_load_file(const char* filename, void* context);
+static void eeprom_trial(uint64_t begin, uint64_t end, void* context);
+
+void eeprom_key_init(EEPROM_KEY* key, const uint8_t* eeprom_key) {
+	SHA1HmacReset(&key->hmac, eeprom_key, XB_KEY_SIZE);
+}
+
+int eeprom_decrypt(const EEPROM_KEY* key, const uint8_t* eeprom, EEPROM_SECURITY* security) {
+	// rc4 key = hmac(hash); the section is valid when hmac(decrypted) == hash.
+
+	RC4_CONTEXT rc4_ctx;
+	uint8_t rc4_hash[SHA1_DIGEST_LEN];
+	uint8_t hash[SHA1_DIGEST_LEN];
+
+	memcpy(security, eeprom, sizeof(EEPROM_SECURITY));
+
+	SHA1Hmac(&key->hmac, security->hash, SHA1_DIGEST_LEN, rc4_hash);
+	rc4_key(&rc4_ctx, rc4_hash, SHA1_DIGEST_LEN);
+	rc4(&rc4_ctx, security->confounder, EEPROM_ENC_SIZE);
+
+	SHA1Hmac(&key->hmac, security->confounder, EEPROM_ENC_SIZE, hash);
+	if (memcmp(hash, security->hash, SHA1_DIGEST_LEN) != 0)
+		return EEPROM_ERROR_HASH;
+
+	return EEPROM_ERROR_SUCCESS;
+}
+
+void eeprom_encrypt(const EEPROM_KEY* key, const EEPROM_SECURITY* security, uint8_t* eeprom) {
+	RC4_CONTEXT rc4_ctx;
+	uint8_t rc4_hash[SHA1_DIGEST_LEN];
+	EEPROM_SECURITY* enc = (EEPROM_SECURITY*)eeprom;
+
+	memcpy(enc, security, sizeof(EEPROM_SECURITY));
+
+	SHA1Hmac(&key->hmac, security->confounder, EEPROM_ENC_SIZE, enc->hash);
+	SHA1Hmac(&key->hmac, enc->hash, SHA1_DIGEST_LEN, rc4_hash);
+	rc4_key(&rc4_ctx, rc4_hash, SHA1_DIGEST_LEN);
+	rc4(&rc4_ctx, enc->confounder, EEPROM_ENC_SIZE);
+}
+
+int eeprom_batch(EEPROM_BATCH* batch, const char* path, const KEYRING* keyring) {
+	EEPROM_LOAD_CONTEXT load;
+	EEPROM_TRIAL_CONTEXT trial;
+	EEPROM_KEY* keys = NULL;
+	WorkPool pool;
+	WORK_RANGE range;
+	uint32_t i;
+	int result = EEPROM_ERROR_FAILED;
+
+	batch->results = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+
+	load.batch = batch;
+	load.images = NULL;
+	load.images_capacity = 0;
+
+	if (enumerateFiles(path, false, eeprom_load_file, &load) != 0)
+		goto Cleanup;
+
+	if (batch->count == 0 || keyring->count == 0) {
+		result = EEPROM_ERROR_SUCCESS;
+		goto Cleanup;
+	}
+
+	// precompute the hmac states once per key; shared by every file.
+	keys = (EEPROM_KEY*)malloc(keyring->count * sizeof(EEPROM_KEY));
+	if (keys == NULL)
+		goto Cleanup;
+	for (i = 0; i < keyring->count; ++i) {
+		eeprom_key_init(&keys[i], keyring->keys[i].key);
+	}
+
+	trial.batch = batch;
+	trial.images = load.images;
+	trial.keys = keys;
+	trial.key_count = keyring->count;
+
+	range.begin = 0;
+	range.end = batch->count;
+	if (pool.start(&range, 1, 1, 0, eeprom_trial, &trial) != 0)
+		goto Cleanup;
+	while (!pool.wait(1000)) {}
+
+	result = EEPROM_ERROR_SUCCESS;
+
+Cleanup:
+
+	if (keys != NULL) {
+		free(keys);
+		keys = NULL;
+	}
+
+	if (load.images != NULL) {
+		free(load.images);
+		load.images = NULL;
+	}
+
+	return result;
+}
+void eeprom_batch_free(EEPROM_BATCH* batch) {
+	uint32_t i;
+
+	if (batch->results != NULL) {
+		for (i = 0; i < batch->count; ++i) {
+			if (batch->results[i].filename != NULL) {
+				free(batch->results[i].filename);
+				batch->results[i].filename = NULL;
+			}
+		}
+		free(batch->results);
+		batch->results = NULL;
+	}
+	batch->count = 0;
+	batch->capacity = 0;
+}
+
+const char* eeprom_region_str(const uint32_t region) {
+	switch (region) {
+		case EEPROM_REGION_NA:
+			return "North America";
+		case EEPROM_REGION_JP:
+			return "Japan";
+		case EEPROM_REGION_EU:
+			return "Europe / Australia";
+		case EEPROM_REGION_MANUFACTURING:
+			return "Manufacturing";
+		default:
+			return "Unknown";
+	}
+}
+const char* eeprom_video_standard_str(const uint32_t standard) {
+	switch (standard) {
+		case 0x00400100:
+			return "NTSC-M";
+		case 0x00400200:
+			return "NTSC-J";
+		case 0x00800300:
+			return "PAL-I";
+		case 0x00400400:
+			return "PAL-M";
+		default:
+			return "Unknown";
+	}
+}
+
+static int eeprom_load_file(const char* filename, void* context) {
+	// add an eeprom image to the batch. files that are not EEPROM_SIZE bytes are skipped.
+
+	EEPROM_LOAD_CONTEXT* load = (EEPROM_LOAD_CONTEXT*)context;
+	EEPROM_BATCH* batch = load->batch;
+	EEPROM_BATCH_RESULT* result;
+	FILE* file = NULL;
+	uint32_t size = 0;
+	uint32_t capacity;
+	void* ptr;
+
+	fopen_s(&file, filename, "rb");
+	if (file == NULL)
+		return 0;
+
+	getFileSize(file, &size);
+	if (size != EEPROM_SIZE) {
+		fclose(file);
+		return 0;
+	}
+
+	if (batch->count == batch->capacity) {
+		capacity = (batch->capacity == 0) ? 16 : batch->capacity * 2;
+		ptr = realloc(batch->results, capacity * sizeof(EEPROM_BATCH_RESULT));
+		if (ptr == NULL) {
+			fclose(file);
+			return 1;
+		}
+		batch->results = (EEPROM_BATCH_RESULT*)ptr;
+		batch->capacity = capacity;
+
+		ptr = realloc(load->images, capacity * EEPROM_SIZE);
+		if (ptr == NULL) {
+			fclose(file);
+			return 1;
+		}
+		load->images = (uint8_t*)ptr;
+		load->images_capacity = capacity;
+	}
+
+	if (fread(load->images + batch->count * EEPROM_SIZE, 1, EEPROM_SIZE, file) != EEPROM_SIZE) {
+		fclose(file);
+		return 0;
+	}
+	fclose(file);
+
+	result = &batch->results[batch->count];
+	result->filename = (char*)malloc(strlen(filename) + 1);
+	if (result->filename == NULL)
+		return 1;
+	strcpy(result->filename, filename);
+	result->key = KEYRING_NO_MATCH;
+	memset(&result->security, 0, sizeof(EEPROM_SECURITY));
+
+	batch->count++;
+	return 0;
+}
+
+static void eeprom_trial(uint64_t begin, uint64_t end, void* context) {
+	// try each key against the files [begin, end) until one verifies.
+
+	EEPROM_TRIAL_CONTEXT* trial = (EEPROM_TRIAL_CONTEXT*)context;
+	EEPROM_BATCH_RESULT* result;
+	EEPROM_SECURITY security;
+	uint32_t i;
+
+	for (; begin < end; ++begin) {
+		result = &trial->batch->results[begin];
+		for (i = 0; i < trial->key_count; ++i) {
+			if (eeprom_decrypt(&trial->keys[i], trial->images + begin * EEPROM_SIZE, &security) == EEPROM_ERROR_SUCCESS) {
+				result->key = (int)i;
+				result->security = security;
+				break;
+			}
+		}
+	}
+}
@@ -19,16 +19,360 @@
 // Author: tommojphillips
 // GitHub: https:\\github.com\tommojphillips
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // copy_file_range
+#endif
+
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 #include <malloc.h>
 
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 #include "file.h"
+#include "log.h"
 
 #ifdef MEM_TRACKING
 #include "mem_tracking.h"
 #endif
 
+// a memory file.
+typedef struct {
+	char* name;
+	uint8_t* data;
+	uint32_t size;
+	FILE* stream;				// open for writing; the bytes are written back when it is closed
+} MEM_FILE;
+
+static MEM_FILE* mem_files = NULL;
+static uint32_t mem_file_count = 0;
+
+static MEM_FILE* findMemFile(const char* filename);
+static int setMemFile(const char* filename, uint8_t* data, const uint32_t size);
+static void removeMemFile(MEM_FILE* file);
+
+int mapFile(const char* filename, MAPPED_FILE* map) {
+	if (filename == NULL || map == NULL)
+		return 1;
+
+	map->data = NULL;
+	map->size = 0;
+	map->writable = false;
+	map->type = MAPPED_FILE_DISK;
+
+	if (isMemFile(filename)) {
+		// the view is private; a copy keeps writes from reaching the memory file.
+		MEM_FILE* mem = findMemFile(filename);
+		if (mem == NULL || mem->size == 0) {
+			log_error("could not open file: %s\n", filename);
+			return 1;
+		}
+		map->data = (uint8_t*)malloc(mem->size);
+		if (map->data == NULL)
+			return 1;
+		memcpy(map->data, mem->data, mem->size);
+		map->size = mem->size;
+		map->type = MAPPED_FILE_COPY;
+		return 0;
+	}
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+	LARGE_INTEGER size;
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		log_error("could not open file: %s\n", filename);
+		return 1;
+	}
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || size.HighPart != 0) {
+		log_error("could not map file: %s\n", filename);
+		CloseHandle(file);
+		return 1;
+	}
+
+	// PAGE_WRITECOPY + FILE_MAP_COPY: written pages are private to this process.
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (mapping != NULL) {
+		map->data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+
+	if (map->data == NULL) {
+		log_error("could not map file: %s\n", filename);
+		return 1;
+	}
+	map->size = size.LowPart;
+#else
+	int fd;
+	struct stat st;
+	void* view;
+
+	fd = open(filename, O_RDONLY);
+	if (fd == -1) {
+		log_error("could not open file: %s\n", filename);
+		return 1;
+	}
+	if (fstat(fd, &st) != 0 || st.st_size == 0 || st.st_size > UINT32_MAX) {
+		log_error("could not map file: %s\n", filename);
+		close(fd);
+		return 1;
+	}
+
+	// MAP_PRIVATE: written pages are private to this process.
+	view = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (view == MAP_FAILED) {
+		log_error("could not map file: %s\n", filename);
+		return 1;
+	}
+	map->data = (uint8_t*)view;
+	map->size = (uint32_t)st.st_size;
+#endif
+
+	return 0;
+}
+int mapFileWrite(const char* filename, const uint32_t size, MAPPED_FILE* map) {
+	if (filename == NULL || map == NULL || size == 0)
+		return 1;
+
+	map->data = NULL;
+	map->size = 0;
+	map->writable = true;
+	map->type = MAPPED_FILE_DISK;
+
+	if (isMemFile(filename)) {
+		map->data = (uint8_t*)calloc(size, 1);
+		if (map->data == NULL)
+			return 1;
+		if (setMemFile(filename, map->data, size) != 0) {
+			free(map->data);
+			map->data = NULL;
+			return 1;
+		}
+		map->size = size;
+		map->type = MAPPED_FILE_MEM;
+		return 0;
+	}
+
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+
+	file = CreateFileA(filename, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		log_error("Could not open file: %s\n", filename);
+		return 1;
+	}
+
+	// the mapping extends the file to size; the new bytes are zero.
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, 0, size, NULL);
+	if (mapping != NULL) {
+		map->data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, size);
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+#else
+	int fd;
+	void* view;
+
+	fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+		log_error("Could not open file: %s\n", filename);
+		return 1;
+	}
+
+	view = MAP_FAILED;
+	if (ftruncate(fd, size) == 0) {
+		view = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	close(fd);
+
+	if (view != MAP_FAILED) {
+		map->data = (uint8_t*)view;
+	}
+#endif
+
+	if (map->data == NULL) {
+		log_error("could not map file: %s\n", filename);
+		return 1;
+	}
+	map->size = size;
+
+	return 0;
+}
+void unmapFile(MAPPED_FILE* map) {
+	if (map == NULL || map->data == NULL)
+		return;
+
+	if (map->type == MAPPED_FILE_COPY) {
+		free(map->data);
+	}
+	else if (map->type == MAPPED_FILE_DISK) {
+#ifdef _WIN32
+		if (map->writable)
+			FlushViewOfFile(map->data, 0);
+		UnmapViewOfFile(map->data);
+#else
+		if (map->writable)
+			msync(map->data, map->size, MS_SYNC);
+		munmap(map->data, map->size);
+#endif
+	}
+
+	map->data = NULL;
+	map->size = 0;
+	map->writable = false;
+	map->type = MAPPED_FILE_DISK;
+}
+
+int copyFileRanges(const char* filename, const FILE_RANGE* ranges, const uint32_t count) {
+	MAPPED_FILE map = { 0 };
+	char* temp = NULL;
+	uint32_t i;
+	uint32_t done;
+	int result = 1;
+
+	if (filename == NULL || ranges == NULL)
+		return 1;
+
+	if (isMemFile(filename)) {
+		// build the memory file from the ranges.
+		uint8_t* data;
+		uint32_t size = 0;
+		for (i = 0; i < count; ++i) {
+			size += ranges[i].size;
+		}
+		data = (uint8_t*)malloc(size);
+		if (data == NULL)
+			return 1;
+		for (i = 0, done = 0; i < count; done += ranges[i].size, ++i) {
+			if (mapFile(ranges[i].filename, &map) != 0)
+				break;
+			if (ranges[i].offset > map.size || ranges[i].size > map.size - ranges[i].offset) {
+				log_error("range out of bounds: %s\n", ranges[i].filename);
+				break;
+			}
+			memcpy(data + done, map.data + ranges[i].offset, ranges[i].size);
+			unmapFile(&map);
+		}
+		unmapFile(&map);
+		if (i != count || setMemFile(filename, data, size) != 0) {
+			free(data);
+			return 1;
+		}
+		return 0;
+	}
+
+	temp = tempFileName(filename);
+	if (temp == NULL)
+		return 1;
+
+#ifdef _WIN32
+	HANDLE file;
+	DWORD written;
+
+	file = CreateFileA(temp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+#else
+	int fd;
+	ssize_t n;
+	uint32_t left;
+
+	fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) {
+#endif
+		log_error("Could not open file: %s\n", temp);
+		free(temp);
+		return 1;
+	}
+
+	for (i = 0; i < count; ++i) {
+		done = 0;
+
+#ifdef __linux__
+		// copy in the kernel; the file offset of fd advances with each copy.
+		int src;
+		off64_t src_offset;
+
+		if (isMemFile(ranges[i].filename))
+			goto MappedCopy;
+
+		src = open(ranges[i].filename, O_RDONLY);
+		if (src == -1) {
+			log_error("could not open file: %s\n", ranges[i].filename);
+			goto Cleanup;
+		}
+		src_offset = ranges[i].offset;
+		while (done < ranges[i].size) {
+			n = copy_file_range(src, &src_offset, fd, NULL, ranges[i].size - done, 0);
+			if (n <= 0)
+				break;
+			done += (uint32_t)n;
+		}
+		close(src);
+		if (done == ranges[i].size)
+			continue;
+		// not supported between these files; copy the rest from a mapped view.
+MappedCopy:
+#endif
+
+		if (mapFile(ranges[i].filename, &map) != 0)
+			goto Cleanup;
+		if (ranges[i].offset > map.size || ranges[i].size > map.size - ranges[i].offset) {
+			log_error("range out of bounds: %s\n", ranges[i].filename);
+			goto Cleanup;
+		}
+
+#ifdef _WIN32
+		if (!WriteFile(file, map.data + ranges[i].offset + done, ranges[i].size - done, &written, NULL) || written != ranges[i].size - done)
+			goto Cleanup;
+#else
+		left = ranges[i].size - done;
+		while (left > 0) {
+			n = write(fd, map.data + ranges[i].offset + (ranges[i].size - left), left);
+			if (n <= 0)
+				goto Cleanup;
+			left -= (uint32_t)n;
+		}
+#endif
+		unmapFile(&map);
+	}
+
+	result = 0;
+
+Cleanup:
+	unmapFile(&map);
+#ifdef _WIN32
+	CloseHandle(file);
+#else
+	close(fd);
+#endif
+	if (result == 0 && renameFile(temp, filename) != 0) {
+		log_error("Could not write file: %s\n", filename);
+		result = 1;
+	}
+	if (result != 0) {
+		deleteFile(temp);
+	}
+	free(temp);
+	return result;
+}
+
 uint8_t* readFile(const char* filename, uint32_t* bytesRead, const uint32_t expectedSize) {
 	FILE* file = NULL;
 	uint32_t size = 0;
@@ -36,16 +380,36 @@ uint8_t* readFile(const char* filename, uint32_t* bytesRead, const uint32_t expe
 	if (filename == NULL)
 		return NULL;
 
+	if (isMemFile(filename)) {
+		MEM_FILE* mem = findMemFile(filename);
+		if (mem == NULL) {
+			log_error("could not open file: %s\n", filename);
+			return NULL;
+		}
+		if (expectedSize != 0 && mem->size != expectedSize) {
+			log_error("invalid file size. Expected %u bytes. Got %u bytes\n", expectedSize, mem->size);
+			return NULL;
+		}
+		uint8_t* data = (uint8_t*)malloc(mem->size);
+		if (data != NULL) {
+			memcpy(data, mem->data, mem->size);
+			if (bytesRead != NULL) {
+				*bytesRead = mem->size;
+			}
+		}
+		return data;
+	}
+
 	fopen_s(&file, filename, "rb");
 	if (file == NULL) {
-		printf("Error: could not open file: %s\n", filename);
+		log_error("could not open file: %s\n", filename);
 		return NULL;
 	}
 
 	getFileSize(file, &size);
 
 	if (expectedSize != 0 && size != expectedSize) {
-		printf("Error: invalid file size. Expected %u bytes. Got %u bytes\n", expectedSize, size);
+		log_error("invalid file size. Expected %u bytes. Got %u bytes\n", expectedSize, size);
 		fclose(file);
 		return NULL;
 	}
@@ -69,9 +433,21 @@ int writeFile(const char* filename, void* ptr, const uint32_t bytesToWrite) {
 	if (filename == NULL)
 		return 1;
 
+	if (isMemFile(filename)) {
+		uint8_t* data = (uint8_t*)malloc(bytesToWrite);
+		if (data == NULL)
+			return 1;
+		memcpy(data, ptr, bytesToWrite);
+		if (setMemFile(filename, data, bytesToWrite) != 0) {
+			free(data);
+			return 1;
+		}
+		return 0;
+	}
+
 	fopen_s(&file, filename, "wb");
 	if (file == NULL) {
-		printf("Error: Could not open file: %s\n", filename);
+		log_error("Could not open file: %s\n", filename);
 		return 1;
 	}
 
@@ -80,29 +456,33 @@ int writeFile(const char* filename, void* ptr, const uint32_t bytesToWrite) {
 
 	return 0;
 }
-int writeFileF(const char* filename, const char* tag, void* ptr, const uint32_t bytesToWrite) {
+void printWriteF(const char* filename, const char* tag, const uint32_t bytesWritten) {
 	static const char SUCCESS_OUT[] = "Writing %s to %s ( %.2f %s )\n";
-	static const char FAIL_OUT[] = "Error: Failed to write %s\n";
 	static const char* units[] = { "bytes", "kb", "mb", "gb" };
 
-	int result;
+	int unit;
 	float bytesF;
-	const char* sizeSuffix;
-	
-	bytesF = (float)bytesToWrite;
-	result = 0;
-	while (bytesF > 1024.0f && result < (sizeof(units) / sizeof(char*)) - 1) {
+
+	bytesF = (float)bytesWritten;
+	unit = 0;
+	while (bytesF > 1024.0f && unit < (sizeof(units) / sizeof(char*)) - 1) {
 		bytesF /= 1024.0f;
-		result++;
+		unit++;
 	}
-	sizeSuffix = units[result];
+
+	log_info(SUCCESS_OUT, tag, filename, bytesF, units[unit]);
+}
+int writeFileF(const char* filename, const char* tag, void* ptr, const uint32_t bytesToWrite) {
+	static const char FAIL_OUT[] = "Failed to write %s\n";
+
+	int result;
 
 	result = writeFile(filename, ptr, bytesToWrite);
 	if (result == 0) {
-		printf(SUCCESS_OUT, tag, filename, bytesF, sizeSuffix);
+		printWriteF(filename, tag, bytesToWrite);
 	}
 	else {
-		printf(FAIL_OUT, filename);
+		log_error(FAIL_OUT, filename);
 	}
 
 	return result;
@@ -117,12 +497,117 @@ int getFileSize(FILE* file, uint32_t* fileSize) {
 	fseek(file, 0, SEEK_SET);
 	return 0;
 }
+FILE* openFile(const char* filename, const char* mode) {
+	FILE* stream = NULL;
+	MEM_FILE* mem;
+
+	if (filename == NULL || mode == NULL)
+		return NULL;
+
+	if (!isMemFile(filename)) {
+		fopen_s(&stream, filename, mode);
+		return stream;
+	}
+
+	// a memory file is streamed through an anonymous temp file.
+	if (mode[0] == 'r') {
+		mem = findMemFile(filename);
+		if (mem == NULL)
+			return NULL;
+		stream = tmpfile();
+		if (stream == NULL)
+			return NULL;
+		if (mem->size != 0 && fwrite(mem->data, 1, mem->size, stream) != mem->size) {
+			fclose(stream);
+			return NULL;
+		}
+		rewind(stream);
+		return stream;
+	}
+
+	stream = tmpfile();
+	if (stream == NULL)
+		return NULL;
+	if (setMemFile(filename, NULL, 0) != 0) {
+		fclose(stream);
+		return NULL;
+	}
+	findMemFile(filename)->stream = stream;
+	return stream;
+}
+int closeFile(FILE* stream) {
+	uint8_t* data = NULL;
+	uint32_t size = 0;
+	uint32_t i;
+	int result = 0;
+
+	if (stream == NULL)
+		return 1;
+
+	for (i = 0; i < mem_file_count; ++i) {
+		if (mem_files[i].stream != stream)
+			continue;
+
+		// hand the written bytes to the memory file.
+		mem_files[i].stream = NULL;
+		if (getFileSize(stream, &size) != 0) {
+			result = 1;
+			break;
+		}
+		if (size != 0) {
+			data = (uint8_t*)malloc(size);
+			if (data == NULL || fread(data, 1, size, stream) != size || setMemFile(mem_files[i].name, data, size) != 0) {
+				if (data != NULL)
+					free(data);
+				result = 1;
+			}
+		}
+		break;
+	}
+
+	fclose(stream);
+	return result;
+}
+int syncFile(FILE* stream) {
+	if (stream == NULL || fflush(stream) != 0)
+		return 1;
+
+#ifdef _WIN32
+	if (!FlushFileBuffers((HANDLE)_get_osfhandle(_fileno(stream))))
+		return 1;
+#else
+	if (fsync(fileno(stream)) != 0)
+		return 1;
+#endif
+
+	return 0;
+}
+bool isMemFile(const char* filename) {
+	return filename != NULL && filename[0] == MEM_FILE_PREFIX;
+}
+void freeMemFiles() {
+	uint32_t i;
+
+	for (i = 0; i < mem_file_count; ++i) {
+		free(mem_files[i].name);
+		free(mem_files[i].data);
+	}
+	if (mem_files != NULL) {
+		free(mem_files);
+		mem_files = NULL;
+	}
+	mem_file_count = 0;
+}
+
 bool fileExists(const char* filename) {
 	FILE* file = NULL;
 
 	if (filename == NULL)
 		return false;
 
+	if (isMemFile(filename))
+		return findMemFile(filename) != NULL;
+
 	fopen_s(&file, filename, "rb");
 	if (file == NULL)
 		return false;
@@ -134,6 +619,13 @@ int deleteFile(const char* filename) {
 	if (filename == NULL)
 		return 1;
 
+	if (isMemFile(filename)) {
+		MEM_FILE* mem = findMemFile(filename);
+		if (mem != NULL)
+			removeMemFile(mem);
+		return 0;
+	}
+
 	if (!fileExists(filename))
 		return 0;
 
@@ -142,3 +634,277 @@ int deleteFile(const char* filename) {
 
 	return 0;
 }
+
+bool isDirectory(const char* path) {
+	if (path == NULL)
+		return false;
+
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+int createDirectory(const char* path) {
+	if (path == NULL)
+		return 1;
+
+	if (isDirectory(path))
+		return 0;
+
+#ifdef _WIN32
+	if (!CreateDirectoryA(path, NULL) && GetLastError() != ERROR_ALREADY_EXISTS) {
+#else
+	if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+#endif
+		log_error("could not create directory: %s\n", path);
+		return 1;
+	}
+
+	return 0;
+}
+
+char* tempFileName(const char* filename) {
+	char* temp;
+
+	if (filename == NULL)
+		return NULL;
+
+	temp = (char*)malloc(strlen(filename) + 5);
+	if (temp == NULL)
+		return NULL;
+	sprintf(temp, "%s.tmp", filename);
+	return temp;
+}
+int renameFile(const char* from, const char* to) {
+	if (from == NULL || to == NULL)
+		return 1;
+
+	if (isMemFile(from) || isMemFile(to)) {
+		// memory files only rename to memory files.
+		MEM_FILE* mem = findMemFile(from);
+		if (mem == NULL || !isMemFile(from) || !isMemFile(to))
+			return 1;
+		if (strcmp(from, to) == 0)
+			return 0;
+		if (setMemFile(to, mem->data, mem->size) != 0)
+			return 1;
+		mem = findMemFile(from);
+		mem->data = NULL;
+		removeMemFile(mem);
+		return 0;
+	}
+
+#ifdef _WIN32
+	if (!MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING))
+		return 1;
+#else
+	if (rename(from, to) != 0)
+		return 1;
+#endif
+
+	return 0;
+}
+
+int getFileStat(const char* filename, uint64_t* size, int64_t* mtime) {
+	if (filename == NULL)
+		return 1;
+
+	if (isMemFile(filename)) {
+		MEM_FILE* mem = findMemFile(filename);
+		if (mem == NULL)
+			return 1;
+		if (size != NULL)
+			*size = mem->size;
+		if (mtime != NULL)
+			*mtime = 0;
+		return 0;
+	}
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA fad;
+	if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &fad))
+		return 1;
+	if (size != NULL)
+		*size = ((uint64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+	if (mtime != NULL) {
+		// 100ns intervals since 1601 to seconds since 1970.
+		uint64_t ft = ((uint64_t)fad.ftLastWriteTime.dwHighDateTime << 32) | fad.ftLastWriteTime.dwLowDateTime;
+		*mtime = (int64_t)(ft / 10000000ULL) - 11644473600LL;
+	}
+#else
+	struct stat st;
+	if (stat(filename, &st) != 0)
+		return 1;
+	if (size != NULL)
+		*size = (uint64_t)st.st_size;
+	if (mtime != NULL)
+		*mtime = (int64_t)st.st_mtime;
+#endif
+
+	return 0;
+}
+
+int touchFile(const char* filename) {
+	if (filename == NULL)
+		return 1;
+
+	if (isMemFile(filename))
+		return (findMemFile(filename) != NULL) ? 0 : 1;
+
+#ifdef _WIN32
+	HANDLE file;
+	FILETIME ft;
+	BOOL ok;
+
+	file = CreateFileA(filename, FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return 1;
+	GetSystemTimeAsFileTime(&ft);
+	ok = SetFileTime(file, NULL, NULL, &ft);
+	CloseHandle(file);
+	if (!ok)
+		return 1;
+#else
+	if (utimensat(AT_FDCWD, filename, NULL, 0) != 0)
+		return 1;
+#endif
+
+	return 0;
+}
+
+int enumerateFiles(const char* path, bool recursive, ENUM_FILES_CALLBACK callback, void* context) {
+	char* filename = NULL;
+	size_t pathLen = 0;
+	size_t nameLen = 0;
+	int result = 0;
+	bool dir = false;
+	const char* name = NULL;
+
+	if (path == NULL || callback == NULL)
+		return 1;
+
+	pathLen = strlen(path);
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA fd;
+	HANDLE handle;
+
+	filename = (char*)malloc(pathLen + 3);
+	if (filename == NULL)
+		return 1;
+	sprintf(filename, "%s\\*", path);
+	handle = FindFirstFileA(filename, &fd);
+	free(filename);
+	filename = NULL;
+	if (handle == INVALID_HANDLE_VALUE) {
+		log_error("could not open directory: %s\n", path);
+		return 1;
+	}
+	do {
+		name = fd.cFileName;
+		dir = (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+#else
+	DIR* handle;
+	struct dirent* entry;
+
+	handle = opendir(path);
+	if (handle == NULL) {
+		log_error("could not open directory: %s\n", path);
+		return 1;
+	}
+	while ((entry = readdir(handle)) != NULL) {
+		name = entry->d_name;
+		dir = false;
+#endif
+		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+			continue;
+
+		nameLen = strlen(name);
+		filename = (char*)malloc(pathLen + nameLen + 2);
+		if (filename == NULL) {
+			result = 1;
+			break;
+		}
+#ifdef _WIN32
+		sprintf(filename, "%s\\%s", path, name);
+#else
+		sprintf(filename, "%s/%s", path, name);
+		dir = isDirectory(filename);
+#endif
+		if (dir) {
+			if (recursive)
+				result = enumerateFiles(filename, recursive, callback, context);
+		}
+		else {
+			result = callback(filename, context);
+		}
+
+		free(filename);
+		filename = NULL;
+
+		if (result != 0)
+			break;
+#ifdef _WIN32
+	} while (FindNextFileA(handle, &fd));
+	FindClose(handle);
+#else
+	}
+	closedir(handle);
+#endif
+
+	return result;
+}
+
+static MEM_FILE* findMemFile(const char* filename) {
+	uint32_t i;
+
+	for (i = 0; i < mem_file_count; ++i) {
+		if (strcmp(mem_files[i].name, filename) == 0)
+			return &mem_files[i];
+	}
+	return NULL;
+}
+static int setMemFile(const char* filename, uint8_t* data, const uint32_t size) {
+	// create or replace a memory file. takes ownership of data if successful.
+
+	MEM_FILE* mem;
+	MEM_FILE* new_files;
+	char* name;
+
+	mem = findMemFile(filename);
+	if (mem != NULL) {
+		if (mem->data != data)
+			free(mem->data);
+		mem->data = data;
+		mem->size = size;
+		return 0;
+	}
+
+	name = (char*)malloc(strlen(filename) + 1);
+	if (name == NULL)
+		return 1;
+	strcpy(name, filename);
+
+	new_files = (MEM_FILE*)realloc(mem_files, (mem_file_count + 1) * sizeof(MEM_FILE));
+	if (new_files == NULL) {
+		free(name);
+		return 1;
+	}
+	mem_files = new_files;
+	mem_files[mem_file_count].name = name;
+	mem_files[mem_file_count].data = data;
+	mem_files[mem_file_count].size = size;
+	mem_files[mem_file_count].stream = NULL;
+	mem_file_count++;
+	return 0;
+}
+static void removeMemFile(MEM_FILE* file) {
+	free(file->name);
+	if (file->data != NULL)
+		free(file->data);
+	*file = mem_files[--mem_file_count];
+}
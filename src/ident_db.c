@@ -0,0 +1,510 @@
+// ident_db.c: Implements the known component identification database.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// user incl
+#include "ident_db.h"
+#include "bldr.h"
+#include "file.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define IDENT_DB_MIN_SLOTS 8
+
+// a built-in entry
+typedef struct {
+	IDENT_TYPE type;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	const char* name;
+	const char* version;
+	MCPX_REV mcpx_rev;
+	uint16_t sbkey_offset;
+} IDENT_BUILTIN;
+
+// a parsed data file line
+typedef struct {
+	IDENT_TYPE type;
+	uint8_t hash[SHA1_DIGEST_LEN];
+	const char* name;
+	const char* version;
+	MCPX_REV mcpx_rev;
+	uint16_t sbkey_offset;
+} IDENT_LINE;
+
+// accepted mcpx roms. the sb key is read from the rom at sbkey_offset.
+static const IDENT_BUILTIN builtin[] = {
+	{ IDENT_TYPE_MCPX, {
+		0x5d, 0x27, 0x06, 0x75, 0xb5, 0x4e, 0xb8, 0x07, 0x1b, 0x48,
+		0x0e, 0x42, 0xd2, 0x2a, 0x30, 0x15, 0xac, 0x21, 0x1c, 0xef },
+		"MCPX", "1.0", MCPX_REV_0, 0x1A5 },
+	{ IDENT_TYPE_MCPX, {
+		0x6c, 0x87, 0x5f, 0x17, 0xf7, 0x73, 0xaa, 0xec, 0x51, 0xeb,
+		0x43, 0x40, 0x68, 0xbb, 0x6c, 0x65, 0x7c, 0x43, 0x43, 0xc0 },
+		"MCPX", "1.1", MCPX_REV_1, 0x19C },
+	{ IDENT_TYPE_MCPX, {
+		0xb9, 0xe8, 0x8e, 0x37, 0x50, 0x40, 0xbf, 0xaf, 0x90, 0x28,
+		0x15, 0xbe, 0x99, 0x16, 0x8c, 0x8b, 0x05, 0x14, 0x71, 0x37 },
+		"M.O.U.S.E rev 0", "", MCPX_REV_0, 0x19C },
+	{ IDENT_TYPE_MCPX, {
+		0x15, 0x13, 0xab, 0xcb, 0x6b, 0x97, 0x9f, 0x79, 0x53, 0x6f,
+		0xcf, 0x0e, 0xd9, 0x67, 0xf3, 0x77, 0x55, 0xe0, 0x7f, 0x9b },
+		"M.O.U.S.E rev 1", "", MCPX_REV_1, 0x19C },
+};
+
+static const char* type_names[IDENT_TYPE_COUNT] = {
+	"none", "mcpx", "preldr", "bldr", "inittbl", "krnl", "krnldata"
+};
+
+static int table_open(IDENT_DB_TABLE* table, const uint8_t* image, const uint32_t size);
+static int table_find(const IDENT_DB_TABLE* table, const IDENT_TYPE type, const uint8_t* hash, IDENT_ENTRY* entry);
+static int parse_line(char* line, IDENT_LINE* entry);
+static char* next_token(char** str);
+static int parse_hash(const char* str, uint8_t* hash);
+static uint32_t hash_index(const uint8_t* hash);
+
+void ident_db_init(IDENT_DB* db) {
+	memset(db, 0, sizeof(IDENT_DB));
+}
+void ident_db_free(IDENT_DB* db) {
+	uint32_t i;
+
+	for (i = 0; i < db->count; ++i) {
+		if (db->tables[i].image != NULL) {
+			free(db->tables[i].image);
+		}
+		else {
+			unmapFile(&db->tables[i].map);
+		}
+	}
+	memset(db, 0, sizeof(IDENT_DB));
+}
+
+int ident_db_load(IDENT_DB* db, const char* path) {
+	IDENT_DB_TABLE* table;
+	uint8_t* image = NULL;
+	uint32_t size = 0;
+	int result;
+
+	if (db->count >= IDENT_DB_MAX_TABLES) {
+		log_error("Too many identification databases\n");
+		return IDENT_DB_ERROR_FAILED;
+	}
+
+	table = &db->tables[db->count];
+	memset(table, 0, sizeof(IDENT_DB_TABLE));
+
+	if (mapFile(path, &table->map) != 0)
+		return IDENT_DB_ERROR_FAILED;
+
+	if (table->map.size >= sizeof(IDENT_DB_HEADER) && ((const IDENT_DB_HEADER*)table->map.data)->magic == IDENT_DB_MAGIC) {
+		// a compiled database; used in place.
+		result = table_open(table, table->map.data, table->map.size);
+		if (result != IDENT_DB_ERROR_SUCCESS) {
+			log_error("'%s' is not a valid identification database\n", path);
+			unmapFile(&table->map);
+			return result;
+		}
+		db->count++;
+		return IDENT_DB_ERROR_SUCCESS;
+	}
+
+	// a data file
+	unmapFile(&table->map);
+
+	result = ident_db_compile(path, &image, &size);
+	if (result != IDENT_DB_ERROR_SUCCESS)
+		return result;
+
+	result = table_open(table, image, size);
+	if (result != IDENT_DB_ERROR_SUCCESS) {
+		free(image);
+		return result;
+	}
+	table->image = image;
+	db->count++;
+
+	return IDENT_DB_ERROR_SUCCESS;
+}
+
+int ident_db_compile(const char* path, uint8_t** image, uint32_t* size) {
+	IDENT_LINE* lines = NULL;
+	IDENT_LINE* new_lines;
+	IDENT_DB_HEADER* header;
+	IDENT_DB_SLOT* slots;
+	IDENT_DB_SLOT* slot;
+	char* text = NULL;
+	char* strings;
+	char* line;
+	char* next;
+	uint8_t* data = NULL;
+	uint32_t data_size = 0;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+	uint32_t line_num = 0;
+	uint32_t slot_count;
+	uint32_t strings_size = 1;
+	uint32_t entry_count = 0;
+	uint32_t image_size;
+	uint32_t offset;
+	uint32_t mask;
+	uint32_t index;
+	uint32_t len;
+	uint32_t i;
+	int result = IDENT_DB_ERROR_FAILED;
+
+	*image = NULL;
+	*size = 0;
+
+	data = readFile(path, &data_size, 0);
+	if (data == NULL)
+		return IDENT_DB_ERROR_FAILED;
+
+	text = (char*)malloc(data_size + 1);
+	if (text == NULL)
+		goto Cleanup;
+	memcpy(text, data, data_size);
+	text[data_size] = '\0';
+
+	// parse the lines; the names point into the text.
+	for (line = text; line != NULL; line = next) {
+		next = strchr(line, '\n');
+		if (next != NULL) {
+			*next++ = '\0';
+		}
+		line_num++;
+
+		if (count == capacity) {
+			capacity = (capacity > 0) ? capacity * 2 : 64;
+			new_lines = (IDENT_LINE*)realloc(lines, capacity * sizeof(IDENT_LINE));
+			if (new_lines == NULL)
+				goto Cleanup;
+			lines = new_lines;
+		}
+
+		result = parse_line(line, &lines[count]);
+		if (result == IDENT_DB_ERROR_NOT_FOUND) {
+			result = IDENT_DB_ERROR_FAILED;
+			continue;
+		}
+		if (result != IDENT_DB_ERROR_SUCCESS) {
+			log_error("Invalid entry on line %u of '%s'\n", line_num, path);
+			goto Cleanup;
+		}
+		result = IDENT_DB_ERROR_FAILED;
+
+		strings_size += (uint32_t)strlen(lines[count].name) + 1;
+		strings_size += (uint32_t)strlen(lines[count].version) + 1;
+		count++;
+	}
+
+	// at most half of the slots are used, so probe runs stay short.
+	slot_count = IDENT_DB_MIN_SLOTS;
+	while (slot_count < count * 2) {
+		slot_count <<= 1;
+	}
+
+	image_size = sizeof(IDENT_DB_HEADER) + slot_count * sizeof(IDENT_DB_SLOT) + strings_size;
+	*image = (uint8_t*)calloc(1, image_size);
+	if (*image == NULL)
+		goto Cleanup;
+
+	header = (IDENT_DB_HEADER*)*image;
+	slots = (IDENT_DB_SLOT*)(*image + sizeof(IDENT_DB_HEADER));
+	strings = (char*)(slots + slot_count);
+	offset = 1;
+	mask = slot_count - 1;
+
+	for (i = 0; i < count; ++i) {
+		// a later line replaces an earlier line for the same component.
+		index = hash_index(lines[i].hash) & mask;
+		for (;;) {
+			slot = &slots[index];
+			if (slot->type == IDENT_TYPE_NONE) {
+				entry_count++;
+				break;
+			}
+			if (slot->type == lines[i].type && memcmp(slot->hash, lines[i].hash, SHA1_DIGEST_LEN) == 0)
+				break;
+			index = (index + 1) & mask;
+		}
+
+		memcpy(slot->hash, lines[i].hash, SHA1_DIGEST_LEN);
+		slot->type = (uint8_t)lines[i].type;
+		slot->mcpx_rev = (uint8_t)lines[i].mcpx_rev;
+		slot->sbkey_offset = lines[i].sbkey_offset;
+
+		slot->name = 0;
+		len = (uint32_t)strlen(lines[i].name);
+		if (len > 0) {
+			slot->name = offset;
+			memcpy(strings + offset, lines[i].name, len + 1);
+			offset += len + 1;
+		}
+		slot->version = 0;
+		len = (uint32_t)strlen(lines[i].version);
+		if (len > 0) {
+			slot->version = offset;
+			memcpy(strings + offset, lines[i].version, len + 1);
+			offset += len + 1;
+		}
+	}
+
+	header->magic = IDENT_DB_MAGIC;
+	header->version = IDENT_DB_VERSION;
+	header->slot_count = slot_count;
+	header->entry_count = entry_count;
+	header->strings_size = offset;
+
+	*size = sizeof(IDENT_DB_HEADER) + slot_count * sizeof(IDENT_DB_SLOT) + offset;
+	result = IDENT_DB_ERROR_SUCCESS;
+
+Cleanup:
+	if (result != IDENT_DB_ERROR_SUCCESS && *image != NULL) {
+		free(*image);
+		*image = NULL;
+	}
+	if (lines != NULL) {
+		free(lines);
+	}
+	if (text != NULL) {
+		free(text);
+	}
+	if (data != NULL) {
+		free(data);
+	}
+	return result;
+}
+
+int ident_db_find(const IDENT_DB* db, const IDENT_TYPE type, const uint8_t hash[SHA1_DIGEST_LEN], IDENT_ENTRY* entry) {
+	uint32_t i;
+
+	if (db != NULL) {
+		for (i = db->count; i > 0; --i) {
+			if (table_find(&db->tables[i - 1], type, hash, entry) == IDENT_DB_ERROR_SUCCESS)
+				return IDENT_DB_ERROR_SUCCESS;
+		}
+	}
+
+	for (i = 0; i < sizeof(builtin) / sizeof(IDENT_BUILTIN); ++i) {
+		if (builtin[i].type == type && memcmp(builtin[i].hash, hash, SHA1_DIGEST_LEN) == 0) {
+			entry->type = type;
+			entry->name = builtin[i].name;
+			entry->version = builtin[i].version;
+			entry->mcpx_rev = builtin[i].mcpx_rev;
+			entry->sbkey_offset = builtin[i].sbkey_offset;
+			return IDENT_DB_ERROR_SUCCESS;
+		}
+	}
+
+	return IDENT_DB_ERROR_NOT_FOUND;
+}
+
+const char* ident_type_name(const IDENT_TYPE type) {
+	if (type >= IDENT_TYPE_COUNT)
+		return "unknown";
+	return type_names[type];
+}
+
+static int table_open(IDENT_DB_TABLE* table, const uint8_t* image, const uint32_t size) {
+	// check the header only; the slots are checked as they are probed.
+
+	const IDENT_DB_HEADER* header = (const IDENT_DB_HEADER*)image;
+	uint64_t expected;
+
+	if (size < sizeof(IDENT_DB_HEADER) || header->magic != IDENT_DB_MAGIC || header->version != IDENT_DB_VERSION)
+		return IDENT_DB_ERROR_INVALID;
+
+	if (header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0 || header->strings_size == 0)
+		return IDENT_DB_ERROR_INVALID;
+
+	expected = sizeof(IDENT_DB_HEADER) + (uint64_t)header->slot_count * sizeof(IDENT_DB_SLOT) + header->strings_size;
+	if (expected != size)
+		return IDENT_DB_ERROR_INVALID;
+
+	table->header = header;
+	table->slots = (const IDENT_DB_SLOT*)(image + sizeof(IDENT_DB_HEADER));
+	table->strings = (const char*)(table->slots + header->slot_count);
+
+	// every string ends inside the table.
+	if (table->strings[0] != '\0' || table->strings[header->strings_size - 1] != '\0')
+		return IDENT_DB_ERROR_INVALID;
+
+	return IDENT_DB_ERROR_SUCCESS;
+}
+static int table_find(const IDENT_DB_TABLE* table, const IDENT_TYPE type, const uint8_t* hash, IDENT_ENTRY* entry) {
+	const IDENT_DB_SLOT* slot;
+	const uint32_t mask = table->header->slot_count - 1;
+	const uint32_t strings_size = table->header->strings_size;
+	uint32_t index = hash_index(hash) & mask;
+	uint32_t i;
+
+	for (i = 0; i <= mask; ++i) {
+		slot = &table->slots[index];
+		if (slot->type == IDENT_TYPE_NONE)
+			break;
+
+		if (slot->type == type && memcmp(slot->hash, hash, SHA1_DIGEST_LEN) == 0) {
+			// the sb key is read from the rom at this offset; it must end inside the rom.
+			if (slot->sbkey_offset > MCPX_BLOCK_SIZE - XB_KEY_SIZE)
+				return IDENT_DB_ERROR_INVALID;
+
+			entry->type = type;
+			entry->name = table->strings + ((slot->name < strings_size) ? slot->name : 0);
+			entry->version = table->strings + ((slot->version < strings_size) ? slot->version : 0);
+			entry->mcpx_rev = (slot->mcpx_rev <= MCPX_REV_1) ? (MCPX_REV)slot->mcpx_rev : MCPX_REV_UNK;
+			entry->sbkey_offset = slot->sbkey_offset;
+			return IDENT_DB_ERROR_SUCCESS;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	return IDENT_DB_ERROR_NOT_FOUND;
+}
+
+static int parse_line(char* line, IDENT_LINE* entry) {
+	// returns IDENT_DB_ERROR_NOT_FOUND for a blank or comment line.
+
+	char* token;
+	char* value;
+	char* end;
+	uint32_t i;
+	unsigned long n;
+
+	memset(entry, 0, sizeof(IDENT_LINE));
+	entry->mcpx_rev = MCPX_REV_UNK;
+	entry->version = "";
+
+	token = next_token(&line);
+	if (token == NULL)
+		return IDENT_DB_ERROR_NOT_FOUND;
+
+	for (i = IDENT_TYPE_NONE + 1; i < IDENT_TYPE_COUNT; ++i) {
+		if (strcmp(token, type_names[i]) == 0) {
+			entry->type = (IDENT_TYPE)i;
+			break;
+		}
+	}
+	if (entry->type == IDENT_TYPE_NONE)
+		return IDENT_DB_ERROR_INVALID;
+
+	token = next_token(&line);
+	if (token == NULL || parse_hash(token, entry->hash) != 0)
+		return IDENT_DB_ERROR_INVALID;
+
+	entry->name = next_token(&line);
+	if (entry->name == NULL)
+		return IDENT_DB_ERROR_INVALID;
+
+	while ((token = next_token(&line)) != NULL) {
+		value = strchr(token, '=');
+		if (value == NULL) {
+			// the version; once, before the options.
+			if (entry->version[0] != '\0' || entry->mcpx_rev != MCPX_REV_UNK || entry->sbkey_offset != 0)
+				return IDENT_DB_ERROR_INVALID;
+			entry->version = token;
+			continue;
+		}
+
+		*value++ = '\0';
+		n = strtoul(value, &end, 0);
+		if (end == value || *end != '\0')
+			return IDENT_DB_ERROR_INVALID;
+
+		if (strcmp(token, "rev") == 0 && n <= 1) {
+			entry->mcpx_rev = (n == 0) ? MCPX_REV_0 : MCPX_REV_1;
+		}
+		else if (strcmp(token, "sbkey") == 0 && n <= MCPX_BLOCK_SIZE - XB_KEY_SIZE) {
+			entry->sbkey_offset = (uint16_t)n;
+		}
+		else {
+			return IDENT_DB_ERROR_INVALID;
+		}
+	}
+
+	return IDENT_DB_ERROR_SUCCESS;
+}
+static char* next_token(char** str) {
+	// split off the next token. a quoted token can hold spaces. NULL at the end of the line or at a comment.
+
+	char* p = *str;
+	char* token;
+
+	while (*p == ' ' || *p == '\t' || *p == '\r')
+		p++;
+
+	if (*p == '\0' || *p == '#' || *p == ';') {
+		*str = p;
+		return NULL;
+	}
+
+	if (*p == '"') {
+		token = ++p;
+		while (*p != '\0' && *p != '"')
+			p++;
+	}
+	else {
+		token = p;
+		while (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\r')
+			p++;
+	}
+
+	if (*p != '\0') {
+		*p++ = '\0';
+	}
+	*str = p;
+
+	return token;
+}
+static int parse_hash(const char* str, uint8_t* hash) {
+	uint32_t i;
+	int hi;
+	int lo;
+
+	if (strlen(str) != SHA1_DIGEST_LEN * 2)
+		return 1;
+
+	for (i = 0; i < SHA1_DIGEST_LEN; ++i) {
+		hi = str[i * 2];
+		lo = str[i * 2 + 1];
+		hi = (hi >= '0' && hi <= '9') ? hi - '0' : (hi >= 'a' && hi <= 'f') ? hi - 'a' + 10 : (hi >= 'A' && hi <= 'F') ? hi - 'A' + 10 : -1;
+		lo = (lo >= '0' && lo <= '9') ? lo - '0' : (lo >= 'a' && lo <= 'f') ? lo - 'a' + 10 : (lo >= 'A' && lo <= 'F') ? lo - 'A' + 10 : -1;
+		if (hi < 0 || lo < 0)
+			return 1;
+		hash[i] = (uint8_t)((hi << 4) | lo);
+	}
+
+	return 0;
+}
+static uint32_t hash_index(const uint8_t* hash) {
+	// sha-1 bytes are uniform; the first 4 are the index.
+	uint32_t index;
+	memcpy(&index, hash, sizeof(uint32_t));
+	return index;
+}
@@ -0,0 +1,593 @@
+// keyring.cpp: Implements a set of candidate keys and a parallel key trial engine for BIOS images with unknown keys.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <malloc.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// user incl
+#include "keyring.h"
+#include "Bios.h"
+#include "Mcpx.h"
+#include "bldr.h"
+#include "file.h"
+#include "lzx.h"
+#include "rc4.h"
+#include "util.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define KEYRING_LANES 4						// candidates per rc4_lanes batch
+#define KEYRING_MAX_FILE_SIZE 0x1000		// max size of a packed key list file
+#define KEYRING_KERNEL_BLOCKS 16			// lzx block headers to validate before accepting a kernel key
+
+// keystream offsets into the 2BL block
+#define TRIAL_BOOT_PARAMS_OFFSET (BLDR_BLOCK_SIZE - sizeof(BOOT_PARAMS))
+#define TRIAL_PRELDR_BOOT_PARAMS_OFFSET (TRIAL_BOOT_PARAMS_OFFSET - PRELDR_NONCE_SIZE)
+#define TRIAL_PRELDR_ENTRY_OFFSET (BLDR_BLOCK_SIZE - PRELDR_BLOCK_SIZE - sizeof(PRELDR_ENTRY))
+
+typedef struct {
+	const KEYRING* keyring;
+	const uint8_t* bldr;		// encrypted 2BL block in the image
+	const uint8_t* nonce;		// preldr nonce
+	uint32_t size;				// image size
+	int plain_batches;			// batches [0, plain_batches) try the 2BL path, the rest try the FBL path.
+	int* preldr_keys;			// keyring indices of the FBL candidates
+	int preldr_count;
+} TRIAL_CONTEXT;
+
+static int keyring_load_file(const char* filename, void* context);
+static bool trial_boot_params(const BOOT_PARAMS* boot_params, const uint32_t size);
+static bool trial_plain_bldr(const uint8_t* bldr, const uint32_t size);
+static int trial_bldr_batch(const TRIAL_CONTEXT* tc, const int batch);
+static bool trial_kernel(const uint8_t* kernel, const uint32_t kernel_size, const uint8_t* key);
+static void trial_find_kernel_key(const KEYRING* keyring, const uint8_t* data, const uint32_t size, KEYRING_MATCH* match);
+
+template <typename F>
+static int run_parallel(const int count, F trial, int* lane);
+
+void keyring_init(KEYRING* keyring) {
+	keyring->keys = NULL;
+	keyring->count = 0;
+	keyring->capacity = 0;
+}
+void keyring_free(KEYRING* keyring) {
+	if (keyring->keys != NULL) {
+		free(keyring->keys);
+		keyring->keys = NULL;
+	}
+	keyring->count = 0;
+	keyring->capacity = 0;
+}
+
+int keyring_add(KEYRING* keyring, const uint8_t* key, MCPX_REV rev, const char* name) {
+	// add a key to the keyring; skip duplicates.
+
+	KEYRING_KEY* keys;
+	uint32_t i;
+
+	for (i = 0; i < keyring->count; ++i) {
+		if (memcmp(keyring->keys[i].key, key, XB_KEY_SIZE) == 0) {
+			if (keyring->keys[i].rev != rev)
+				keyring->keys[i].rev = MCPX_REV_UNK; // try both paths
+			return KEYRING_ERROR_SUCCESS;
+		}
+	}
+
+	if (keyring->count == keyring->capacity) {
+		i = (keyring->capacity == 0) ? 16 : keyring->capacity * 2;
+		keys = (KEYRING_KEY*)realloc(keyring->keys, i * sizeof(KEYRING_KEY));
+		if (keys == NULL)
+			return KEYRING_ERROR_FAILED;
+		keyring->keys = keys;
+		keyring->capacity = i;
+	}
+
+	keys = &keyring->keys[keyring->count];
+	memcpy(keys->key, key, XB_KEY_SIZE);
+	keys->rev = rev;
+	keys->name[0] = '\0';
+	if (name != NULL) {
+		strncpy(keys->name, name, KEYRING_NAME_LEN - 1);
+		keys->name[KEYRING_NAME_LEN - 1] = '\0';
+	}
+
+	keyring->count++;
+	return KEYRING_ERROR_SUCCESS;
+}
+
+int keyring_load(KEYRING* keyring, const char* path) {
+	// load keys from a file or a directory of key files.
+
+	int result;
+
+	if (isDirectory(path)) {
+		result = enumerateFiles(path, false, keyring_load_file, keyring);
+	}
+	else {
+		result = keyring_load_file(path, keyring);
+	}
+
+	if (result != 0)
+		return KEYRING_ERROR_FAILED;
+
+	return KEYRING_ERROR_SUCCESS;
+}
+
+int keyring_trial(const KEYRING* keyring, const uint8_t* data, const uint32_t size, KEYRING_MATCH* match) {
+	// try every key against the 2BL, then find the kernel key.
+
+	TRIAL_CONTEXT tc;
+	int batch;
+	int lane;
+	uint32_t i;
+
+	match->bldr_key = KEYRING_NO_MATCH;
+	match->kernel_key = KEYRING_NO_MATCH;
+	match->preldr = false;
+	match->trials = 0;
+	memset(match->preldr_key, 0, SHA1_DIGEST_LEN);
+
+	if (size < BLDR_BLOCK_SIZE + MCPX_BLOCK_SIZE)
+		return KEYRING_ERROR_NO_MATCH;
+
+	// a 2BL that is not encrypted needs no key; only the kernel key is looked for.
+	if (trial_plain_bldr(data + size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE, size)) {
+		match->bldr_key = KEYRING_KEY_NONE;
+		trial_find_kernel_key(keyring, data, size, match);
+		return KEYRING_ERROR_SUCCESS;
+	}
+
+	if (keyring->count == 0)
+		return KEYRING_ERROR_NO_MATCH;
+
+	tc.keyring = keyring;
+	tc.size = size;
+	tc.bldr = data + size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE;
+	tc.nonce = tc.bldr + BLDR_BLOCK_SIZE - PRELDR_NONCE_SIZE;
+	tc.plain_batches = (keyring->count + KEYRING_LANES - 1) / KEYRING_LANES;
+	tc.preldr_count = 0;
+	tc.preldr_keys = NULL;
+
+	// FBL candidates; only if the preldr jmp is present. rev 0 keys never go through the FBL.
+	if (((PRELDR_PARAMS*)(tc.bldr + BLDR_BLOCK_SIZE - PRELDR_BLOCK_SIZE))->jmp_opcode == 0xE9) {
+		tc.preldr_keys = (int*)malloc(keyring->count * sizeof(int));
+		if (tc.preldr_keys == NULL)
+			return KEYRING_ERROR_NO_MATCH;
+		for (i = 0; i < keyring->count; ++i) {
+			if (keyring->keys[i].rev != MCPX_REV_0)
+				tc.preldr_keys[tc.preldr_count++] = i;
+		}
+	}
+
+	// cheap 2BL path batches first, then the FBL batches.
+	batch = run_parallel(tc.plain_batches + (tc.preldr_count + KEYRING_LANES - 1) / KEYRING_LANES,
+		[&tc](int b) { return trial_bldr_batch(&tc, b); }, &lane);
+
+	match->trials = keyring->count + tc.preldr_count;
+
+	if (batch != KEYRING_NO_MATCH) {
+		if (batch < tc.plain_batches) {
+			match->bldr_key = batch * KEYRING_LANES + lane;
+		}
+		else {
+			match->bldr_key = tc.preldr_keys[(batch - tc.plain_batches) * KEYRING_LANES + lane];
+			match->preldr = true;
+			bios_preldr_create_key(keyring->keys[match->bldr_key].key, tc.nonce, match->preldr_key);
+		}
+		trial_find_kernel_key(keyring, data, size, match);
+	}
+
+	if (tc.preldr_keys != NULL) {
+		free(tc.preldr_keys);
+		tc.preldr_keys = NULL;
+	}
+
+	return (match->bldr_key != KEYRING_NO_MATCH) ? KEYRING_ERROR_SUCCESS : KEYRING_ERROR_NO_MATCH;
+}
+
+int keyring_find_keys(const KEYRING* keyring, const uint8_t* data, const uint32_t size, BIOS_LOAD_PARAMS* params, MCPX* mcpx, KEYRING_MATCH* match) {
+	// the load only reads the keys.
+
+	if (keyring_trial(keyring, data, size, match) != KEYRING_ERROR_SUCCESS)
+		return KEYRING_ERROR_NO_MATCH;
+
+	if (match->bldr_key == KEYRING_KEY_NONE) {
+		// the load reads the 2BL as it is; the mcpx is left as the caller set it.
+		params->bldr_key = NULL;
+		params->enc_bldr = true;
+	}
+	else {
+		mcpx_init(mcpx);
+		mcpx->rev = match->preldr ? MCPX_REV_1 : MCPX_REV_0;
+		params->mcpx = mcpx;
+		params->bldr_key = (uint8_t*)keyring->keys[match->bldr_key].key;
+	}
+
+	switch (match->kernel_key) {
+		case KEYRING_KEY_NONE:
+			params->kernel_key = NULL;
+			params->enc_kernel = true;
+			break;
+		case KEYRING_KEY_BLDR:
+			params->kernel_key = NULL;
+			break;
+		case KEYRING_NO_MATCH:
+			break;
+		default:
+			params->kernel_key = (uint8_t*)keyring->keys[match->kernel_key].key;
+			break;
+	}
+
+	return KEYRING_ERROR_SUCCESS;
+}
+
+static int keyring_load_file(const char* filename, void* context) {
+	// load a key file into the keyring. unrecognized files are skipped.
+
+	KEYRING* keyring = (KEYRING*)context;
+	MCPX mcpx;
+	const char* name;
+	char key_name[KEYRING_NAME_LEN];
+	uint8_t* data;
+	uint32_t size = 0;
+	uint32_t i;
+	int result = KEYRING_ERROR_SUCCESS;
+
+	data = readFile(filename, &size, 0);
+	if (data == NULL)
+		return 1;
+
+	// strip the directory from the name
+	name = filename;
+	for (i = 0; filename[i] != '\0'; ++i) {
+		if (filename[i] == '\\' || filename[i] == '/')
+			name = filename + i + 1;
+	}
+
+	if (size == XB_KEY_SIZE) {
+		result = keyring_add(keyring, data, MCPX_REV_UNK, name);
+	}
+	else if (size == MCPX_BLOCK_SIZE) {
+		mcpx_init(&mcpx);
+		if (mcpx_load(&mcpx, data) == 0) {
+			result = keyring_add(keyring, mcpx.sbkey, mcpx.rev, name);
+		}
+		else {
+			// unknown MCPX dump; try the sb key at both known offsets.
+			snprintf(key_name, KEYRING_NAME_LEN, "%s+0x19c", name);
+			result = keyring_add(keyring, data + 0x19C, MCPX_REV_UNK, key_name);
+			if (result == KEYRING_ERROR_SUCCESS) {
+				snprintf(key_name, KEYRING_NAME_LEN, "%s+0x1a5", name);
+				result = keyring_add(keyring, data + 0x1A5, MCPX_REV_0, key_name);
+			}
+		}
+	}
+	else if (size % XB_KEY_SIZE == 0 && size <= KEYRING_MAX_FILE_SIZE) {
+		// packed key list
+		for (i = 0; i < size / XB_KEY_SIZE && result == KEYRING_ERROR_SUCCESS; ++i) {
+			snprintf(key_name, KEYRING_NAME_LEN, "%s[%u]", name, i);
+			result = keyring_add(keyring, data + i * XB_KEY_SIZE, MCPX_REV_UNK, key_name);
+		}
+	}
+
+	free(data);
+
+	return result;
+}
+
+static bool trial_boot_params(const BOOT_PARAMS* boot_params, const uint32_t size) {
+	// validate decrypted boot params.
+
+	if (boot_params->signature != BOOT_SIGNATURE)
+		return false;
+	if (boot_params->init_tbl_size > size)
+		return false;
+	if (boot_params->compressed_kernel_size > size || boot_params->uncompressed_kernel_data_size > size)
+		return false;
+	if (boot_params->compressed_kernel_size + boot_params->uncompressed_kernel_data_size > size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE)
+		return false;
+	return true;
+}
+
+static bool trial_plain_bldr(const uint8_t* bldr, const uint32_t size) {
+	// validate a 2BL as it is in the image; same checks as a decrypted one.
+
+	const uint32_t entry = ((const BOOT_LDR_PARAM*)bldr)->bldr_entry_point;
+
+	if ((entry & 0xFFFF0000) != BLDR_BASE || (entry & 0x0000FFFF) >= BLDR_BLOCK_SIZE)
+		return false;
+	return trial_boot_params((const BOOT_PARAMS*)(bldr + TRIAL_BOOT_PARAMS_OFFSET), size);
+}
+
+static int trial_bldr_batch(const TRIAL_CONTEXT* tc, const int batch) {
+	// try a batch of keys against the 2BL. only the keystream needed to reach the checked fields is generated.
+	// returns the first lane that decrypted the 2BL, or KEYRING_NO_MATCH.
+
+	RC4_CONTEXT context[KEYRING_LANES];
+	uint8_t field[KEYRING_LANES][sizeof(BOOT_PARAMS)];
+	uint8_t* ptrs[KEYRING_LANES];
+	uint8_t message[KEYRING_LANES][XB_KEY_SIZE + PRELDR_NONCE_SIZE + XB_KEY_SIZE];
+	const uint8_t* messages[KEYRING_LANES] = {};
+	uint32_t lens[KEYRING_LANES] = {};
+	uint8_t key[KEYRING_LANES][SHA1_DIGEST_LEN];
+	bool valid[KEYRING_LANES];
+	bool any;
+	int first;
+	int count;
+	int n;
+
+	const bool preldr = (batch >= tc->plain_batches);
+
+	if (!preldr) {
+		first = batch * KEYRING_LANES;
+		count = tc->keyring->count - first;
+	}
+	else {
+		first = (batch - tc->plain_batches) * KEYRING_LANES;
+		count = tc->preldr_count - first;
+	}
+	if (count > KEYRING_LANES)
+		count = KEYRING_LANES;
+
+	if (!preldr) {
+		for (n = 0; n < count; ++n) {
+			rc4_key(&context[n], tc->keyring->keys[first + n].key, XB_KEY_SIZE);
+		}
+	}
+	else {
+		// derive the FBL keys for the whole batch at once; sha1(sbkey + nonce + (sbkey ^ 0x5C))
+		for (n = 0; n < count; ++n) {
+			const uint8_t* sbkey = tc->keyring->keys[tc->preldr_keys[first + n]].key;
+			memcpy(message[n], sbkey, XB_KEY_SIZE);
+			memcpy(message[n] + XB_KEY_SIZE, tc->nonce, PRELDR_NONCE_SIZE);
+			for (int i = 0; i < XB_KEY_SIZE; ++i)
+				message[n][XB_KEY_SIZE + PRELDR_NONCE_SIZE + i] = sbkey[i] ^ 0x5C;
+			messages[n] = message[n];
+			lens[n] = sizeof(message[n]);
+		}
+		SHA1Multi(messages, lens, key, count);
+		for (n = 0; n < count; ++n) {
+			rc4_key(&context[n], key[n], SHA1_DIGEST_LEN);
+		}
+	}
+
+	for (n = 0; n < count; ++n) {
+		ptrs[n] = field[n];
+		valid[n] = true;
+	}
+
+	if (!preldr) {
+		// 2BL entry point; the first 4 bytes of the 2BL.
+		for (n = 0; n < count; ++n)
+			memcpy(field[n], tc->bldr, sizeof(uint32_t));
+		rc4_lanes(context, ptrs, count, sizeof(uint32_t));
+
+		any = false;
+		for (n = 0; n < count; ++n) {
+			const uint32_t entry = *(uint32_t*)field[n];
+			valid[n] = (entry & 0xFFFF0000) == BLDR_BASE && (entry & 0x0000FFFF) < BLDR_BLOCK_SIZE;
+			any |= valid[n];
+		}
+		if (!any)
+			return KEYRING_NO_MATCH;
+
+		rc4_lanes(context, NULL, count, TRIAL_BOOT_PARAMS_OFFSET - sizeof(uint32_t));
+		for (n = 0; n < count; ++n)
+			memcpy(field[n], tc->bldr + TRIAL_BOOT_PARAMS_OFFSET, sizeof(BOOT_PARAMS));
+		rc4_lanes(context, ptrs, count, sizeof(BOOT_PARAMS));
+	}
+	else {
+		// 2BL entry offset stored just before the FBL block; the first 16 bytes of the 2BL were zeroed.
+		rc4_lanes(context, NULL, count, TRIAL_PRELDR_ENTRY_OFFSET);
+		for (n = 0; n < count; ++n)
+			memcpy(field[n], tc->bldr + TRIAL_PRELDR_ENTRY_OFFSET, sizeof(PRELDR_ENTRY));
+		rc4_lanes(context, ptrs, count, sizeof(PRELDR_ENTRY));
+
+		any = false;
+		for (n = 0; n < count; ++n) {
+			valid[n] = ((PRELDR_ENTRY*)field[n])->bldr_entry_offset < BLDR_BLOCK_SIZE;
+			any |= valid[n];
+		}
+		if (!any)
+			return KEYRING_NO_MATCH;
+
+		// boot params sit 16 bytes early; the preldr nonce follows them.
+		rc4_lanes(context, NULL, count, TRIAL_PRELDR_BOOT_PARAMS_OFFSET - TRIAL_PRELDR_ENTRY_OFFSET - sizeof(PRELDR_ENTRY));
+		for (n = 0; n < count; ++n)
+			memcpy(field[n], tc->bldr + TRIAL_PRELDR_BOOT_PARAMS_OFFSET, sizeof(BOOT_PARAMS));
+		rc4_lanes(context, ptrs, count, sizeof(BOOT_PARAMS));
+	}
+
+	for (n = 0; n < count; ++n) {
+		if (valid[n] && trial_boot_params((BOOT_PARAMS*)field[n], tc->size))
+			return n;
+	}
+
+	return KEYRING_NO_MATCH;
+}
+
+static bool trial_kernel(const uint8_t* kernel, const uint32_t kernel_size, const uint8_t* key) {
+	// walk the lzx block headers of the compressed kernel. key is NULL for an unencrypted kernel.
+
+	RC4_CONTEXT context;
+	LZX_BLOCK block;
+	uint32_t pos = 0;
+	uint32_t stream_pos = 0;
+	int blocks = 0;
+
+	if (key != NULL)
+		rc4_key(&context, key, XB_KEY_SIZE);
+
+	while (pos < kernel_size && blocks < KEYRING_KERNEL_BLOCKS) {
+		if (pos + sizeof(LZX_BLOCK) > kernel_size)
+			return false;
+
+		memcpy(&block, kernel + pos, sizeof(LZX_BLOCK));
+		if (key != NULL) {
+			rc4(&context, NULL, pos - stream_pos);
+			rc4(&context, (uint8_t*)&block, sizeof(LZX_BLOCK));
+			stream_pos = pos + sizeof(LZX_BLOCK);
+		}
+
+		if (block.compressed_size == 0 || block.compressed_size > LZX_OUTPUT_SIZE)
+			return false;
+		if (block.uncompressed_size == 0 || block.uncompressed_size > LZX_CHUNK_SIZE)
+			return false;
+
+		pos += sizeof(LZX_BLOCK) + block.compressed_size;
+		blocks++;
+	}
+
+	return blocks == KEYRING_KERNEL_BLOCKS || pos == kernel_size;
+}
+
+static void trial_find_kernel_key(const KEYRING* keyring, const uint8_t* data, const uint32_t size, KEYRING_MATCH* match) {
+	// decrypt a copy of the 2BL with the matched key and find the kernel key.
+
+	static const uint8_t ZERO_KEY[XB_KEY_SIZE] = { 0 };
+	RC4_CONTEXT context;
+	BOOT_PARAMS* boot_params;
+	BLDR_ENTRY* entry;
+	BLDR_KEYS* keys = NULL;
+	const uint8_t* kernel;
+	uint8_t* bldr;
+	uint32_t entry_offset;
+	uint32_t keys_offset;
+	int index;
+	int lane;
+
+	bldr = (uint8_t*)malloc(BLDR_BLOCK_SIZE);
+	if (bldr == NULL)
+		return;
+
+	memcpy(bldr, data + size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE, BLDR_BLOCK_SIZE);
+	if (match->preldr) {
+		rc4_key(&context, match->preldr_key, SHA1_DIGEST_LEN);
+		rc4(&context, bldr, BLDR_BLOCK_SIZE);
+		boot_params = (BOOT_PARAMS*)(bldr + TRIAL_PRELDR_BOOT_PARAMS_OFFSET);
+		entry_offset = ((PRELDR_ENTRY*)(bldr + TRIAL_PRELDR_ENTRY_OFFSET))->bldr_entry_offset;
+	}
+	else {
+		if (match->bldr_key != KEYRING_KEY_NONE) {
+			rc4_key(&context, keyring->keys[match->bldr_key].key, XB_KEY_SIZE);
+			rc4(&context, bldr, BLDR_BLOCK_SIZE);
+		}
+		boot_params = (BOOT_PARAMS*)(bldr + TRIAL_BOOT_PARAMS_OFFSET);
+		entry_offset = ((BOOT_LDR_PARAM*)bldr)->bldr_entry_point & 0x0000FFFF;
+	}
+
+	entry = (BLDR_ENTRY*)(bldr + entry_offset - sizeof(BLDR_ENTRY));
+	if (IN_BOUNDS(entry, bldr, BLDR_BLOCK_SIZE)) {
+		keys_offset = entry->keys_ptr & 0x0000FFFF;
+		keys = (BLDR_KEYS*)(bldr + keys_offset);
+		if (!IN_BOUNDS(keys, bldr, BLDR_BLOCK_SIZE))
+			keys = NULL;
+	}
+
+	kernel = data + size - BLDR_BLOCK_SIZE - MCPX_BLOCK_SIZE - boot_params->uncompressed_kernel_data_size - boot_params->compressed_kernel_size;
+
+	if (trial_kernel(kernel, boot_params->compressed_kernel_size, NULL)) {
+		match->kernel_key = KEYRING_KEY_NONE;
+	}
+	else if (keys != NULL && memcmp(keys->kernel_key, ZERO_KEY, XB_KEY_SIZE) != 0 &&
+		trial_kernel(kernel, boot_params->compressed_kernel_size, keys->kernel_key)) {
+		match->kernel_key = KEYRING_KEY_BLDR;
+	}
+	else {
+		// custom BIOS; the kernel key isnt in the 2BL.
+		const uint32_t kernel_size = boot_params->compressed_kernel_size;
+		index = run_parallel(keyring->count, [keyring, kernel, kernel_size](int i) {
+			return trial_kernel(kernel, kernel_size, keyring->keys[i].key) ? 0 : KEYRING_NO_MATCH;
+		}, &lane);
+		match->kernel_key = index;
+		match->trials += keyring->count;
+	}
+
+	free(bldr);
+}
+
+template <typename F>
+static int run_parallel(const int count, F trial, int* lane) {
+	// run trial(0 .. count-1) across all cores. items are taken in order and
+	// the search stops once no remaining item can beat the lowest match.
+	// returns the lowest matching item, or KEYRING_NO_MATCH. lane is the trial result of that item.
+
+	std::atomic<int> next(0);
+	std::atomic<int> found(count);
+	std::vector<std::thread> threads;
+	int* results;
+	int thread_count;
+	int i;
+
+	if (count <= 0)
+		return KEYRING_NO_MATCH;
+
+	results = (int*)malloc(count * sizeof(int));
+	if (results == NULL)
+		return KEYRING_NO_MATCH;
+
+	auto worker = [&]() {
+		int item;
+		int result;
+		int current;
+		while ((item = next.fetch_add(1)) < count) {
+			if (item > found.load())
+				break;
+			result = trial(item);
+			if (result == KEYRING_NO_MATCH)
+				continue;
+			results[item] = result;
+			current = found.load();
+			while (item < current && !found.compare_exchange_weak(current, item)) {}
+		}
+	};
+
+	thread_count = (int)std::thread::hardware_concurrency();
+	if (thread_count > count)
+		thread_count = count;
+	for (i = 1; i < thread_count; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (i = 0; i < (int)threads.size(); ++i) {
+		threads[i].join();
+	}
+
+	i = found.load();
+	if (i < count) {
+		*lane = results[i];
+	}
+	else {
+		i = KEYRING_NO_MATCH;
+	}
+
+	free(results);
+	return i;
+}
@@ -0,0 +1,308 @@
+// krnl_cache.cpp: Implements an on-disk, size capped LRU cache of decompressed kernel images.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+
+#ifdef _WIN32
+#include <process.h>
+#define KRNL_CACHE_PID() _getpid()
+#define KRNL_CACHE_SEP "\\"
+#else
+#include <unistd.h>
+#define KRNL_CACHE_PID() getpid()
+#define KRNL_CACHE_SEP "/"
+#endif
+
+// user incl
+#include "krnl_cache.h"
+#include "file.h"
+#include "sha1.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define KRNL_CACHE_NAME_LEN (SHA1_DIGEST_LEN * 2)
+#define KRNL_CACHE_MAGIC 0x4D49434B // 'KCIM'
+
+// follows the image in a cache file, so the image maps at offset 0.
+typedef struct {
+	uint32_t magic;
+	uint32_t size;					// image size
+	uint8_t hash[SHA1_DIGEST_LEN];	// sha1 of the image
+} KRNL_CACHE_TRAILER;
+
+typedef struct {
+	char* filename;
+	uint64_t size;
+	int64_t mtime;
+} KRNL_CACHE_ENTRY;
+
+typedef struct {
+	KRNL_CACHE_ENTRY* entries;
+	uint32_t count;
+	uint32_t capacity;
+	uint64_t total;
+} KRNL_CACHE_SCAN;
+
+// unique temp file names across the threads of this process.
+static std::atomic<uint32_t> temp_counter(0);
+
+static char* krnl_cache_filename(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], const char* suffix);
+static void krnl_cache_hash(const uint8_t* img, const uint32_t size, uint8_t hash[SHA1_DIGEST_LEN]);
+static bool krnl_cache_check(const MAPPED_FILE* map, uint32_t* img_size);
+static int krnl_cache_scan_file(const char* filename, void* context);
+static int krnl_cache_entry_cmp(const void* a, const void* b);
+static void krnl_cache_evict(const KRNL_CACHE* cache, const char* keep);
+
+int krnl_cache_open(KRNL_CACHE* cache, const char* path, const uint64_t max_size) {
+	cache->path = NULL;
+	cache->max_size = max_size;
+
+	if (path == NULL || createDirectory(path) != 0)
+		return KRNL_CACHE_ERROR_FAILED;
+
+	cache->path = (char*)malloc(strlen(path) + 1);
+	if (cache->path == NULL)
+		return KRNL_CACHE_ERROR_FAILED;
+	strcpy(cache->path, path);
+
+	return KRNL_CACHE_ERROR_SUCCESS;
+}
+void krnl_cache_close(KRNL_CACHE* cache) {
+	if (cache->path != NULL) {
+		free(cache->path);
+		cache->path = NULL;
+	}
+}
+
+void krnl_cache_key(const uint8_t* compressed_kernel, const uint32_t size, uint8_t key[SHA1_DIGEST_LEN]) {
+	SHA1Context context;
+	SHA1Reset(&context);
+	SHA1Input(&context, compressed_kernel, size);
+	SHA1Result(&context, key);
+}
+
+int krnl_cache_get(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], MAPPED_FILE* map, uint32_t* img_size) {
+	char* filename;
+	int result = KRNL_CACHE_ERROR_MISS;
+
+	if (cache == NULL || cache->path == NULL)
+		return KRNL_CACHE_ERROR_MISS;
+
+	filename = krnl_cache_filename(cache, key, NULL);
+	if (filename == NULL)
+		return KRNL_CACHE_ERROR_MISS;
+
+	if (fileExists(filename) && mapFile(filename, map) == 0) {
+		if (krnl_cache_check(map, img_size)) {
+			// the mtime is the lru clock.
+			touchFile(filename);
+			result = KRNL_CACHE_ERROR_SUCCESS;
+		}
+		else {
+			// a torn or corrupt image is a miss; the next put replaces it.
+			log_info("Discarded corrupt cached kernel image %s\n", filename);
+			unmapFile(map);
+			deleteFile(filename);
+		}
+	}
+
+	free(filename);
+	return result;
+}
+
+int krnl_cache_put(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], const uint8_t* img, const uint32_t size) {
+	char suffix[32];
+	char* filename = NULL;
+	char* temp = NULL;
+	FILE* stream = NULL;
+	KRNL_CACHE_TRAILER trailer;
+	bool written;
+	int result = KRNL_CACHE_ERROR_FAILED;
+
+	if (cache == NULL || cache->path == NULL || img == NULL || size == 0)
+		return KRNL_CACHE_ERROR_FAILED;
+
+	// an image bigger than the cap would only be evicted again.
+	if (cache->max_size != 0 && (uint64_t)size + sizeof(KRNL_CACHE_TRAILER) > cache->max_size)
+		return KRNL_CACHE_ERROR_FAILED;
+
+	sprintf(suffix, ".%d.%u.tmp", (int)KRNL_CACHE_PID(), temp_counter.fetch_add(1));
+
+	filename = krnl_cache_filename(cache, key, NULL);
+	temp = krnl_cache_filename(cache, key, suffix);
+	if (filename == NULL || temp == NULL)
+		goto Cleanup;
+
+	trailer.magic = KRNL_CACHE_MAGIC;
+	trailer.size = size;
+	krnl_cache_hash(img, size, trailer.hash);
+
+	stream = openFile(temp, "wb");
+	if (stream == NULL)
+		goto Cleanup;
+
+	// the bytes are on disk before the rename, so a crash never leaves a named, partial image.
+	written = fwrite(img, 1, size, stream) == size
+		&& fwrite(&trailer, 1, sizeof(trailer), stream) == sizeof(trailer)
+		&& syncFile(stream) == 0;
+	if (closeFile(stream) != 0 || !written) {
+		deleteFile(temp);
+		goto Cleanup;
+	}
+
+	if (renameFile(temp, filename) != 0) {
+		deleteFile(temp);
+		goto Cleanup;
+	}
+
+	result = KRNL_CACHE_ERROR_SUCCESS;
+
+	krnl_cache_evict(cache, filename);
+
+Cleanup:
+	if (filename != NULL)
+		free(filename);
+	if (temp != NULL)
+		free(temp);
+
+	return result;
+}
+
+static char* krnl_cache_filename(const KRNL_CACHE* cache, const uint8_t key[SHA1_DIGEST_LEN], const char* suffix) {
+	// <path>/<sha1 hex>.img[suffix]
+
+	const size_t len = strlen(cache->path) + 1 + KRNL_CACHE_NAME_LEN + strlen(KRNL_CACHE_EXT) + (suffix != NULL ? strlen(suffix) : 0) + 1;
+	char* filename = (char*)malloc(len);
+	char* ptr;
+
+	if (filename == NULL)
+		return NULL;
+
+	ptr = filename + sprintf(filename, "%s" KRNL_CACHE_SEP, cache->path);
+	for (int i = 0; i < SHA1_DIGEST_LEN; i++) {
+		ptr += sprintf(ptr, "%02x", key[i]);
+	}
+	sprintf(ptr, "%s%s", KRNL_CACHE_EXT, suffix != NULL ? suffix : "");
+
+	return filename;
+}
+static void krnl_cache_hash(const uint8_t* img, const uint32_t size, uint8_t hash[SHA1_DIGEST_LEN]) {
+	SHA1Context context;
+	SHA1Reset(&context);
+	SHA1Input(&context, img, size);
+	SHA1Result(&context, hash);
+}
+static bool krnl_cache_check(const MAPPED_FILE* map, uint32_t* img_size) {
+	// check the trailer; the file size, the image size and the image hash must all agree.
+
+	KRNL_CACHE_TRAILER trailer;
+	uint8_t hash[SHA1_DIGEST_LEN];
+
+	if (map->size < sizeof(KRNL_CACHE_TRAILER))
+		return false;
+
+	memcpy(&trailer, map->data + map->size - sizeof(KRNL_CACHE_TRAILER), sizeof(KRNL_CACHE_TRAILER));
+	if (trailer.magic != KRNL_CACHE_MAGIC || trailer.size != map->size - sizeof(KRNL_CACHE_TRAILER))
+		return false;
+
+	krnl_cache_hash(map->data, trailer.size, hash);
+	if (memcmp(hash, trailer.hash, SHA1_DIGEST_LEN) != 0)
+		return false;
+
+	*img_size = trailer.size;
+	return true;
+}
+static int krnl_cache_scan_file(const char* filename, void* context) {
+	// collect the cached images; temp files and foreign files are skipped.
+
+	KRNL_CACHE_SCAN* scan = (KRNL_CACHE_SCAN*)context;
+	const size_t len = strlen(filename);
+	const size_t ext_len = strlen(KRNL_CACHE_EXT);
+	KRNL_CACHE_ENTRY entry;
+
+	if (len < ext_len || strcmp(filename + len - ext_len, KRNL_CACHE_EXT) != 0)
+		return 0;
+
+	if (getFileStat(filename, &entry.size, &entry.mtime) != 0)
+		return 0;
+
+	if (scan->count == scan->capacity) {
+		uint32_t capacity = scan->capacity == 0 ? 64 : scan->capacity * 2;
+		KRNL_CACHE_ENTRY* entries = (KRNL_CACHE_ENTRY*)realloc(scan->entries, capacity * sizeof(KRNL_CACHE_ENTRY));
+		if (entries == NULL)
+			return 1;
+		scan->entries = entries;
+		scan->capacity = capacity;
+	}
+
+	entry.filename = (char*)malloc(len + 1);
+	if (entry.filename == NULL)
+		return 1;
+	strcpy(entry.filename, filename);
+
+	scan->entries[scan->count++] = entry;
+	scan->total += entry.size;
+
+	return 0;
+}
+static int krnl_cache_entry_cmp(const void* a, const void* b) {
+	// oldest first
+	const KRNL_CACHE_ENTRY* x = (const KRNL_CACHE_ENTRY*)a;
+	const KRNL_CACHE_ENTRY* y = (const KRNL_CACHE_ENTRY*)b;
+	return (x->mtime > y->mtime) - (x->mtime < y->mtime);
+}
+static void krnl_cache_evict(const KRNL_CACHE* cache, const char* keep) {
+	// delete the least recently used images until the cache fits the cap. the image just stored is kept.
+
+	KRNL_CACHE_SCAN scan = { NULL, 0, 0, 0 };
+	uint32_t i;
+
+	if (cache->max_size == 0)
+		return;
+
+	enumerateFiles(cache->path, false, krnl_cache_scan_file, &scan);
+
+	if (scan.total > cache->max_size) {
+		qsort(scan.entries, scan.count, sizeof(KRNL_CACHE_ENTRY), krnl_cache_entry_cmp);
+		for (i = 0; i < scan.count && scan.total > cache->max_size; i++) {
+			if (strcmp(scan.entries[i].filename, keep) == 0)
+				continue;
+			if (deleteFile(scan.entries[i].filename) == 0) {
+				log_info("Evicted cached kernel image %s\n", scan.entries[i].filename);
+				scan.total -= scan.entries[i].size;
+			}
+		}
+	}
+
+	for (i = 0; i < scan.count; i++) {
+		free(scan.entries[i].filename);
+	}
+	if (scan.entries != NULL)
+		free(scan.entries);
+}
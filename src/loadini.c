@@ -23,6 +23,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdlib.h>
 #include <malloc.h>
 
 // user incl
@@ -33,12 +34,22 @@
 #include "mem_tracking.h"
 #endif
 
-#define LOADINI_MAX_LINE_SIZE 128
 #define LOADINI_DELIM "="
 
 static void set_setting_value(char** setting, const char* value, uint32_t len);
+static int loadini_lines(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size, char* section, uint32_t section_size);
 
 int loadini(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size) {
+	return loadini_lines(stream, settings_map, map_size, NULL, 0);
+}
+int loadini_section(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size, char* section, uint32_t section_size) {
+	if (section == NULL || section_size == 0)
+		return LOADINI_ERROR_INVALID_DATA;
+	section[0] = '\0';
+	return loadini_lines(stream, settings_map, map_size, section, section_size);
+}
+
+static int loadini_lines(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_size, char* section, uint32_t section_size) {
 	uint32_t i = 0;
 	uint32_t len = 0;
 		
@@ -56,6 +67,15 @@ int loadini(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_
 		if (line_ptr[0] == ';') // comment
 			continue;
 
+		// section-format: [name]; stops the section.
+		if (section != NULL && line_ptr[0] == '[') {
+			key = strtok(line_ptr + 1, "]");
+			if (key == NULL || strlen(key) >= section_size)
+				return LOADINI_ERROR_INVALID_DATA;
+			strcpy(section, key);
+			return LOADINI_ERROR_SUCCESS;
+		}
+
 		// line-format: key=value
 
 		// get the key.
@@ -101,6 +121,10 @@ int loadini(FILE* stream, const LOADINI_SETTING_MAP* settings_map, uint32_t map_
 					*(bool*)settings_map[i].var = false;
 				}
 				break;
+
+			case LOADINI_SETTING_TYPE_INT:
+				*(uint32_t*)settings_map[i].var = strtoul(value, NULL, 0);
+				break;
 			}
 			break;
 		}
@@ -0,0 +1,281 @@
+// log.cpp: leveled logging with per-thread buffering and pluggable sinks.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+
+// user incl
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define LOG_RECORD_HEADER 3 // level (1 byte), length (2 bytes)
+
+// a thread's pending messages; records of header + text. flushed when the thread exits.
+struct LOG_BUFFER {
+	char data[LOG_BUFFER_SIZE];
+	uint32_t len;
+
+	LOG_BUFFER() : len(0) { };
+	~LOG_BUFFER();
+};
+
+static std::mutex log_sink_lock;
+static LOG_SINK log_sink = { NULL, NULL };
+static std::atomic<int> log_level(LOG_LEVEL_INFO);
+static std::atomic<bool> log_enabled(false);		// a sink other than the null sink is set
+static std::atomic<bool> log_buffered(true);
+static thread_local LOG_BUFFER log_buffer;
+
+static void log_flush_buffer(LOG_BUFFER* buffer);
+static const char* log_prefix(LOG_LEVEL level);
+static void log_stream_write(void* context, LOG_LEVEL level, const char* text, const uint32_t len);
+static void log_ring_write(void* context, LOG_LEVEL level, const char* text, const uint32_t len);
+static void log_ring_put(LOG_RING* ring, const char* text, uint32_t len);
+
+LOG_BUFFER::~LOG_BUFFER() {
+	log_flush_buffer(this);
+}
+
+void log_set_level(LOG_LEVEL level) {
+	log_level.store(level);
+}
+LOG_LEVEL log_get_level(void) {
+	return (LOG_LEVEL)log_level.load();
+}
+void log_set_sink(const LOG_SINK* sink) {
+	log_flush();
+
+	std::lock_guard<std::mutex> lock(log_sink_lock);
+	if (sink != NULL) {
+		log_sink = *sink;
+	}
+	else {
+		log_sink.write = NULL;
+		log_sink.context = NULL;
+	}
+	log_enabled.store(log_sink.write != NULL);
+}
+void log_set_buffered(bool buffered) {
+	log_buffered.store(buffered);
+}
+
+void log_write(LOG_LEVEL level, const char* format, ...) {
+	char msg[LOG_MESSAGE_MAX];
+	va_list args;
+	int len;
+	LOG_BUFFER* buffer;
+
+	if (level >= LOG_LEVEL_NONE || (int)level < log_level.load(std::memory_order_relaxed) || !log_enabled.load(std::memory_order_relaxed))
+		return;
+
+	va_start(args, format);
+	len = vsnprintf(msg, sizeof(msg), format, args);
+	va_end(args);
+	if (len < 0)
+		return;
+	if (len > LOG_MESSAGE_MAX - 1)
+		len = LOG_MESSAGE_MAX - 1;
+
+	if (len == 0 || msg[len - 1] != '\n') {
+		if (len == LOG_MESSAGE_MAX - 1)
+			len--;
+		msg[len++] = '\n';
+	}
+
+	buffer = &log_buffer;
+	if (buffer->len + LOG_RECORD_HEADER + len > LOG_BUFFER_SIZE) {
+		log_flush_buffer(buffer);
+	}
+
+	buffer->data[buffer->len] = (char)level;
+	buffer->data[buffer->len + 1] = (char)(len & 0xFF);
+	buffer->data[buffer->len + 2] = (char)(len >> 8);
+	memcpy(buffer->data + buffer->len + LOG_RECORD_HEADER, msg, len);
+	buffer->len += LOG_RECORD_HEADER + len;
+
+	if (level >= LOG_LEVEL_WARN || !log_buffered.load(std::memory_order_relaxed)) {
+		log_flush_buffer(buffer);
+	}
+}
+void log_flush(void) {
+	log_flush_buffer(&log_buffer);
+}
+
+void log_sink_null(LOG_SINK* sink) {
+	sink->write = NULL;
+	sink->context = NULL;
+}
+void log_sink_stream(LOG_SINK* sink, FILE* stream) {
+	sink->write = log_stream_write;
+	sink->context = stream;
+}
+int log_sink_file(LOG_SINK* sink, const char* filename) {
+	FILE* stream = NULL;
+
+	log_sink_null(sink);
+	if (filename == NULL)
+		return 1;
+
+	stream = fopen(filename, "a");
+	if (stream == NULL)
+		return 1;
+
+	log_sink_stream(sink, stream);
+	return 0;
+}
+void log_sink_file_close(LOG_SINK* sink) {
+	if (sink->context != NULL) {
+		fclose((FILE*)sink->context);
+	}
+	log_sink_null(sink);
+}
+
+int log_ring_init(LOG_RING* ring, const uint32_t size) {
+	ring->written = 0;
+	ring->size = size;
+	ring->data = (char*)malloc(size);
+	if (ring->data == NULL) {
+		ring->size = 0;
+		return 1;
+	}
+	return 0;
+}
+void log_ring_free(LOG_RING* ring) {
+	if (ring->data != NULL) {
+		free(ring->data);
+		ring->data = NULL;
+	}
+	ring->size = 0;
+	ring->written = 0;
+}
+void log_sink_ring(LOG_SINK* sink, LOG_RING* ring) {
+	sink->write = log_ring_write;
+	sink->context = ring;
+}
+uint32_t log_ring_read(LOG_RING* ring, char* buf, const uint32_t size) {
+	uint64_t start;
+	uint32_t len;
+	uint32_t pos;
+	uint32_t first;
+
+	if (buf == NULL || size == 0)
+		return 0;
+
+	// writes happen under the sink lock.
+	std::lock_guard<std::mutex> lock(log_sink_lock);
+
+	buf[0] = '\0';
+	if (ring->data == NULL || ring->size == 0)
+		return 0;
+
+	len = (ring->written < ring->size) ? (uint32_t)ring->written : ring->size;
+	if (len > size - 1)
+		len = size - 1;
+
+	start = ring->written - len;
+	pos = (uint32_t)(start % ring->size);
+	first = ring->size - pos;
+	if (first > len)
+		first = len;
+
+	memcpy(buf, ring->data + pos, first);
+	memcpy(buf + first, ring->data, len - first);
+	buf[len] = '\0';
+
+	return len;
+}
+
+static void log_flush_buffer(LOG_BUFFER* buffer) {
+	uint32_t i;
+	uint32_t len;
+	LOG_LEVEL level;
+
+	if (buffer->len == 0)
+		return;
+
+	// one lock per batch of messages.
+	std::lock_guard<std::mutex> lock(log_sink_lock);
+	if (log_sink.write != NULL) {
+		for (i = 0; i < buffer->len; i += LOG_RECORD_HEADER + len) {
+			level = (LOG_LEVEL)buffer->data[i];
+			len = (uint8_t)buffer->data[i + 1] | ((uint32_t)(uint8_t)buffer->data[i + 2] << 8);
+			log_sink.write(log_sink.context, level, buffer->data + i + LOG_RECORD_HEADER, len);
+		}
+	}
+	buffer->len = 0;
+}
+static const char* log_prefix(LOG_LEVEL level) {
+	switch (level) {
+		case LOG_LEVEL_ERROR:
+			return "Error: ";
+		case LOG_LEVEL_WARN:
+			return "Warning: ";
+		default:
+			return "";
+	}
+}
+static void log_stream_write(void* context, LOG_LEVEL level, const char* text, const uint32_t len) {
+	FILE* stream = (FILE*)context;
+	const char* prefix = log_prefix(level);
+
+	fputs(prefix, stream);
+	fwrite(text, 1, len, stream);
+	if (level >= LOG_LEVEL_WARN)
+		fflush(stream);
+}
+static void log_ring_write(void* context, LOG_LEVEL level, const char* text, const uint32_t len) {
+	LOG_RING* ring = (LOG_RING*)context;
+	const char* prefix = log_prefix(level);
+
+	if (ring->data == NULL || ring->size == 0)
+		return;
+
+	log_ring_put(ring, prefix, (uint32_t)strlen(prefix));
+	log_ring_put(ring, text, len);
+}
+static void log_ring_put(LOG_RING* ring, const char* text, uint32_t len) {
+	uint32_t pos;
+	uint32_t first;
+
+	// only the newest size bytes survive.
+	if (len > ring->size) {
+		text += len - ring->size;
+		len = ring->size;
+	}
+
+	pos = (uint32_t)(ring->written % ring->size);
+	first = ring->size - pos;
+	if (first > len)
+		first = len;
+
+	memcpy(ring->data + pos, text, first);
+	memcpy(ring->data, text + first, len - first);
+	ring->written += len;
+}
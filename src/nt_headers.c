@@ -27,6 +27,7 @@
 // user incl
 #include "nt_headers.h"
 #include "util.h"
+#include "log.h"
 
 void print_image_dos_header(IMAGE_DOS_HEADER* dos_header)
 {
@@ -173,20 +174,20 @@ IMAGE_DOS_HEADER* verify_dos_header(uint8_t* data, uint32_t size)
 {
     if (data == NULL)
     {
-        printf("Error: Invalid data\n");
+        log_error("invalid data\n");
         return NULL;
     }
 
     IMAGE_DOS_HEADER* dosHeader = (IMAGE_DOS_HEADER*)data;
     if (IN_BOUNDS(dosHeader, data, size) == false)
     {
-        printf("Error: DOS header out of bounds\n");
+        log_error("DOS header out of bounds\n");
         return NULL;
     }
 
     if (dosHeader->e_magic != IMAGE_DOS_SIGNATURE)
     {
-        printf("Error: Invalid DOS signature\n");
+        log_error("invalid DOS signature\n");
         return NULL;
     }
 
@@ -199,7 +200,7 @@ IMAGE_NT_HEADER* verify_nt_headers(uint8_t* data, uint32_t size)
 
     if (data == NULL)
     {
-        printf("Error: Invalid data\n");
+        log_error("invalid data\n");
         return NULL;
     }
 
@@ -212,13 +213,13 @@ IMAGE_NT_HEADER* verify_nt_headers(uint8_t* data, uint32_t size)
     nt = (IMAGE_NT_HEADER*)(data + dos->e_lfanew);
     if (IN_BOUNDS(nt, data, size) == false)
     {
-        printf("Error: NT headers out of bounds\n");
+        log_error("NT headers out of bounds\n");
         return NULL;
     }
 
     if (nt->signature != IMAGE_NT_SIGNATURE)
     {
-        printf("Error: Invalid PE signature\n");
+        log_error("invalid PE signature\n");
         return NULL;
     }
 
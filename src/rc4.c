@@ -61,6 +61,45 @@ void rc4_symmetric_enc_dec(uint8_t* data, const size_t size, const uint8_t* key,
     rc4(&context, data, size);
 }
 
+void rc4_lanes(RC4_CONTEXT* c, uint8_t** data, const int lanes, const size_t size) {
+    uint8_t k[RC4_MAX_LANES];
+    uint8_t j[RC4_MAX_LANES];
+    uint8_t a, b;
+    uint8_t* s;
+    int n;
+
+    if (lanes > RC4_MAX_LANES) {
+        rc4_lanes(c, data, RC4_MAX_LANES, size);
+        rc4_lanes(c + RC4_MAX_LANES, data != NULL ? data + RC4_MAX_LANES : NULL, lanes - RC4_MAX_LANES, size);
+        return;
+    }
+
+    for (n = 0; n < lanes; ++n) {
+        k[n] = c[n].k;
+        j[n] = c[n].j;
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        for (n = 0; n < lanes; ++n) {
+            s = c[n].s;
+            k[n] = k[n] + 1;
+            a = s[k[n]];
+            j[n] = j[n] + a;
+            b = s[j[n]];
+            s[k[n]] = b;
+            s[j[n]] = a;
+            if (data != NULL && data[n] != NULL)
+                data[n][i] ^= s[(uint8_t)(a + b)];
+        }
+    }
+
+    for (n = 0; n < lanes; ++n) {
+        c[n].k = k[n];
+        c[n].j = j[n];
+        c[n].t = (uint8_t)(c[n].s[k[n]] + c[n].s[j[n]]);
+    }
+}
+
 inline void swap_byte(uint8_t* a, uint8_t* b) {
     uint8_t tmp = *a;
     *a = *b;
@@ -1,4 +1,4 @@
-// rsa.c:
+// rsa.c: RSA1 public key helpers and a montgomery verify engine.
 
 /* Copyright(C) 2024 tommojphillips
  *
@@ -27,6 +27,27 @@
 // user incl
 #include "rsa.h"
 
+#define RSA_MAX_LIMBS (RSA_MAX_BITS / 32)
+
+#ifdef _MSC_VER
+#define RSA_THREAD_LOCAL __declspec(thread)
+#else
+#define RSA_THREAD_LOCAL __thread
+#endif
+
+// montgomery context for a modulus; 32 bit limbs, little endian.
+typedef struct {
+	uint32_t n[RSA_MAX_LIMBS];
+	uint32_t rr[RSA_MAX_LIMBS];	// R^2 mod n; R = 2^(32 * limbs)
+	uint32_t n0;				// -n^-1 mod 2^32
+	int limbs;
+} RSA_MONT;
+
+static int rsa_cmp(const uint32_t* a, const uint32_t* b, const int limbs);
+static uint32_t rsa_sub(uint32_t* a, const uint32_t* b, const int limbs);
+static void rsa_mont_mul(const RSA_MONT* mont, uint32_t* out, const uint32_t* a, const uint32_t* b);
+static int rsa_mont_init(RSA_MONT* mont, const uint8_t* modulus, const uint32_t size);
+
 int rsa_verifyPublicKey(uint8_t* data, uint32_t size, uint32_t offset, PUBLIC_KEY** pubkey)
 {
 	// verify the public key header.
@@ -79,3 +100,229 @@ int rsa_findPublicKey(uint8_t* data, uint32_t size, PUBLIC_KEY** pubkey, uint32_
 
 	return result;
 }
+
+int rsa_public(const PUBLIC_KEY* pubkey, const uint8_t* sig, uint8_t* out)
+{
+	// out = sig ^ e mod n
+
+	// the last modulus seen by this thread; images are mostly verified against the same few keys.
+	static RSA_THREAD_LOCAL RSA_MONT mont;
+	uint32_t x[RSA_MAX_LIMBS];
+	uint32_t xm[RSA_MAX_LIMBS];
+	uint32_t acc[RSA_MAX_LIMBS];
+	uint32_t one[RSA_MAX_LIMBS] = { 1 };
+	uint32_t e;
+	uint32_t size;
+	int bit;
+	int i;
+
+	if (pubkey == NULL || sig == NULL || out == NULL)
+		return RSA_ERROR_INVALID_DATA;
+
+	size = RSA_MOD_SIZE(&pubkey->header);
+	e = pubkey->header.exponent;
+	if (e == 0)
+		return RSA_ERROR_INVALID_DATA;
+
+	if (mont.limbs != (int)(size + 3) / 4 || memcmp(mont.n, RSA_MODULUS(pubkey), size) != 0) {
+		if (rsa_mont_init(&mont, RSA_MODULUS(pubkey), size) != RSA_ERROR_SUCCESS) {
+			mont.limbs = 0;
+			return RSA_ERROR_INVALID_DATA;
+		}
+	}
+
+	memset(x, 0, sizeof(x));
+	memcpy(x, sig, size);
+	if (rsa_cmp(x, mont.n, mont.limbs) >= 0) // sig >= n
+		return RSA_ERROR_INVALID_DATA;
+
+	// to montgomery form; xm = x * R mod n
+	rsa_mont_mul(&mont, xm, x, mont.rr);
+
+	// left to right square and multiply; e is public so no need for a ladder.
+	memcpy(acc, xm, sizeof(acc));
+	for (bit = 31; bit >= 0 && ((e >> bit) & 1) == 0; --bit);
+	for (--bit; bit >= 0; --bit) {
+		rsa_mont_mul(&mont, acc, acc, acc);
+		if ((e >> bit) & 1)
+			rsa_mont_mul(&mont, acc, acc, xm);
+	}
+
+	// out of montgomery form
+	rsa_mont_mul(&mont, x, acc, one);
+
+	for (i = 0; i < (int)size; ++i) {
+		out[i] = (uint8_t)(x[i / 4] >> (8 * (i % 4)));
+	}
+
+	return RSA_ERROR_SUCCESS;
+}
+int rsa_recoverDigest(const PUBLIC_KEY* pubkey, const uint8_t* sig, uint8_t* digest)
+{
+	// decrypted xbox signature (little endian):
+	// [0..19] sha1 digest reversed, [20] 0x00, [21..n-3] 0xFF, [n-2] 0x01, [n-1] 0x00
+
+	uint8_t buf[RSA_MAX_BITS / 8];
+	uint32_t size;
+	uint32_t i;
+	int result;
+
+	result = rsa_public(pubkey, sig, buf);
+	if (result != RSA_ERROR_SUCCESS)
+		return result;
+
+	size = RSA_MOD_SIZE(&pubkey->header);
+	if (size < SHA1_DIGEST_LEN + 3)
+		return RSA_ERROR_SIGNATURE;
+
+	if (buf[SHA1_DIGEST_LEN] != 0x00 || buf[size - 2] != 0x01 || buf[size - 1] != 0x00)
+		return RSA_ERROR_SIGNATURE;
+
+	for (i = SHA1_DIGEST_LEN + 1; i < size - 2; ++i) {
+		if (buf[i] != 0xFF)
+			return RSA_ERROR_SIGNATURE;
+	}
+
+	if (digest != NULL) {
+		for (i = 0; i < SHA1_DIGEST_LEN; ++i) {
+			digest[i] = buf[SHA1_DIGEST_LEN - 1 - i];
+		}
+	}
+
+	return RSA_ERROR_SUCCESS;
+}
+int rsa_verifySignature(const PUBLIC_KEY* pubkey, const uint8_t* sig, const uint8_t* digest)
+{
+	uint8_t recovered[SHA1_DIGEST_LEN];
+	int result;
+
+	result = rsa_recoverDigest(pubkey, sig, recovered);
+	if (result != RSA_ERROR_SUCCESS)
+		return result;
+
+	if (memcmp(recovered, digest, SHA1_DIGEST_LEN) != 0)
+		return RSA_ERROR_SIGNATURE;
+
+	return RSA_ERROR_SUCCESS;
+}
+
+static int rsa_cmp(const uint32_t* a, const uint32_t* b, const int limbs)
+{
+	int i;
+	for (i = limbs - 1; i >= 0; --i) {
+		if (a[i] != b[i])
+			return (a[i] > b[i]) ? 1 : -1;
+	}
+	return 0;
+}
+static uint32_t rsa_sub(uint32_t* a, const uint32_t* b, const int limbs)
+{
+	// a -= b; returns the borrow.
+
+	uint64_t t;
+	uint32_t borrow = 0;
+	int i;
+	for (i = 0; i < limbs; ++i) {
+		t = (uint64_t)a[i] - b[i] - borrow;
+		a[i] = (uint32_t)t;
+		borrow = (uint32_t)(t >> 63);
+	}
+	return borrow;
+}
+static void rsa_mont_mul(const RSA_MONT* mont, uint32_t* out, const uint32_t* a, const uint32_t* b)
+{
+	// out = a * b * R^-1 mod n (CIOS). out may alias a or b.
+
+	uint32_t t[RSA_MAX_LIMBS + 2];
+	uint64_t c;
+	uint32_t m;
+	const int s = mont->limbs;
+	int i, j;
+
+	memset(t, 0, sizeof(t));
+
+	for (i = 0; i < s; ++i) {
+		// t += a * b[i]
+		c = 0;
+		for (j = 0; j < s; ++j) {
+			c += (uint64_t)a[j] * b[i] + t[j];
+			t[j] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[s];
+		t[s] = (uint32_t)c;
+		t[s + 1] = (uint32_t)(c >> 32);
+
+		// t = (t + m * n) / 2^32
+		m = t[0] * mont->n0;
+		c = (uint64_t)m * mont->n[0] + t[0];
+		c >>= 32;
+		for (j = 1; j < s; ++j) {
+			c += (uint64_t)m * mont->n[j] + t[j];
+			t[j - 1] = (uint32_t)c;
+			c >>= 32;
+		}
+		c += t[s];
+		t[s - 1] = (uint32_t)c;
+		t[s] = t[s + 1] + (uint32_t)(c >> 32);
+	}
+
+	if (t[s] != 0 || rsa_cmp(t, mont->n, s) >= 0)
+		rsa_sub(t, mont->n, s);
+
+	memcpy(out, t, s * sizeof(uint32_t));
+}
+static int rsa_mont_init(RSA_MONT* mont, const uint8_t* modulus, const uint32_t size)
+{
+	uint32_t inv;
+	uint32_t top;
+	uint32_t bits;
+	uint32_t i;
+	int k;
+
+	if (size == 0 || size > RSA_MAX_BITS / 8)
+		return RSA_ERROR_INVALID_DATA;
+
+	memset(mont, 0, sizeof(RSA_MONT));
+	memcpy(mont->n, modulus, size);
+	mont->limbs = (size + 3) / 4;
+
+	if ((mont->n[0] & 1) == 0 || mont->n[mont->limbs - 1] == 0) // must be odd and full length
+		return RSA_ERROR_INVALID_DATA;
+
+	// n0 = -n^-1 mod 2^32; newton iteration, each step doubles the correct bits.
+	inv = mont->n[0];
+	for (k = 0; k < 5; ++k)
+		inv *= 2 - mont->n[0] * inv;
+	mont->n0 = (uint32_t)0 - inv;
+
+	// R^2 mod n. double upto R * 2^a mod n, then square in montgomery form;
+	// mont(R * 2^a, R * 2^a) = R * 2^2a. stop when 2^a == R.
+	bits = 32 * mont->limbs;
+	for (k = 0; ((bits >> k) & 1) == 0; ++k);
+
+	memset(mont->rr, 0, sizeof(mont->rr));
+	if (mont->n[mont->limbs - 1] & 0x80000000) {
+		// R > n > R / 2 so R mod n = R - n
+		rsa_sub(mont->rr, mont->n, mont->limbs);
+		i = bits;
+	}
+	else {
+		mont->rr[0] = 1;
+		i = 0;
+	}
+	for (; i < bits + (bits >> k); ++i) {
+		// rr = 2 * rr mod n
+		top = mont->rr[mont->limbs - 1] >> 31;
+		for (int j = mont->limbs - 1; j > 0; --j)
+			mont->rr[j] = (mont->rr[j] << 1) | (mont->rr[j - 1] >> 31);
+		mont->rr[0] <<= 1;
+		if (top || rsa_cmp(mont->rr, mont->n, mont->limbs) >= 0)
+			rsa_sub(mont->rr, mont->n, mont->limbs);
+	}
+	for (; k > 0; --k) {
+		rsa_mont_mul(mont, mont->rr, mont->rr, mont->rr);
+	}
+
+	return RSA_ERROR_SUCCESS;
+}
@@ -36,13 +36,22 @@
  *      a multiple of the size of an 8-bit character.
  */
 
+#include <string.h>
+
 #include "sha1.h"
 
 #define SHA1CircularShift(bits,word) (((word) << (bits)) | ((word) >> (32-(bits))))
 
+typedef void (*SHA1_COMPRESS)(uint32_t state[5], const uint8_t* blocks, uint32_t count);
+
 void SHA1PadMessage(SHA1Context*); 
 void SHA1ProcessMessageBlock(SHA1Context*);
 
+/* block function and multi-buffer width for this cpu; generic until SHA1Init() selects them. */
+static SHA1_COMPRESS sha1_compress = sha1_compress_generic;
+static const char* sha1_impl = "generic";
+static int sha1_lanes = 1;
+
 /*
  *  SHA1Reset
  *
@@ -149,6 +158,8 @@ int SHA1Result(SHA1Context* context, uint8_t digest[SHA1_DIGEST_LEN])
  */
 int SHA1Input(SHA1Context* context, const uint8_t *message, uint32_t len)
 {
+    uint32_t n;
+
     if (!len) return SHA_STATUS_SUCCESS;
 
     if (!context || !message)  return SHA_STATUS_STATE_NULL;
@@ -159,34 +170,51 @@ int SHA1Input(SHA1Context* context, const uint8_t *message, uint32_t len)
     }
 
     if (context->corrupted)  return context->corrupted;
-    
-    while(len-- && !context->corrupted) {
-        if (context->block_index >= 64) {
-            context->corrupted = SHA_STATUS_INPUT_TOO_LONG;
-            return SHA_STATUS_INPUT_TOO_LONG;
-        }
 
-    	context->block[context->block_index] = (*message & 0xFF);
+    if (context->block_index >= 64) {
+        context->corrupted = SHA_STATUS_INPUT_TOO_LONG;
+        return SHA_STATUS_INPUT_TOO_LONG;
+    }
 
-        context->block_index++;
+    /* message length in bits */
+    n = context->length_high;
+    context->length_high += (len >> 29);
+    context->length_low += (len << 3);
+    if (context->length_low < (len << 3))
+        context->length_high++;
+    if (context->length_high < n) { // Message is too long
+        context->corrupted = SHA_STATUS_INPUT_TOO_LONG;
+        return SHA_STATUS_INPUT_TOO_LONG;
+    }
 
-        context->length_low += 8;
-    	
-    	if (context->length_low == 0) {
-        	context->length_high++;
-        	
-        	if (context->length_high == 0) { // Message is too long
-                context->corrupted = SHA_STATUS_INPUT_TOO_LONG;
-        	}
-    	}
+    /* top up a partial block first */
+    if (context->block_index > 0) {
+        n = 64 - context->block_index;
+        if (n > len)
+            n = len;
+        memcpy(context->block + context->block_index, message, n);
+        context->block_index += (short)n;
+        message += n;
+        len -= n;
 
-    	if (context->block_index == 64) { // Process the message block
-        	SHA1ProcessMessageBlock(context);
-    	}
+        if (context->block_index < 64)
+            return SHA_STATUS_SUCCESS;
 
-    	message++;
+        SHA1ProcessMessageBlock(context);
     }
-        
+
+    /* whole blocks straight from the message */
+    n = len / 64;
+    if (n > 0) {
+        sha1_compress(context->intermediate_hash, message, n);
+        message += n * 64;
+        len -= n * 64;
+    }
+
+    /* buffer the remainder */
+    memcpy(context->block, message, len);
+    context->block_index = (short)len;
+
     return SHA_STATUS_SUCCESS;
 }
 
@@ -197,6 +225,19 @@ int SHA1Input(SHA1Context* context, const uint8_t *message, uint32_t len)
  *      stored in the block array.
  */
 void SHA1ProcessMessageBlock(SHA1Context *context)
+{
+    sha1_compress(context->intermediate_hash, context->block, 1);
+    
+    context->block_index = 0;
+}
+
+/*  sha1_compress_generic
+ *
+ *  Description:
+ *      Portable block function. Processes count 512 bit blocks
+ *      into the hash state.
+ */
+void sha1_compress_generic(uint32_t state[5], const uint8_t* blocks, uint32_t count)
 {
     // Constants defined in SHA-1
     const uint32_t K[] = { 0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6 };
@@ -206,67 +247,69 @@ void SHA1ProcessMessageBlock(SHA1Context *context)
     uint32_t W[80];         // Word sequence
     uint32_t A, B, C, D, E; // Word buffers
 
-    for(t = 0; t < 16; t++) {
-        W[t] = context->block[t * 4] << 24;
-        W[t] |= context->block[t * 4 + 1] << 16;
-        W[t] |= context->block[t * 4 + 2] << 8;
-        W[t] |= context->block[t * 4 + 3];
-    }
-    
-    for(t = 16; t < 80; t++) {
-       W[t] = SHA1CircularShift(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
-    }
+    while (count--) {
+        for(t = 0; t < 16; t++) {
+            W[t] = blocks[t * 4] << 24;
+            W[t] |= blocks[t * 4 + 1] << 16;
+            W[t] |= blocks[t * 4 + 2] << 8;
+            W[t] |= blocks[t * 4 + 3];
+        }
+        
+        for(t = 16; t < 80; t++) {
+           W[t] = SHA1CircularShift(1,W[t-3] ^ W[t-8] ^ W[t-14] ^ W[t-16]);
+        }
 
-    A = context->intermediate_hash[0];
-    B = context->intermediate_hash[1];
-    C = context->intermediate_hash[2];
-    D = context->intermediate_hash[3];
-    E = context->intermediate_hash[4];
+        A = state[0];
+        B = state[1];
+        C = state[2];
+        D = state[3];
+        E = state[4];
 
-    for(t = 0; t < 20; t++) {
-        temp =  SHA1CircularShift(5,A) + ((B & C) | ((~B) & D)) + E + W[t] + K[0];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
+        for(t = 0; t < 20; t++) {
+            temp =  SHA1CircularShift(5,A) + ((B & C) | ((~B) & D)) + E + W[t] + K[0];
+            E = D;
+            D = C;
+            C = SHA1CircularShift(30,B);
 
-        B = A;
-        A = temp;
-    }
+            B = A;
+            A = temp;
+        }
 
-    for(t = 20; t < 40; t++) {
-        temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[1];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
+        for(t = 20; t < 40; t++) {
+            temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[1];
+            E = D;
+            D = C;
+            C = SHA1CircularShift(30,B);
+            B = A;
+            A = temp;
+        }
 
-    for(t = 40; t < 60; t++) {
-        temp = SHA1CircularShift(5,A) + ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
+        for(t = 40; t < 60; t++) {
+            temp = SHA1CircularShift(5,A) + ((B & C) | (B & D) | (C & D)) + E + W[t] + K[2];
+            E = D;
+            D = C;
+            C = SHA1CircularShift(30,B);
+            B = A;
+            A = temp;
+        }
 
-    for(t = 60; t < 80; t++) {
-        temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[3];
-        E = D;
-        D = C;
-        C = SHA1CircularShift(30,B);
-        B = A;
-        A = temp;
-    }
+        for(t = 60; t < 80; t++) {
+            temp = SHA1CircularShift(5,A) + (B ^ C ^ D) + E + W[t] + K[3];
+            E = D;
+            D = C;
+            C = SHA1CircularShift(30,B);
+            B = A;
+            A = temp;
+        }
 
-    context->intermediate_hash[0] += A;
-    context->intermediate_hash[1] += B;
-    context->intermediate_hash[2] += C;
-    context->intermediate_hash[3] += D;
-    context->intermediate_hash[4] += E;
-    
-    context->block_index = 0;
+        state[0] += A;
+        state[1] += B;
+        state[2] += C;
+        state[3] += D;
+        state[4] += E;
+
+        blocks += 64;
+    }
 }
 
 /*  SHA1PadMessage
@@ -325,3 +368,224 @@ void SHA1PadMessage(SHA1Context *context)
       
     SHA1ProcessMessageBlock(context);
 }  
+
+/*  SHA1Init
+ *
+ *  Description:
+ *      Pick the fastest block function and multi-buffer width
+ *      for this cpu. Not thread safe; call it once at startup,
+ *      before any thread hashes.
+ */
+void SHA1Init(void)
+{
+#ifdef CPU_X86
+    const int features = cpu_features();
+
+    if (features & CPU_FEATURE_AVX2)
+        sha1_lanes = 8;
+    else if (features & CPU_FEATURE_SSSE3)
+        sha1_lanes = 4;
+
+    if (features & CPU_FEATURE_SHA) {
+        sha1_impl = "sha-ni";
+        sha1_compress = sha1_compress_shani;
+        return;
+    }
+    if (features & CPU_FEATURE_SSSE3) {
+        sha1_impl = "ssse3";
+        sha1_compress = sha1_compress_ssse3;
+        return;
+    }
+#endif
+}
+
+const char* SHA1Impl(void)
+{
+    return sha1_impl;
+}
+
+/*  SHA1Multi
+ *
+ *  Description:
+ *      Hash several independent messages in parallel. Each message
+ *      occupies one vector lane; lanes that run out of blocks are fed
+ *      a dummy block and their digest is taken when their last block
+ *      is processed.
+ *
+ *  Parameters:
+ *      messages: [in]
+ *          The messages to hash.
+ *      lens: [in]
+ *          The length of each message.
+ *      digests: [out]
+ *          Where the digests are returned.
+ *      count: [in]
+ *          The number of messages.
+ *
+ *  Returns:
+ *      sha Error Code.
+ */
+int SHA1Multi(const uint8_t* const* messages, const uint32_t* lens, uint8_t (*digests)[SHA1_DIGEST_LEN], const uint32_t count)
+{
+    static const uint8_t dummy[64] = { 0 };
+    uint8_t tail[SHA1_MAX_LANES][128];   // padded final block(s) of each lane
+    uint32_t state[SHA1_MAX_LANES][5];
+    uint32_t full[SHA1_MAX_LANES];       // whole message blocks
+    uint32_t total[SHA1_MAX_LANES];      // whole message blocks + padding blocks
+    const uint8_t* blocks[SHA1_MAX_LANES];
+    uint32_t lanes, base, n, step, steps, rem, i;
+    uint64_t bits;
+    SHA1Context context;
+
+    if (!messages || !lens || !digests)
+        return SHA_STATUS_STATE_NULL;
+
+    if (sha1_lanes == 1) {
+        for (n = 0; n < count; ++n) {
+            SHA1Reset(&context);
+            SHA1Input(&context, messages[n], lens[n]);
+            SHA1Result(&context, digests[n]);
+        }
+        return SHA_STATUS_SUCCESS;
+    }
+
+    for (base = 0; base < count; base += sha1_lanes) {
+        lanes = count - base;
+        if (lanes > (uint32_t)sha1_lanes)
+            lanes = sha1_lanes;
+
+        steps = 0;
+        for (n = 0; n < (uint32_t)sha1_lanes; ++n) {
+            state[n][0] = 0x67452301;
+            state[n][1] = 0xEFCDAB89;
+            state[n][2] = 0x98BADCFE;
+            state[n][3] = 0x10325476;
+            state[n][4] = 0xC3D2E1F0;
+
+            if (n >= lanes) {
+                full[n] = 0;
+                total[n] = 0;
+                continue;
+            }
+
+            full[n] = lens[base + n] / 64;
+            rem = lens[base + n] % 64;
+            total[n] = full[n] + (rem > 55 ? 2 : 1);
+
+            memset(tail[n], 0, sizeof(tail[n]));
+            memcpy(tail[n], messages[base + n] + full[n] * 64, rem);
+            tail[n][rem] = 0x80;
+
+            bits = (uint64_t)lens[base + n] << 3;
+            for (i = 0; i < 8; ++i) {
+                tail[n][(total[n] - full[n]) * 64 - 1 - i] = (uint8_t)(bits >> (i * 8));
+            }
+
+            if (total[n] > steps)
+                steps = total[n];
+        }
+
+        for (step = 0; step < steps; ++step) {
+            for (n = 0; n < (uint32_t)sha1_lanes; ++n) {
+                if (step < full[n])
+                    blocks[n] = messages[base + n] + step * 64;
+                else if (step < total[n])
+                    blocks[n] = tail[n] + (step - full[n]) * 64;
+                else
+                    blocks[n] = dummy;
+            }
+
+#ifdef CPU_X86
+            if (sha1_lanes == 8)
+                sha1_compress_x8(state, blocks);
+            else
+                sha1_compress_x4(state, blocks);
+#endif
+
+            for (n = 0; n < lanes; ++n) {
+                if (step + 1 != total[n])
+                    continue;
+                for (i = 0; i < SHA1_DIGEST_LEN; ++i) {
+                    digests[base + n][i] = (uint8_t)(state[n][i >> 2] >> 8 * (3 - (i & 0x03)));
+                }
+            }
+        }
+    }
+
+    return SHA_STATUS_SUCCESS;
+}
+
+/*  SHA1HmacReset
+ *
+ *  Description:
+ *      Precompute the HMAC-SHA1 inner and outer states for a key so
+ *      each message only hashes its own blocks.
+ *
+ *  Parameters:
+ *      context: [out]
+ *          The HMAC context to initialize.
+ *      key: [in]
+ *          The HMAC key. Keys longer than a block are hashed first.
+ *      len: [in]
+ *          The length of the key.
+ *
+ *  Returns:
+ *      sha Error Code.
+ */
+int SHA1HmacReset(SHA1HmacContext* context, const uint8_t* key, uint32_t len)
+{
+    uint8_t pad[64];
+    uint8_t digest[SHA1_DIGEST_LEN];
+    int i;
+
+    if (!context || (!key && len)) return SHA_STATUS_STATE_NULL;
+
+    if (len > sizeof(pad)) {
+        SHA1Reset(&context->inner);
+        SHA1Input(&context->inner, key, len);
+        SHA1Result(&context->inner, digest);
+        key = digest;
+        len = SHA1_DIGEST_LEN;
+    }
+
+    memset(pad, 0, sizeof(pad));
+    memcpy(pad, key, len);
+    for (i = 0; i < 64; ++i)
+        pad[i] ^= 0x36;
+    SHA1Reset(&context->inner);
+    SHA1Input(&context->inner, pad, sizeof(pad));
+
+    for (i = 0; i < 64; ++i)
+        pad[i] ^= 0x36 ^ 0x5C;
+    SHA1Reset(&context->outer);
+    SHA1Input(&context->outer, pad, sizeof(pad));
+
+    return SHA_STATUS_SUCCESS;
+}
+
+/*  SHA1Hmac
+ *
+ *  Description:
+ *      HMAC-SHA1 of a message from the precomputed key states.
+ *      The context is not modified, so it can be shared by threads.
+ *
+ *  Returns:
+ *      sha Error Code.
+ */
+int SHA1Hmac(const SHA1HmacContext* context, const uint8_t* message, uint32_t len, uint8_t digest[SHA1_DIGEST_LEN])
+{
+    SHA1Context sha;
+    uint8_t inner[SHA1_DIGEST_LEN];
+    int result;
+
+    if (!context || !digest) return SHA_STATUS_STATE_NULL;
+
+    sha = context->inner;
+    result = SHA1Input(&sha, message, len);
+    if (result != SHA_STATUS_SUCCESS) return result;
+    SHA1Result(&sha, inner);
+
+    sha = context->outer;
+    SHA1Input(&sha, inner, SHA1_DIGEST_LEN);
+    return SHA1Result(&sha, digest);
+}
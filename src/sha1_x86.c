@@ -0,0 +1,349 @@
+// sha1_x86.c: x86 SHA-1 block functions. SHA-NI, SSSE3 message schedule and SSSE3 / AVX2 multi-buffer.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#include "sha1.h"
+
+#ifdef CPU_X86
+
+// std incl
+#include <stdint.h>
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define SHA1_BSWAP(x) _byteswap_ulong(x)
+#else
+#define SHA1_BSWAP(x) __builtin_bswap32(x)
+#endif
+
+#define SHA1_K0 0x5A827999
+#define SHA1_K1 0x6ED9EBA1
+#define SHA1_K2 0x8F1BBCDC
+#define SHA1_K3 0xCA62C1D6
+
+/*
+ * SHA-NI
+ */
+
+// 4 rounds. Ea / Eb alternate, M0 holds W[4g..4g+3], M1..M3 are the next message vectors.
+#define SHANI_STEP(g, Ea, Eb, M0, M1, M2, M3) \
+	Ea = _mm_sha1nexte_epu32(Ea, M0); \
+	Eb = ABCD; \
+	if ((g) >= 3 && (g) <= 18) M1 = _mm_sha1msg2_epu32(M1, M0); \
+	ABCD = _mm_sha1rnds4_epu32(ABCD, Ea, (g) / 5); \
+	if ((g) >= 1 && (g) <= 16) M3 = _mm_sha1msg1_epu32(M3, M0); \
+	if ((g) >= 2 && (g) <= 17) M2 = _mm_xor_si128(M2, M0);
+
+CPU_TARGET("sha,sse4.1,ssse3")
+void sha1_compress_shani(uint32_t state[5], const uint8_t* blocks, uint32_t count) {
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+	__m128i ABCD, ABCD_SAVE, E0, E0_SAVE, E1;
+	__m128i MSG0, MSG1, MSG2, MSG3;
+
+	ABCD = _mm_loadu_si128((const __m128i*)state);
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+	E0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+	while (count--) {
+		ABCD_SAVE = ABCD;
+		E0_SAVE = E0;
+
+		MSG0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 0)), MASK);
+		MSG1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 16)), MASK);
+		MSG2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 32)), MASK);
+		MSG3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + 48)), MASK);
+
+		// rounds 0-3
+		E0 = _mm_add_epi32(E0, MSG0);
+		E1 = ABCD;
+		ABCD = _mm_sha1rnds4_epu32(ABCD, E0, 0);
+
+		SHANI_STEP(1, E1, E0, MSG1, MSG2, MSG3, MSG0);
+		SHANI_STEP(2, E0, E1, MSG2, MSG3, MSG0, MSG1);
+		SHANI_STEP(3, E1, E0, MSG3, MSG0, MSG1, MSG2);
+		SHANI_STEP(4, E0, E1, MSG0, MSG1, MSG2, MSG3);
+		SHANI_STEP(5, E1, E0, MSG1, MSG2, MSG3, MSG0);
+		SHANI_STEP(6, E0, E1, MSG2, MSG3, MSG0, MSG1);
+		SHANI_STEP(7, E1, E0, MSG3, MSG0, MSG1, MSG2);
+		SHANI_STEP(8, E0, E1, MSG0, MSG1, MSG2, MSG3);
+		SHANI_STEP(9, E1, E0, MSG1, MSG2, MSG3, MSG0);
+		SHANI_STEP(10, E0, E1, MSG2, MSG3, MSG0, MSG1);
+		SHANI_STEP(11, E1, E0, MSG3, MSG0, MSG1, MSG2);
+		SHANI_STEP(12, E0, E1, MSG0, MSG1, MSG2, MSG3);
+		SHANI_STEP(13, E1, E0, MSG1, MSG2, MSG3, MSG0);
+		SHANI_STEP(14, E0, E1, MSG2, MSG3, MSG0, MSG1);
+		SHANI_STEP(15, E1, E0, MSG3, MSG0, MSG1, MSG2);
+		SHANI_STEP(16, E0, E1, MSG0, MSG1, MSG2, MSG3);
+		SHANI_STEP(17, E1, E0, MSG1, MSG2, MSG3, MSG0);
+		SHANI_STEP(18, E0, E1, MSG2, MSG3, MSG0, MSG1);
+		SHANI_STEP(19, E1, E0, MSG3, MSG0, MSG1, MSG2);
+
+		E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+		ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+
+		blocks += 64;
+	}
+
+	ABCD = _mm_shuffle_epi32(ABCD, 0x1B);
+	_mm_storeu_si128((__m128i*)state, ABCD);
+	state[4] = (uint32_t)_mm_extract_epi32(E0, 3);
+}
+
+/*
+ * SSSE3 message schedule; the rounds stay scalar but W[t] + K is computed 4 words at a time.
+ */
+
+#define SHA1_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SHA1_ROUND(a, b, c, d, e, f, wk) \
+	e += SHA1_ROL(a, 5) + (f) + (wk); \
+	b = SHA1_ROL(b, 30);
+#define SHA1_F0(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define SHA1_F1(b, c, d) ((b) ^ (c) ^ (d))
+#define SHA1_F2(b, c, d) (((b) & (c)) | ((d) & ((b) | (c))))
+
+CPU_TARGET("ssse3")
+static inline __m128i sha1_rol_epi32(__m128i x, const int n) {
+	return _mm_or_si128(_mm_slli_epi32(x, n), _mm_srli_epi32(x, 32 - n));
+}
+
+CPU_TARGET("ssse3")
+void sha1_compress_ssse3(uint32_t state[5], const uint8_t* blocks, uint32_t count) {
+	const __m128i MASK = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+	__m128i w[20];
+	__m128i tmp;
+	uint32_t wk[80];
+	uint32_t a, b, c, d, e;
+	int i;
+
+	while (count--) {
+		for (i = 0; i < 4; ++i) {
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(blocks + i * 16)), MASK);
+		}
+
+		// W[16..31]: the last lane depends on the first lane of the same vector.
+		for (i = 4; i < 8; ++i) {
+			tmp = _mm_xor_si128(_mm_xor_si128(w[i - 4], _mm_alignr_epi8(w[i - 3], w[i - 4], 8)),
+				_mm_xor_si128(w[i - 2], _mm_srli_si128(w[i - 1], 4)));
+			tmp = sha1_rol_epi32(tmp, 1);
+			w[i] = _mm_xor_si128(tmp, sha1_rol_epi32(_mm_slli_si128(tmp, 12), 1));
+		}
+
+		// W[32..79]: W[t] = rol2(W[t-6] ^ W[t-16] ^ W[t-28] ^ W[t-32])
+		for (i = 8; i < 20; ++i) {
+			tmp = _mm_xor_si128(_mm_xor_si128(_mm_alignr_epi8(w[i - 1], w[i - 2], 8), w[i - 4]),
+				_mm_xor_si128(w[i - 7], w[i - 8]));
+			w[i] = sha1_rol_epi32(tmp, 2);
+		}
+
+		for (i = 0; i < 5; ++i) {
+			_mm_storeu_si128((__m128i*)&wk[i * 4], _mm_add_epi32(w[i], _mm_set1_epi32(SHA1_K0)));
+			_mm_storeu_si128((__m128i*)&wk[i * 4 + 20], _mm_add_epi32(w[i + 5], _mm_set1_epi32(SHA1_K1)));
+			_mm_storeu_si128((__m128i*)&wk[i * 4 + 40], _mm_add_epi32(w[i + 10], _mm_set1_epi32((int)SHA1_K2)));
+			_mm_storeu_si128((__m128i*)&wk[i * 4 + 60], _mm_add_epi32(w[i + 15], _mm_set1_epi32((int)SHA1_K3)));
+		}
+
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+
+		for (i = 0; i < 20; i += 5) {
+			SHA1_ROUND(a, b, c, d, e, SHA1_F0(b, c, d), wk[i + 0]);
+			SHA1_ROUND(e, a, b, c, d, SHA1_F0(a, b, c), wk[i + 1]);
+			SHA1_ROUND(d, e, a, b, c, SHA1_F0(e, a, b), wk[i + 2]);
+			SHA1_ROUND(c, d, e, a, b, SHA1_F0(d, e, a), wk[i + 3]);
+			SHA1_ROUND(b, c, d, e, a, SHA1_F0(c, d, e), wk[i + 4]);
+		}
+		for (i = 20; i < 40; i += 5) {
+			SHA1_ROUND(a, b, c, d, e, SHA1_F1(b, c, d), wk[i + 0]);
+			SHA1_ROUND(e, a, b, c, d, SHA1_F1(a, b, c), wk[i + 1]);
+			SHA1_ROUND(d, e, a, b, c, SHA1_F1(e, a, b), wk[i + 2]);
+			SHA1_ROUND(c, d, e, a, b, SHA1_F1(d, e, a), wk[i + 3]);
+			SHA1_ROUND(b, c, d, e, a, SHA1_F1(c, d, e), wk[i + 4]);
+		}
+		for (i = 40; i < 60; i += 5) {
+			SHA1_ROUND(a, b, c, d, e, SHA1_F2(b, c, d), wk[i + 0]);
+			SHA1_ROUND(e, a, b, c, d, SHA1_F2(a, b, c), wk[i + 1]);
+			SHA1_ROUND(d, e, a, b, c, SHA1_F2(e, a, b), wk[i + 2]);
+			SHA1_ROUND(c, d, e, a, b, SHA1_F2(d, e, a), wk[i + 3]);
+			SHA1_ROUND(b, c, d, e, a, SHA1_F2(c, d, e), wk[i + 4]);
+		}
+		for (i = 60; i < 80; i += 5) {
+			SHA1_ROUND(a, b, c, d, e, SHA1_F1(b, c, d), wk[i + 0]);
+			SHA1_ROUND(e, a, b, c, d, SHA1_F1(a, b, c), wk[i + 1]);
+			SHA1_ROUND(d, e, a, b, c, SHA1_F1(e, a, b), wk[i + 2]);
+			SHA1_ROUND(c, d, e, a, b, SHA1_F1(d, e, a), wk[i + 3]);
+			SHA1_ROUND(b, c, d, e, a, SHA1_F1(c, d, e), wk[i + 4]);
+		}
+
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+
+		blocks += 64;
+	}
+}
+
+/*
+ * Multi-buffer; one independent message per vector lane.
+ */
+
+#define SHA1_LOAD_WORD(p, t) SHA1_BSWAP(((const uint32_t*)(p))[t])
+
+CPU_TARGET("ssse3")
+void sha1_compress_x4(uint32_t state[][5], const uint8_t* const* blocks) {
+	__m128i a, b, c, d, e, f, temp;
+	__m128i w[16];
+	int t;
+
+	for (t = 0; t < 16; ++t) {
+		w[t] = _mm_set_epi32((int)SHA1_LOAD_WORD(blocks[3], t), (int)SHA1_LOAD_WORD(blocks[2], t),
+			(int)SHA1_LOAD_WORD(blocks[1], t), (int)SHA1_LOAD_WORD(blocks[0], t));
+	}
+
+	a = _mm_set_epi32((int)state[3][0], (int)state[2][0], (int)state[1][0], (int)state[0][0]);
+	b = _mm_set_epi32((int)state[3][1], (int)state[2][1], (int)state[1][1], (int)state[0][1]);
+	c = _mm_set_epi32((int)state[3][2], (int)state[2][2], (int)state[1][2], (int)state[0][2]);
+	d = _mm_set_epi32((int)state[3][3], (int)state[2][3], (int)state[1][3], (int)state[0][3]);
+	e = _mm_set_epi32((int)state[3][4], (int)state[2][4], (int)state[1][4], (int)state[0][4]);
+
+	for (t = 0; t < 80; ++t) {
+		if (t >= 16) {
+			temp = _mm_xor_si128(_mm_xor_si128(w[(t - 3) & 15], w[(t - 8) & 15]), _mm_xor_si128(w[(t - 14) & 15], w[t & 15]));
+			w[t & 15] = sha1_rol_epi32(temp, 1);
+		}
+
+		if (t < 20) {
+			f = _mm_xor_si128(d, _mm_and_si128(b, _mm_xor_si128(c, d)));
+			f = _mm_add_epi32(f, _mm_set1_epi32(SHA1_K0));
+		}
+		else if (t < 40) {
+			f = _mm_add_epi32(_mm_xor_si128(_mm_xor_si128(b, c), d), _mm_set1_epi32(SHA1_K1));
+		}
+		else if (t < 60) {
+			f = _mm_or_si128(_mm_and_si128(b, c), _mm_and_si128(d, _mm_or_si128(b, c)));
+			f = _mm_add_epi32(f, _mm_set1_epi32((int)SHA1_K2));
+		}
+		else {
+			f = _mm_add_epi32(_mm_xor_si128(_mm_xor_si128(b, c), d), _mm_set1_epi32((int)SHA1_K3));
+		}
+
+		temp = _mm_add_epi32(_mm_add_epi32(sha1_rol_epi32(a, 5), f), _mm_add_epi32(e, w[t & 15]));
+		e = d;
+		d = c;
+		c = sha1_rol_epi32(b, 30);
+		b = a;
+		a = temp;
+	}
+
+	uint32_t out[5][4];
+	_mm_storeu_si128((__m128i*)out[0], a);
+	_mm_storeu_si128((__m128i*)out[1], b);
+	_mm_storeu_si128((__m128i*)out[2], c);
+	_mm_storeu_si128((__m128i*)out[3], d);
+	_mm_storeu_si128((__m128i*)out[4], e);
+	for (t = 0; t < 4; ++t) {
+		state[t][0] += out[0][t];
+		state[t][1] += out[1][t];
+		state[t][2] += out[2][t];
+		state[t][3] += out[3][t];
+		state[t][4] += out[4][t];
+	}
+}
+
+CPU_TARGET("avx2")
+static inline __m256i sha1_rol_epi32_avx2(__m256i x, const int n) {
+	return _mm256_or_si256(_mm256_slli_epi32(x, n), _mm256_srli_epi32(x, 32 - n));
+}
+
+CPU_TARGET("avx2")
+static inline __m256i sha1_set_lanes_avx2(const uint32_t state[][5], const int i) {
+	return _mm256_set_epi32((int)state[7][i], (int)state[6][i], (int)state[5][i], (int)state[4][i],
+		(int)state[3][i], (int)state[2][i], (int)state[1][i], (int)state[0][i]);
+}
+
+CPU_TARGET("avx2")
+void sha1_compress_x8(uint32_t state[][5], const uint8_t* const* blocks) {
+	__m256i a, b, c, d, e, f, temp;
+	__m256i w[16];
+	int t;
+
+	for (t = 0; t < 16; ++t) {
+		w[t] = _mm256_set_epi32((int)SHA1_LOAD_WORD(blocks[7], t), (int)SHA1_LOAD_WORD(blocks[6], t),
+			(int)SHA1_LOAD_WORD(blocks[5], t), (int)SHA1_LOAD_WORD(blocks[4], t),
+			(int)SHA1_LOAD_WORD(blocks[3], t), (int)SHA1_LOAD_WORD(blocks[2], t),
+			(int)SHA1_LOAD_WORD(blocks[1], t), (int)SHA1_LOAD_WORD(blocks[0], t));
+	}
+
+	a = sha1_set_lanes_avx2(state, 0);
+	b = sha1_set_lanes_avx2(state, 1);
+	c = sha1_set_lanes_avx2(state, 2);
+	d = sha1_set_lanes_avx2(state, 3);
+	e = sha1_set_lanes_avx2(state, 4);
+
+	for (t = 0; t < 80; ++t) {
+		if (t >= 16) {
+			temp = _mm256_xor_si256(_mm256_xor_si256(w[(t - 3) & 15], w[(t - 8) & 15]), _mm256_xor_si256(w[(t - 14) & 15], w[t & 15]));
+			w[t & 15] = sha1_rol_epi32_avx2(temp, 1);
+		}
+
+		if (t < 20) {
+			f = _mm256_xor_si256(d, _mm256_and_si256(b, _mm256_xor_si256(c, d)));
+			f = _mm256_add_epi32(f, _mm256_set1_epi32(SHA1_K0));
+		}
+		else if (t < 40) {
+			f = _mm256_add_epi32(_mm256_xor_si256(_mm256_xor_si256(b, c), d), _mm256_set1_epi32(SHA1_K1));
+		}
+		else if (t < 60) {
+			f = _mm256_or_si256(_mm256_and_si256(b, c), _mm256_and_si256(d, _mm256_or_si256(b, c)));
+			f = _mm256_add_epi32(f, _mm256_set1_epi32((int)SHA1_K2));
+		}
+		else {
+			f = _mm256_add_epi32(_mm256_xor_si256(_mm256_xor_si256(b, c), d), _mm256_set1_epi32((int)SHA1_K3));
+		}
+
+		temp = _mm256_add_epi32(_mm256_add_epi32(sha1_rol_epi32_avx2(a, 5), f), _mm256_add_epi32(e, w[t & 15]));
+		e = d;
+		d = c;
+		c = sha1_rol_epi32_avx2(b, 30);
+		b = a;
+		a = temp;
+	}
+
+	uint32_t out[5][8];
+	_mm256_storeu_si256((__m256i*)out[0], a);
+	_mm256_storeu_si256((__m256i*)out[1], b);
+	_mm256_storeu_si256((__m256i*)out[2], c);
+	_mm256_storeu_si256((__m256i*)out[3], d);
+	_mm256_storeu_si256((__m256i*)out[4], e);
+	for (t = 0; t < 8; ++t) {
+		state[t][0] += out[0][t];
+		state[t][1] += out[1][t];
+		state[t][2] += out[2][t];
+		state[t][3] += out[3][t];
+		state[t][4] += out[4][t];
+	}
+}
+
+#endif // CPU_X86
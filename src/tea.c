@@ -5,12 +5,21 @@
 // GitHub: https:\\github.com\tommojphillips
 
 #include <stdint.h>
+#include <string.h>
 
 #include "tea.h"
 
 #define TEA_DELTA 0x9E3779B9
 #define TEA_DECRYPT_SUM 0xC6EF3720
 
+typedef void(*TEA_HASH_LANES)(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks);
+
+static void tea_hash_generic(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks);
+
+// lane function for this cpu; generic until tea_init() selects it.
+static TEA_HASH_LANES tea_lanes = tea_hash_generic;
+static const char* tea_lanes_impl = "generic";
+
 void tea_encrypt(uint32_t v[2], const uint32_t k[4]) {
     uint32_t sum = 0;
     uint32_t h0 = v[0], h1 = v[1];
@@ -36,4 +45,78 @@ void tea_decrypt(uint32_t v[2], const uint32_t k[4]) {
         h0 -= ((h1 << 4) + k0) ^ (h1 + sum) ^ ((h1 >> 5) + k1);
         sum -= TEA_DELTA;
     }
+
+    v[0] = h0;
+    v[1] = h1;
+}
+
+void tea_hash(uint32_t h[2], const uint8_t* data, uint32_t size) {
+    uint32_t k[4];
+    uint32_t v[2];
+
+    for (uint32_t i = 0; i + TEA_BLOCK_SIZE <= size; i += TEA_BLOCK_SIZE) {
+        memcpy(k, data + i, TEA_BLOCK_SIZE);
+        v[0] = h[0];
+        v[1] = h[1];
+        tea_encrypt(v, k);
+        h[0] ^= v[0];
+        h[1] ^= v[1];
+    }
+}
+
+static void tea_hash_generic(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks) {
+    uint32_t lane_h[2];
+    uint32_t lane_k[4];
+    uint32_t v[2];
+
+    for (int i = 0; i < TEA_MAX_LANES; ++i) {
+        lane_h[0] = h[0][i];
+        lane_h[1] = h[1][i];
+        lane_k[0] = k[0][i];
+        lane_k[1] = k[1][i];
+        lane_k[2] = k[2][i];
+        lane_k[3] = k[3][i];
+
+        v[0] = lane_h[0];
+        v[1] = lane_h[1];
+        tea_encrypt(v, lane_k);
+        lane_h[0] ^= v[0];
+        lane_h[1] ^= v[1];
+
+        tea_hash(lane_h, data, blocks * TEA_BLOCK_SIZE);
+        h[0][i] = lane_h[0];
+        h[1][i] = lane_h[1];
+    }
+}
+
+#ifdef CPU_X86
+static void tea_hash_x4x2(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks) {
+    tea_hash_x4(h, k, data, blocks, 0);
+    tea_hash_x4(h, k, data, blocks, 4);
+}
+#endif
+
+void tea_init(void) {
+#ifdef CPU_X86
+    const int features = cpu_features();
+
+    if (features & CPU_FEATURE_AVX2) {
+        tea_lanes_impl = "avx2 x8";
+        tea_lanes = tea_hash_x8;
+        return;
+    }
+    if (features & CPU_FEATURE_SSE2) {
+        tea_lanes_impl = "sse2 x4";
+        tea_lanes = tea_hash_x4x2;
+        return;
+    }
+#endif
+}
+
+void tea_hash_lanes(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks) {
+    tea_lanes(h, k, data, blocks);
+}
+
+const char* tea_impl(void) {
+    return tea_lanes_impl;
 }
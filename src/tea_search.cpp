@@ -0,0 +1,419 @@
+// tea_search.cpp: Multithreaded search for modifications of a region that keep its tea hash.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <chrono>
+#include <mutex>
+
+// user incl
+#include "tea_search.h"
+#include "tea.h"
+#include "work_pool.h"
+#include "file.h"
+#include "log.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define TEA_CHECKPOINT_MAGIC 0x43414554		// 'TEAC'
+#define TEA_CHECKPOINT_VERSION 1
+#define TEA_CHECKPOINT_INTERVAL 10			// seconds between checkpoints
+#define TEA_SEARCH_GRAIN 0x10000			// candidates per work item for a one block suffix
+
+// checkpoint file header; followed by range_count WORK_RANGEs and found_count uint64_t deltas.
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;					// region size
+	uint32_t offset;				// searched offset
+	uint32_t hash[2];				// region hash; a checkpoint only resumes the same search
+	uint32_t range_count;			// unsearched ranges
+	uint32_t found_count;
+	uint64_t searched;
+} TEA_CHECKPOINT_HEADER;
+
+typedef struct {
+	uint32_t prefix[2];				// chaining value before the modified block
+	uint32_t block[4];				// the modified block, unmodified
+	uint32_t word;					// block word of the low searched word
+	const uint8_t* suffix;			// blocks after the modified block
+	uint32_t suffix_blocks;
+	uint32_t target[2];
+	std::mutex lock;
+	uint32_t found_count;
+	uint64_t found[TEA_SEARCH_MAX_FOUND];
+} TEA_SEARCH_CONTEXT;
+
+static volatile sig_atomic_t tea_search_interrupted = 0;
+
+static void tea_search_signal(int sig);
+static void tea_search_range(uint64_t begin, uint64_t end, void* context);
+static int tea_search_load_checkpoint(const char* path, const TEA_CHECKPOINT_HEADER* expected, WORK_RANGE** ranges, uint32_t* range_count, TEA_SEARCH_CONTEXT* ctx);
+static int tea_search_save_checkpoint(const char* path, const TEA_CHECKPOINT_HEADER* expected, WorkPool* pool, const uint64_t total, TEA_SEARCH_CONTEXT* ctx);
+
+int tea_search(const TEA_SEARCH_PARAMS* params, TEA_SEARCH_RESULT* result) {
+	TEA_SEARCH_CONTEXT* ctx = NULL;
+	TEA_CHECKPOINT_HEADER header;
+	WorkPool pool;
+	WORK_RANGE* ranges = NULL;
+	uint32_t range_count = 0;
+	uint32_t block_offset;
+	uint32_t size;
+	uint32_t printed = 0;
+	uint64_t prior;
+	uint64_t grain;
+	double elapsed = 0;
+	void(*prev_handler)(int) = SIG_DFL;
+	int status = TEA_SEARCH_ERROR_FAILED;
+
+	memset(result, 0, sizeof(TEA_SEARCH_RESULT));
+
+	size = params->size - (params->size % TEA_BLOCK_SIZE);
+	if (size == 0) {
+		log_error("region is smaller than a tea block\n");
+		return TEA_SEARCH_ERROR_FAILED;
+	}
+	if ((params->offset % 4) != 0 || (params->offset % TEA_BLOCK_SIZE) > TEA_BLOCK_SIZE - TEA_SEARCH_WORD_SIZE || params->offset >= size) {
+		log_error("search offset 0x%x must be 4 byte aligned with both words in one tea block\n", params->offset);
+		return TEA_SEARCH_ERROR_FAILED;
+	}
+
+	ctx = new TEA_SEARCH_CONTEXT();
+	block_offset = params->offset - (params->offset % TEA_BLOCK_SIZE);
+
+	// hash the prefix once; every candidate starts from it.
+	ctx->prefix[0] = 0;
+	ctx->prefix[1] = 0;
+	tea_hash(ctx->prefix, params->region, block_offset);
+	memcpy(ctx->block, params->region + block_offset, TEA_BLOCK_SIZE);
+	ctx->word = (params->offset % TEA_BLOCK_SIZE) / 4;
+	ctx->suffix = params->region + block_offset + TEA_BLOCK_SIZE;
+	ctx->suffix_blocks = (size - block_offset) / TEA_BLOCK_SIZE - 1;
+	ctx->found_count = 0;
+
+	ctx->target[0] = ctx->prefix[0];
+	ctx->target[1] = ctx->prefix[1];
+	tea_hash(ctx->target, params->region + block_offset, size - block_offset);
+	result->hash[0] = ctx->target[0];
+	result->hash[1] = ctx->target[1];
+
+	// delta 0 is the unmodified region. the all ones delta does not fit a half open range.
+	result->total = UINT64_MAX - 1;
+
+	header.magic = TEA_CHECKPOINT_MAGIC;
+	header.version = TEA_CHECKPOINT_VERSION;
+	header.size = size;
+	header.offset = params->offset;
+	header.hash[0] = ctx->target[0];
+	header.hash[1] = ctx->target[1];
+	header.range_count = 0;
+	header.found_count = 0;
+	header.searched = 0;
+
+	if (params->checkpoint != NULL && fileExists(params->checkpoint)) {
+		if (tea_search_load_checkpoint(params->checkpoint, &header, &ranges, &range_count, ctx) != 0)
+			goto Cleanup;
+		log_info("Resuming from checkpoint: %s ( %u ranges, %u found )\n", params->checkpoint, range_count, ctx->found_count);
+	}
+	else {
+		ranges = (WORK_RANGE*)malloc(sizeof(WORK_RANGE));
+		if (ranges == NULL)
+			goto Cleanup;
+		ranges[0].begin = 1;
+		ranges[0].end = UINT64_MAX;
+		range_count = 1;
+	}
+
+	grain = TEA_SEARCH_GRAIN / (ctx->suffix_blocks + 1);
+	if (grain < TEA_MAX_LANES)
+		grain = TEA_MAX_LANES;
+
+	if (pool.start(ranges, range_count, grain, params->threads, tea_search_range, ctx) != 0)
+		goto Cleanup;
+
+	prior = result->total - pool.total();
+
+	printf("tea hash:  %08X%08X\nblock:     %u of %u\nthreads:   %d\nlanes:     %s\n\n",
+		ctx->target[0], ctx->target[1], block_offset / TEA_BLOCK_SIZE, size / TEA_BLOCK_SIZE, pool.threadCount(), tea_impl());
+
+	tea_search_interrupted = 0;
+	prev_handler = signal(SIGINT, tea_search_signal);
+
+	{
+		auto start = std::chrono::steady_clock::now();
+		auto last_checkpoint = start;
+		auto now = start;
+		bool finished = false;
+
+		while (!finished) {
+			finished = pool.wait(1000);
+			now = std::chrono::steady_clock::now();
+			elapsed = std::chrono::duration<double>(now - start).count();
+
+			result->searched = prior + pool.completed();
+			result->rate = (elapsed > 0) ? pool.completed() / elapsed : 0;
+
+			{
+				std::lock_guard<std::mutex> guard(ctx->lock);
+				while (printed < ctx->found_count) {
+					printf("\rfound: delta %016llX%32s\n", (unsigned long long)ctx->found[printed], "");
+					printed++;
+				}
+			}
+
+			printf("\rsearched: %llu ( %.8f%% ) %.2f MH/s ", (unsigned long long)result->searched,
+				(double)result->searched * 100.0 / (double)result->total, result->rate / 1000000.0);
+			fflush(stdout);
+
+			if (tea_search_interrupted || (params->limit != 0 && pool.completed() >= params->limit))
+				break;
+
+			if (!finished && params->checkpoint != NULL && now - last_checkpoint >= std::chrono::seconds(TEA_CHECKPOINT_INTERVAL)) {
+				tea_search_save_checkpoint(params->checkpoint, &header, &pool, result->total, ctx);
+				last_checkpoint = now;
+			}
+		}
+		printf("\n");
+
+		pool.stop();
+		status = finished ? TEA_SEARCH_ERROR_SUCCESS : TEA_SEARCH_ERROR_INTERRUPTED;
+	}
+
+	signal(SIGINT, prev_handler);
+
+	if (params->checkpoint != NULL) {
+		if (tea_search_save_checkpoint(params->checkpoint, &header, &pool, result->total, ctx) != 0) {
+			status = TEA_SEARCH_ERROR_FAILED;
+		}
+		else {
+			log_info("Checkpoint: %s\n", params->checkpoint);
+		}
+	}
+
+	result->found_count = ctx->found_count;
+	memcpy(result->found, ctx->found, ctx->found_count * sizeof(uint64_t));
+
+Cleanup:
+
+	if (ranges != NULL) {
+		free(ranges);
+		ranges = NULL;
+	}
+
+	if (ctx != NULL) {
+		delete ctx;
+		ctx = NULL;
+	}
+
+	return status;
+}
+
+void tea_search_apply(uint8_t* region, const uint32_t offset, const uint64_t delta) {
+	uint32_t words[2];
+
+	memcpy(words, region + offset, sizeof(words));
+	words[0] ^= (uint32_t)delta;
+	words[1] ^= (uint32_t)(delta >> 32);
+	memcpy(region + offset, words, sizeof(words));
+}
+
+static void tea_search_signal(int sig) {
+	tea_search_interrupted = 1;
+	signal(sig, tea_search_signal);
+}
+
+static void tea_search_range(uint64_t begin, uint64_t end, void* context) {
+	// hash the candidates [begin, end) TEA_MAX_LANES at a time. spare lanes repeat the first candidate.
+
+	TEA_SEARCH_CONTEXT* ctx = (TEA_SEARCH_CONTEXT*)context;
+	uint32_t h[2][TEA_MAX_LANES];
+	uint32_t k[4][TEA_MAX_LANES];
+	uint64_t delta;
+	uint64_t count;
+	uint64_t i;
+	int lane;
+	int w;
+
+	for (w = 0; w < 4; ++w) {
+		for (lane = 0; lane < TEA_MAX_LANES; ++lane) {
+			k[w][lane] = ctx->block[w];
+		}
+	}
+
+	for (i = begin; i < end; i += count) {
+		count = (end - i < TEA_MAX_LANES) ? end - i : TEA_MAX_LANES;
+
+		for (lane = 0; lane < TEA_MAX_LANES; ++lane) {
+			delta = ((uint64_t)lane < count) ? i + lane : i;
+			k[ctx->word][lane] = ctx->block[ctx->word] ^ (uint32_t)delta;
+			k[ctx->word + 1][lane] = ctx->block[ctx->word + 1] ^ (uint32_t)(delta >> 32);
+			h[0][lane] = ctx->prefix[0];
+			h[1][lane] = ctx->prefix[1];
+		}
+
+		tea_hash_lanes(h, k, ctx->suffix, ctx->suffix_blocks);
+
+		for (lane = 0; lane < (int)count; ++lane) {
+			if (h[0][lane] != ctx->target[0] || h[1][lane] != ctx->target[1])
+				continue;
+			std::lock_guard<std::mutex> guard(ctx->lock);
+			if (ctx->found_count < TEA_SEARCH_MAX_FOUND) {
+				ctx->found[ctx->found_count++] = i + lane;
+			}
+		}
+	}
+}
+
+static int tea_search_load_checkpoint(const char* path, const TEA_CHECKPOINT_HEADER* expected, WORK_RANGE** ranges, uint32_t* range_count, TEA_SEARCH_CONTEXT* ctx) {
+	TEA_CHECKPOINT_HEADER header;
+	uint8_t* data = NULL;
+	uint32_t size = 0;
+	int result = 1;
+
+	data = readFile(path, &size, 0);
+	if (data == NULL)
+		return 1;
+
+	if (size < sizeof(TEA_CHECKPOINT_HEADER)) {
+		log_error("invalid checkpoint file: %s\n", path);
+		goto Cleanup;
+	}
+
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != TEA_CHECKPOINT_MAGIC || header.version != TEA_CHECKPOINT_VERSION || header.found_count > TEA_SEARCH_MAX_FOUND ||
+		size != sizeof(header) + header.range_count * sizeof(WORK_RANGE) + header.found_count * sizeof(uint64_t)) {
+		log_error("invalid checkpoint file: %s\n", path);
+		goto Cleanup;
+	}
+
+	if (header.size != expected->size || header.offset != expected->offset || memcmp(header.hash, expected->hash, sizeof(header.hash)) != 0) {
+		log_error("checkpoint '%s' is for a different search. Delete it or use -ckpt to start a new one.\n", path);
+		goto Cleanup;
+	}
+
+	*ranges = (WORK_RANGE*)malloc(header.range_count * sizeof(WORK_RANGE) + 1);
+	if (*ranges == NULL)
+		goto Cleanup;
+
+	memcpy(*ranges, data + sizeof(header), header.range_count * sizeof(WORK_RANGE));
+	*range_count = header.range_count;
+
+	memcpy(ctx->found, data + sizeof(header) + header.range_count * sizeof(WORK_RANGE), header.found_count * sizeof(uint64_t));
+	ctx->found_count = header.found_count;
+
+	result = 0;
+
+Cleanup:
+
+	if (data != NULL) {
+		free(data);
+		data = NULL;
+	}
+
+	return result;
+}
+
+static int tea_search_save_checkpoint(const char* path, const TEA_CHECKPOINT_HEADER* expected, WorkPool* pool, const uint64_t total, TEA_SEARCH_CONTEXT* ctx) {
+	// write to a temp file and swap it in so an interrupted write keeps the last checkpoint.
+
+	TEA_CHECKPOINT_HEADER header;
+	uint8_t* data = NULL;
+	WORK_RANGE* ranges;
+	uint64_t remaining = 0;
+	uint32_t count;
+	uint32_t size;
+	uint32_t i;
+	char* tmp_path = NULL;
+	int result = 1;
+
+	// a steal can split a range between sizing and taking the snapshot; retry until it fits.
+	count = pool->remaining(NULL, 0);
+	for (;;) {
+		size = sizeof(header) + count * sizeof(WORK_RANGE) + TEA_SEARCH_MAX_FOUND * sizeof(uint64_t);
+		data = (uint8_t*)malloc(size);
+		if (data == NULL)
+			goto Cleanup;
+
+		ranges = (WORK_RANGE*)(data + sizeof(header));
+		i = pool->remaining(ranges, count);
+		if (i <= count) {
+			count = i;
+			break;
+		}
+
+		free(data);
+		data = NULL;
+		count = i;
+	}
+
+	header = *expected;
+	header.range_count = count;
+	for (i = 0; i < count; ++i) {
+		remaining += ranges[i].end - ranges[i].begin;
+	}
+	header.searched = total - remaining;
+
+	{
+		std::lock_guard<std::mutex> guard(ctx->lock);
+		header.found_count = ctx->found_count;
+		memcpy(data + sizeof(header) + count * sizeof(WORK_RANGE), ctx->found, ctx->found_count * sizeof(uint64_t));
+	}
+	memcpy(data, &header, sizeof(header));
+	size = sizeof(header) + count * sizeof(WORK_RANGE) + header.found_count * sizeof(uint64_t);
+
+	tmp_path = (char*)malloc(strlen(path) + 5);
+	if (tmp_path == NULL)
+		goto Cleanup;
+	strcpy(tmp_path, path);
+	strcat(tmp_path, ".tmp");
+
+	if (writeFile(tmp_path, data, size) != 0)
+		goto Cleanup;
+
+	if (fileExists(path))
+		deleteFile(path);
+	if (rename(tmp_path, path) != 0) {
+		log_error("Failed to write checkpoint: %s\n", path);
+		goto Cleanup;
+	}
+
+	result = 0;
+
+Cleanup:
+
+	if (data != NULL) {
+		free(data);
+		data = NULL;
+	}
+
+	if (tmp_path != NULL) {
+		free(tmp_path);
+		tmp_path = NULL;
+	}
+
+	return result;
+}
@@ -0,0 +1,123 @@
+// tea_x86.c: sse2 and avx2 multi-lane tea hash.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+#include "tea.h"
+
+#ifdef CPU_X86
+
+// std incl
+#include <stdint.h>
+#include <string.h>
+#include <immintrin.h>
+
+#define TEA_DELTA 0x9E3779B9
+
+static uint32_t tea_load32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/*
+ * SSE2; 4 lanes
+ */
+
+#define TEA_ROUND_X4(v0, v1, k0, k1, k2, k3, sum) \
+	v0 = _mm_add_epi32(v0, _mm_xor_si128(_mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(v1, 4), k0), _mm_add_epi32(v1, sum)), _mm_add_epi32(_mm_srli_epi32(v1, 5), k1))); \
+	v1 = _mm_add_epi32(v1, _mm_xor_si128(_mm_xor_si128(_mm_add_epi32(_mm_slli_epi32(v0, 4), k2), _mm_add_epi32(v0, sum)), _mm_add_epi32(_mm_srli_epi32(v0, 5), k3)))
+
+CPU_TARGET("sse2")
+static void tea_dm_x4(__m128i* h0, __m128i* h1, __m128i k0, __m128i k1, __m128i k2, __m128i k3) {
+	// h = E(k, h) ^ h
+	__m128i v0 = *h0;
+	__m128i v1 = *h1;
+	uint32_t sum = 0;
+	for (int i = 0; i < 32; ++i) {
+		sum += TEA_DELTA;
+		const __m128i s = _mm_set1_epi32((int)sum);
+		TEA_ROUND_X4(v0, v1, k0, k1, k2, k3, s);
+	}
+	*h0 = _mm_xor_si128(*h0, v0);
+	*h1 = _mm_xor_si128(*h1, v1);
+}
+
+CPU_TARGET("sse2")
+void tea_hash_x4(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks, int lane) {
+	__m128i h0 = _mm_loadu_si128((const __m128i*)&h[0][lane]);
+	__m128i h1 = _mm_loadu_si128((const __m128i*)&h[1][lane]);
+
+	tea_dm_x4(&h0, &h1,
+		_mm_loadu_si128((const __m128i*)&k[0][lane]), _mm_loadu_si128((const __m128i*)&k[1][lane]),
+		_mm_loadu_si128((const __m128i*)&k[2][lane]), _mm_loadu_si128((const __m128i*)&k[3][lane]));
+
+	for (uint32_t i = 0; i < blocks; ++i, data += TEA_BLOCK_SIZE) {
+		tea_dm_x4(&h0, &h1,
+			_mm_set1_epi32((int)tea_load32(data)), _mm_set1_epi32((int)tea_load32(data + 4)),
+			_mm_set1_epi32((int)tea_load32(data + 8)), _mm_set1_epi32((int)tea_load32(data + 12)));
+	}
+
+	_mm_storeu_si128((__m128i*)&h[0][lane], h0);
+	_mm_storeu_si128((__m128i*)&h[1][lane], h1);
+}
+
+/*
+ * AVX2; 8 lanes
+ */
+
+#define TEA_ROUND_X8(v0, v1, k0, k1, k2, k3, sum) \
+	v0 = _mm256_add_epi32(v0, _mm256_xor_si256(_mm256_xor_si256(_mm256_add_epi32(_mm256_slli_epi32(v1, 4), k0), _mm256_add_epi32(v1, sum)), _mm256_add_epi32(_mm256_srli_epi32(v1, 5), k1))); \
+	v1 = _mm256_add_epi32(v1, _mm256_xor_si256(_mm256_xor_si256(_mm256_add_epi32(_mm256_slli_epi32(v0, 4), k2), _mm256_add_epi32(v0, sum)), _mm256_add_epi32(_mm256_srli_epi32(v0, 5), k3)))
+
+CPU_TARGET("avx2")
+static void tea_dm_x8(__m256i* h0, __m256i* h1, __m256i k0, __m256i k1, __m256i k2, __m256i k3) {
+	// h = E(k, h) ^ h
+	__m256i v0 = *h0;
+	__m256i v1 = *h1;
+	uint32_t sum = 0;
+	for (int i = 0; i < 32; ++i) {
+		sum += TEA_DELTA;
+		const __m256i s = _mm256_set1_epi32((int)sum);
+		TEA_ROUND_X8(v0, v1, k0, k1, k2, k3, s);
+	}
+	*h0 = _mm256_xor_si256(*h0, v0);
+	*h1 = _mm256_xor_si256(*h1, v1);
+}
+
+CPU_TARGET("avx2")
+void tea_hash_x8(uint32_t h[2][TEA_MAX_LANES], const uint32_t k[4][TEA_MAX_LANES], const uint8_t* data, uint32_t blocks) {
+	__m256i h0 = _mm256_loadu_si256((const __m256i*)h[0]);
+	__m256i h1 = _mm256_loadu_si256((const __m256i*)h[1]);
+
+	tea_dm_x8(&h0, &h1,
+		_mm256_loadu_si256((const __m256i*)k[0]), _mm256_loadu_si256((const __m256i*)k[1]),
+		_mm256_loadu_si256((const __m256i*)k[2]), _mm256_loadu_si256((const __m256i*)k[3]));
+
+	for (uint32_t i = 0; i < blocks; ++i, data += TEA_BLOCK_SIZE) {
+		tea_dm_x8(&h0, &h1,
+			_mm256_set1_epi32((int)tea_load32(data)), _mm256_set1_epi32((int)tea_load32(data + 4)),
+			_mm256_set1_epi32((int)tea_load32(data + 8)), _mm256_set1_epi32((int)tea_load32(data + 12)));
+	}
+
+	_mm256_storeu_si256((__m256i*)h[0], h0);
+	_mm256_storeu_si256((__m256i*)h[1], h1);
+}
+
+#endif // CPU_X86
@@ -0,0 +1,240 @@
+// work_pool.cpp: A work stealing thread pool over ranges of a 64-bit index space.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <chrono>
+
+// user incl
+#include "work_pool.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+WorkPool::WorkPool() : done(0), active(0), stopping(false) {
+	totalItems = 0;
+	grainSize = 1;
+	func = NULL;
+	context = NULL;
+}
+WorkPool::~WorkPool() {
+	stop();
+	clear();
+}
+
+int WorkPool::start(const WORK_RANGE* ranges, const uint32_t count, const uint64_t grain, int threads, WORK_FUNC func, void* context) {
+	uint32_t i;
+
+	if (active.load() != 0 || func == NULL)
+		return 1;
+
+	join();
+	clear();
+
+	if (threads <= 0)
+		threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0)
+		threads = 1;
+
+	this->func = func;
+	this->context = context;
+	grainSize = (grain == 0) ? 1 : grain;
+	totalItems = 0;
+	done = 0;
+	stopping = false;
+
+	for (i = 0; i < (uint32_t)threads; ++i) {
+		Worker* worker = new Worker();
+		worker->current = { 0, 0 };
+		worker->inflight = { 0, 0 };
+		workers.push_back(worker);
+	}
+
+	for (i = 0; i < count; ++i) {
+		if (ranges[i].end <= ranges[i].begin)
+			continue;
+		workers[i % threads]->queue.push_back(ranges[i]);
+		totalItems += ranges[i].end - ranges[i].begin;
+	}
+
+	active = threads;
+	for (i = 0; i < (uint32_t)threads; ++i) {
+		workers[i]->thread = std::thread(&WorkPool::run, this, workers[i]);
+	}
+
+	return 0;
+}
+
+bool WorkPool::wait(const uint32_t ms) {
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+	while (active.load() != 0) {
+		if (std::chrono::steady_clock::now() >= end)
+			return false;
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	join();
+	return true;
+}
+
+void WorkPool::stop() {
+	stopping = true;
+	join();
+}
+
+uint32_t WorkPool::remaining(WORK_RANGE* ranges, const uint32_t max) {
+	// lock every worker (in order) so ranges being stolen are not missed or counted twice.
+
+	uint32_t count = 0;
+	size_t i;
+
+	for (i = 0; i < workers.size(); ++i) {
+		workers[i]->lock.lock();
+	}
+
+	for (i = 0; i < workers.size(); ++i) {
+		Worker* worker = workers[i];
+		if (worker->inflight.end > worker->inflight.begin) {
+			if (ranges != NULL && count < max)
+				ranges[count] = worker->inflight;
+			count++;
+		}
+		if (worker->current.end > worker->current.begin) {
+			if (ranges != NULL && count < max)
+				ranges[count] = worker->current;
+			count++;
+		}
+		for (const WORK_RANGE& range : worker->queue) {
+			if (ranges != NULL && count < max)
+				ranges[count] = range;
+			count++;
+		}
+	}
+
+	for (i = 0; i < workers.size(); ++i) {
+		workers[i]->lock.unlock();
+	}
+
+	return count;
+}
+
+void WorkPool::run(Worker* self) {
+	WORK_RANGE work;
+
+	while (!stopping.load()) {
+		if (!next(self, &work)) {
+			if (done.load() >= totalItems)
+				break;
+			if (!steal(self))
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		func(work.begin, work.end, context);
+
+		self->lock.lock();
+		self->inflight = { 0, 0 };
+		self->lock.unlock();
+		done += work.end - work.begin;
+	}
+
+	active--;
+}
+
+bool WorkPool::next(Worker* self, WORK_RANGE* work) {
+	// take the next grain from the current range, refilling it from the queue.
+
+	std::lock_guard<std::mutex> guard(self->lock);
+
+	if (self->current.begin >= self->current.end) {
+		if (self->queue.empty())
+			return false;
+		self->current = self->queue.front();
+		self->queue.pop_front();
+	}
+
+	work->begin = self->current.begin;
+	work->end = (self->current.end - work->begin > grainSize) ? work->begin + grainSize : self->current.end;
+	self->current.begin = work->end;
+	self->inflight = *work;
+	return true;
+}
+
+bool WorkPool::steal(Worker* self) {
+	// take a queued range or the upper half of the current range from the busiest worker.
+
+	Worker* victim = NULL;
+	uint64_t best = 0;
+	uint64_t size;
+	uint64_t mid;
+
+	for (Worker* worker : workers) {
+		if (worker == self)
+			continue;
+		std::lock_guard<std::mutex> guard(worker->lock);
+		size = worker->current.end - worker->current.begin;
+		for (const WORK_RANGE& range : worker->queue) {
+			size += range.end - range.begin;
+		}
+		if (size > best) {
+			best = size;
+			victim = worker;
+		}
+	}
+
+	if (victim == NULL)
+		return false;
+
+	std::lock(self->lock, victim->lock);
+	std::lock_guard<std::mutex> self_guard(self->lock, std::adopt_lock);
+	std::lock_guard<std::mutex> victim_guard(victim->lock, std::adopt_lock);
+
+	if (self->current.begin < self->current.end || !self->queue.empty())
+		return true;
+
+	if (!victim->queue.empty()) {
+		self->current = victim->queue.back();
+		victim->queue.pop_back();
+		return true;
+	}
+
+	size = victim->current.end - victim->current.begin;
+	if (size == 0)
+		return false;
+
+	mid = victim->current.begin + size / 2;
+	self->current = { mid, victim->current.end };
+	victim->current.end = mid;
+	return true;
+}
+
+void WorkPool::join() {
+	for (Worker* worker : workers) {
+		if (worker->thread.joinable())
+			worker->thread.join();
+	}
+}
+void WorkPool::clear() {
+	for (Worker* worker : workers) {
+		delete worker;
+	}
+	workers.clear();
+}
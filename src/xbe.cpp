@@ -0,0 +1,327 @@
+// xbe.cpp: Xbox executable (XBE) parsing and verification.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <ctype.h>
+#include <atomic>
+
+// user incl
+#include "xbe.h"
+#include "file.h"
+#include "rsa.h"
+#include "sha1.h"
+#include "work_pool.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+#define XBE_SIGNED_OFFSET offsetof(XBE_HEADER, base_address) // the header signature covers the headers from here
+
+typedef struct {
+	const XBE* xbe;
+	int* status;
+	std::atomic<uint32_t> bad;
+} XBE_SECTION_CONTEXT;
+
+typedef struct {
+	XBE_BATCH* batch;
+	const PUBLIC_KEY* pubkey;
+	std::atomic<uint64_t> bytes;
+} XBE_BATCH_CONTEXT;
+
+static void xbe_digest(const uint8_t* data, const uint32_t size, uint8_t digest[SHA1_DIGEST_LEN]);
+static int xbe_sectionStatus(const XBE* xbe, const XBE_SECTION_HEADER* section);
+static void xbe_verifySectionRange(uint64_t begin, uint64_t end, void* context);
+static int xbe_batch_add(const char* filename, void* context);
+static void xbe_batch_verify(uint64_t begin, uint64_t end, void* context);
+
+int xbe_load(XBE* xbe, uint8_t* data, const uint32_t size) {
+	XBE_HEADER* header;
+	uint32_t offset;
+	uint32_t entry;
+	uint32_t i;
+
+	memset(xbe, 0, sizeof(XBE));
+
+	if (data == NULL || size < sizeof(XBE_HEADER))
+		return XBE_ERROR_INVALID_DATA;
+
+	header = (XBE_HEADER*)data;
+	if (header->magic != XBE_MAGIC || header->headers_size < sizeof(XBE_HEADER) || header->headers_size > size)
+		return XBE_ERROR_INVALID_DATA;
+
+	// certificate
+	offset = header->certificate_address - header->base_address;
+	if (header->certificate_address < header->base_address || size < sizeof(XBE_CERTIFICATE) || offset > size - sizeof(XBE_CERTIFICATE))
+		return XBE_ERROR_INVALID_DATA;
+	xbe->cert = (XBE_CERTIFICATE*)(data + offset);
+
+	// section headers
+	offset = header->section_headers_address - header->base_address;
+	if (header->section_headers_address < header->base_address || offset > header->headers_size ||
+		header->section_count > (header->headers_size - offset) / sizeof(XBE_SECTION_HEADER))
+		return XBE_ERROR_INVALID_DATA;
+	xbe->sections = (XBE_SECTION_HEADER*)(data + offset);
+
+	for (i = 0; i < header->section_count; ++i) {
+		if (xbe->sections[i].raw_address > size || xbe->sections[i].raw_size > size - xbe->sections[i].raw_address)
+			return XBE_ERROR_INVALID_DATA;
+	}
+
+	// retail entry points decode into the image.
+	entry = header->entry_point ^ XBE_ENTRY_XOR_RETAIL;
+	xbe->debug = (entry < header->base_address || entry >= header->base_address + header->image_size);
+
+	xbe->data = data;
+	xbe->size = size;
+	xbe->header = header;
+	return XBE_ERROR_SUCCESS;
+}
+
+const char* xbe_sectionName(const XBE* xbe, const XBE_SECTION_HEADER* section) {
+	uint32_t offset = section->section_name_address - xbe->header->base_address;
+	uint32_t i;
+
+	if (section->section_name_address < xbe->header->base_address || offset >= xbe->header->headers_size)
+		return "";
+
+	// the name must be terminated inside the headers.
+	for (i = offset; i < xbe->header->headers_size; ++i) {
+		if (xbe->data[i] == '\0')
+			return (const char*)(xbe->data + offset);
+	}
+	return "";
+}
+
+void xbe_headerDigest(const XBE* xbe, uint8_t digest[SHA1_DIGEST_LEN]) {
+	xbe_digest(xbe->data + XBE_SIGNED_OFFSET, xbe->header->headers_size - XBE_SIGNED_OFFSET, digest);
+}
+
+int xbe_verifyHeader(const XBE* xbe, const PUBLIC_KEY* pubkey) {
+	uint8_t digest[SHA1_DIGEST_LEN];
+
+	xbe_headerDigest(xbe, digest);
+	if (rsa_verifySignature(pubkey, xbe->header->signature, digest) != RSA_ERROR_SUCCESS)
+		return XBE_ERROR_SIGNATURE;
+
+	return XBE_ERROR_SUCCESS;
+}
+
+int xbe_verifySections(const XBE* xbe, int* status, const int threads) {
+	XBE_SECTION_CONTEXT ctx;
+	WorkPool pool;
+	WORK_RANGE range;
+
+	ctx.xbe = xbe;
+	ctx.status = status;
+	ctx.bad = 0;
+
+	range.begin = 0;
+	range.end = xbe->header->section_count;
+
+	if (threads == 1 || xbe->header->section_count < 2 || pool.start(&range, 1, 1, threads, xbe_verifySectionRange, &ctx) != 0) {
+		xbe_verifySectionRange(range.begin, range.end, &ctx);
+	}
+	else {
+		while (!pool.wait(1000)) {}
+	}
+
+	return (ctx.bad.load() == 0) ? XBE_ERROR_SUCCESS : XBE_ERROR_DIGEST;
+}
+
+void xbe_titleKeys(const XBE_CERTIFICATE* cert, const uint8_t* cert_key, uint8_t lan_key[XB_KEY_SIZE], uint8_t signature_key[XB_KEY_SIZE]) {
+	SHA1HmacContext hmac;
+	uint8_t digest[SHA1_DIGEST_LEN];
+
+	SHA1HmacReset(&hmac, cert_key, XB_KEY_SIZE);
+
+	SHA1Hmac(&hmac, cert->lan_key, XB_KEY_SIZE, digest);
+	memcpy(lan_key, digest, XB_KEY_SIZE);
+
+	SHA1Hmac(&hmac, cert->signature_key, XB_KEY_SIZE, digest);
+	memcpy(signature_key, digest, XB_KEY_SIZE);
+}
+
+int xbe_batch(XBE_BATCH* batch, const char* path, const PUBLIC_KEY* pubkey) {
+	XBE_BATCH_CONTEXT ctx;
+	WorkPool pool;
+	WORK_RANGE range;
+
+	batch->results = NULL;
+	batch->count = 0;
+	batch->capacity = 0;
+	batch->bytes = 0;
+
+	if (enumerateFiles(path, true, xbe_batch_add, batch) != 0)
+		return XBE_ERROR_FAILED;
+
+	if (batch->count == 0)
+		return XBE_ERROR_SUCCESS;
+
+	ctx.batch = batch;
+	ctx.pubkey = pubkey;
+	ctx.bytes = 0;
+
+	// one file per work item; files are hashed on a single thread each so reads overlap across cores.
+	range.begin = 0;
+	range.end = batch->count;
+	if (pool.start(&range, 1, 1, 0, xbe_batch_verify, &ctx) != 0)
+		return XBE_ERROR_FAILED;
+	while (!pool.wait(1000)) {}
+
+	batch->bytes = ctx.bytes.load();
+	return XBE_ERROR_SUCCESS;
+}
+void xbe_batch_free(XBE_BATCH* batch) {
+	uint32_t i;
+
+	if (batch->results != NULL) {
+		for (i = 0; i < batch->count; ++i) {
+			if (batch->results[i].filename != NULL) {
+				free(batch->results[i].filename);
+				batch->results[i].filename = NULL;
+			}
+		}
+		free(batch->results);
+		batch->results = NULL;
+	}
+	batch->count = 0;
+	batch->capacity = 0;
+}
+
+static void xbe_digest(const uint8_t* data, const uint32_t size, uint8_t digest[SHA1_DIGEST_LEN]) {
+	// xbe digests hash the size (le) before the data.
+
+	SHA1Context context;
+	uint8_t len[4];
+
+	len[0] = (uint8_t)size;
+	len[1] = (uint8_t)(size >> 8);
+	len[2] = (uint8_t)(size >> 16);
+	len[3] = (uint8_t)(size >> 24);
+
+	SHA1Reset(&context);
+	SHA1Input(&context, len, sizeof(len));
+	SHA1Input(&context, data, size);
+	SHA1Result(&context, digest);
+}
+
+static int xbe_sectionStatus(const XBE* xbe, const XBE_SECTION_HEADER* section) {
+	uint8_t digest[SHA1_DIGEST_LEN];
+
+	xbe_digest(xbe->data + section->raw_address, section->raw_size, digest);
+	if (memcmp(digest, section->digest, SHA1_DIGEST_LEN) != 0)
+		return XBE_ERROR_DIGEST;
+
+	return XBE_ERROR_SUCCESS;
+}
+
+static void xbe_verifySectionRange(uint64_t begin, uint64_t end, void* context) {
+	XBE_SECTION_CONTEXT* ctx = (XBE_SECTION_CONTEXT*)context;
+	int result;
+
+	for (; begin < end; ++begin) {
+		result = xbe_sectionStatus(ctx->xbe, &ctx->xbe->sections[begin]);
+		if (ctx->status != NULL)
+			ctx->status[begin] = result;
+		if (result != XBE_ERROR_SUCCESS)
+			ctx->bad++;
+	}
+}
+
+static int xbe_batch_add(const char* filename, void* context) {
+	// add .xbe files to the batch.
+
+	XBE_BATCH* batch = (XBE_BATCH*)context;
+	XBE_BATCH_RESULT* results;
+	XBE_BATCH_RESULT* result;
+	uint32_t capacity;
+	size_t len;
+
+	len = strlen(filename);
+	if (len < 4 || filename[len - 4] != '.' || tolower(filename[len - 3]) != 'x' || tolower(filename[len - 2]) != 'b' || tolower(filename[len - 1]) != 'e')
+		return 0;
+
+	if (batch->count == batch->capacity) {
+		capacity = (batch->capacity == 0) ? 64 : batch->capacity * 2;
+		results = (XBE_BATCH_RESULT*)realloc(batch->results, capacity * sizeof(XBE_BATCH_RESULT));
+		if (results == NULL)
+			return 1;
+		batch->results = results;
+		batch->capacity = capacity;
+	}
+
+	result = &batch->results[batch->count];
+	result->filename = (char*)malloc(len + 1);
+	if (result->filename == NULL)
+		return 1;
+	strcpy(result->filename, filename);
+	result->size = 0;
+	result->status = XBE_ERROR_FAILED;
+	result->header = XBE_ERROR_FAILED;
+	result->bad_sections = 0;
+
+	batch->count++;
+	return 0;
+}
+
+static void xbe_batch_verify(uint64_t begin, uint64_t end, void* context) {
+	XBE_BATCH_CONTEXT* ctx = (XBE_BATCH_CONTEXT*)context;
+	XBE_BATCH_RESULT* result;
+	XBE xbe;
+	uint8_t* data;
+	uint32_t size;
+	uint32_t i;
+
+	for (; begin < end; ++begin) {
+		result = &ctx->batch->results[begin];
+
+		size = 0;
+		data = readFile(result->filename, &size, 0);
+		if (data == NULL)
+			continue;
+		result->size = size;
+
+		result->status = xbe_load(&xbe, data, size);
+		if (result->status == XBE_ERROR_SUCCESS) {
+			if (ctx->pubkey != NULL) {
+				result->header = xbe_verifyHeader(&xbe, ctx->pubkey);
+				if (result->header != XBE_ERROR_SUCCESS)
+					result->status = result->header;
+			}
+			for (i = 0; i < xbe.header->section_count; ++i) {
+				if (xbe_sectionStatus(&xbe, &xbe.sections[i]) != XBE_ERROR_SUCCESS)
+					result->bad_sections++;
+			}
+			if (result->bad_sections != 0 && result->status == XBE_ERROR_SUCCESS)
+				result->status = XBE_ERROR_DIGEST;
+		}
+
+		ctx->bytes += size;
+		free(data);
+	}
+}
@@ -0,0 +1,544 @@
+// xbios.cpp: libxbios; a reentrant, handle based interface to the BIOS tools.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <mutex>
+
+// user incl
+#include "xbios.h"
+#include "Bios.h"
+#include "Mcpx.h"
+#include "bios_map.h"
+#include "bldr.h"
+#include "file.h"
+#include "ident_db.h"
+#include "keyring.h"
+#include "krnl_cache.h"
+#include "lzx.h"
+#include "XcodeDecoder.h"
+#include "sha1.h"
+
+#ifdef MEM_TRACKING
+#include "mem_tracking.h"
+#endif
+
+struct XBIOS {
+	Bios bios;
+	BIOS_LOAD_PARAMS params;		// load params; key pointers point into this handle
+	MCPX mcpx;						// the mcpx rom from the params
+	MCPX keyring_mcpx;				// rev only; set by a keyring match
+	const KEYRING* keyring;
+	BIOS_BANKS banks;				// bank layout of the loaded image
+	uint8_t bldr_key[XB_KEY_SIZE];
+	uint8_t kernel_key[XB_KEY_SIZE];
+	uint8_t keyring_kernel_key[XB_KEY_SIZE];
+};
+
+static void xbios_init_once();
+static int xbios_trial_keyring(XBIOS* xbios, const uint8_t* data, const uint32_t size, BIOS_LOAD_PARAMS* params);
+static int xbios_in_image(const Bios* bios, const uint8_t* ptr, const uint32_t size);
+
+void xbios_init_params(XBIOS_PARAMS* params) {
+	params->bldr_key = NULL;
+	params->kernel_key = NULL;
+	params->mcpx = NULL;
+	params->ident = NULL;
+	params->keyring = NULL;
+	params->krnl_cache = NULL;
+	params->romsize = 0;
+	params->enc_bldr = false;
+	params->enc_kernel = false;
+	params->restore_boot_params = true;
+}
+void xbios_init_build_params(XBIOS_BUILD_PARAMS* params) {
+	memset(params, 0, sizeof(XBIOS_BUILD_PARAMS));
+}
+
+KEYRING* xbios_keyring_load(const char* path) {
+	KEYRING* keyring = (KEYRING*)malloc(sizeof(KEYRING));
+	if (keyring == NULL)
+		return NULL;
+
+	keyring_init(keyring);
+	if (keyring_load(keyring, path) != KEYRING_ERROR_SUCCESS) {
+		xbios_keyring_destroy(keyring);
+		return NULL;
+	}
+	return keyring;
+}
+void xbios_keyring_destroy(KEYRING* keyring) {
+	if (keyring == NULL)
+		return;
+	keyring_free(keyring);
+	free(keyring);
+}
+
+KRNL_CACHE* xbios_krnl_cache_open(const char* path, uint64_t max_size) {
+	KRNL_CACHE* cache = (KRNL_CACHE*)malloc(sizeof(KRNL_CACHE));
+	if (cache == NULL)
+		return NULL;
+
+	if (max_size == 0)
+		max_size = KRNL_CACHE_DEFAULT_SIZE;
+
+	if (krnl_cache_open(cache, path, max_size) != KRNL_CACHE_ERROR_SUCCESS) {
+		free(cache);
+		return NULL;
+	}
+	return cache;
+}
+void xbios_krnl_cache_close(KRNL_CACHE* cache) {
+	if (cache == NULL)
+		return;
+	krnl_cache_close(cache);
+	free(cache);
+}
+
+XBIOS* xbios_create(const XBIOS_PARAMS* params) {
+	xbios_init_once();
+
+	XBIOS* xbios = new XBIOS();
+	if (xbios == NULL)
+		return NULL;
+
+	mcpx_init(&xbios->mcpx);
+	mcpx_init(&xbios->keyring_mcpx);
+	bios_init_params(&xbios->params);
+	xbios->keyring = NULL;
+	xbios->params.mcpx = &xbios->mcpx;
+
+	if (params == NULL)
+		return xbios;
+
+	if (params->mcpx != NULL) {
+		uint8_t* rom = (uint8_t*)malloc(MCPX_BLOCK_SIZE);
+		if (rom == NULL) {
+			xbios_destroy(xbios);
+			return NULL;
+		}
+		memcpy(rom, params->mcpx, MCPX_BLOCK_SIZE);
+		mcpx_identify(&xbios->mcpx, rom, params->ident);
+	}
+	if (params->bldr_key != NULL) {
+		memcpy(xbios->bldr_key, params->bldr_key, XB_KEY_SIZE);
+		xbios->params.bldr_key = xbios->bldr_key;
+	}
+	if (params->kernel_key != NULL) {
+		memcpy(xbios->kernel_key, params->kernel_key, XB_KEY_SIZE);
+		xbios->params.kernel_key = xbios->kernel_key;
+	}
+
+	xbios->keyring = params->keyring;
+	xbios->params.krnl_cache = params->krnl_cache;
+	xbios->params.romsize = params->romsize;
+	xbios->params.enc_bldr = params->enc_bldr;
+	xbios->params.enc_kernel = params->enc_kernel;
+	xbios->params.restore_boot_params = params->restore_boot_params;
+
+	return xbios;
+}
+void xbios_destroy(XBIOS* xbios) {
+	if (xbios == NULL)
+		return;
+
+	xbios->bios.unload();
+	mcpx_free(&xbios->mcpx);
+	delete xbios;
+}
+
+int xbios_load(XBIOS* xbios, const uint8_t* data, const uint32_t size) {
+	uint8_t* image;
+
+	if (xbios == NULL || data == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	if (bios_check_size(size) != 0)
+		return XBIOS_ERROR_INVALID_SIZE;
+
+	image = (uint8_t*)malloc(size);
+	if (image == NULL)
+		return XBIOS_ERROR_FAILED;
+	memcpy(image, data, size);
+
+	BIOS_LOAD_PARAMS params = xbios->params;
+	int result = xbios_trial_keyring(xbios, image, size, &params);
+	if (result != XBIOS_ERROR_SUCCESS) {
+		free(image);
+		return result;
+	}
+	if (bios_detect_banks(image, size, &xbios->banks) != 0) {
+		free(image);
+		return XBIOS_ERROR_INVALID_SIZE;
+	}
+	if (params.romsize == 0)
+		params.romsize = xbios->banks.romsize;
+
+	// the bios owns the image once loaded.
+	xbios->bios.unload();
+	if (xbios->bios.load(image, size, &params) != BIOS_LOAD_STATUS_SUCCESS) {
+		xbios->bios.unload();
+		return XBIOS_ERROR_FAILED;
+	}
+
+	return XBIOS_ERROR_SUCCESS;
+}
+int xbios_load_file(XBIOS* xbios, const char* filename) {
+	MAPPED_FILE map;
+
+	if (xbios == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	if (mapFile(filename, &map) != 0)
+		return XBIOS_ERROR_FAILED;
+
+	if (bios_check_size(map.size) != 0) {
+		unmapFile(&map);
+		return XBIOS_ERROR_INVALID_SIZE;
+	}
+
+	BIOS_LOAD_PARAMS params = xbios->params;
+	int result = xbios_trial_keyring(xbios, map.data, map.size, &params);
+	if (result != XBIOS_ERROR_SUCCESS) {
+		unmapFile(&map);
+		return result;
+	}
+	if (bios_detect_banks(map.data, map.size, &xbios->banks) != 0) {
+		unmapFile(&map);
+		return XBIOS_ERROR_INVALID_SIZE;
+	}
+	if (params.romsize == 0)
+		params.romsize = xbios->banks.romsize;
+
+	xbios->bios.unload();
+	if (xbios->bios.load(&map, &params) != BIOS_LOAD_STATUS_SUCCESS) {
+		xbios->bios.unload();
+		return XBIOS_ERROR_FAILED;
+	}
+
+	return XBIOS_ERROR_SUCCESS;
+}
+
+int xbios_list(XBIOS* xbios, XBIOS_INFO* info) {
+	Bios* bios;
+
+	if (xbios == NULL || info == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	bios = &xbios->bios;
+	if (bios->data == NULL)
+		return XBIOS_ERROR_NOT_LOADED;
+
+	memset(info, 0, sizeof(XBIOS_INFO));
+	info->size = bios->size;
+	info->romsize = bios->params.romsize;
+	info->banks = xbios->banks.banks;
+	info->unique_banks = xbios->banks.unique_banks;
+
+	// init table; plain text, nothing to decrypt.
+	info->kernel_ver = bios->init_tbl->kernel_ver & 0x7FFF;
+	info->kernel_delay_flag = (bios->init_tbl->kernel_ver & 0x8000) != 0;
+	info->init_tbl_identifier = bios->init_tbl->init_tbl_identifier;
+	info->init_tbl_revision = bios->init_tbl->revision;
+
+	info->bldr_status = bios->loadBldr();
+	info->preldr_status = bios->preldr.status;
+
+	info->signature = bios->bldr.boot_params->signature;
+	info->init_tbl_size = bios->bldr.boot_params->init_tbl_size;
+	info->kernel_size = bios->bldr.boot_params->compressed_kernel_size;
+	info->kernel_data_size = bios->bldr.boot_params->uncompressed_kernel_data_size;
+
+	if (info->bldr_status != BIOS_LOAD_STATUS_SUCCESS) {
+		info->available_space = -1;
+		return XBIOS_ERROR_INVALID_BLDR;
+	}
+
+	info->bldr_entry_point = bios->bldr.ldr_params->bldr_entry_point;
+	if (bios->bldr.entry != NULL)
+		info->bfm_entry_point = bios->bldr.entry->bfm_entry_point;
+	info->available_space = bios->available_space;
+
+	return XBIOS_ERROR_SUCCESS;
+}
+
+int xbios_extract(XBIOS* xbios, XBIOS_COMPONENT component, const uint8_t** data, uint32_t* size) {
+	Bios* bios;
+	const uint8_t* ptr = NULL;
+	uint32_t len = 0;
+
+	if (xbios == NULL || data == NULL || size == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	bios = &xbios->bios;
+	if (bios->data == NULL)
+		return XBIOS_ERROR_NOT_LOADED;
+
+	*data = NULL;
+	*size = 0;
+
+	if (component == XBIOS_COMPONENT_PRELDR) {
+		bios->loadPreldr();
+		if (bios->preldr.status == PRELDR_STATUS_NOT_FOUND)
+			return XBIOS_ERROR_FAILED;
+		*data = bios->preldr.data;
+		*size = PRELDR_SIZE;
+		return XBIOS_ERROR_SUCCESS;
+	}
+
+	// everything else is found through the 2BL boot params.
+	if (bios->loadBldr() != BIOS_LOAD_STATUS_SUCCESS)
+		return XBIOS_ERROR_INVALID_BLDR;
+
+	switch (component) {
+		case XBIOS_COMPONENT_BLDR:
+			// zero the rom digest so the 2BL is clean; same as -extr.
+			if (bios->rom_digest != NULL)
+				memset(bios->rom_digest, 0, ROM_DIGEST_SIZE);
+			ptr = bios->bldr.data;
+			len = BLDR_BLOCK_SIZE;
+			break;
+		case XBIOS_COMPONENT_INIT_TBL:
+			ptr = bios->data;
+			len = bios->bldr.boot_params->init_tbl_size;
+			break;
+		case XBIOS_COMPONENT_KERNEL:
+			if (bios->loadKernel() != BIOS_LOAD_STATUS_SUCCESS)
+				return XBIOS_ERROR_FAILED;
+			ptr = bios->kernel.compressed_kernel_ptr;
+			len = bios->bldr.boot_params->compressed_kernel_size;
+			break;
+		case XBIOS_COMPONENT_KERNEL_DATA:
+			ptr = bios->kernel.uncompressed_data_ptr;
+			len = bios->bldr.boot_params->uncompressed_kernel_data_size;
+			break;
+		case XBIOS_COMPONENT_KERNEL_IMG:
+			if (bios->decompressKrnl() != 0)
+				return XBIOS_ERROR_FAILED;
+			*data = bios->kernel.img;
+			*size = bios->kernel.img_size;
+			return XBIOS_ERROR_SUCCESS;
+		default:
+			return XBIOS_ERROR_FAILED;
+	}
+
+	if (len == 0 || !xbios_in_image(bios, ptr, len))
+		return XBIOS_ERROR_FAILED;
+
+	*data = ptr;
+	*size = len;
+	return XBIOS_ERROR_SUCCESS;
+}
+
+int xbios_build(XBIOS* xbios, const XBIOS_BUILD_PARAMS* build_params, const char* filename) {
+	BIOS_BUILD_PARAMS build;
+	BIOS_LOAD_PARAMS params;
+	BIOS_LAYOUT layout;
+	uint8_t* compressed_kernel = NULL;
+	uint32_t kernel_size = 0;
+	char* temp = NULL;
+	int result = XBIOS_ERROR_SUCCESS;
+
+	if (xbios == NULL || build_params == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	if (build_params->init_tbl == NULL || build_params->bldr == NULL || build_params->kernel_data == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	if (build_params->compressed_kernel == NULL) {
+		if (!bios_is_kernel_img(build_params->kernel_img, build_params->kernel_img_size))
+			return XBIOS_ERROR_FAILED;
+		if (bios_compress_kernel(build_params->kernel_img, build_params->kernel_img_size, &compressed_kernel, &kernel_size) != 0)
+			return XBIOS_ERROR_FAILED;
+	}
+	else {
+		compressed_kernel = (uint8_t*)build_params->compressed_kernel;
+		kernel_size = build_params->kernel_size;
+	}
+
+	// the build only reads the buffers.
+	bios_init_build_params(&build);
+	build.init_tbl = (uint8_t*)build_params->init_tbl;
+	build.preldr = (uint8_t*)build_params->preldr;
+	build.bldr = (uint8_t*)build_params->bldr;
+	build.compressed_kernel = compressed_kernel;
+	build.kernel_data = (uint8_t*)build_params->kernel_data;
+	build.eeprom_key = (uint8_t*)build_params->eeprom_key;
+	build.cert_key = (uint8_t*)build_params->cert_key;
+	build.init_tbl_size = build_params->init_tbl_size;
+	build.preldr_size = build_params->preldr_size;
+	build.bldrSize = build_params->bldr_size;
+	build.kernel_size = kernel_size;
+	build.kernel_data_size = build_params->kernel_data_size;
+	build.bfm = build_params->bfm;
+	build.hackinittbl = build_params->hackinittbl;
+	build.hacksignature = build_params->hacksignature;
+	build.nobootparams = build_params->nobootparams;
+
+	params = xbios->params;
+	if (params.romsize == 0)
+		params.romsize = MIN_BIOS_SIZE;
+
+	// build into a temp file; it replaces the file only once the build succeeds.
+	if (filename != NULL) {
+		temp = tempFileName(filename);
+		if (temp == NULL)
+			result = XBIOS_ERROR_FAILED;
+	}
+
+	xbios->bios.unload();
+	if (result == XBIOS_ERROR_SUCCESS && xbios->bios.build(&build, build_params->binsize, &params, temp) != BIOS_LOAD_STATUS_SUCCESS) {
+		result = XBIOS_ERROR_FAILED;
+	}
+
+	// xcodes go in once the init table is in place; the build sets the rom size.
+	if (result == XBIOS_ERROR_SUCCESS && build_params->xcodes != NULL) {
+		layout.romsize = params.romsize;
+		layout.kernel_size = kernel_size;
+		layout.kernel_data_size = build_params->kernel_data_size;
+		layout.preldr = (build_params->preldr != NULL);
+		if (bios_inject_xcodes(xbios->bios.data, xbios->bios.size, &layout, build_params->xcodes, build_params->xcodes_size) != BIOS_MAP_ERROR_SUCCESS)
+			result = XBIOS_ERROR_FAILED;
+	}
+
+	if (result == XBIOS_ERROR_SUCCESS && temp != NULL && renameFile(temp, filename) != 0) {
+		result = XBIOS_ERROR_FAILED;
+	}
+
+	if (result != XBIOS_ERROR_SUCCESS) {
+		xbios->bios.unload();
+		if (temp != NULL)
+			deleteFile(temp);
+	}
+	else {
+		// the view stays mapped across the rename.
+		bios_detect_banks(xbios->bios.data, xbios->bios.size, &xbios->banks);
+	}
+
+	if (temp != NULL) {
+		free(temp);
+	}
+
+	// the build copies the kernel; a kernel compressed here is not needed after it.
+	if (compressed_kernel != build_params->compressed_kernel) {
+		free(compressed_kernel);
+	}
+
+	return result;
+}
+int xbios_image(XBIOS* xbios, const uint8_t** data, uint32_t* size) {
+	if (xbios == NULL || data == NULL || size == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	if (xbios->bios.data == NULL)
+		return XBIOS_ERROR_NOT_LOADED;
+
+	*data = xbios->bios.data;
+	*size = xbios->bios.size;
+	return XBIOS_ERROR_SUCCESS;
+}
+
+int xbios_compress(const uint8_t* src, const uint32_t size, uint8_t** dest, uint32_t* dest_size) {
+	if (src == NULL || dest == NULL || dest_size == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	*dest = NULL;
+	if (lzx_compress(src, size, dest, dest_size) != 0) {
+		xbios_free(*dest);
+		*dest = NULL;
+		return XBIOS_ERROR_FAILED;
+	}
+	return XBIOS_ERROR_SUCCESS;
+}
+int xbios_decompress(const uint8_t* src, const uint32_t size, uint8_t** dest, uint32_t* dest_size) {
+	uint32_t buffer_size = 0;
+
+	if (src == NULL || dest == NULL || dest_size == NULL)
+		return XBIOS_ERROR_FAILED;
+
+	*dest = NULL;
+	if (lzx_decompress(src, size, dest, &buffer_size, dest_size) != 0) {
+		xbios_free(*dest);
+		*dest = NULL;
+		return XBIOS_ERROR_FAILED;
+	}
+	return XBIOS_ERROR_SUCCESS;
+}
+
+int xbios_decode(const uint8_t* data, const uint32_t size, const uint32_t base, const char* ini, bool branch, FILE* stream) {
+	XcodeDecoder decoder;
+
+	if (data == NULL || stream == NULL || base >= size)
+		return XBIOS_ERROR_FAILED;
+
+	// the decoder only reads the xcodes.
+	if (decoder.load((uint8_t*)data, size, base, ini) != 0)
+		return XBIOS_ERROR_FAILED;
+
+	decoder.context->branch = branch;
+	decoder.context->stream = stream;
+
+	if (decoder.decodeXcodes() != 0)
+		return XBIOS_ERROR_FAILED;
+
+	return XBIOS_ERROR_SUCCESS;
+}
+
+void xbios_free(void* ptr) {
+	if (ptr != NULL)
+		free(ptr);
+}
+
+static void xbios_init_once() {
+	// the block function for this cpu is picked once, by the first handle created on any thread.
+	static std::once_flag flag;
+	std::call_once(flag, SHA1Init);
+}
+static int xbios_trial_keyring(XBIOS* xbios, const uint8_t* data, const uint32_t size, BIOS_LOAD_PARAMS* params) {
+	// find the 2BL and kernel keys in the keyring and point the load params at them.
+	// the keys are copied into the handle so it does not depend on the keyring after the load.
+
+	KEYRING_MATCH match;
+
+	if (xbios->keyring == NULL || xbios->params.bldr_key != NULL)
+		return XBIOS_ERROR_SUCCESS;
+
+	if (keyring_find_keys(xbios->keyring, data, size, params, &xbios->keyring_mcpx, &match) != KEYRING_ERROR_SUCCESS)
+		return XBIOS_ERROR_NO_KEY;
+
+	if (params->bldr_key != NULL) {
+		memcpy(xbios->bldr_key, params->bldr_key, XB_KEY_SIZE);
+		params->bldr_key = xbios->bldr_key;
+	}
+
+	if (params->kernel_key != NULL && params->kernel_key != xbios->kernel_key) {
+		memcpy(xbios->keyring_kernel_key, params->kernel_key, XB_KEY_SIZE);
+		params->kernel_key = xbios->keyring_kernel_key;
+	}
+
+	return XBIOS_ERROR_SUCCESS;
+}
+static int xbios_in_image(const Bios* bios, const uint8_t* ptr, const uint32_t size) {
+	return ptr >= bios->data && size <= bios->size && ptr <= bios->data + bios->size - size;
+}
@@ -28,6 +28,7 @@ if "%~1" == "/?" goto :help
     set "error_flag=0"
     
     set "exe=..\bin\xbios.exe"
+    set "api_test=..\bin\xbios_test.exe"
 
     set "MCPX_ROM_1_0=-mcpx mcpx\mcpx_1.0.bin"
     set "MCPX_ROM_1_1=-mcpx mcpx\mcpx_1.1.bin"
@@ -43,6 +44,8 @@ if "%~1" == "/?" goto :help
     if not exist "bios\og_1_1" mkdir bios\og_1_1
     if not exist "bios\512kb" mkdir bios\512kb
     if not exist "bios\img" mkdir bios\img
+    if not exist "eeprom" mkdir eeprom
+    if not exist "xbe" mkdir xbe
     if not exist "logs\" mkdir logs
     
     set "x3_preldr=bios\preldr\x3preldr.bin"
@@ -63,6 +66,7 @@ if "%~1" == "/?" goto :help
         echo Failed to clear root directory
         exit /b 1
     )    
+    if exist "logs\krnl_cache" rmdir /s /q logs\krnl_cache
     echo Cleaned up.    
     if "%~1" == "-c" exit /b 0
 
@@ -80,6 +84,10 @@ if "%~1" == "/?" goto :help
         echo '!exe!' not found
         exit /b 1
     )
+    if not exist "!api_test!" (
+        echo '!api_test!' not found
+        exit /b 1
+    )
 
     if not exist "!x3_preldr!" (
         echo bone stock x3 preldr not found. Used to verify preldr was extracted correctly. ^( for BIOSes ^>= 4817 ^)
@@ -128,6 +136,18 @@ if "%~1" == "/?" goto :help
     REM ensure we got help for ALL commands
     call :do_test "-? -help-all" 0
 
+    REM scan every test bios; the keys are found in the mcpx roms.
+    call :do_test "-scan noexist" 1
+    call :do_test "-scan bios -keyring mcpx -out logs\scan.csv" 0
+    call :do_test "-scan bios -keyring mcpx -json -out logs\scan.json" 0
+    call :do_test "-scan bios -keyring mcpx -index logs\scan.idx -out logs\scan_index.csv" 0
+    call :do_test "-similar noexist -index logs\scan.idx" 1
+    call :do_test "-similar logs\scan.csv -index logs\scan.csv" 1
+
+    REM a missing xbe or a file that is not an xbe fails.
+    call :do_test "-xbe noexist.xbe" 1
+    call :do_test "-xbe logs\scan.csv" 1
+
 REM run original tests for bios less than 4817
 :mcpx_1_0_bios_tests   
     call :run_og_test "bios\og_1_0" "%MCPX_ROM_1_0%"
@@ -144,6 +164,64 @@ REM run original tests for bios less than 4817
         call :cmp_file "!arg_name!_bank1.bin" "!arg_name!_bank2.bin"
         call :cmp_file "!arg_name!_bank1.bin" "!arg_name!_bank3.bin"
         call :cmp_file "!arg_name!_bank1.bin" "!arg_name!_bank4.bin"        
+
+        REM the banks are copied file to file; combining or replicating them gives back the bios.
+        call :cmp_file "bios.bin" "!arg!"
+        call :do_test "-replicate !arg_name!_bank1.bin -binsize 1024 -out replicated.bin" 0 "!arg_name!"
+        call :cmp_file "replicated.bin" "!arg!"
+        call :do_test "-replicate !arg_name!_bank1.bin -binsize 768 -out replicated.bin" 1 "!arg_name!"
+
+        REM an input can also be the output.
+        call :do_test "-combine !arg_name!_bank1.bin !arg_name!_bank2.bin !arg_name!_bank3.bin !arg_name!_bank4.bin -out !arg_name!_bank1.bin" 0 "!arg_name!"
+        call :cmp_file "!arg_name!_bank1.bin" "!arg!"
+
+        REM components are decrypted on first access; the nv2a table needs no key, the keys need the 2BL.
+        call :do_test "-ls !arg! -nv2a %MCPX_ROM_1_1%" 0 "!arg_name!"
+        call :do_test "-ls !arg! -keys %MCPX_ROM_1_1%" 1 "!arg_name!"
+        call :do_test "-ls !arg! -keys %MCPX_ROM_1_0%" 0 "!arg_name!"
+
+        REM simulate the boot path; a 1.0 bios boots on the 1.0 mcpx and stops on the 1.1 mcpx, which needs an FBL.
+        call :do_test "-ls !arg! %MCPX_ROM_1_0% -bootable" 0 "!arg_name!"
+        call :do_test "-ls !arg! %MCPX_ROM_1_1% -bootable" 1 "!arg_name!"
+
+        REM extract into the component store and rebuild the bios from its manifest; the output should be identical.
+        call :do_test "-extr !arg! %MCPX_ROM_1_0% -store store" 0 "!arg_name!"
+        call :do_test "-bld-matrix !arg_name!.ini %MCPX_ROM_1_0%" 0 "!arg_name!"
+        call :cmp_file "!arg!" "!arg_name!.bin"
+
+        REM the same through a memory file manifest in a chain.
+        del /q !arg_name!.bin 2>nul
+        call :do_test "-extr !arg! %MCPX_ROM_1_0% -store store -out @manifest + -bld-matrix @manifest %MCPX_ROM_1_0%" 0 "!arg_name!"
+        call :cmp_file "!arg!" "!arg_name!.bin"
+
+        REM a decoded xcode listing can be written to a memory file and passed on.
+        call :do_test "-xcode-decode !arg! -d -out @xcodes + -compress @xcodes -out xcodes.lzx" 0 "!arg_name!"
+
+        REM every scanned bios is in the index.
+        call :do_test "-similar !arg! %MCPX_ROM_1_0% -index logs\scan.idx -top 3" 0 "!arg_name!"
+
+        REM an exact match ranks first with every component identical.
+        !exe! -similar !arg! %MCPX_ROM_1_0% -index logs\scan.idx -top 1 > logs\similar.txt
+        call :find_str "=        =        =        =        !arg!" "logs\similar.txt"
+
+        REM a copy with a patched init table is not in the index; its source still ranks first.
+        call :do_test "-extr !arg! %MCPX_ROM_1_0%" 0 "!arg_name!"
+        call :do_test "-bld -bldr bldr.bin -inittbl inittbl.bin -krnl krnl.bin -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl -binsize 1024 -xcodes xcode_code_inject.bin -out similar_mod.bin" 0 "!arg_name!"
+        !exe! -similar similar_mod.bin %MCPX_ROM_1_0% -index logs\scan.idx -top 1 > logs\similar.txt
+        call :find_str "!arg!" "logs\similar.txt"
+
+        REM the library builds the same image as the CLI, and finds the keys in the keyring itself.
+        call :do_test "-bld -bldr bldr.bin -inittbl inittbl.bin -krnl krnl.bin -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl -binsize 1024 -out api_bios.bin" 0 "!arg_name!"
+        set "exe=!api_test!"
+        call :do_test "!arg! mcpx\mcpx_1.0.bin api_bios.bin mcpx" 0 "!arg_name!"
+        set "exe=..\bin\xbios.exe"
+
+        REM verify the test xbes with the keys of the bios, then with the extracted key files. a bios is not an xbe.
+        call :do_test "-xbe !arg! -bios !arg! %MCPX_ROM_1_0%" 1 "!arg_name!"
+        call :do_test "-xbe xbe -bios !arg! %MCPX_ROM_1_0%" 0 "!arg_name!"
+        call :do_test "-extr !arg! %MCPX_ROM_1_0% -keys" 0 "!arg_name!"
+        call :do_test "-xbe xbe -pubkey pubkey.bin -certkey cert_key.bin" 0 "!arg_name!"
+        call :do_test "-xbe xbe -pubkey cert_key.bin" 1 "!arg_name!"
     )
 if "!test_group!" == "-1.0" goto :exit
 
@@ -160,6 +238,32 @@ REM run original tests for bios greater than or equal to 4817
         
         REM compare preldr with REAL preldr. ensure we extracting it exactly as intended.
         call :cmp_file "preldr.bin" "!x3_preldr!"
+
+        REM decrypt, verify and re-encrypt every eeprom dump with the eeprom key from the 2bl.
+        REM re-encrypting an unchanged security section reproduces the dump byte for byte.
+        call :do_test "-extr !arg! %MCPX_ROM_1_1% -keys" 0 "!arg_name!"
+        for %%e in (eeprom\*.bin) do (
+            call :do_test "-eeprom %%e -eepromkey eeprom_key.bin -out eeprom_rt.bin" 0 "%%~ne"
+            call :cmp_file "%%e" "eeprom_rt.bin"
+            call :do_test "-eeprom %%e -eepromkey eeprom_key.bin -region 4 -out eeprom_eu.bin" 0 "%%~ne"
+            call :do_test "-eeprom eeprom_eu.bin -eepromkey eeprom_key.bin -region 4 -out eeprom_eu2.bin" 0 "%%~ne"
+            call :cmp_file "eeprom_eu.bin" "eeprom_eu2.bin"
+            call :do_test "-eeprom %%e -keyring mcpx" 1 "%%~ne"
+        )
+        call :do_test "-eeprom eeprom -keyring eeprom_key.bin" 0 "!arg_name!"
+
+        REM the FBL recovers the signed rom digest with its rsa public key on the way to the kernel.
+        call :do_test "-ls !arg! %MCPX_ROM_1_1% -bootable" 0 "!arg_name!"
+        call :do_test "-ls !arg! %MCPX_ROM_1_0% -bootable" 1 "!arg_name!"
+
+        REM a bounded tea search checkpoints its progress, and the same command resumes it.
+        del /q logs\tea.ckpt 2>nul
+        call :do_test "-tea-search !arg!" 1 "!arg_name!"
+        call :do_test "-tea-search !arg! -limit 1000000 -ckpt logs\tea.ckpt" 2 "!arg_name!"
+        call :do_test "-tea-search !arg! -limit 1000000 -ckpt logs\tea.ckpt" 2 "!arg_name!"
+
+        REM a checkpoint only resumes the same search.
+        call :do_test "-tea-search !arg! -offset 0 -limit 1000000 -ckpt logs\tea.ckpt" 1 "!arg_name!"
     )
 if "!test_group!" == "-1.1" goto :exit
 
@@ -194,6 +298,12 @@ if "!test_group!" == "-512" goto :exit
     REM custom bios that need 512kb and w/ no bldr (2bl) encryption (x2)
     call :run_og_test "bios\custom_512kb_noenc" "" "-romsize 512 -enc-bldr -enc-krnl"
 
+    REM a keyring is not needed for a 2BL that is not encrypted; the load falls through to no key.
+    for %%f in (bios\custom_512kb_noenc\*.bin) do (
+        call :do_test "-ls %%f -keyring mcpx -romsize 512" 0 "%%~nf"
+        call :do_test "-extr %%f -keyring mcpx -romsize 512" 0 "%%~nf"
+    )
+
 if "!test_group!" == "-custom" goto :exit
 
 :img_tests
@@ -290,6 +400,54 @@ if "!test_group!" == "-img" goto :exit
     
     exit /b 0
 
+:wait_file
+    REM wait for a file to appear; fails after about a minute.
+	if NOT !error_flag! == 0 exit /b 0
+
+    set /a jobs_total+=1
+    set "cur_job=wait for %~1"
+
+    echo.
+    echo Test !jobs_total! '!cur_job!'
+
+    for /l %%i in (1,1,60) do (
+        if exist "%~1" (
+            set /a jobs_passed+=1
+            echo Pass.
+            exit /b 0
+        )
+        ping -n 2 127.0.0.1 > nul
+    )
+
+    set error_flag=1
+    exit /b 0
+
+:find_str
+    REM check a file contains a string using findstr. pass 1 as the third argument to check it does not.
+	if NOT !error_flag! == 0 exit /b 0
+
+    set /a jobs_total+=1
+    set "expected_error=%~3"
+    if "!expected_error!" == "" set expected_error=0
+    set "cur_job=findstr /i /c:"%~1" "%~2""
+    
+    echo.
+    echo Test !jobs_total! '!cur_job!'
+
+    !cur_job! > nul
+    
+    set last_error=!errorlevel!
+    if !errorlevel! neq !expected_error! (
+        set error_flag=!last_error!        
+        echo.
+        exit /b 0
+    )
+    
+    set /a jobs_passed+=1
+    echo Pass.
+    
+    exit /b 0
+
 :help
     echo Usage: %~nx0 [-h] [-c] [-1.0] [-1.1] [-512]
     echo.
@@ -316,6 +474,9 @@ if "!test_group!" == "-img" goto :exit
         call :do_test "-ls !arg! -datatbl" 0 "!arg_name!"
         call :do_test "-ls !arg! -img !mcpx_rom! !extra_args!" 0 "!arg_name!"
         
+        REM test the keys can be found without specifying the mcpx rom
+        if not "!mcpx_rom!" == "" call :do_test "-ls !arg! -img -keyring mcpx !extra_args!" 0 "!arg_name!"
+        
         call :run_decode_xcode_tests
 
         REM test extracting bios 
@@ -327,6 +488,10 @@ if "!test_group!" == "-img" goto :exit
         REM cmp decompressed files
         call :cmp_file "krnl_decompressed.img" "krnl.img"
 
+        REM the same round trip chained through memory files; only the last output is written.
+        call :do_test "-decompress krnl.bin -out @img + -compress @img -out @krnl + -decompress @krnl -out krnl_chained.img" 0 "!arg_name!"
+        call :cmp_file "krnl_chained.img" "krnl.img"
+
         REM compress decompressed extracted krnl.
         call :do_test "-compress krnl_decompressed.img -out krnl_compressed.bin" 0 "!arg_name!"
 
@@ -338,9 +503,72 @@ if "!test_group!" == "-img" goto :exit
         
         REM test built bios; running -ls calls most things in the program.
         call :do_test "-ls bios.bin %MCPX_ROM_1_0% !extra_args!" 0
+
+        REM list it again with a compiled identification database.
+        echo mcpx 5d270675b54eb8071b480e42d22a3015ac211cef "MCPX" 1.0 rev=0 sbkey=0x1A5 > ident.txt
+        call :do_test "-mkident ident.txt -out ident.db" 0
+        call :do_test "-ls bios.bin %MCPX_ROM_1_0% -ident ident.db !extra_args!" 0
+
+        REM build it again from the uncompressed kernel image; the output should be identical.
+        call :do_test "-bld -bldr bldr.bin -inittbl inittbl.bin -krnl krnl.img -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl !extra_args! -binsize 1024 -out bios_img.bin" 0
+        call :cmp_file "bios.bin" "bios_img.bin"
+        call :do_test "-diff bios.bin bios_img.bin %MCPX_ROM_1_0% !extra_args!" 0
+
+        REM inject xcodes and decode them back out of the built bios. a small injection replaces the exit xcode;
+        REM a large one is reached with a jump to free space, so the decode follows branches.
+        echo|set /p="XBOX"> xcode_code.bin
+        copy /b mcpx\mcpx_1.0.bin + mcpx\mcpx_1.0.bin + mcpx\mcpx_1.0.bin + mcpx\mcpx_1.0.bin + xcode_code.bin xcode_big.bin > nul
+        for %%x in (xcode_code xcode_big) do (
+            call :do_test "-x86-encode %%x.bin -out %%x_inject.bin" 0 "!arg_name!"
+            call :do_test "-bld -bldr bldr.bin -inittbl inittbl.bin -krnl krnl.bin -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl !extra_args! -binsize 1024 -xcodes %%x_inject.bin -out bios_xcodes.bin" 0
+            call :do_test "-ls bios_xcodes.bin %MCPX_ROM_1_0% !extra_args!" 0
+            call :do_test "-xcode-decode bios_xcodes.bin -branch -d -out logs\xcodes_injected.txt" 0
+            call :find_str "584f4258" "logs\xcodes_injected.txt"
+        )
+
+        REM watch mode builds the same image, and rebuilds it when the compressed kernel is swapped for the kernel image.
+        REM -limit 2 exits after the second image. the output and the kernel are renamed into place, so neither is read part way written.
+        copy /y krnl.bin watch_krnl.bin > nul
+        del /q watch.bin logs\watch.done 2>nul
+        start "" /b cmd /c "!exe! -bld -bldr bldr.bin -inittbl inittbl.bin -krnl watch_krnl.bin -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl !extra_args! -binsize 1024 -watch -limit 2 -out watch.bin > logs\watch.txt 2>&1 & echo done> logs\watch.done"
+        call :wait_file "watch.bin"
+        call :cmp_file "bios.bin" "watch.bin"
+        copy /y krnl.img watch_krnl.tmp > nul
+        move /y watch_krnl.tmp watch_krnl.bin > nul
+        call :wait_file "logs\watch.done"
+        call :find_str "Compressed kernel image" "logs\watch.txt"
+        call :cmp_file "bios.bin" "watch.bin"
+
+        REM a failed build leaves the existing output as it was.
+        call :do_test "-bld -bldr bldr.bin -inittbl inittbl.bin -krnl krnl.bin -krnldata krnl_data.bin %MCPX_ROM_1_0% -enc-krnl !extra_args! -binsize 1024 -xcodes noexist.bin -out bios_img.bin" 1
+        call :cmp_file "bios.bin" "bios_img.bin"
+
+        REM patch the extracted bios into the built bios and back.
+        call :do_test "-mkpatch !arg! bios.bin %MCPX_ROM_1_0% !extra_args! -out bios.xbp" 0
+        call :do_test "-applypatch !arg! bios.xbp %MCPX_ROM_1_0% !extra_args! -out bios_patched.bin" 0
+        call :cmp_file "bios.bin" "bios_patched.bin"
 	
 	  REM compare decompressed kernel with an already decompressed kernel image to ensure we havent fucked anything up.
         call :cmp_file "krnl.img" "bios\img\!arg_name!_krnl.img"
+
+        REM extract through the kernel cache; the first run decompresses into it, the second maps the cached image.
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -krnl-cache logs\krnl_cache" 0 "!arg_name!"
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -krnl-cache logs\krnl_cache" 0 "!arg_name!"
+        call :cmp_file "krnl.img" "bios\img\!arg_name!_krnl.img"
+
+        REM a cached image without a valid size and hash is discarded and decompressed again.
+        for %%k in (logs\krnl_cache\*.img) do copy /y /b "bios\img\!arg_name!_krnl.img" "%%k" >nul
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -krnl-cache logs\krnl_cache" 0 "!arg_name!"
+        call :cmp_file "krnl.img" "bios\img\!arg_name!_krnl.img"
+
+        REM library messages go to the -log file, filtered by -loglevel.
+        del /q logs\log_info.log logs\log_error.log 2>nul
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -log logs\log_info.log" 0 "!arg_name!"
+        call :find_str "Writing compressed kernel" "logs\log_info.log"
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -loglevel debug -log logs\log_info.log" 0 "!arg_name!"
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -loglevel error -log logs\log_error.log" 0 "!arg_name!"
+        call :find_str "Writing" "logs\log_error.log" 1
+        call :do_test "-extr !arg! !mcpx_rom! !extra_args! -loglevel verbose" 1 "!arg_name!"
     )
     exit /b 0
 
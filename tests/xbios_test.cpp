@@ -0,0 +1,472 @@
+// xbios_test.cpp: tests for libxbios. run by test.bat.
+
+/* Copyright(C) 2024 tommojphillips
+ *
+ * This program is free software : you can redistribute it and /or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.If not, see < https://www.gnu.org/licenses/>.
+*/
+
+// Author: tommojphillips
+// GitHub: https:\\github.com\tommojphillips
+
+// usage: xbios_test <bios> <mcpx rom> <built bios> <keyring>
+//  bios:		a retail bios that decrypts with the mcpx rom.
+//  built bios:	the bios built from its extracted components with: -bld <mcpx rom> -enc-krnl -binsize 1024
+//  keyring:	a key file or directory with the sb key of the bios.
+// returns 0 if every test passes.
+
+// std incl
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+
+// user incl
+#include "xbios.h"
+#include "log.h"
+
+#define TEST_THREADS 4
+#define TEST_BINSIZE (1024 * 1024)
+#define TEST_OUT_FILE "xbios_test.bin"
+
+typedef struct {
+	const char* bios_file;
+	const char* keyring_path;
+	uint8_t* mcpx;
+	uint8_t* built;
+	uint32_t built_size;
+	const uint8_t* components[XBIOS_COMPONENT_COUNT];
+	uint32_t sizes[XBIOS_COMPONENT_COUNT];
+	XBIOS* xbios;				// holds the bios the components point into
+	XBIOS_INFO info;
+} TEST_CONTEXT;
+
+static int failed = 0;
+
+static void check(bool pass, const char* name);
+static uint8_t* read_file(const char* filename, uint32_t* size);
+static bool same(const uint8_t* a, const uint32_t a_size, const uint8_t* b, const uint32_t b_size);
+static void init_build_params(const TEST_CONTEXT* ctx, XBIOS_BUILD_PARAMS* build_params);
+
+static void test_errors(TEST_CONTEXT* ctx);
+static void test_load(TEST_CONTEXT* ctx);
+static void test_extract(TEST_CONTEXT* ctx);
+static void test_build(TEST_CONTEXT* ctx);
+static void test_build_file(TEST_CONTEXT* ctx);
+static void test_reload(TEST_CONTEXT* ctx);
+static void test_compress(TEST_CONTEXT* ctx);
+static void test_keyring(TEST_CONTEXT* ctx);
+static void test_threads(TEST_CONTEXT* ctx);
+static void test_log(TEST_CONTEXT* ctx);
+
+int main(int argc, char** argv) {
+	TEST_CONTEXT ctx;
+	uint32_t size = 0;
+
+	if (argc != 5) {
+		printf("usage: xbios_test <bios> <mcpx rom> <built bios> <keyring>\n");
+		return 1;
+	}
+
+	memset(&ctx, 0, sizeof(TEST_CONTEXT));
+	ctx.bios_file = argv[1];
+	ctx.keyring_path = argv[4];
+
+	ctx.mcpx = read_file(argv[2], &size);
+	if (ctx.mcpx == NULL || size != 512) {
+		printf("Error: could not read the mcpx rom '%s'\n", argv[2]);
+		return 1;
+	}
+	ctx.built = read_file(argv[3], &ctx.built_size);
+	if (ctx.built == NULL) {
+		printf("Error: could not read the built bios '%s'\n", argv[3]);
+		return 1;
+	}
+
+	test_errors(&ctx);
+	test_load(&ctx);
+	if (ctx.xbios != NULL) {
+		test_extract(&ctx);
+		test_build(&ctx);
+		test_build_file(&ctx);
+		test_reload(&ctx);
+		test_compress(&ctx);
+	}
+	test_keyring(&ctx);
+	test_threads(&ctx);
+	test_log(&ctx);
+
+	xbios_destroy(ctx.xbios);
+	free(ctx.mcpx);
+	free(ctx.built);
+
+	printf("\n%s\n", failed == 0 ? "All tests passed." : "Tests failed.");
+	return failed == 0 ? 0 : 1;
+}
+
+static void test_errors(TEST_CONTEXT* ctx) {
+	// calls on an empty handle, and loads that can not succeed.
+
+	XBIOS_INFO info;
+	const uint8_t* data = NULL;
+	uint32_t size = 0;
+
+	XBIOS* xbios = xbios_create(NULL);
+	check(xbios != NULL, "create with no params");
+	if (xbios == NULL)
+		return;
+
+	check(xbios_list(xbios, &info) == XBIOS_ERROR_NOT_LOADED, "list before a load");
+	check(xbios_image(xbios, &data, &size) == XBIOS_ERROR_NOT_LOADED, "image before a load");
+	check(xbios_extract(xbios, XBIOS_COMPONENT_BLDR, &data, &size) == XBIOS_ERROR_NOT_LOADED, "extract before a load");
+	check(xbios_load(xbios, ctx->mcpx, 512) == XBIOS_ERROR_INVALID_SIZE, "load an invalid size");
+	check(xbios_load_file(xbios, "noexist.bin") == XBIOS_ERROR_FAILED, "load a missing file");
+
+	xbios_destroy(xbios);
+}
+static void test_load(TEST_CONTEXT* ctx) {
+	// load and list the bios with the mcpx rom.
+
+	XBIOS_PARAMS params;
+
+	xbios_init_params(&params);
+	params.mcpx = ctx->mcpx;
+
+	ctx->xbios = xbios_create(&params);
+	check(ctx->xbios != NULL, "create");
+	if (ctx->xbios == NULL)
+		return;
+
+	check(xbios_load_file(ctx->xbios, ctx->bios_file) == XBIOS_ERROR_SUCCESS, "load file");
+	check(xbios_list(ctx->xbios, &ctx->info) == XBIOS_ERROR_SUCCESS, "list");
+	check(ctx->info.kernel_size != 0 && ctx->info.kernel_data_size != 0 && ctx->info.init_tbl_size != 0, "list sizes");
+	check(ctx->info.romsize != 0 && ctx->info.size % ctx->info.romsize == 0, "list rom size");
+
+	if (failed != 0) {
+		xbios_destroy(ctx->xbios);
+		ctx->xbios = NULL;
+	}
+}
+static void test_extract(TEST_CONTEXT* ctx) {
+	// every component; the sizes match the listing.
+
+	int i;
+
+	for (i = XBIOS_COMPONENT_BLDR; i < XBIOS_COMPONENT_COUNT; ++i) {
+		check(xbios_extract(ctx->xbios, (XBIOS_COMPONENT)i, &ctx->components[i], &ctx->sizes[i]) == XBIOS_ERROR_SUCCESS, "extract");
+	}
+	check(ctx->sizes[XBIOS_COMPONENT_INIT_TBL] == ctx->info.init_tbl_size, "extract init tbl size");
+	check(ctx->sizes[XBIOS_COMPONENT_KERNEL] == ctx->info.kernel_size, "extract kernel size");
+	check(ctx->sizes[XBIOS_COMPONENT_KERNEL_DATA] == ctx->info.kernel_data_size, "extract kernel data size");
+	check(ctx->sizes[XBIOS_COMPONENT_KERNEL_IMG] > ctx->sizes[XBIOS_COMPONENT_KERNEL], "extract kernel image");
+}
+static void test_build(TEST_CONTEXT* ctx) {
+	// build the components into a new handle; the image is the one the CLI built.
+	// the kernel image is compressed by the build to the same bytes.
+
+	XBIOS_PARAMS params;
+	XBIOS_BUILD_PARAMS build_params;
+	const uint8_t* image = NULL;
+	uint32_t size = 0;
+	XBIOS* xbios;
+
+	xbios_init_params(&params);
+	params.mcpx = ctx->mcpx;
+	params.romsize = ctx->info.romsize;
+	params.enc_kernel = true;
+
+	xbios = xbios_create(&params);
+	if (xbios == NULL) {
+		check(false, "create for the build");
+		return;
+	}
+
+	init_build_params(ctx, &build_params);
+	check(xbios_build(xbios, &build_params, NULL) == XBIOS_ERROR_SUCCESS, "build");
+	check(xbios_image(xbios, &image, &size) == XBIOS_ERROR_SUCCESS && same(image, size, ctx->built, ctx->built_size), "build matches the CLI build");
+
+	build_params.compressed_kernel = NULL;
+	build_params.kernel_size = 0;
+	build_params.kernel_img = ctx->components[XBIOS_COMPONENT_KERNEL_IMG];
+	build_params.kernel_img_size = ctx->sizes[XBIOS_COMPONENT_KERNEL_IMG];
+	check(xbios_build(xbios, &build_params, NULL) == XBIOS_ERROR_SUCCESS, "build from the kernel image");
+	check(xbios_image(xbios, &image, &size) == XBIOS_ERROR_SUCCESS && same(image, size, ctx->built, ctx->built_size), "build from the kernel image matches");
+
+	build_params.bldr = NULL;
+	check(xbios_build(xbios, &build_params, NULL) == XBIOS_ERROR_FAILED, "build with no 2BL fails");
+
+	xbios_destroy(xbios);
+}
+static void test_build_file(TEST_CONTEXT* ctx) {
+	// a build straight into a file; a failed build leaves the file as it was.
+
+	XBIOS_PARAMS params;
+	XBIOS_BUILD_PARAMS build_params;
+	uint8_t* data;
+	uint32_t size = 0;
+	XBIOS* xbios;
+	static const uint8_t xcodes[] = { 0x03, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };	// xc_mem_write 0x10, 0
+
+	xbios_init_params(&params);
+	params.mcpx = ctx->mcpx;
+	params.romsize = ctx->info.romsize;
+	params.enc_kernel = true;
+
+	xbios = xbios_create(&params);
+	if (xbios == NULL) {
+		check(false, "create for the file build");
+		return;
+	}
+
+	init_build_params(ctx, &build_params);
+	check(xbios_build(xbios, &build_params, TEST_OUT_FILE) == XBIOS_ERROR_SUCCESS, "build into a file");
+	data = read_file(TEST_OUT_FILE, &size);
+	check(data != NULL && same(data, size, ctx->built, ctx->built_size), "built file matches the CLI build");
+	free(data);
+
+	build_params.bldr = NULL;
+	check(xbios_build(xbios, &build_params, TEST_OUT_FILE) == XBIOS_ERROR_FAILED, "failed build into a file");
+	data = read_file(TEST_OUT_FILE, &size);
+	check(data != NULL && same(data, size, ctx->built, ctx->built_size), "failed build leaves the file");
+	free(data);
+
+	// xcodes are added after the build; the image changes, but only in the first bank and its mirrors.
+	init_build_params(ctx, &build_params);
+	build_params.xcodes = xcodes;
+	build_params.xcodes_size = sizeof(xcodes);
+	check(xbios_build(xbios, &build_params, TEST_OUT_FILE) == XBIOS_ERROR_SUCCESS, "build with xcodes");
+	data = read_file(TEST_OUT_FILE, &size);
+	check(data != NULL && size == ctx->built_size && !same(data, size, ctx->built, ctx->built_size), "build with xcodes changes the image");
+	check(data != NULL && size == TEST_BINSIZE && memcmp(data, data + size - ctx->info.romsize, ctx->info.romsize) == 0, "build with xcodes replicates the bank");
+	free(data);
+
+	xbios_destroy(xbios);
+	remove(TEST_OUT_FILE);
+}
+static void test_reload(TEST_CONTEXT* ctx) {
+	// load the built image from memory; the kernel image comes back out of it.
+
+	XBIOS_PARAMS params;
+	XBIOS_INFO info;
+	const uint8_t* data = NULL;
+	uint32_t size = 0;
+	XBIOS* xbios;
+
+	xbios_init_params(&params);
+	params.mcpx = ctx->mcpx;
+	params.enc_kernel = true;
+
+	xbios = xbios_create(&params);
+	if (xbios == NULL) {
+		check(false, "create for the reload");
+		return;
+	}
+
+	check(xbios_load(xbios, ctx->built, ctx->built_size) == XBIOS_ERROR_SUCCESS, "load from memory");
+	check(xbios_list(xbios, &info) == XBIOS_ERROR_SUCCESS && info.kernel_size == ctx->info.kernel_size, "list the built bios");
+	check(xbios_extract(xbios, XBIOS_COMPONENT_KERNEL_IMG, &data, &size) == XBIOS_ERROR_SUCCESS &&
+		same(data, size, ctx->components[XBIOS_COMPONENT_KERNEL_IMG], ctx->sizes[XBIOS_COMPONENT_KERNEL_IMG]), "kernel image of the built bios");
+
+	xbios_destroy(xbios);
+}
+static void test_compress(TEST_CONTEXT* ctx) {
+	// the kernel decompresses to the kernel image and compresses back to the same bytes.
+
+	uint8_t* img = NULL;
+	uint8_t* krnl = NULL;
+	uint32_t img_size = 0;
+	uint32_t krnl_size = 0;
+
+	check(xbios_decompress(ctx->components[XBIOS_COMPONENT_KERNEL], ctx->sizes[XBIOS_COMPONENT_KERNEL], &img, &img_size) == XBIOS_ERROR_SUCCESS &&
+		same(img, img_size, ctx->components[XBIOS_COMPONENT_KERNEL_IMG], ctx->sizes[XBIOS_COMPONENT_KERNEL_IMG]), "decompress");
+	check(img != NULL && xbios_compress(img, img_size, &krnl, &krnl_size) == XBIOS_ERROR_SUCCESS &&
+		same(krnl, krnl_size, ctx->components[XBIOS_COMPONENT_KERNEL], ctx->sizes[XBIOS_COMPONENT_KERNEL]), "compress");
+
+	xbios_free(img);
+	xbios_free(krnl);
+}
+static void test_keyring(TEST_CONTEXT* ctx) {
+	// the keys are found without the mcpx rom.
+
+	XBIOS_PARAMS params;
+	XBIOS_INFO info;
+	KEYRING* keyring;
+	XBIOS* xbios;
+
+	keyring = xbios_keyring_load(ctx->keyring_path);
+	check(keyring != NULL, "keyring load");
+	if (keyring == NULL)
+		return;
+
+	xbios_init_params(&params);
+	params.keyring = keyring;
+
+	xbios = xbios_create(&params);
+	check(xbios != NULL, "create with a keyring");
+	if (xbios != NULL) {
+		check(xbios_load_file(xbios, ctx->bios_file) == XBIOS_ERROR_SUCCESS, "load with a keyring");
+		// the handle keeps its own copy of the keys.
+		xbios_keyring_destroy(keyring);
+		keyring = NULL;
+		check(xbios_list(xbios, &info) == XBIOS_ERROR_SUCCESS && info.kernel_size == ctx->info.kernel_size, "list with a keyring");
+		xbios_destroy(xbios);
+	}
+
+	check(xbios_keyring_load("noexist") == NULL, "keyring load of a missing path");
+	xbios_keyring_destroy(keyring);
+}
+static void test_threads(TEST_CONTEXT* ctx) {
+	// separate handles on separate threads; each decompresses the same kernel image.
+
+	std::thread threads[TEST_THREADS];
+	bool pass[TEST_THREADS];
+	int i;
+
+	if (ctx->components[XBIOS_COMPONENT_KERNEL_IMG] == NULL) {
+		check(false, "threads");
+		return;
+	}
+
+	for (i = 0; i < TEST_THREADS; ++i) {
+		pass[i] = false;
+		threads[i] = std::thread([ctx, &pass, i]() {
+			XBIOS_PARAMS params;
+			const uint8_t* data = NULL;
+			uint32_t size = 0;
+
+			xbios_init_params(&params);
+			params.mcpx = ctx->mcpx;
+
+			XBIOS* xbios = xbios_create(&params);
+			if (xbios == NULL)
+				return;
+			pass[i] = xbios_load_file(xbios, ctx->bios_file) == XBIOS_ERROR_SUCCESS &&
+				xbios_extract(xbios, XBIOS_COMPONENT_KERNEL_IMG, &data, &size) == XBIOS_ERROR_SUCCESS &&
+				same(data, size, ctx->components[XBIOS_COMPONENT_KERNEL_IMG], ctx->sizes[XBIOS_COMPONENT_KERNEL_IMG]);
+			xbios_destroy(xbios);
+		});
+	}
+	for (i = 0; i < TEST_THREADS; ++i) {
+		threads[i].join();
+		check(pass[i], "thread");
+	}
+}
+
+static void test_log(TEST_CONTEXT* ctx) {
+	// levels, buffering and sinks; the ring keeps the newest text. the log is process wide, so it is reset after.
+
+	static const char tail[] = "Warning: kept\n0123456789\nError: abcdefghij\n";
+	LOG_RING ring;
+	LOG_SINK sink;
+	XBIOS_PARAMS params;
+	XBIOS_INFO info;
+	XBIOS* xbios;
+	char text[LOG_MESSAGE_MAX];
+	uint64_t written;
+
+	check(log_ring_init(&ring, 32) == 0, "log ring init");
+	if (ring.data == NULL)
+		return;
+	log_sink_ring(&sink, &ring);
+	log_set_sink(&sink);
+	log_set_buffered(true);
+
+	log_set_level(LOG_LEVEL_WARN);
+	log_info("dropped");
+	log_warn("kept");
+	log_ring_read(&ring, text, sizeof(text));
+	check(strcmp(text, "Warning: kept\n") == 0, "log level");
+
+	// info is buffered until a flush; errors flush.
+	log_set_level(LOG_LEVEL_DEBUG);
+	log_debug("0123456789");
+	log_ring_read(&ring, text, sizeof(text));
+	check(strcmp(text, "Warning: kept\n") == 0, "log buffered");
+	log_error("abcdefghij");
+	check(log_ring_read(&ring, text, sizeof(text)) == 32 && strcmp(text, tail + sizeof(tail) - 1 - 32) == 0, "log ring wraps");
+
+	// a thread's buffer is flushed when it exits.
+	std::thread([]() { log_info("thread"); }).join();
+	log_ring_read(&ring, text, sizeof(text));
+	check(strcmp(text + strlen(text) - 7, "thread\n") == 0, "log thread exit");
+
+	// library messages go to the sink. a load is lazy; the 2BL is decrypted by the list.
+	log_ring_free(&ring);
+	log_ring_init(&ring, sizeof(text));
+	log_set_level(LOG_LEVEL_INFO);
+	xbios_init_params(&params);
+	params.mcpx = ctx->mcpx;
+	xbios = xbios_create(&params);
+	if (xbios != NULL) {
+		if (xbios_load_file(xbios, ctx->bios_file) == XBIOS_ERROR_SUCCESS)
+			xbios_list(xbios, &info);
+		xbios_destroy(xbios);
+	}
+	log_flush();
+	log_ring_read(&ring, text, sizeof(text));
+	check(strstr(text, "Decrypting 2BL") != NULL, "log library messages");
+
+	log_set_sink(NULL);
+	written = ring.written;
+	log_error("not logged");
+	check(ring.written == written, "log null sink");
+
+	log_set_level(LOG_LEVEL_INFO);
+	log_ring_free(&ring);
+}
+
+static void check(bool pass, const char* name) {
+	printf("%s: %s\n", name, pass ? "pass" : "FAIL");
+	if (!pass)
+		failed++;
+}
+static uint8_t* read_file(const char* filename, uint32_t* size) {
+	FILE* file;
+	uint8_t* data;
+	long len;
+
+	file = fopen(filename, "rb");
+	if (file == NULL)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	data = (uint8_t*)malloc(len > 0 ? len : 1);
+	if (data != NULL && fread(data, 1, len, file) != (size_t)len) {
+		free(data);
+		data = NULL;
+	}
+	fclose(file);
+
+	*size = (uint32_t)len;
+	return data;
+}
+static bool same(const uint8_t* a, const uint32_t a_size, const uint8_t* b, const uint32_t b_size) {
+	return a != NULL && b != NULL && a_size == b_size && memcmp(a, b, a_size) == 0;
+}
+static void init_build_params(const TEST_CONTEXT* ctx, XBIOS_BUILD_PARAMS* build_params) {
+	// the same build as the CLI: -bld <mcpx rom> -enc-krnl -binsize 1024.
+	xbios_init_build_params(build_params);
+	build_params->init_tbl = ctx->components[XBIOS_COMPONENT_INIT_TBL];
+	build_params->bldr = ctx->components[XBIOS_COMPONENT_BLDR];
+	build_params->compressed_kernel = ctx->components[XBIOS_COMPONENT_KERNEL];
+	build_params->kernel_data = ctx->components[XBIOS_COMPONENT_KERNEL_DATA];
+	build_params->init_tbl_size = ctx->sizes[XBIOS_COMPONENT_INIT_TBL];
+	build_params->bldr_size = ctx->sizes[XBIOS_COMPONENT_BLDR];
+	build_params->kernel_size = ctx->sizes[XBIOS_COMPONENT_KERNEL];
+	build_params->kernel_data_size = ctx->sizes[XBIOS_COMPONENT_KERNEL_DATA];
+	build_params->binsize = TEST_BINSIZE;
+}